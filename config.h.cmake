@@ -10,6 +10,7 @@
 #cmakedefine HAVE_NICE
 #cmakedefine HAVE_EDITLINE
 #cmakedefine HAVE_SYSTEMD
+#cmakedefine HAVE_ZLIB
 
 #cmakedefine ICINGA2_UNITY_BUILD
 #cmakedefine ICINGA2_STACKTRACE_USE_BACKTRACE_SYMBOLS
@@ -17,8 +17,15 @@
 #include "base/workqueue.hpp"
 #include "base/context.hpp"
 #include "base/application.hpp"
+#include "base/configuration.hpp"
+#include "base/utility.hpp"
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <map>
+#include <numeric>
 #include <boost/exception/errinfo_api_function.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
 #include <boost/exception/errinfo_errno.hpp>
 #include <boost/exception/errinfo_file_name.hpp>
 
@@ -458,20 +465,94 @@ void ConfigObject::SetAuthority(bool authority)
 	}
 }
 
-void ConfigObject::DumpObjects(const String& filename, int attributeTypes)
+/* How many objects are serialized (in parallel) before they're written to disk. */
+static const size_t l_DumpSliceSize = 16 * 1024;
+
+/* Incremental state dumps are compacted at least this often (in seconds). */
+static const double l_DumpCompactionInterval = 60 * 60;
+
+static double l_LastFullDump = 0;
+
+std::atomic<double> ConfigObject::m_LastDumpDuration (0);
+std::atomic<size_t> ConfigObject::m_LastDumpObjects (0);
+
+void ConfigObject::OnStateFieldChanged()
 {
-	Log(LogInformation, "ConfigObject")
-		<< "Dumping program state to file '" << filename << "'";
+	MarkStateChanged();
+}
 
-	try {
-		Utility::Glob(filename + ".tmp.*", &Utility::Remove, GlobFile);
-	} catch (const std::exception& ex) {
-		Log(LogWarning, "ConfigObject") << DiagnosticInformation(ex);
+/**
+ * Makes the next incremental state dump include this object.
+ *
+ * The setters of state attributes do this on their own, but changing
+ * a dictionary or an array stored in a state attribute in place doesn't.
+ */
+void ConfigObject::MarkStateChanged()
+{
+	m_StateVersion.fetch_add(1);
+}
+
+/* With Configuration.BinaryStateFile the state file is a header, CBOR-encoded objects and an index:
+ * their offsets, the number of objects and the index offset (uint64 little-endian), a trailer.
+ * Otherwise it consists of JSON-encoded objects as netstrings. Both formats are read.
+ */
+static const char l_StateMagic[] = "I2STAT01";
+static const char l_StateIndexMagic[] = "I2STIDX1";
+static const uint64_t l_StateMagicLength = 8;
+static const uint64_t l_StateIndexTrailerLength = 8 + 8 + l_StateMagicLength;
+
+static void AppendUInt64(std::string& buffer, uint64_t value)
+{
+	for (int shift = 0; shift < 64; shift += 8) {
+		buffer += (char)(value >> shift);
 	}
+}
 
-	AtomicFile fp (filename, 0600);
-	StdioStream::Ptr sfp = new StdioStream(&fp, false);
+static uint64_t ParseUInt64(const char *data)
+{
+	uint64_t value = 0;
+
+	for (int i = 7; i >= 0; i--) {
+		value = (value << 8u) | (unsigned char)data[i];
+	}
 
+	return value;
+}
+
+static bool IsBinaryStateFile(const String& filename)
+{
+	std::ifstream fp (filename.CStr(), std::ios_base::in | std::ios_base::binary);
+	char magic[l_StateMagicLength];
+
+	return fp.read(magic, l_StateMagicLength) && !memcmp(magic, l_StateMagic, l_StateMagicLength);
+}
+
+static String GetIncrementalDumpPath(const String& filename)
+{
+	return filename + ".incremental";
+}
+
+static std::streamoff GetFileSize(const String& path)
+{
+	std::ifstream fp (path.CStr(), std::ios_base::in | std::ios_base::binary | std::ios_base::ate);
+
+	return fp ? std::streamoff(fp.tellg()) : std::streamoff(-1);
+}
+
+/**
+ * Serializes the objects of all types in parallel and passes them to the callback in order.
+ *
+ * @param attributeTypes The attributes to serialize
+ * @param onlyModified Whether to skip objects which haven't changed since they were dumped
+ * @param binary Whether to encode the objects as CBOR instead of JSON
+ * @param dumped The objects handled and their state versions, to be marked as dumped once persisted
+ * @param write Called for each encoded object
+ *
+ * @return The number of objects written
+ */
+size_t ConfigObject::SerializeObjects(int attributeTypes, bool onlyModified, bool binary,
+	std::vector<std::pair<ConfigObject::Ptr, uint_fast64_t>>& dumped, const std::function<void(const String&)>& write)
+{
 	for (const Type::Ptr& type : Type::GetAllTypes()) {
 		auto *dtype = dynamic_cast<ConfigType *>(type.get());
 
@@ -479,31 +560,217 @@ void ConfigObject::DumpObjects(const String& filename, int attributeTypes)
 			continue;
 
 		for (const ConfigObject::Ptr& object : dtype->GetObjects()) {
+			/* Read before serializing, so changes in the meantime aren't lost. */
+			uint_fast64_t version = object->m_StateVersion.load();
+
+			if (onlyModified && version == object->m_DumpedStateVersion)
+				continue;
+
+			dumped.emplace_back(object, version);
+		}
+	}
+
+	WorkQueue upq (0, Configuration::Concurrency, LogNotice);
+	upq.SetName("ConfigObject::DumpObjects");
+
+	std::vector<String> messages;
+	std::vector<size_t> ids;
+	size_t written = 0;
+
+	for (size_t offset = 0; offset < dumped.size(); offset += l_DumpSliceSize) {
+		size_t count = std::min(l_DumpSliceSize, dumped.size() - offset);
+
+		messages.clear();
+		messages.resize(count);
+		ids.resize(count);
+		std::iota(ids.begin(), ids.end(), 0);
+
+		upq.ParallelFor(ids, [&dumped, &messages, offset, attributeTypes, binary](size_t id) {
+			auto& object (dumped[offset + id].first);
 			Dictionary::Ptr update = Serialize(object, attributeTypes);
 
 			if (!update)
-				continue;
+				return;
 
 			Dictionary::Ptr persistentObject = new Dictionary({
-				{ "type", type->GetName() },
+				{ "type", object->GetReflectionType()->GetName() },
 				{ "name", object->GetName() },
 				{ "update", update }
 			});
 
-			String json = JsonEncode(persistentObject);
+			messages[id] = binary ? CborEncode(persistentObject) : JsonEncode(persistentObject);
+		});
+
+		upq.Join();
 
-			NetString::WriteStringToStream(sfp, json);
+		if (upq.HasExceptions())
+			boost::rethrow_exception(upq.GetExceptions().front());
+
+		for (auto& message : messages) {
+			if (!message.IsEmpty()) {
+				write(message);
+				written++;
+			}
 		}
 	}
 
-	sfp->Close();
+	return written;
+}
+
+void ConfigObject::DumpObjects(const String& filename, int attributeTypes)
+{
+	Log(LogInformation, "ConfigObject")
+		<< "Dumping program state to file '" << filename << "'";
+
+	double start = Utility::GetTime();
+
+	try {
+		Utility::Glob(filename + ".tmp.*", &Utility::Remove, GlobFile);
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "ConfigObject") << DiagnosticInformation(ex);
+	}
+
+	AtomicFile fp (filename, 0600);
+
+	std::vector<std::pair<ConfigObject::Ptr, uint_fast64_t>> dumped;
+	size_t written;
+
+	/* Older versions can only read the JSON format, so the binary one is opt-in. */
+	if (Configuration::BinaryStateFile) {
+		std::vector<uint64_t> offsets;
+		uint64_t offset = l_StateMagicLength;
+
+		fp.write(l_StateMagic, l_StateMagicLength);
+
+		written = SerializeObjects(attributeTypes, false, true, dumped, [&fp, &offsets, &offset](const String& record) {
+			offsets.emplace_back(offset);
+			fp.write(record.CStr(), record.GetLength());
+			offset += record.GetLength();
+		});
+
+		std::string index;
+		index.reserve(offsets.size() * 8u + l_StateIndexTrailerLength);
+
+		for (auto recordOffset : offsets) {
+			AppendUInt64(index, recordOffset);
+		}
+
+		AppendUInt64(index, offsets.size());
+		AppendUInt64(index, offset);
+		index.append(l_StateIndexMagic, l_StateMagicLength);
+
+		fp.write(index.data(), index.size());
+	} else {
+		StdioStream::Ptr sfp = new StdioStream(&fp, false);
+
+		written = SerializeObjects(attributeTypes, false, false, dumped, [&sfp](const String& message) {
+			NetString::WriteStringToStream(sfp, message);
+		});
+
+		sfp->Close();
+	}
+
 	fp.Commit();
+
+	/* The full dump supersedes all incremental ones, but only once it's committed. */
+	String incrementalPath = GetIncrementalDumpPath(filename);
+
+	if (Utility::PathExists(incrementalPath))
+		Utility::Remove(incrementalPath);
+
+	for (auto& object : dumped) {
+		object.first->m_DumpedStateVersion = object.second;
+	}
+
+	l_LastFullDump = start;
+	m_LastDumpDuration.store(Utility::GetTime() - start);
+	m_LastDumpObjects.store(written);
+
+	Log(LogNotice, "ConfigObject")
+		<< "Dumped " << written << " objects in " << m_LastDumpDuration.load() << " seconds.";
+}
+
+/**
+ * Appends the objects changed since the previous dump to a separate file
+ * which is merged into the state file by the next full dump. The latter
+ * happens periodically or once the appended data grows too large.
+ *
+ * @param filename The state file
+ * @param attributeTypes The attributes to dump
+ */
+void ConfigObject::DumpObjectsIncremental(const String& filename, int attributeTypes)
+{
+	String incrementalPath = GetIncrementalDumpPath(filename);
+	double start = Utility::GetTime();
+
+	if (start - l_LastFullDump >= l_DumpCompactionInterval) {
+		DumpObjects(filename, attributeTypes);
+		return;
+	}
+
+	auto size (GetFileSize(filename));
+
+	if (size < 0 || GetFileSize(incrementalPath) > size / 2) {
+		DumpObjects(filename, attributeTypes);
+		return;
+	}
+
+	Log(LogInformation, "ConfigObject")
+		<< "Dumping changed program state to file '" << incrementalPath << "'";
+
+	if (!Utility::PathExists(incrementalPath)) {
+		AtomicFile fp (incrementalPath, 0600);
+		fp.Commit();
+	}
+
+	std::fstream fp;
+	fp.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+	fp.open(incrementalPath.CStr(), std::ios_base::out | std::ios_base::app | std::ios_base::binary);
+
+	StdioStream::Ptr sfp = new StdioStream(&fp, false);
+
+	std::vector<std::pair<ConfigObject::Ptr, uint_fast64_t>> dumped;
+	size_t written = SerializeObjects(attributeTypes, true, false, dumped, [&sfp](const String& message) {
+		NetString::WriteStringToStream(sfp, message);
+	});
+
+	sfp->Close();
+	fp.close();
+
+	for (auto& object : dumped) {
+		object.first->m_DumpedStateVersion = object.second;
+	}
+
+	m_LastDumpDuration.store(Utility::GetTime() - start);
+	m_LastDumpObjects.store(written);
+
+	Log(LogNotice, "ConfigObject")
+		<< "Dumped " << written << " changed objects in " << m_LastDumpDuration.load() << " seconds.";
+}
+
+/**
+ * @return How long the last state file dump took, in seconds
+ */
+double ConfigObject::GetLastDumpDuration()
+{
+	return m_LastDumpDuration.load();
+}
+
+/**
+ * @return How many objects the last state file dump has written
+ */
+size_t ConfigObject::GetLastDumpObjects()
+{
+	return m_LastDumpObjects.load();
 }
 
 void ConfigObject::RestoreObject(const String& message, int attributeTypes)
 {
-	Dictionary::Ptr persistentObject = JsonDecode(message);
+	RestoreObject(Dictionary::Ptr(JsonDecode(message)), attributeTypes);
+}
 
+void ConfigObject::RestoreObject(const Dictionary::Ptr& persistentObject, int attributeTypes)
+{
 	String type = persistentObject->Get("type");
 	String name = persistentObject->Get("name");
 
@@ -522,43 +789,217 @@ void ConfigObject::RestoreObject(const String& message, int attributeTypes)
 	object->SetStateLoaded(true);
 }
 
+/**
+ * Restores the objects of a binary state file. The file is mapped into memory
+ * and its index is split into one range per thread. Invalid records are skipped.
+ *
+ * @param filename The state file
+ * @param attributeTypes The attributes to restore
+ * @param changedObjects Objects to skip as they're restored from the incremental dump
+ *
+ * @return The number of objects restored
+ * @exception std::exception The file can't be read or its index is invalid
+ */
+size_t ConfigObject::RestoreObjectsBinary(const String& filename, int attributeTypes,
+	const std::map<std::pair<String, String>, Dictionary::Ptr>& changedObjects)
+{
+	boost::iostreams::mapped_file_source file (filename.GetData());
+	const char *data = file.data();
+	uint64_t size = file.size();
+
+	if (size < l_StateMagicLength + l_StateIndexTrailerLength
+		|| memcmp(data + size - l_StateMagicLength, l_StateIndexMagic, l_StateMagicLength)) {
+		BOOST_THROW_EXCEPTION(std::runtime_error("State file '" + filename + "' is truncated."));
+	}
+
+	uint64_t count = ParseUInt64(data + size - l_StateIndexTrailerLength);
+	uint64_t indexOffset = ParseUInt64(data + size - l_StateIndexTrailerLength + 8);
+
+	if (indexOffset < l_StateMagicLength || indexOffset > size - l_StateIndexTrailerLength
+		|| count != (size - l_StateIndexTrailerLength - indexOffset) / 8u
+		|| (size - l_StateIndexTrailerLength - indexOffset) % 8u) {
+		BOOST_THROW_EXCEPTION(std::runtime_error("State file '" + filename + "' has an invalid index."));
+	}
+
+	auto getOffset ([data, indexOffset, count](uint64_t i) -> uint64_t {
+		return i < count ? ParseUInt64(data + indexOffset + i * 8u) : indexOffset;
+	});
+
+	size_t partitionCount = std::max<size_t>(1, std::min<uint64_t>(Configuration::Concurrency, count));
+	std::vector<size_t> partitionIds (partitionCount);
+	std::iota(partitionIds.begin(), partitionIds.end(), 0);
+
+	std::atomic<size_t> restored (0);
+	std::atomic<size_t> invalid (0);
+
+	WorkQueue upq (0, partitionCount);
+	upq.SetName("ConfigObject::RestoreObjects");
+
+	upq.ParallelFor(partitionIds, false, [&](size_t partition) {
+		uint64_t begin = count * partition / partitionCount;
+		uint64_t end = count * (partition + 1u) / partitionCount;
+
+		for (uint64_t i = begin; i < end; i++) {
+			uint64_t recordBegin = getOffset(i);
+			uint64_t recordEnd = getOffset(i + 1u);
+
+			/* A broken record loses the state of one object, not the one of all others. */
+			try {
+				if (recordBegin < l_StateMagicLength || recordBegin > recordEnd || recordEnd > indexOffset) {
+					BOOST_THROW_EXCEPTION(std::runtime_error("Record has an invalid offset."));
+				}
+
+				Dictionary::Ptr persistentObject = CborDecode(data + recordBegin, data + recordEnd);
+
+				if (!changedObjects.empty()) {
+					String type = persistentObject->Get("type");
+					String name = persistentObject->Get("name");
+
+					if (changedObjects.find({ type, name }) != changedObjects.end())
+						continue;
+				}
+
+				RestoreObject(persistentObject, attributeTypes);
+				restored++;
+			} catch (const std::exception& ex) {
+				if (invalid++ == 0) {
+					Log(LogWarning, "ConfigObject")
+						<< "Skipping invalid record in state file '" << filename << "': " << DiagnosticInformation(ex, false);
+				}
+			}
+		}
+	});
+
+	upq.Join();
+
+	if (upq.HasExceptions())
+		boost::rethrow_exception(upq.GetExceptions().front());
+
+	if (invalid.load()) {
+		Log(LogWarning, "ConfigObject")
+			<< "Skipped " << invalid.load() << " invalid records in state file '" << filename << "'.";
+	}
+
+	return restored.load();
+}
+
 void ConfigObject::RestoreObjects(const String& filename, int attributeTypes)
 {
-	if (!Utility::PathExists(filename))
+	String incrementalPath = GetIncrementalDumpPath(filename);
+
+	if (!Utility::PathExists(filename) && !Utility::PathExists(incrementalPath))
 		return;
 
 	Log(LogInformation, "ConfigObject")
 		<< "Restoring program state from file '" << filename << "'";
 
-	std::fstream fp;
-	fp.open(filename.CStr(), std::ios_base::in);
+	/* The incremental dump has the newest state of the objects it contains. */
+	std::map<std::pair<String, String>, Dictionary::Ptr> changedObjects;
+
+	/* An incremental dump older than the state file is left over from a full dump
+	 * interrupted after it has been committed, so its contents are outdated.
+	 */
+	if (Utility::PathExists(incrementalPath) && Utility::PathExists(filename)
+		&& Utility::GetFileCreationTime(incrementalPath) < Utility::GetFileCreationTime(filename)) {
+		Log(LogWarning, "ConfigObject")
+			<< "Ignoring '" << incrementalPath << "' which is older than '" << filename << "'.";
+	} else if (Utility::PathExists(incrementalPath)) {
+		std::fstream fp;
+		fp.open(incrementalPath.CStr(), std::ios_base::in | std::ios_base::binary);
+
+		StdioStream::Ptr sfp = new StdioStream (&fp, false);
 
-	StdioStream::Ptr sfp = new StdioStream (&fp, false);
+		String message;
+		StreamReadContext src;
 
-	unsigned long restored = 0;
+		try {
+			for (;;) {
+				StreamReadStatus srs = NetString::ReadStringFromStream(sfp, &message, src);
+
+				if (srs == StatusEof)
+					break;
+
+				if (srs != StatusNewItem)
+					continue;
+
+				Dictionary::Ptr persistentObject = JsonDecode(message);
+				String type = persistentObject->Get("type");
+				String name = persistentObject->Get("name");
+
+				changedObjects[{ type, name }] = persistentObject;
+			}
+		} catch (const std::exception& ex) {
+			/* E.g. the last dump was interrupted. */
+			Log(LogWarning, "ConfigObject")
+				<< "Failed to read '" << incrementalPath << "' completely: " << DiagnosticInformation(ex, false);
+		}
+
+		sfp->Close();
+	}
+
+	std::atomic<unsigned long> restored (0);
 
 	WorkQueue upq(25000, Configuration::Concurrency);
 	upq.SetName("ConfigObject::RestoreObjects");
 
-	String message;
-	StreamReadContext src;
-	for (;;) {
-		StreamReadStatus srs = NetString::ReadStringFromStream(sfp, &message, src);
+	if (Utility::PathExists(filename) && IsBinaryStateFile(filename)) {
+		try {
+			restored += RestoreObjectsBinary(filename, attributeTypes, changedObjects);
+		} catch (const std::exception& ex) {
+			/* E.g. the disk ran full while the file was written. There's no other copy of the
+			 * state, so the objects start without state rather than failing the startup.
+			 */
+			Log(LogWarning, "ConfigObject")
+				<< "Failed to read state file '" << filename << "', objects without state in it start with empty state: "
+				<< DiagnosticInformation(ex, false);
+		}
+	} else if (Utility::PathExists(filename)) {
+		std::fstream fp;
+		fp.open(filename.CStr(), std::ios_base::in);
 
-		if (srs == StatusEof)
-			break;
+		StdioStream::Ptr sfp = new StdioStream (&fp, false);
 
-		if (srs != StatusNewItem)
-			continue;
+		String message;
+		StreamReadContext src;
+		for (;;) {
+			StreamReadStatus srs = NetString::ReadStringFromStream(sfp, &message, src);
+
+			if (srs == StatusEof)
+				break;
 
-		upq.Enqueue([message, attributeTypes]() { RestoreObject(message, attributeTypes); });
-		restored++;
+			if (srs != StatusNewItem)
+				continue;
+
+			if (changedObjects.empty()) {
+				upq.Enqueue([message, attributeTypes]() { RestoreObject(message, attributeTypes); });
+				restored++;
+			} else {
+				upq.Enqueue([message, attributeTypes, &changedObjects, &restored]() {
+					Dictionary::Ptr persistentObject = JsonDecode(message);
+					String type = persistentObject->Get("type");
+					String name = persistentObject->Get("name");
+
+					if (changedObjects.find({ type, name }) == changedObjects.end()) {
+						RestoreObject(persistentObject, attributeTypes);
+						restored++;
+					}
+				});
+			}
+		}
+
+		sfp->Close();
 	}
 
-	sfp->Close();
+	upq.Join();
+
+	for (auto& object : changedObjects) {
+		upq.Enqueue([&object, attributeTypes]() { RestoreObject(object.second, attributeTypes); });
+	}
 
 	upq.Join();
 
+	restored += changedObjects.size();
+
 	unsigned long no_state = 0;
 
 	for (const Type::Ptr& type : Type::GetAllTypes()) {
@@ -578,7 +1019,7 @@ void ConfigObject::RestoreObjects(const String& filename, int attributeTypes)
 	}
 
 	Log(LogInformation, "ConfigObject")
-		<< "Restored " << restored << " objects. Loaded " << no_state << " new objects without state.";
+		<< "Restored " << restored.load() << " objects. Loaded " << no_state << " new objects without state.";
 }
 
 void ConfigObject::StopObjects()
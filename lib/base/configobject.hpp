@@ -9,6 +9,13 @@
 #include "base/type.hpp"
 #include "base/dictionary.hpp"
 #include <boost/signals2.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <utility>
+#include <vector>
 
 namespace icinga
 {
@@ -40,6 +47,8 @@ public:
 	void RestoreAttribute(const String& attr, bool updateVersion = true);
 	bool IsAttributeModified(const String& attr) const;
 
+	void MarkStateChanged();
+
 	void Register();
 	void Unregister();
 
@@ -72,17 +81,38 @@ public:
 	static ConfigObject::Ptr GetObject(const String& type, const String& name);
 
 	static void DumpObjects(const String& filename, int attributeTypes = FAState);
+	static void DumpObjectsIncremental(const String& filename, int attributeTypes = FAState);
 	static void RestoreObjects(const String& filename, int attributeTypes = FAState);
 	static void StopObjects();
 
 	static void DumpModifiedAttributes(const std::function<void(const ConfigObject::Ptr&, const String&, const Value&)>& callback);
 
+	static double GetLastDumpDuration();
+	static size_t GetLastDumpObjects();
+
 	static Object::Ptr GetPrototype();
 
+protected:
+	void OnStateFieldChanged() override;
+
 private:
 	ConfigObject::Ptr m_Zone;
 
+	/* Incremented by every change of a state attribute. */
+	std::atomic<uint_fast64_t> m_StateVersion {1};
+
+	/* The state version written to the state file last time, only used by DumpObjects*(). */
+	uint_fast64_t m_DumpedStateVersion {0};
+
+	static std::atomic<double> m_LastDumpDuration;
+	static std::atomic<size_t> m_LastDumpObjects;
+
+	static size_t SerializeObjects(int attributeTypes, bool onlyModified, bool binary,
+		std::vector<std::pair<ConfigObject::Ptr, uint_fast64_t>>& dumped, const std::function<void(const String&)>& write);
 	static void RestoreObject(const String& message, int attributeTypes);
+	static void RestoreObject(const Dictionary::Ptr& persistentObject, int attributeTypes);
+	static size_t RestoreObjectsBinary(const String& filename, int attributeTypes,
+		const std::map<std::pair<String, String>, Dictionary::Ptr>& changedObjects);
 };
 
 #define DECLARE_OBJECTNAME(klass)						\
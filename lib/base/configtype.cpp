@@ -3,6 +3,9 @@
 #include "base/configobject.hpp"
 #include "base/convert.hpp"
 #include "base/exception.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <utility>
 
 using namespace icinga;
 
@@ -43,6 +46,8 @@ void ConfigType::RegisterObject(const ConfigObject::Ptr& object)
 
 		m_ObjectMap[name] = object;
 		m_ObjectVector.push_back(object);
+		m_SortedObjectMap[name] = object.get();
+		m_Registrations[object.get()] = m_NextRegistration++;
 	}
 }
 
@@ -54,6 +59,8 @@ void ConfigType::UnregisterObject(const ConfigObject::Ptr& object)
 		std::unique_lock<decltype(m_Mutex)> lock (m_Mutex);
 
 		m_ObjectMap.erase(name);
+		m_SortedObjectMap.erase(name);
+		m_Registrations.erase(object.get());
 		m_ObjectVector.erase(std::remove(m_ObjectVector.begin(), m_ObjectVector.end(), object), m_ObjectVector.end());
 	}
 }
@@ -64,6 +71,59 @@ std::vector<ConfigObject::Ptr> ConfigType::GetObjects() const
 	return m_ObjectVector;
 }
 
+/**
+ * Returns the objects whose names start with the given prefix, sorted by name.
+ *
+ * @param prefix The name prefix
+ *
+ * @return The objects
+ */
+std::vector<ConfigObject::Ptr> ConfigType::GetObjectsByNamePrefix(const String& prefix) const
+{
+	std::vector<ConfigObject::Ptr> objects;
+
+	std::shared_lock<decltype(m_Mutex)> lock (m_Mutex);
+
+	for (auto it (m_SortedObjectMap.lower_bound(prefix)); it != m_SortedObjectMap.end(); it++) {
+		if (it->first.GetData().compare(0, prefix.GetLength(), prefix.GetData()) != 0)
+			break;
+
+		objects.emplace_back(it->second);
+	}
+
+	return objects;
+}
+
+/**
+ * Sorts objects of this type in the order GetObjects() returns them, i.e. the
+ * order they have been registered in. Objects which aren't registered go last.
+ *
+ * @param objects The objects
+ */
+void ConfigType::SortByRegistration(std::vector<ConfigObject::Ptr>& objects) const
+{
+	std::vector<std::pair<uint_fast64_t, ConfigObject::Ptr>> registered;
+	registered.reserve(objects.size());
+
+	{
+		std::shared_lock<decltype(m_Mutex)> lock (m_Mutex);
+
+		for (auto& object : objects) {
+			auto it (m_Registrations.find(object.get()));
+
+			registered.emplace_back(it == m_Registrations.end() ? UINT_FAST64_MAX : it->second, std::move(object));
+		}
+	}
+
+	std::stable_sort(registered.begin(), registered.end(), [](const std::pair<uint_fast64_t, ConfigObject::Ptr>& a, const std::pair<uint_fast64_t, ConfigObject::Ptr>& b) {
+		return a.first < b.first;
+	});
+
+	for (size_t i = 0; i < objects.size(); i++) {
+		objects[i] = std::move(registered[i].second);
+	}
+}
+
 std::vector<ConfigObject::Ptr> ConfigType::GetObjectsHelper(Type *type)
 {
 	return static_cast<TypeImpl<ConfigObject> *>(type)->GetObjects();
@@ -7,6 +7,8 @@
 #include "base/object.hpp"
 #include "base/type.hpp"
 #include "base/dictionary.hpp"
+#include <cstdint>
+#include <map>
 #include <shared_mutex>
 #include <unordered_map>
 
@@ -26,6 +28,8 @@ public:
 	void UnregisterObject(const intrusive_ptr<ConfigObject>& object);
 
 	std::vector<intrusive_ptr<ConfigObject> > GetObjects() const;
+	std::vector<intrusive_ptr<ConfigObject> > GetObjectsByNamePrefix(const String& prefix) const;
+	void SortByRegistration(std::vector<intrusive_ptr<ConfigObject> >& objects) const;
 
 	template<typename T>
 	static TypeImpl<T> *Get()
@@ -51,10 +55,15 @@ for (const auto& object : objects) {
 private:
 	typedef std::unordered_map<String, intrusive_ptr<ConfigObject> > ObjectMap;
 	typedef std::vector<intrusive_ptr<ConfigObject> > ObjectVector;
+	typedef std::map<String, ConfigObject *> SortedObjectMap;
+	typedef std::unordered_map<ConfigObject *, uint_fast64_t> RegistrationMap;
 
 	mutable std::shared_timed_mutex m_Mutex;
 	ObjectMap m_ObjectMap;
 	ObjectVector m_ObjectVector;
+	SortedObjectMap m_SortedObjectMap;
+	RegistrationMap m_Registrations;
+	uint_fast64_t m_NextRegistration{0};
 
 	static std::vector<intrusive_ptr<ConfigObject> > GetObjectsHelper(Type *type);
 };
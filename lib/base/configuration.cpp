@@ -24,12 +24,14 @@ String Configuration::ApiBindHost = []() {
 
 String Configuration::ApiBindPort{"5665"};
 bool Configuration::AttachDebugger{false};
+bool Configuration::BinaryStateFile{false};
 String Configuration::CacheDir;
 int Configuration::Concurrency{1};
 bool Configuration::ConcurrencyWasModified{false};
 String Configuration::ConfigDir;
 String Configuration::DataDir;
 String Configuration::EventEngine;
+bool Configuration::HotReload{false};
 String Configuration::IncludeConfDir;
 String Configuration::InitRunDir;
 String Configuration::LogDir;
@@ -44,6 +46,7 @@ int Configuration::RLimitProcesses;
 int Configuration::RLimitStack;
 String Configuration::RunAsGroup;
 String Configuration::RunAsUser;
+bool Configuration::ScriptBytecode{false};
 String Configuration::SpoolDir;
 String Configuration::StatePath;
 double Configuration::TlsHandshakeTimeout{10};
@@ -97,6 +100,16 @@ void Configuration::SetAttachDebugger(bool val, bool suppress_events, const Valu
 	HandleUserWrite("AttachDebugger", &Configuration::AttachDebugger, val, m_ReadOnly);
 }
 
+bool Configuration::GetBinaryStateFile() const
+{
+	return Configuration::BinaryStateFile;
+}
+
+void Configuration::SetBinaryStateFile(bool val, bool suppress_events, const Value& cookie)
+{
+	HandleUserWrite("BinaryStateFile", &Configuration::BinaryStateFile, val, m_ReadOnly);
+}
+
 String Configuration::GetCacheDir() const
 {
 	return Configuration::CacheDir;
@@ -148,6 +161,16 @@ void Configuration::SetEventEngine(const String& val, bool suppress_events, cons
 	HandleUserWrite("EventEngine", &Configuration::EventEngine, val, m_ReadOnly);
 }
 
+bool Configuration::GetHotReload() const
+{
+	return Configuration::HotReload;
+}
+
+void Configuration::SetHotReload(bool val, bool suppress_events, const Value& cookie)
+{
+	HandleUserWrite("HotReload", &Configuration::HotReload, val, m_ReadOnly);
+}
+
 String Configuration::GetIncludeConfDir() const
 {
 	return Configuration::IncludeConfDir;
@@ -288,6 +311,16 @@ void Configuration::SetRunAsUser(const String& val, bool suppress_events, const
 	HandleUserWrite("RunAsUser", &Configuration::RunAsUser, val, m_ReadOnly);
 }
 
+bool Configuration::GetScriptBytecode() const
+{
+	return Configuration::ScriptBytecode;
+}
+
+void Configuration::SetScriptBytecode(bool val, bool suppress_events, const Value& cookie)
+{
+	HandleUserWrite("ScriptBytecode", &Configuration::ScriptBytecode, val, m_ReadOnly);
+}
+
 String Configuration::GetSpoolDir() const
 {
 	return Configuration::SpoolDir;
@@ -28,6 +28,9 @@ public:
 	bool GetAttachDebugger() const override;
 	void SetAttachDebugger(bool value, bool suppress_events = false, const Value& cookie = Empty) override;
 
+	bool GetBinaryStateFile() const override;
+	void SetBinaryStateFile(bool value, bool suppress_events = false, const Value& cookie = Empty) override;
+
 	String GetCacheDir() const override;
 	void SetCacheDir(const String& value, bool suppress_events = false, const Value& cookie = Empty) override;
 
@@ -43,6 +46,9 @@ public:
 	String GetEventEngine() const override;
 	void SetEventEngine(const String& value, bool suppress_events = false, const Value& cookie = Empty) override;
 
+	bool GetHotReload() const override;
+	void SetHotReload(bool value, bool suppress_events = false, const Value& cookie = Empty) override;
+
 	String GetIncludeConfDir() const override;
 	void SetIncludeConfDir(const String& value, bool suppress_events = false, const Value& cookie = Empty) override;
 
@@ -85,6 +91,9 @@ public:
 	String GetRunAsUser() const override;
 	void SetRunAsUser(const String& value, bool suppress_events = false, const Value& cookie = Empty) override;
 
+	bool GetScriptBytecode() const override;
+	void SetScriptBytecode(bool value, bool suppress_events = false, const Value& cookie = Empty) override;
+
 	String GetSpoolDir() const override;
 	void SetSpoolDir(const String& value, bool suppress_events = false, const Value& cookie = Empty) override;
 
@@ -116,12 +125,14 @@ public:
 	static String ApiBindHost;
 	static String ApiBindPort;
 	static bool AttachDebugger;
+	static bool BinaryStateFile;
 	static String CacheDir;
 	static int Concurrency;
 	static bool ConcurrencyWasModified;
 	static String ConfigDir;
 	static String DataDir;
 	static String EventEngine;
+	static bool HotReload;
 	static String IncludeConfDir;
 	static String InitRunDir;
 	static String LogDir;
@@ -136,6 +147,7 @@ public:
 	static int RLimitStack;
 	static String RunAsGroup;
 	static String RunAsUser;
+	static bool ScriptBytecode;
 	static String SpoolDir;
 	static String StatePath;
 	static double TlsHandshakeTimeout;
@@ -11,8 +11,10 @@
 #include <bitset>
 #include <boost/exception_ptr.hpp>
 #include <cstdint>
+#include <cstring>
 #include <json.hpp>
 #include <stack>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -21,6 +23,8 @@ using namespace icinga;
 class JsonSax : public nlohmann::json_sax<nlohmann::json>
 {
 public:
+	explicit JsonSax(size_t maxDepth = 0);
+
 	bool null() override;
 	bool boolean(bool val) override;
 	bool number_integer(number_integer_t val) override;
@@ -41,7 +45,9 @@ private:
 	Value m_Root;
 	std::stack<std::pair<Dictionary*, Array*>> m_CurrentSubtree;
 	String m_CurrentKey;
+	size_t m_MaxDepth;
 
+	void EnterContainer();
 	void FillCurrentTarget(Value value);
 };
 
@@ -84,12 +90,38 @@ private:
 	void FinishContainer(char terminator);
 };
 
-template<bool prettyPrint>
-void Encode(JsonEncoder<prettyPrint>& stateMachine, const Value& value);
+/**
+ * Serializes the same event stream as JsonEncoder, but as CBOR (RFC 8949).
+ * Containers are written with indefinite length so they don't have to be
+ * counted in advance.
+ */
+class CborEncoder
+{
+public:
+	void Null();
+	void Boolean(bool value);
+	void NumberFloat(double value);
+	void Strng(const String& value);
+	void StartObject();
+	void Key(const String& value);
+	void EndObject();
+	void StartArray();
+	void EndArray();
 
-template<bool prettyPrint>
+	String GetResult();
+
+private:
+	std::vector<char> m_Result;
+
+	void AppendHead(uint8_t majorType, uint64_t argument);
+};
+
+template<class StateMachine>
+void Encode(StateMachine& stateMachine, const Value& value);
+
+template<class StateMachine>
 inline
-void EncodeNamespace(JsonEncoder<prettyPrint>& stateMachine, const Namespace::Ptr& ns)
+void EncodeNamespace(StateMachine& stateMachine, const Namespace::Ptr& ns)
 {
 	stateMachine.StartObject();
 
@@ -102,9 +134,9 @@ void EncodeNamespace(JsonEncoder<prettyPrint>& stateMachine, const Namespace::Pt
 	stateMachine.EndObject();
 }
 
-template<bool prettyPrint>
+template<class StateMachine>
 inline
-void EncodeDictionary(JsonEncoder<prettyPrint>& stateMachine, const Dictionary::Ptr& dict)
+void EncodeDictionary(StateMachine& stateMachine, const Dictionary::Ptr& dict)
 {
 	stateMachine.StartObject();
 
@@ -117,9 +149,9 @@ void EncodeDictionary(JsonEncoder<prettyPrint>& stateMachine, const Dictionary::
 	stateMachine.EndObject();
 }
 
-template<bool prettyPrint>
+template<class StateMachine>
 inline
-void EncodeArray(JsonEncoder<prettyPrint>& stateMachine, const Array::Ptr& arr)
+void EncodeArray(StateMachine& stateMachine, const Array::Ptr& arr)
 {
 	stateMachine.StartArray();
 
@@ -131,8 +163,8 @@ void EncodeArray(JsonEncoder<prettyPrint>& stateMachine, const Array::Ptr& arr)
 	stateMachine.EndArray();
 }
 
-template<bool prettyPrint>
-void Encode(JsonEncoder<prettyPrint>& stateMachine, const Value& value)
+template<class StateMachine>
+void Encode(StateMachine& stateMachine, const Value& value)
 {
 	switch (value.GetType()) {
 		case ValueNumber:
@@ -217,6 +249,51 @@ Value icinga::JsonDecode(const String& data)
 	return stateMachine.GetResult();
 }
 
+String icinga::CborEncode(const Value& value)
+{
+	CborEncoder stateMachine;
+
+	Encode(stateMachine, value);
+
+	return stateMachine.GetResult();
+}
+
+/**
+ * Decodes a CBOR data item.
+ *
+ * The parser recurses into nested containers, so data from untrusted sources
+ * must be limited in depth not to exhaust the stack (e.g. of a coroutine).
+ *
+ * @param data CBOR data item
+ * @param maxDepth How deeply containers may be nested, 0 for no limit
+ *
+ * @return The decoded value
+ */
+Value icinga::CborDecode(const String& data, size_t maxDepth)
+{
+	JsonSax stateMachine (maxDepth);
+
+	nlohmann::json::sax_parse(data.Begin(), data.End(), &stateMachine, nlohmann::json::input_format_t::cbor);
+
+	return stateMachine.GetResult();
+}
+
+/**
+ * Decodes a CBOR data item in place, e.g. in a memory-mapped file.
+ */
+Value icinga::CborDecode(const char *begin, const char *end)
+{
+	JsonSax stateMachine;
+
+	nlohmann::json::sax_parse(begin, end, &stateMachine, nlohmann::json::input_format_t::cbor);
+
+	return stateMachine.GetResult();
+}
+
+JsonSax::JsonSax(size_t maxDepth) : m_MaxDepth(maxDepth)
+{
+}
+
 inline
 bool JsonSax::null()
 {
@@ -276,6 +353,8 @@ bool JsonSax::binary(JsonSax::binary_t& val)
 inline
 bool JsonSax::start_object(std::size_t)
 {
+	EnterContainer();
+
 	auto object (new Dictionary());
 
 	FillCurrentTarget(object);
@@ -305,6 +384,8 @@ bool JsonSax::end_object()
 inline
 bool JsonSax::start_array(std::size_t)
 {
+	EnterContainer();
+
 	auto array (new Array());
 
 	FillCurrentTarget(array);
@@ -334,6 +415,17 @@ Value JsonSax::GetResult()
 	return m_Root;
 }
 
+/**
+ * Rejects a new container nested too deeply before the parser descends into it.
+ */
+inline
+void JsonSax::EnterContainer()
+{
+	if (m_MaxDepth && m_CurrentSubtree.size() >= m_MaxDepth) {
+		throw std::invalid_argument("Containers are nested deeper than " + std::to_string(m_MaxDepth) + " levels.");
+	}
+}
+
 inline
 void JsonSax::FillCurrentTarget(Value value)
 {
@@ -523,3 +615,126 @@ void JsonEncoder<prettyPrint>::FinishContainer(char terminator)
 
 	m_CurrentSubtree.pop();
 }
+
+inline
+void CborEncoder::Null()
+{
+	m_Result.emplace_back('\xF6');
+}
+
+inline
+void CborEncoder::Boolean(bool value)
+{
+	m_Result.emplace_back(value ? '\xF5' : '\xF4');
+}
+
+inline
+void CborEncoder::NumberFloat(double value)
+{
+	// Like JsonEncoder, write integral numbers as integers. They are a lot shorter.
+	if (value < 0) {
+		if (value >= -9223372036854775808.0) {
+			long long i = value;
+
+			if (i == value) {
+				AppendHead(1, -1 - i);
+				return;
+			}
+		}
+	} else if (value < 18446744073709551616.0) {
+		unsigned long long i = value;
+
+		if (i == value) {
+			AppendHead(0, i);
+			return;
+		}
+	}
+
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	m_Result.emplace_back('\xFB');
+
+	for (auto shift (56); shift >= 0; shift -= 8) {
+		m_Result.emplace_back((char)(bits >> shift));
+	}
+}
+
+inline
+void CborEncoder::Strng(const String& value)
+{
+	AppendHead(3, value.GetLength());
+	m_Result.insert(m_Result.end(), value.Begin(), value.End());
+}
+
+inline
+void CborEncoder::StartObject()
+{
+	m_Result.emplace_back('\xBF');
+}
+
+inline
+void CborEncoder::Key(const String& value)
+{
+	Strng(value);
+}
+
+inline
+void CborEncoder::EndObject()
+{
+	m_Result.emplace_back('\xFF');
+}
+
+inline
+void CborEncoder::StartArray()
+{
+	m_Result.emplace_back('\x9F');
+}
+
+inline
+void CborEncoder::EndArray()
+{
+	m_Result.emplace_back('\xFF');
+}
+
+inline
+String CborEncoder::GetResult()
+{
+	return String(m_Result.begin(), m_Result.end());
+}
+
+/**
+ * Appends the initial byte of a data item and its big-endian argument.
+ *
+ * @param majorType CBOR major type (0-7)
+ * @param argument Length of a string or value of an integer
+ */
+inline
+void CborEncoder::AppendHead(uint8_t majorType, uint64_t argument)
+{
+	uint8_t head = majorType << 5u;
+	int bytes;
+
+	if (argument < 24u) {
+		m_Result.emplace_back((char)(head | argument));
+		return;
+	} else if (argument <= 0xFFu) {
+		head |= 24u;
+		bytes = 1;
+	} else if (argument <= 0xFFFFu) {
+		head |= 25u;
+		bytes = 2;
+	} else if (argument <= 0xFFFFFFFFu) {
+		head |= 26u;
+		bytes = 4;
+	} else {
+		head |= 27u;
+		bytes = 8;
+	}
+
+	m_Result.emplace_back((char)head);
+
+	for (auto shift ((bytes - 1) * 8); shift >= 0; shift -= 8) {
+		m_Result.emplace_back((char)(argument >> shift));
+	}
+}
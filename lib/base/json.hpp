@@ -14,6 +14,10 @@ class Value;
 String JsonEncode(const Value& value, bool pretty_print = false);
 Value JsonDecode(const String& data);
 
+String CborEncode(const Value& value);
+Value CborDecode(const String& data, size_t maxDepth = 0);
+Value CborDecode(const char *begin, const char *end);
+
 }
 
 #endif /* JSON_H */
@@ -165,6 +165,13 @@ void Object::NotifyField(int id, const Value& cookie)
 	BOOST_THROW_EXCEPTION(std::runtime_error("Invalid field ID."));
 }
 
+/**
+ * Called by the setters of state attributes after the value has been changed.
+ */
+void Object::OnStateFieldChanged()
+{
+}
+
 Object::Ptr Object::NavigateField(int id) const
 {
 	BOOST_THROW_EXCEPTION(std::runtime_error("Invalid field ID."));
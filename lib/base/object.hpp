@@ -187,6 +187,9 @@ public:
 
 	static intrusive_ptr<Type> TypeInstance;
 
+protected:
+	virtual void OnStateFieldChanged();
+
 private:
 	Object(const Object& other) = delete;
 	Object& operator=(const Object& rhs) = delete;
@@ -73,11 +73,20 @@ public:
 
 	template<typename VectorType, typename FuncType>
 	void ParallelFor(const VectorType& items, bool preChunk, const FuncType& func)
+	{
+		ParallelForChunks(items, preChunk ? m_ThreadCount : items.size(), func);
+	}
+
+	/**
+	 * Splits the items into the given number of chunks, each of which is one task.
+	 * More chunks than threads let idle threads pick up the next chunk.
+	 */
+	template<typename VectorType, typename FuncType>
+	void ParallelForChunks(const VectorType& items, decltype(items.size()) chunks, const FuncType& func)
 	{
 		using SizeType = decltype(items.size());
 
 		SizeType totalCount = items.size();
-		SizeType chunks = preChunk ? m_ThreadCount : totalCount;
 
 		auto lock = AcquireLock();
 
@@ -2,12 +2,14 @@
 
 #include "cli/daemoncommand.hpp"
 #include "cli/daemonutility.hpp"
+#include "cli/hotreloadutility.hpp"
 #include "remote/apilistener.hpp"
 #include "remote/configobjectslock.hpp"
 #include "remote/configobjectutility.hpp"
 #include "config/configcompiler.hpp"
 #include "config/configcompilercontext.hpp"
 #include "config/configitembuilder.hpp"
+#include "config/configprofiler.hpp"
 #include "base/atomic.hpp"
 #include "base/defer.hpp"
 #include "base/logger.hpp"
@@ -178,6 +180,7 @@ void DaemonCommand::InitParameters(boost::program_options::options_description&
 		("no-config,z", "start without a configuration file")
 		("validate,C", "exit after validating the configuration")
 		("dump-objects", "write icinga2.debug cache file for icinga2 object list")
+		("profile-config", po::value<std::string>(), "write a profile of the config evaluation to the specified JSON file")
 		("errorlog,e", po::value<std::string>(), "log fatal errors to the specified log file (only works in combination with --daemonize or --close-stdio)")
 #ifndef _WIN32
 		("daemonize,d", "detach from the controlling terminal")
@@ -188,7 +191,7 @@ void DaemonCommand::InitParameters(boost::program_options::options_description&
 
 std::vector<String> DaemonCommand::GetArgumentSuggestions(const String& argument, const String& word) const
 {
-	if (argument == "config" || argument == "errorlog")
+	if (argument == "config" || argument == "errorlog" || argument == "profile-config")
 		return GetBashCompletionSuggestions("file", word);
 	else
 		return CLICommand::GetArgumentSuggestions(argument, word);
@@ -200,6 +203,9 @@ pid_t l_UmbrellaPid = 0;
 
 // Whether the umbrella process allowed us to continue working beyond config validation
 static Atomic<bool> l_AllowedToWork (false);
+
+// Whether the umbrella process requested to re-load config in place (and we didn't handle that request, yet)
+static Atomic<bool> l_RequestedHotReload (false);
 #endif /* _WIN32 */
 
 #ifdef I2_DEBUG
@@ -221,6 +227,7 @@ static double GetDebugWorkerDelay()
 #endif /* I2_DEBUG */
 
 static String l_ObjectsPath;
+static String l_ProfileConfigPath;
 
 /**
  * Do the actual work (config loading, ...)
@@ -251,8 +258,22 @@ int RunWorker(const std::vector<std::string>& configs, bool closeConsoleLog = fa
 
 	{
 		std::vector<ConfigItem::Ptr> newItems;
+		String objectsPath = l_ObjectsPath;
+
+#ifndef _WIN32
+		// The objects to compare the new config with on reload
+		if (Configuration::HotReload) {
+			HotReloadUtility::RemoveStaleObjectsFiles();
+			objectsPath = HotReloadUtility::GetObjectsPath();
+		}
+#endif /* _WIN32 */
 
-		if (!DaemonUtility::LoadConfigFiles(configs, newItems, l_ObjectsPath, Configuration::VarsPath)) {
+		bool loaded = DaemonUtility::LoadConfigFiles(configs, newItems, objectsPath, Configuration::VarsPath);
+
+		if (!l_ProfileConfigPath.IsEmpty())
+			ConfigProfiler::WriteReport(l_ProfileConfigPath);
+
+		if (!loaded) {
 			Log(LogCritical, "cli", "Config validation failed. Re-run with 'icinga2 daemon -C' after fixing the config.");
 			NotifyStatus("Config validation failed.");
 			return EXIT_FAILURE;
@@ -322,6 +343,20 @@ int RunWorker(const std::vector<std::string>& configs, bool closeConsoleLog = fa
 
 	ApiListener::UpdateObjectAuthority();
 
+#ifndef _WIN32
+	Timer::Ptr hotReloadTimer;
+
+	if (Configuration::HotReload) {
+		hotReloadTimer = Timer::Create();
+		hotReloadTimer->SetInterval(1);
+		hotReloadTimer->OnTimerExpired.connect([](const Timer * const&) {
+			if (l_RequestedHotReload.exchange(false))
+				HotReloadUtility::Reload();
+		});
+		hotReloadTimer->Start();
+	}
+#endif /* _WIN32 */
+
 	NotifyStatus("Startup finished.");
 
 	return Application::GetInstance()->Run();
@@ -351,9 +386,15 @@ static Atomic<bool> l_CurrentlyStartingUnixWorkerReady (false);
 // The last temination signal we received
 static Atomic<int> l_TermSignal (-1);
 
+// The PID of the current seamless worker
+static Atomic<pid_t> l_CurrentUnixWorkerPid (-1);
+
 // Whether someone requested to re-load config (and we didn't handle that request, yet)
 static Atomic<bool> l_RequestedReload (false);
 
+// Whether the current seamless worker requested to re-load config by replacing it (and we didn't handle that request, yet)
+static Atomic<bool> l_RequestedFullReload (false);
+
 // Whether someone requested to re-open logs (and we didn't handle that request, yet)
 static Atomic<bool> l_RequestedReopenLogs (false);
 
@@ -391,6 +432,11 @@ static void UmbrellaSignalHandler(int num, siginfo_t *info, void*)
 			break;
 		case SIGHUP:
 			// Someone requested to re-load config
+			if (info->si_pid != 0 && info->si_pid == l_CurrentUnixWorkerPid.load()) {
+				// E.g. via the API or because the config can't be re-loaded in place
+				l_RequestedFullReload.store(true);
+			}
+
 			l_RequestedReload.store(true);
 			break;
 		default:
@@ -422,6 +468,12 @@ static void WorkerSignalHandler(int num, siginfo_t *info, void*)
 				Application::RequestShutdown();
 			}
 			break;
+		case SIGHUP:
+			if (info->si_pid == 0 || info->si_pid == l_UmbrellaPid) {
+				// The umbrella process requested to re-load config in place
+				l_RequestedHotReload.store(true);
+			}
+			break;
 		default:
 			// Programming error (or someone has broken the userspace)
 			VERIFY(!"Caught unexpected signal");
@@ -502,15 +554,6 @@ static pid_t StartUnixWorker(const std::vector<std::string>& configs, bool close
 					(void)sigaction(SIGUSR1, &sa, nullptr);
 				}
 
-				{
-					struct sigaction sa;
-					memset(&sa, 0, sizeof(sa));
-
-					sa.sa_handler = SIG_IGN;
-
-					(void)sigaction(SIGHUP, &sa, nullptr);
-				}
-
 				{
 					struct sigaction sa;
 					memset(&sa, 0, sizeof(sa));
@@ -522,6 +565,7 @@ static pid_t StartUnixWorker(const std::vector<std::string>& configs, bool close
 					(void)sigaction(SIGUSR2, &sa, nullptr);
 					(void)sigaction(SIGINT, &sa, nullptr);
 					(void)sigaction(SIGTERM, &sa, nullptr);
+					(void)sigaction(SIGHUP, &sa, nullptr);
 				}
 
 				(void)sigprocmask(SIG_UNBLOCK, &l_UnixWorkerSignals, nullptr);
@@ -647,12 +691,22 @@ int DaemonCommand::Run(const po::variables_map& vm, const std::vector<std::strin
 		l_ObjectsPath = Configuration::ObjectsPath;
 	}
 
+	if (vm.count("profile-config")) {
+		l_ProfileConfigPath = vm["profile-config"].as<std::string>();
+		ConfigProfiler::Enable();
+	}
+
 	if (vm.count("validate")) {
 		Log(LogInformation, "cli", "Loading configuration file(s).");
 
 		std::vector<ConfigItem::Ptr> newItems;
 
-		if (!DaemonUtility::LoadConfigFiles(configs, newItems, l_ObjectsPath, Configuration::VarsPath)) {
+		bool loaded = DaemonUtility::LoadConfigFiles(configs, newItems, l_ObjectsPath, Configuration::VarsPath);
+
+		if (!l_ProfileConfigPath.IsEmpty())
+			ConfigProfiler::WriteReport(l_ProfileConfigPath);
+
+		if (!loaded) {
 			Log(LogCritical, "cli", "Config validation failed. Re-run with 'icinga2 daemon -C' after fixing the config.");
 			return EXIT_FAILURE;
 		}
@@ -749,6 +803,8 @@ int DaemonCommand::Run(const po::variables_map& vm, const std::vector<std::strin
 		return EXIT_FAILURE;
 	}
 
+	l_CurrentUnixWorkerPid.store(currentWorker);
+
 	if (closeConsoleLog) {
 		// After disabling the console log, any further errors will go to the configured log only.
 		// Let's try to make this clear and say good bye.
@@ -794,7 +850,14 @@ int DaemonCommand::Run(const po::variables_map& vm, const std::vector<std::strin
 			}
 		}
 
-		if (l_RequestedReload.exchange(false)) {
+		bool requestedReload = l_RequestedReload.exchange(false);
+
+		if (requestedReload && Configuration::HotReload && !l_RequestedFullReload.exchange(false)) {
+			Log(LogInformation, "Application")
+				<< "Got reload command: Forwarding to seamless worker (PID " << currentWorker << ") for reloading config in place.";
+
+			(void)kill(currentWorker, SIGHUP);
+		} else if (requestedReload) {
 			Log(LogInformation, "Application")
 				<< "Got reload command: Starting new instance.";
 
@@ -843,6 +906,7 @@ int DaemonCommand::Run(const po::variables_map& vm, const std::vector<std::strin
 					NotifyStatus("Shut down old instance.");
 
 					currentWorker = nextWorker;
+					l_CurrentUnixWorkerPid.store(currentWorker);
 			}
 
 #ifdef HAVE_SYSTEMD
@@ -7,6 +7,7 @@
 #include "base/logger.hpp"
 #include "base/application.hpp"
 #include "base/scriptglobal.hpp"
+#include "config/compiledconfigcache.hpp"
 #include "config/configcompiler.hpp"
 #include "config/configcompilercontext.hpp"
 #include "config/configitembuilder.hpp"
@@ -45,11 +46,14 @@ static bool IncludeZoneDirRecursive(const String& path, const String& package, b
 	/* register this zone path for cluster config sync */
 	ConfigCompiler::RegisterZoneDir("_etc", path, zoneName);
 
-	std::vector<std::unique_ptr<Expression> > expressions;
-	Utility::GlobRecursive(path, "*.conf", [&expressions, zoneName, package](const String& file) {
-		ConfigCompiler::CollectIncludes(expressions, file, zoneName, package);
+	std::vector<IncludedFile> files;
+	Utility::GlobRecursive(path, "*.conf", [&files, zoneName, package](const String& file) {
+		files.push_back({ file, zoneName, package });
 	}, GlobFile);
 
+	std::vector<std::unique_ptr<Expression> > expressions;
+	ConfigCompiler::CompileIncludes(expressions, files);
+
 	DictExpression expr(std::move(expressions));
 	if (!ExecuteExpression(&expr))
 		success = false;
@@ -80,11 +84,14 @@ static bool IncludeNonLocalZone(const String& zonePath, const String& package, b
 		return true;
 	}
 
-	std::vector<std::unique_ptr<Expression> > expressions;
-	Utility::GlobRecursive(zonePath, "*.conf", [&expressions, zoneName, package](const String& file) {
-		ConfigCompiler::CollectIncludes(expressions, file, zoneName, package);
+	std::vector<IncludedFile> files;
+	Utility::GlobRecursive(zonePath, "*.conf", [&files, zoneName, package](const String& file) {
+		files.push_back({ file, zoneName, package });
 	}, GlobFile);
 
+	std::vector<std::unique_ptr<Expression> > expressions;
+	ConfigCompiler::CompileIncludes(expressions, files);
+
 	DictExpression expr(std::move(expressions));
 	if (!ExecuteExpression(&expr))
 		success = false;
@@ -281,5 +288,8 @@ bool DaemonUtility::LoadConfigFiles(const std::vector<std::string>& configs,
 
 	ConfigCompilerContext::GetInstance()->FinishObjectsFile();
 
+	/* All config files have been compiled by now, drop the cache entries of removed ones. */
+	CompiledConfigCache::Prune();
+
 	return true;
 }
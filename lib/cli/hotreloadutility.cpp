@@ -0,0 +1,777 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "cli/hotreloadutility.hpp"
+#include "remote/apilistener.hpp"
+#include "remote/configobjectslock.hpp"
+#include "remote/configobjectutility.hpp"
+#include "remote/configpackageutility.hpp"
+#include "remote/endpoint.hpp"
+#include "remote/zone.hpp"
+#include "config/activationcontext.hpp"
+#include "config/configitem.hpp"
+#include "config/configitembuilder.hpp"
+#include "config/expression.hpp"
+#include "base/application.hpp"
+#include "base/configtype.hpp"
+#include "base/configuration.hpp"
+#include "base/convert.hpp"
+#include "base/defer.hpp"
+#include "base/dependencygraph.hpp"
+#include "base/exception.hpp"
+#include "base/json.hpp"
+#include "base/logger.hpp"
+#include "base/netstring.hpp"
+#include "base/objectlock.hpp"
+#include "base/stdiostream.hpp"
+#include "base/utility.hpp"
+#include "base/workqueue.hpp"
+#include <atomic>
+#include <cerrno>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <vector>
+
+#ifndef _WIN32
+#include <signal.h>
+#endif /* _WIN32 */
+
+using namespace icinga;
+
+typedef std::map<std::pair<String, String> /* type, name */, String /* dumped object */> DumpedObjects;
+
+static std::atomic<bool> l_Reloading (false);
+
+/**
+ * @returns The path of the objects file the current process loaded its configuration from.
+ */
+String HotReloadUtility::GetObjectsPath()
+{
+	return Configuration::CacheDir + "/hot-reload." + Convert::ToString(Utility::GetPid()) + ".objects";
+}
+
+/**
+ * Removes the objects files of processes which don't exist anymore.
+ */
+void HotReloadUtility::RemoveStaleObjectsFiles()
+{
+#ifndef _WIN32
+	Utility::Glob(Configuration::CacheDir + "/hot-reload.*", [](const String& path) {
+		std::vector<String> tokens = Utility::BaseName(path).Split(".");
+
+		if (tokens.size() < 3u)
+			return;
+
+		pid_t pid;
+
+		try {
+			pid = Convert::ToLong(tokens[1]);
+		} catch (const std::exception&) {
+			return;
+		}
+
+		if (kill(pid, 0) == -1 && errno == ESRCH)
+			Utility::Remove(path);
+	}, GlobFile);
+#endif /* _WIN32 */
+}
+
+/**
+ * Validates the configuration in a child process and applies it once that finished.
+ * Falls back to restarting the process if the changes can't be applied in place.
+ */
+void HotReloadUtility::Reload()
+{
+	if (l_Reloading.exchange(true)) {
+		Log(LogWarning, "HotReloadUtility", "A reload is already in progress, ignoring.");
+		return;
+	}
+
+	VERIFY(Application::GetArgC() >= 1);
+
+	Log(LogInformation, "HotReloadUtility", "Got reload command: Validating the new configuration.");
+
+	// prepare arguments
+	Array::Ptr args = new Array({
+		Application::GetExePath(Application::GetArgV()[0]),
+	});
+
+	// copy all arguments of parent process
+	for (int i = 1; i < Application::GetArgC(); i++) {
+		String argV = Application::GetArgV()[i];
+
+		if (argV == "-d" || argV == "--daemonize")
+			continue;
+
+		if (argV == "--profile-config") {
+			i++;
+			continue;
+		}
+
+		if (argV.SubStr(0, 17) == "--profile-config=")
+			continue;
+
+		args->Add(argV);
+	}
+
+	String objectsPath = GetObjectsPath() + ".new";
+
+	// add arguments for validation
+	args->Add("--validate");
+	args->Add("--dump-objects");
+	args->Add("--define");
+	args->Add("Configuration.ObjectsPath=" + objectsPath);
+
+	Process::Ptr process = new Process(Process::PrepareCommand(args));
+	process->SetTimeout(Application::GetReloadTimeout());
+	process->Run([objectsPath](const ProcessResult& pr) {
+		ReloadCallback(pr, objectsPath);
+	});
+}
+
+void HotReloadUtility::ReloadCallback(const ProcessResult& pr, const String& objectsPath)
+{
+	Defer resetReloading ([]() {
+		l_Reloading.store(false);
+	});
+
+	Defer removeObjectsFile ([&objectsPath]() {
+		for (auto& path : { objectsPath, objectsPath + ".files" }) {
+			try {
+				if (Utility::PathExists(path))
+					Utility::Remove(path);
+			} catch (const std::exception& ex) {
+				Log(LogWarning, "HotReloadUtility")
+					<< "Failed to remove '" << path << "': " << DiagnosticInformation(ex, false);
+			}
+		}
+	});
+
+	if (pr.ExitStatus != 0) {
+		Log(LogCritical, "HotReloadUtility")
+			<< "Found error in config: reloading aborted. Validation output:\n" << pr.Output;
+
+		Application::SetLastReloadFailed(Utility::GetTime());
+		return;
+	}
+
+	bool applied = false;
+	String reason;
+
+	try {
+#ifndef _WIN32
+		// Runtime config changes in the meantime would be lost.
+		ConfigObjectsExclusiveLock lock;
+#endif /* _WIN32 */
+
+		applied = Apply(objectsPath, reason);
+
+		if (applied) {
+			Utility::RenameFile(objectsPath, GetObjectsPath());
+			Utility::RenameFile(objectsPath + ".files", GetObjectsPath() + ".files");
+		}
+	} catch (const std::exception& ex) {
+		reason = DiagnosticInformation(ex, false);
+	}
+
+	if (applied) {
+		Application::SetLastReloadFailed(0);
+		return;
+	}
+
+	Log(LogInformation, "HotReloadUtility")
+		<< "Cannot reload the configuration in place, restarting instead: " << reason;
+
+	Application::RequestRestart();
+}
+
+static Dictionary::Ptr ReadFiles(const String& objectsPath)
+{
+	String path = objectsPath + ".files";
+	std::ifstream fp (path.CStr(), std::ifstream::in);
+
+	if (!fp)
+		BOOST_THROW_EXCEPTION(std::runtime_error("Could not open '" + path + "'."));
+
+	return JsonDecode(String(std::istreambuf_iterator<char>(fp), std::istreambuf_iterator<char>()));
+}
+
+static DumpedObjects ReadObjects(const String& objectsPath)
+{
+	std::fstream fp;
+	fp.open(objectsPath.CStr(), std::ios_base::in);
+
+	if (!fp)
+		BOOST_THROW_EXCEPTION(std::runtime_error("Could not open '" + objectsPath + "'."));
+
+	StdioStream::Ptr sfp = new StdioStream(&fp, false);
+	DumpedObjects objects;
+	String message;
+	StreamReadContext src;
+
+	for (;;) {
+		StreamReadStatus srs = NetString::ReadStringFromStream(sfp, &message, src);
+
+		if (srs == StatusEof)
+			break;
+
+		if (srs != StatusNewItem)
+			continue;
+
+		Dictionary::Ptr object = JsonDecode(message);
+		Dictionary::Ptr properties = object->Get("properties");
+		String type = object->Get("type");
+		String name = properties->Get("__name");
+
+		objects.emplace(std::make_pair(type, name), message);
+	}
+
+	sfp->Close();
+
+	return objects;
+}
+
+/**
+ * Serialized functions only consist of their name, i.e. a changed function body isn't visible in the objects file.
+ */
+static bool ContainsFunction(const Value& value)
+{
+	if (value.IsObjectType<Dictionary>()) {
+		Dictionary::Ptr dict = value;
+
+		if (dict->Get("type") == "Function")
+			return true;
+
+		ObjectLock olock(dict);
+
+		for (auto& kv : dict) {
+			if (ContainsFunction(kv.second))
+				return true;
+		}
+	} else if (value.IsObjectType<Array>()) {
+		Array::Ptr arr = value;
+		ObjectLock olock(arr);
+
+		for (auto& item : arr) {
+			if (ContainsFunction(item))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Collects the files of the messages in the given debug hints, i.e. where the object's attributes have been set.
+ */
+static void CollectDebugHintPaths(const Value& hints, std::set<String>& paths)
+{
+	if (hints.IsObjectType<Dictionary>()) {
+		Dictionary::Ptr dict = hints;
+		ObjectLock olock(dict);
+
+		for (auto& kv : dict) {
+			CollectDebugHintPaths(kv.second, paths);
+		}
+	} else if (hints.IsObjectType<Array>()) {
+		Array::Ptr arr = hints;
+
+		/* [ message, path, first line, first column, last line, last column ] */
+		if (arr->GetLength() == 6u && arr->Get(1).IsString()) {
+			String path = arr->Get(1);
+			paths.emplace(std::move(path));
+			return;
+		}
+
+		ObjectLock olock(arr);
+
+		for (auto& item : arr) {
+			CollectDebugHintPaths(item, paths);
+		}
+	}
+}
+
+static bool IsDefinedInFiles(const Dictionary::Ptr& object, const std::set<String>& files)
+{
+	std::set<String> paths;
+	Array::Ptr debugInfo = object->Get("debug_info");
+
+	if (debugInfo && debugInfo->GetLength()) {
+		String path = debugInfo->Get(0);
+		paths.emplace(std::move(path));
+	}
+
+	CollectDebugHintPaths(object->Get("debug_hints"), paths);
+
+	for (auto& path : paths) {
+		if (files.find(path) != files.end())
+			return true;
+	}
+
+	return false;
+}
+
+static DebugInfo GetDebugInfo(const Dictionary::Ptr& object)
+{
+	Array::Ptr debugInfo = object->Get("debug_info");
+	DebugInfo di;
+
+	if (debugInfo && debugInfo->GetLength() == 5u) {
+		di.Path = debugInfo->Get(0);
+		di.FirstLine = debugInfo->Get(1);
+		di.FirstColumn = debugInfo->Get(2);
+		di.LastLine = debugInfo->Get(3);
+		di.LastColumn = debugInfo->Get(4);
+	}
+
+	return di;
+}
+
+/**
+ * Objects of types which are activated in a specific order (features, the application, ...)
+ * and the cluster topology can't be changed at runtime.
+ */
+static bool IsSupportedType(const Type::Ptr& type)
+{
+	return dynamic_cast<ConfigType*>(type.get()) && type->GetActivationPriority() == 0
+		&& type != Zone::TypeInstance && type != Endpoint::TypeInstance;
+}
+
+/**
+ * Whether the attribute (or parts of it) have been modified at runtime, e.g. via the API.
+ */
+static bool IsModifiedAttribute(const ConfigObject::Ptr& object, const String& attr)
+{
+	Dictionary::Ptr originalAttributes = object->GetOriginalAttributes();
+
+	if (!originalAttributes)
+		return false;
+
+	ObjectLock olock(originalAttributes);
+
+	for (auto& kv : originalAttributes) {
+		if (kv.first == attr || kv.first.SubStr(0, attr.GetLength() + 1u) == attr + ".")
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * Validates object references as if the pending creates and deletes have been applied already.
+ */
+class HotReloadValidationUtils final : public ValidationUtils
+{
+public:
+	HotReloadValidationUtils(const std::map<Type::Ptr, std::set<String>>& created, const std::set<ConfigObject::Ptr>& deleted)
+		: m_Created(created), m_Deleted(deleted)
+	{ }
+
+	bool ValidateName(const String& type, const String& name) const override
+	{
+		Type::Ptr ptype = Type::GetByName(type);
+		auto *ctype = dynamic_cast<ConfigType*>(ptype.get());
+
+		if (!ctype)
+			return false;
+
+		ConfigObject::Ptr object = ctype->GetObject(name);
+
+		if (object)
+			return m_Deleted.find(object) == m_Deleted.end();
+
+		for (auto& kv : m_Created) {
+			if (ptype->IsAssignableFrom(kv.first) && kv.second.find(name) != kv.second.end())
+				return true;
+		}
+
+		return false;
+	}
+
+private:
+	const std::map<Type::Ptr, std::set<String>>& m_Created;
+	const std::set<ConfigObject::Ptr>& m_Deleted;
+};
+
+static String GetDescription(const ConfigObject::Ptr& object)
+{
+	return "Object '" + object->GetName() + "' of type '" + object->GetReflectionType()->GetName() + "'";
+}
+
+static void CreateObjects(const Type::Ptr& type, const std::vector<Dictionary::Ptr>& objects, size_t& created,
+	std::vector<ConfigObject::Ptr>& createdObjects)
+{
+	auto ctype (dynamic_cast<ConfigType*>(type.get()));
+
+	ActivationScope ascope;
+	size_t count = 0;
+
+	for (auto& object : objects) {
+		Dictionary::Ptr properties = object->Get("properties");
+
+		/* E.g. created by apply rules for new objects of another type. */
+		if (ctype->GetObject(properties->Get("__name")))
+			continue;
+
+		DebugInfo di = GetDebugInfo(object);
+
+		ConfigItemBuilder builder{di};
+		builder.SetType(type);
+		builder.SetName(properties->Get("name"));
+		builder.SetZone(properties->Get("zone"));
+		builder.SetPackage(properties->Get("package"));
+
+		{
+			ObjectLock olock(properties);
+
+			for (auto& kv : properties) {
+				if (kv.first == "__name" || kv.first == "name" || kv.first == "source_location")
+					continue;
+
+				builder.AddExpression(new SetExpression(MakeIndexer(ScopeThis, kv.first), OpSetLiteral, MakeLiteral(kv.second), di));
+			}
+		}
+
+		builder.Compile()->Register();
+		count++;
+	}
+
+	if (!count)
+		return;
+
+	WorkQueue upq;
+	upq.SetName("HotReloadUtility::CreateObjects");
+
+	std::vector<ConfigItem::Ptr> newItems;
+
+	if (!ConfigItem::CommitItems(ascope.GetContext(), upq, newItems, true)) {
+		auto exceptions (upq.GetExceptions());
+
+		BOOST_THROW_EXCEPTION(std::runtime_error("Failed to create objects of type '" + type->GetName() + "'"
+			+ (exceptions.empty() ? String() : ": " + DiagnosticInformation(exceptions.front(), false))));
+	}
+
+	for (auto& item : newItems) {
+		ConfigObject::Ptr object = item->GetObject();
+
+		if (object)
+			createdObjects.emplace_back(std::move(object));
+	}
+
+	if (!ConfigItem::ActivateItems(newItems, true, false, false))
+		BOOST_THROW_EXCEPTION(std::runtime_error("Failed to activate objects of type '" + type->GetName() + "'."));
+
+	created += count;
+}
+
+/**
+ * Compares the given objects file with the one of the current configuration and applies the differences.
+ *
+ * @param objectsPath The objects file of the new configuration
+ * @param reason Why the differences can't be applied in place
+ * @returns Whether the differences have been applied
+ */
+bool HotReloadUtility::Apply(const String& objectsPath, String& reason)
+{
+	String currentPath = GetObjectsPath();
+	String apiPackagePrefix = ConfigPackageUtility::GetPackageDir() + "/_api/";
+
+	/* The objects defined in unchanged files can only change if the objects they import
+	 * do so, which are dumped as well. Everything else (apply rules, global variables, ...)
+	 * can affect any object.
+	 */
+	Dictionary::Ptr currentFiles = ReadFiles(currentPath);
+	Dictionary::Ptr newFiles = ReadFiles(objectsPath);
+	std::set<String> changedFiles;
+
+	for (auto& files : { std::make_pair(currentFiles, newFiles), std::make_pair(newFiles, currentFiles) }) {
+		ObjectLock olock(files.first);
+
+		for (auto& kv : files.first) {
+			Dictionary::Ptr file = kv.second;
+			Dictionary::Ptr other = files.second->Get(kv.first);
+
+			if (other && other->Get("hash") == file->Get("hash"))
+				continue;
+
+			/* Runtime created objects are already up to date. */
+			if (kv.first.SubStr(0, apiPackagePrefix.GetLength()) == apiPackagePrefix)
+				continue;
+
+			if (!file->Get("objects_only").ToBool()) {
+				reason = "File '" + kv.first + "' contains more than object definitions and has been changed.";
+				return false;
+			}
+
+			changedFiles.emplace(kv.first);
+		}
+	}
+
+	DumpedObjects currentObjects = ReadObjects(currentPath);
+	DumpedObjects newObjects = ReadObjects(objectsPath);
+
+	std::map<Type::Ptr, std::vector<Dictionary::Ptr>> creates;
+	std::vector<std::pair<ConfigObject::Ptr, Dictionary::Ptr>> updates;
+	std::vector<std::pair<ConfigObject::Ptr, DebugInfo>> moves;
+	std::vector<std::pair<Type::Ptr, String>> deletes;
+	std::set<ConfigObject::Ptr> deletedObjects;
+	std::set<ConfigObject::Ptr> keptAttributes;
+
+	std::set<std::pair<String, String>> keys;
+
+	for (auto& kv : currentObjects)
+		keys.emplace(kv.first);
+
+	for (auto& kv : newObjects)
+		keys.emplace(kv.first);
+
+	for (auto& key : keys) {
+		auto current (currentObjects.find(key));
+		auto next (newObjects.find(key));
+		bool unchanged = current != currentObjects.end() && next != newObjects.end() && current->second == next->second;
+
+		if (unchanged && current->second.Find("\"Function\"") == String::NPos)
+			continue;
+
+		Dictionary::Ptr currentObject, newObject;
+
+		if (current != currentObjects.end())
+			currentObject = JsonDecode(current->second);
+
+		if (next != newObjects.end())
+			newObject = JsonDecode(next->second);
+
+		Dictionary::Ptr anyObject = newObject ? newObject : currentObject;
+		Dictionary::Ptr anyProperties = anyObject->Get("properties");
+
+		if (anyProperties->Get("package") == "_api")
+			continue;
+
+		String description = "Object '" + key.second + "' of type '" + key.first + "'";
+
+		if (ContainsFunction(anyProperties) && (IsDefinedInFiles(anyObject, changedFiles)
+			|| (currentObject && newObject && IsDefinedInFiles(currentObject, changedFiles)))) {
+			reason = description + " contains functions and has been changed.";
+			return false;
+		}
+
+		if (unchanged)
+			continue;
+
+		Type::Ptr type = Type::GetByName(key.first);
+
+		if (!type || !IsSupportedType(type)) {
+			reason = description + " has been changed, but its type doesn't support reloading in place.";
+			return false;
+		}
+
+		ConfigObject::Ptr object = dynamic_cast<ConfigType*>(type.get())->GetObject(key.second);
+
+		if (!newObject) {
+			if (object) {
+				deletes.emplace_back(type, key.second);
+				deletedObjects.emplace(object);
+			}
+
+			continue;
+		}
+
+		if (!currentObject || !object) {
+			if (object) {
+				Log(LogNotice, "HotReloadUtility")
+					<< description << " already exists, not creating it.";
+				continue;
+			}
+
+			if (ContainsFunction(newObject->Get("properties"))) {
+				reason = description + " contains functions and has been added.";
+				return false;
+			}
+
+			creates[type].emplace_back(newObject);
+			continue;
+		}
+
+		Dictionary::Ptr currentProperties = currentObject->Get("properties");
+		Dictionary::Ptr newProperties = newObject->Get("properties");
+		Dictionary::Ptr attrs = new Dictionary();
+
+		{
+			ObjectLock olock(newProperties);
+
+			for (auto& kv : newProperties) {
+				if (kv.first == "source_location" || JsonEncode(kv.second) == JsonEncode(currentProperties->Get(kv.first)))
+					continue;
+
+				int fid = type->GetFieldId(kv.first);
+
+				if (fid < 0 || (type->GetFieldInfo(fid).Attributes & FANoUserModify)) {
+					reason = description + ": Attribute '" + kv.first + "' has been changed, but can't be modified at runtime.";
+					return false;
+				}
+
+				if (ContainsFunction(kv.second)) {
+					reason = description + ": Attribute '" + kv.first + "' contains functions and has been changed.";
+					return false;
+				}
+
+				if (IsModifiedAttribute(object, kv.first)) {
+					Log(LogNotice, "HotReloadUtility")
+						<< description << ": Attribute '" << kv.first << "' has been modified at runtime, not changing it.";
+					keptAttributes.emplace(object);
+					continue;
+				}
+
+				attrs->Set(kv.first, kv.second);
+			}
+		}
+
+		if (attrs->GetLength())
+			updates.emplace_back(object, attrs);
+
+		if (JsonEncode(currentObject->Get("debug_info")) != JsonEncode(newObject->Get("debug_info")))
+			moves.emplace_back(object, GetDebugInfo(newObject));
+	}
+
+	/* Check everything which can be checked before changing anything, so that a failure leaves the objects untouched. */
+	std::map<Type::Ptr, std::set<String>> createdNames;
+	std::set<ConfigObject::Ptr> updatedObjects;
+
+	for (auto& kv : creates) {
+		for (auto& object : kv.second) {
+			Dictionary::Ptr properties = object->Get("properties");
+			createdNames[kv.first].emplace(properties->Get("__name"));
+		}
+	}
+
+	HotReloadValidationUtils utils (createdNames, deletedObjects);
+
+	for (auto& update : updates) {
+		auto& object (update.first);
+		Type::Ptr type = object->GetReflectionType();
+		ObjectLock olock(update.second);
+
+		for (auto& kv : update.second) {
+			try {
+				object->ValidateField(type->GetFieldId(kv.first), Lazy<Value>{kv.second}, utils);
+			} catch (const std::exception& ex) {
+				reason = GetDescription(object) + ": Attribute '" + kv.first + "' is invalid: " + DiagnosticInformation(ex, false);
+				return false;
+			}
+		}
+
+		if (keptAttributes.find(object) == keptAttributes.end())
+			updatedObjects.emplace(object);
+	}
+
+	/* Deleting an object deletes the objects referring to it as well (like cascading deletes via the API).
+	 * That's fine for other deleted objects and runtime created ones, e.g. comments and downtimes.
+	 * Objects of the new configuration don't refer to deleted ones anymore, unless they keep an attribute modified at runtime.
+	 */
+	for (auto& object : deletedObjects) {
+		for (const Object::Ptr& parent : DependencyGraph::GetParents(object)) {
+			ConfigObject::Ptr parentObj = dynamic_pointer_cast<ConfigObject>(parent);
+
+			if (!parentObj || parentObj->GetPackage() == "_api" || deletedObjects.find(parentObj) != deletedObjects.end()
+				|| updatedObjects.find(parentObj) != updatedObjects.end())
+				continue;
+
+			reason = GetDescription(object) + " has been removed, but " + GetDescription(parentObj) + " still refers to it.";
+			return false;
+		}
+	}
+
+	/* Created first, so that updated objects can reference them. Parent types first, see ConfigItem::CommitNewItems().
+	 * If that fails, the objects created so far are deleted again.
+	 */
+	size_t created = 0;
+	std::vector<ConfigObject::Ptr> createdObjects;
+
+	while (!creates.empty()) {
+		auto next (creates.begin());
+
+		for (auto it (creates.begin()); it != creates.end(); ++it) {
+			bool ready = true;
+
+			for (auto dependency : it->first->GetLoadDependencies()) {
+				if (dependency != it->first.get() && creates.find(dependency) != creates.end()) {
+					ready = false;
+					break;
+				}
+			}
+
+			if (ready) {
+				next = it;
+				break;
+			}
+		}
+
+		try {
+			CreateObjects(next->first, next->second, created, createdObjects);
+		} catch (const std::exception&) {
+			for (auto it (createdObjects.rbegin()); it != createdObjects.rend(); ++it) {
+				auto ctype (dynamic_cast<ConfigType*>((*it)->GetReflectionType().get()));
+
+				/* Might have been deleted along with another object. */
+				if (ctype->GetObject((*it)->GetName()) == *it)
+					ConfigObjectUtility::DeleteObjectHelper(*it, true, nullptr, nullptr);
+			}
+
+			throw;
+		}
+
+		creates.erase(next);
+	}
+
+	if (created)
+		ApiListener::UpdateObjectAuthority();
+
+	for (auto& update : updates) {
+		auto& object (update.first);
+		ObjectLock olock(update.second);
+
+		for (auto& kv : update.second) {
+			object->ModifyAttribute(kv.first, kv.second, false);
+
+			/* It's the configuration now, not a modified attribute. */
+			Dictionary::Ptr originalAttributes = object->GetOriginalAttributes();
+
+			if (originalAttributes)
+				originalAttributes->Remove(kv.first);
+		}
+	}
+
+	for (auto& move : moves)
+		move.first->SetDebugInfo(move.second);
+
+	/* Deleted last, so that updated objects don't reference them anymore. Like the updates, this has been checked above.
+	 * Only an exception thrown while deactivating an object can interrupt it (see ReloadCallback()).
+	 */
+	size_t deleted = 0;
+
+	for (auto& del : deletes) {
+		/* Might have been deleted along with another object. */
+		ConfigObject::Ptr object = dynamic_cast<ConfigType*>(del.first.get())->GetObject(del.second);
+
+		if (!object)
+			continue;
+
+		Array::Ptr errors = new Array();
+
+		if (!ConfigObjectUtility::DeleteObjectHelper(object, true, errors, nullptr)) {
+			String message = errors->Join(" ");
+
+			BOOST_THROW_EXCEPTION(std::runtime_error("Failed to delete object '" + del.second + "' of type '"
+				+ del.first->GetName() + "': " + message));
+		}
+
+		deleted++;
+	}
+
+	Log(LogInformation, "HotReloadUtility")
+		<< "Reloaded the configuration in place: " << created << " objects created, "
+		<< updates.size() << " updated, " << deleted << " deleted.";
+
+	return true;
+}
@@ -0,0 +1,39 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef HOTRELOADUTILITY_H
+#define HOTRELOADUTILITY_H
+
+#include "cli/i2-cli.hpp"
+#include "base/process.hpp"
+#include "base/string.hpp"
+
+namespace icinga
+{
+
+/**
+ * Reloads the configuration in the running process (see Configuration.HotReload).
+ *
+ * The new configuration is validated by a child process which dumps its objects.
+ * These are compared with the objects dumped while loading the current configuration
+ * and the differences are applied like the /v1/objects API does.
+ *
+ * @ingroup cli
+ */
+class HotReloadUtility
+{
+public:
+	static String GetObjectsPath();
+	static void RemoveStaleObjectsFiles();
+
+	static void Reload();
+	static bool Apply(const String& objectsPath, String& reason);
+
+private:
+	HotReloadUtility();
+
+	static void ReloadCallback(const ProcessResult& pr, const String& objectsPath);
+};
+
+}
+
+#endif /* HOTRELOADUTILITY_H */
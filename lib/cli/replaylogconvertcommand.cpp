@@ -0,0 +1,91 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "cli/replaylogconvertcommand.hpp"
+#include "remote/apilistener.hpp"
+#include "remote/replaylog.hpp"
+#include "base/logger.hpp"
+#include "base/utility.hpp"
+#include "base/exception.hpp"
+#include <vector>
+
+using namespace icinga;
+
+REGISTER_CLICOMMAND("api/convert-replay-log", ReplayLogConvertCommand);
+
+String ReplayLogConvertCommand::GetDescription() const
+{
+	return "Converts the cluster replay log files written by older versions of Icinga 2 into indexed segments.\n"
+		"Icinga 2 must not be running while doing so.";
+}
+
+String ReplayLogConvertCommand::GetShortDescription() const
+{
+	return "converts the cluster replay log";
+}
+
+ImpersonationLevel ReplayLogConvertCommand::GetImpersonationLevel() const
+{
+	return ImpersonateIcinga;
+}
+
+/**
+ * The entry point for the "api convert-replay-log" CLI command.
+ *
+ * @returns An exit status.
+ */
+int ReplayLogConvertCommand::Run(const boost::program_options::variables_map& vm, const std::vector<std::string>& ap) const
+{
+	std::vector<String> files;
+
+	Utility::Glob(ApiListener::GetApiDir() + "log/*", [&files](const String& file) {
+		if (!Utility::Match("*.tmp", file))
+			files.push_back(file);
+	}, GlobFile);
+
+	int rc = 0;
+
+	for (auto& file : files) {
+		ReplayLogReader reader (file);
+
+		if (!reader.IsLegacy())
+			continue;
+
+		String tmpFile = file + ".tmp";
+		size_t count = 0;
+
+		try {
+			/* Left over by an interrupted conversion */
+			if (Utility::PathExists(tmpFile))
+				Utility::Remove(tmpFile);
+
+			ReplayLogWriter writer (tmpFile);
+			ReplayLogRecord record;
+
+			try {
+				while (reader.Next(record)) {
+					writer.Write(record);
+					count++;
+				}
+			} catch (const std::exception&) {
+				Log(LogWarning, "cli")
+					<< "Unexpected end-of-file for cluster log: " << file;
+			}
+
+			/* The current log file is continued by Icinga 2, the others are finished. */
+			writer.Close(Utility::BaseName(file) != "current");
+
+			Utility::RenameFile(tmpFile, file);
+		} catch (const std::exception& ex) {
+			Log(LogCritical, "cli")
+				<< "Cannot convert cluster log '" << file << "': " << DiagnosticInformation(ex, false);
+
+			rc = 1;
+			continue;
+		}
+
+		Log(LogInformation, "cli")
+			<< "Converted " << count << " messages in cluster log '" << file << "'.";
+	}
+
+	return rc;
+}
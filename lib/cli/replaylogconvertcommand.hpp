@@ -0,0 +1,29 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef REPLAYLOGCONVERTCOMMAND_H
+#define REPLAYLOGCONVERTCOMMAND_H
+
+#include "cli/clicommand.hpp"
+
+namespace icinga
+{
+
+/**
+ * The "api convert-replay-log" command.
+ *
+ * @ingroup cli
+ */
+class ReplayLogConvertCommand final : public CLICommand
+{
+public:
+	DECLARE_PTR_TYPEDEFS(ReplayLogConvertCommand);
+
+	String GetDescription() const override;
+	String GetShortDescription() const override;
+	int Run(const boost::program_options::variables_map& vm, const std::vector<std::string>& ap) const override;
+	ImpersonationLevel GetImpersonationLevel() const override;
+};
+
+}
+
+#endif /* REPLAYLOGCONVERTCOMMAND_H */
@@ -0,0 +1,349 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "config/applyrule.hpp"
+#include "config/expression.hpp"
+#include "config/vmops.hpp"
+#include "base/array.hpp"
+#include "base/objectlock.hpp"
+#include "base/utility.hpp"
+#include <algorithm>
+#include <limits>
+
+using namespace icinga;
+
+static const size_t l_NoPath = std::numeric_limits<size_t>::max();
+
+/* Limits the clauses an || expression may produce, larger ones are just not indexed. */
+static const size_t l_MaxClauses = 16;
+
+/**
+ * @returns All regular ApplyRules which may match the given target object, in the order of GetRules().
+ * The others' filters are known to evaluate to false without an error. (See AddPrefilteredRule().)
+ */
+std::vector<ApplyRule::Ptr> ApplyRule::GetCandidateRules(const Type::Ptr& sourceType, const Type::Ptr& targetType, const Object::Ptr& target)
+{
+	auto& rules (GetRules(sourceType, targetType));
+
+	if (rules.empty()) {
+		return {};
+	}
+
+	auto& perSourceType (m_Rules.find(sourceType.get())->second);
+	auto prefilter (perSourceType.Prefiltered.find(targetType.get()));
+
+	if (prefilter == perSourceType.Prefiltered.end()) {
+		return rules;
+	}
+
+	std::vector<bool> candidates (rules.size(), false);
+
+	auto add ([&candidates](const std::vector<size_t>& ids) {
+		for (auto id : ids) {
+			candidates[id] = true;
+		}
+	});
+
+	auto addValue ([&add](const PrefilterPath& path, const String& value) {
+		auto ids (path.Rules.find(value));
+
+		if (ids != path.Rules.end()) {
+			add(ids->second);
+		}
+	});
+
+	add(prefilter->second.Unconditional);
+
+	for (auto& path : prefilter->second.Paths) {
+		Value value = target;
+
+		try {
+			for (auto& field : path.Fields) {
+				value = VMOps::GetField(value, field);
+			}
+		} catch (const std::exception&) {
+			add(path.Dependent);
+			continue;
+		}
+
+		switch (path.Kind) {
+			case PrefilterKind::Equal:
+				/* Only strings and null compare equal to strings, see Value::operator==(). */
+				if (value.IsString() || value.IsEmpty()) {
+					addValue(path, value);
+				}
+				break;
+
+			case PrefilterKind::In:
+				if (value.IsObjectType<Array>()) {
+					Array::Ptr arr = value;
+					ObjectLock olock (arr);
+
+					for (const Value& item : arr) {
+						if (item.IsString() || item.IsEmpty()) {
+							addValue(path, item);
+						}
+					}
+				} else if (!value.IsEmpty()) {
+					/* The "in" operator would throw an error. */
+					add(path.Dependent);
+				}
+				break;
+
+			case PrefilterKind::Match:
+				if (value.IsString() || value.IsEmpty()) {
+					String text = value;
+
+					for (auto& pattern : path.Rules) {
+						if (Utility::Match(pattern.first, text)) {
+							add(pattern.second);
+						}
+					}
+				} else {
+					/* Arrays, numbers etc. aren't worth it. */
+					add(path.Dependent);
+				}
+		}
+	}
+
+	std::vector<ApplyRule::Ptr> result;
+
+	for (size_t i = 0; i < rules.size(); ++i) {
+		if (candidates[i]) {
+			result.emplace_back(rules[i]);
+		}
+	}
+
+	return result;
+}
+
+/**
+ * Add the given regular ApplyRule with the given position in Regular to the given index.
+ *
+ * The rule's filter is analyzed for conditions on the target object it requires, like:
+ *
+ * - host.vars.os == "Linux"
+ * - "linux" in host.groups
+ * - match("db-*", host.name)
+ *
+ * Such conditions combined via && and || form clauses, i.e. sets of conditions one of which
+ * has to be true for the filter to be true. The rule is indexed by the conditions of its smallest clause.
+ * If none of them is true, the filter evaluates to false without an error.
+ */
+void ApplyRule::AddPrefilteredRule(const ApplyRule::Ptr& rule, size_t id, const String& targetType, Prefilter& prefilter)
+{
+	const char *lcType;
+
+	if (targetType == "Host") {
+		lcType = "host";
+	} else if (targetType == "Service") {
+		lcType = "service";
+	} else {
+		prefilter.Unconditional.emplace_back(id);
+		return;
+	}
+
+	/* With a for loop, the rule's errors regarding the loop variables would go unnoticed.
+	 * Locals named like the target object or match() would change the filter's meaning.
+	 */
+	if (rule->m_FTerm || (rule->m_Scope && (rule->m_Scope->Contains(lcType) || rule->m_Scope->Contains("match")))) {
+		prefilter.Unconditional.emplace_back(id);
+		return;
+	}
+
+	std::vector<std::vector<std::pair<size_t, const String *>>> clauses;
+	std::set<size_t> paths;
+
+	GetPrefilterClauses(rule->m_Filter.get(), lcType, prefilter, clauses, paths);
+
+	if (clauses.empty()) {
+		prefilter.Unconditional.emplace_back(id);
+		return;
+	}
+
+	auto clause (std::min_element(clauses.begin(), clauses.end(), [](const auto& lhs, const auto& rhs) {
+		return lhs.size() < rhs.size();
+	}));
+
+	for (auto& condition : *clause) {
+		prefilter.Paths[condition.first].Rules[*condition.second].emplace_back(id);
+	}
+
+	for (auto path : paths) {
+		prefilter.Paths[path].Dependent.emplace_back(id);
+	}
+}
+
+/**
+ * Collect the clauses required by the given filter. If one of them is false,
+ * the filter evaluates to false without an error - as long as none of the
+ * collected paths' conditions can't be checked.
+ *
+ * @returns Whether the given filter consists only of conditions which don't throw errors (if checkable).
+ */
+bool ApplyRule::GetPrefilterClauses(Expression* filter, const char * lcType, Prefilter& prefilter,
+	std::vector<std::vector<std::pair<size_t, const String *>>>& clauses, std::set<size_t>& paths)
+{
+	auto land (dynamic_cast<LogicalAndExpression*>(filter));
+
+	if (land) {
+		std::vector<std::vector<std::pair<size_t, const String *>>> rhs;
+		bool pure1 = GetPrefilterClauses(land->GetOperand1().get(), lcType, prefilter, clauses, paths);
+		bool pure2 = GetPrefilterClauses(land->GetOperand2().get(), lcType, prefilter, rhs, paths);
+
+		/* The right operand is only relevant if the left one can't throw an error before. */
+		if (pure1) {
+			clauses.insert(clauses.end(), rhs.begin(), rhs.end());
+		}
+
+		return pure1 && pure2;
+	}
+
+	auto lor (dynamic_cast<LogicalOrExpression*>(filter));
+
+	if (lor) {
+		std::vector<std::vector<std::pair<size_t, const String *>>> lhs, rhs;
+		bool pure1 = GetPrefilterClauses(lor->GetOperand1().get(), lcType, prefilter, lhs, paths);
+		bool pure2 = GetPrefilterClauses(lor->GetOperand2().get(), lcType, prefilter, rhs, paths);
+
+		if (lhs.size() * rhs.size() <= l_MaxClauses) {
+			for (auto& clause1 : lhs) {
+				for (auto& clause2 : rhs) {
+					clauses.emplace_back(clause1);
+					clauses.back().insert(clauses.back().end(), clause2.begin(), clause2.end());
+				}
+			}
+		}
+
+		return pure1 && pure2;
+	}
+
+	auto lnot (dynamic_cast<LogicalNegateExpression*>(filter));
+
+	if (lnot) {
+		std::vector<std::vector<std::pair<size_t, const String *>>> negated;
+
+		return GetPrefilterClauses(lnot->GetOperand().get(), lcType, prefilter, negated, paths);
+	}
+
+	auto ne (dynamic_cast<NotEqualExpression*>(filter));
+
+	if (ne) {
+		/* Not indexable, but at least it doesn't prevent indexing the right operand of an && expression. */
+		auto op1 (ne->GetOperand1().get());
+		auto op2 (ne->GetOperand2().get());
+
+		if (!GetConstString(op2, nullptr)) {
+			std::swap(op1, op2);
+		}
+
+		if (!GetConstString(op2, nullptr)) {
+			return false;
+		}
+
+		auto path (GetPrefilterPath(op1, PrefilterKind::Equal, lcType, prefilter));
+
+		if (path == l_NoPath) {
+			return false;
+		}
+
+		paths.emplace(path);
+		return true;
+	}
+
+	size_t path = l_NoPath;
+	const String *value = nullptr;
+	auto eq (dynamic_cast<EqualExpression*>(filter));
+
+	if (eq) {
+		auto op1 (eq->GetOperand1().get());
+		auto op2 (eq->GetOperand2().get());
+
+		value = GetConstString(op2, nullptr);
+
+		if (!value) {
+			std::swap(op1, op2);
+			value = GetConstString(op2, nullptr);
+		}
+
+		if (value) {
+			path = GetPrefilterPath(op1, PrefilterKind::Equal, lcType, prefilter);
+		}
+	}
+
+	auto in (dynamic_cast<InExpression*>(filter));
+
+	if (in) {
+		value = GetConstString(in->GetOperand1().get(), nullptr);
+
+		if (value) {
+			path = GetPrefilterPath(in->GetOperand2().get(), PrefilterKind::In, lcType, prefilter);
+		}
+	}
+
+	auto call (dynamic_cast<FunctionCallExpression*>(filter));
+
+	if (call && call->m_Args.size() == 2u) {
+		auto func (dynamic_cast<VariableExpression*>(call->m_FName.get()));
+
+		if (func && func->GetVariable() == "match") {
+			value = GetConstString(call->m_Args[0].get(), nullptr);
+
+			if (value) {
+				path = GetPrefilterPath(call->m_Args[1].get(), PrefilterKind::Match, lcType, prefilter);
+			}
+		}
+	}
+
+	if (path == l_NoPath) {
+		return false;
+	}
+
+	clauses.push_back({{path, value}});
+	paths.emplace(path);
+
+	return true;
+}
+
+/**
+ * @returns If the given expression is like $lcType$.a.b["c"], the position of the respective path in the given index
+ * (added if necessary). l_NoPath on failure.
+ */
+size_t ApplyRule::GetPrefilterPath(Expression* exp, PrefilterKind kind, const char * lcType, Prefilter& prefilter)
+{
+	std::vector<String> fields;
+
+	for (;;) {
+		auto ixr (dynamic_cast<IndexerExpression*>(exp));
+
+		if (!ixr) {
+			break;
+		}
+
+		auto field (GetConstString(ixr->GetOperand2().get(), nullptr));
+
+		if (!field) {
+			return l_NoPath;
+		}
+
+		fields.emplace_back(*field);
+		exp = ixr->GetOperand1().get();
+	}
+
+	auto var (dynamic_cast<VariableExpression*>(exp));
+
+	if (fields.empty() || !var || var->GetVariable() != lcType) {
+		return l_NoPath;
+	}
+
+	std::reverse(fields.begin(), fields.end());
+
+	for (size_t i = 0; i < prefilter.Paths.size(); ++i) {
+		if (prefilter.Paths[i].Kind == kind && prefilter.Paths[i].Fields == fields) {
+			return i;
+		}
+	}
+
+	prefilter.Paths.push_back({kind, std::move(fields), {}, {}});
+
+	return prefilter.Paths.size() - 1u;
+}
@@ -1,6 +1,7 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
 #include "config/applyrule.hpp"
+#include "config/bytecode.hpp"
 #include "base/logger.hpp"
 #include <set>
 #include <unordered_set>
@@ -13,7 +14,8 @@ ApplyRule::TypeMap ApplyRule::m_Types;
 ApplyRule::ApplyRule(String name, Expression::Ptr expression,
 	Expression::Ptr filter, String package, String fkvar, String fvvar, Expression::Ptr fterm,
 	bool ignoreOnError, DebugInfo di, Dictionary::Ptr scope)
-	: m_Name(std::move(name)), m_Expression(std::move(expression)), m_Filter(std::move(filter)), m_Package(std::move(package)), m_FKVar(std::move(fkvar)),
+	: m_Name(std::move(name)), m_Expression(std::move(expression)), m_Filter(std::move(filter)),
+	m_FilterProgram(BytecodeExpression::Compile(m_Filter)), m_Package(std::move(package)), m_FKVar(std::move(fkvar)),
 	m_FVVar(std::move(fvvar)), m_FTerm(std::move(fterm)), m_IgnoreOnError(ignoreOnError), m_DebugInfo(std::move(di)), m_Scope(std::move(scope)), m_HasMatches(false)
 { }
 
@@ -75,13 +77,17 @@ void ApplyRule::AddRule(const String& sourceType, const String& targetType, cons
 	auto& rules (m_Rules[Type::GetByName(sourceType).get()]);
 
 	if (!AddTargetedRule(rule, *actualTargetType, rules)) {
-		rules.Regular[Type::GetByName(*actualTargetType).get()].emplace_back(std::move(rule));
+		auto type (Type::GetByName(*actualTargetType).get());
+		auto& regular (rules.Regular[type]);
+
+		AddPrefilteredRule(rule, regular.size(), *actualTargetType, rules.Prefiltered[type]);
+		regular.emplace_back(std::move(rule));
 	}
 }
 
 bool ApplyRule::EvaluateFilter(ScriptFrame& frame) const
 {
-	return Convert::ToBool(m_Filter->Evaluate(frame));
+	return Convert::ToBool(m_FilterProgram->Evaluate(frame));
 }
 
 void ApplyRule::RegisterType(const String& sourceType, const std::vector<String>& targetTypes)
@@ -126,7 +132,10 @@ const std::vector<String>& ApplyRule::GetTargetTypes(const String& sourceType)
 
 void ApplyRule::AddMatch()
 {
-	m_HasMatches.store(true, std::memory_order_relaxed);
+	/* Rules matching lots of objects would otherwise make all threads write to the same cache line. */
+	if (!m_HasMatches.load(std::memory_order_relaxed)) {
+		m_HasMatches.store(true, std::memory_order_relaxed);
+	}
 }
 
 bool ApplyRule::HasMatches() const
@@ -8,6 +8,8 @@
 #include "base/debuginfo.hpp"
 #include "base/shared-object.hpp"
 #include "base/type.hpp"
+#include <map>
+#include <set>
 #include <unordered_map>
 #include <atomic>
 
@@ -28,9 +30,31 @@ public:
 		std::unordered_map<String /* service */, std::set<ApplyRule::Ptr>> ForServices;
 	};
 
+	enum class PrefilterKind
+	{
+		Equal, /* $lcType$.path == "V" */
+		In, /* "V" in $lcType$.path */
+		Match /* match("V", $lcType$.path) */
+	};
+
+	struct PrefilterPath
+	{
+		PrefilterKind Kind;
+		std::vector<String> Fields;
+		std::map<String /* compared value or pattern */, std::vector<size_t>> Rules;
+		std::vector<size_t> Dependent;
+	};
+
+	struct Prefilter
+	{
+		std::vector<PrefilterPath> Paths;
+		std::vector<size_t> Unconditional;
+	};
+
 	struct PerSourceType
 	{
 		std::unordered_map<Type* /* target type */, std::vector<ApplyRule::Ptr>> Regular;
+		std::unordered_map<Type* /* target type */, Prefilter> Prefiltered;
 		std::unordered_map<String /* host */, PerHost> Targeted;
 	};
 
@@ -47,6 +71,16 @@ public:
 	 *
 	 * m_Rules[T::TypeInstance.get()].Regular[C::TypeInstance.get()]
 	 * contains all other apply rules like apply T "x" to C { ... }.
+	 *
+	 * m_Rules[T::TypeInstance.get()].Prefiltered[C::TypeInstance.get()]
+	 * indexes the latter (by their position in Regular) by conditions
+	 * their filters require, e.g. "linux" in host.groups:
+	 *
+	 * - Paths[i].Rules["V"] contains the rules which require the i-th condition
+	 *   (e.g. host.vars.os == "V") or another one in the same Paths[j].Rules.
+	 * - Paths[i].Dependent contains the rules which have to be evaluated anyway
+	 *   if the i-th condition can't be checked without an error.
+	 * - Unconditional contains the rules which don't require any indexed condition.
 	 */
 	typedef std::unordered_map<Type* /* source type */, PerSourceType> RuleMap;
 
@@ -80,6 +114,7 @@ public:
 		const Expression::Ptr& filter, const String& package, const String& fkvar, const String& fvvar, const Expression::Ptr& fterm,
 		bool ignoreOnError, const DebugInfo& di, const Dictionary::Ptr& scope);
 	static const std::vector<ApplyRule::Ptr>& GetRules(const Type::Ptr& sourceType, const Type::Ptr& targetType);
+	static std::vector<ApplyRule::Ptr> GetCandidateRules(const Type::Ptr& sourceType, const Type::Ptr& targetType, const Object::Ptr& target);
 	static const std::set<ApplyRule::Ptr>& GetTargetedHostRules(const Type::Ptr& sourceType, const String& host);
 	static const std::set<ApplyRule::Ptr>& GetTargetedServiceRules(const Type::Ptr& sourceType, const String& host, const String& service);
 	static bool GetTargetHosts(Expression* assignFilter, std::vector<const String *>& hosts, const Dictionary::Ptr& constants = nullptr);
@@ -97,6 +132,7 @@ private:
 	String m_Name;
 	Expression::Ptr m_Expression;
 	Expression::Ptr m_Filter;
+	Expression::Ptr m_FilterProgram; /* m_Filter, compiled to bytecode if enabled */
 	String m_Package;
 	String m_FKVar;
 	String m_FVVar;
@@ -110,6 +146,10 @@ private:
 	static RuleMap m_Rules;
 
 	static bool AddTargetedRule(const ApplyRule::Ptr& rule, const String& targetType, PerSourceType& rules);
+	static void AddPrefilteredRule(const ApplyRule::Ptr& rule, size_t id, const String& targetType, Prefilter& prefilter);
+	static bool GetPrefilterClauses(Expression* filter, const char * lcType, Prefilter& prefilter,
+		std::vector<std::vector<std::pair<size_t, const String *>>>& clauses, std::set<size_t>& paths);
+	static size_t GetPrefilterPath(Expression* exp, PrefilterKind kind, const char * lcType, Prefilter& prefilter);
 	static std::pair<const String *, const String *> GetTargetService(Expression* assignFilter, const Dictionary::Ptr& constants);
 	static const String * GetComparedName(Expression* assignFilter, const char * lcType, const Dictionary::Ptr& constants);
 	static bool IsNameIndexer(Expression* exp, const char * lcType, const Dictionary::Ptr& constants);
@@ -0,0 +1,797 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "config/bytecode.hpp"
+#include "config/vmops.hpp"
+#include "base/array.hpp"
+#include "base/configuration.hpp"
+#include "base/exception.hpp"
+#include "base/json.hpp"
+#include "base/scriptglobal.hpp"
+#include <boost/exception/errinfo_nested_exception.hpp>
+#include <limits>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+
+using namespace icinga;
+
+enum BytecodeOp : uint8_t
+{
+	OpMove,
+	OpLoadVar,
+	OpLoadVarRef,
+	OpLoadScope,
+	OpGetField,
+	OpNegate,
+	OpLogicalNegate,
+	OpAdd,
+	OpSubtract,
+	OpMultiply,
+	OpDivide,
+	OpModulo,
+	OpXor,
+	OpBinaryAnd,
+	OpBinaryOr,
+	OpShiftLeft,
+	OpShiftRight,
+	OpEqual,
+	OpNotEqual,
+	OpLessThan,
+	OpGreaterThan,
+	OpLessThanOrEqual,
+	OpGreaterThanOrEqual,
+	OpCheckIn,
+	OpCheckNotIn,
+	OpIn,
+	OpNotIn,
+	OpJumpIfFalse,
+	OpJumpIfTrue,
+	OpMakeArray,
+	OpCheckCallable,
+	OpCall
+};
+
+/* Operands with this bit set refer to m_Constants, all others to registers. */
+static const uint32_t l_ConstantOperand = 0x80000000u;
+static const uint32_t l_NoRegister = std::numeric_limits<uint32_t>::max();
+
+/**
+ * Dst = Op(A, B), or as documented in BytecodeExpression::DoEvaluate().
+ */
+struct BytecodeExpression::Instruction
+{
+	BytecodeOp Op;
+	uint32_t Dst;
+	uint32_t A;
+	uint32_t B;
+	uint32_t C;
+	uint32_t N;
+	const DebugInfo *DI;
+};
+
+/**
+ * A variable looked up at most once per evaluation, by value or (for calls) by reference.
+ */
+struct BytecodeExpression::Slot
+{
+	const VariableExpression *Variable;
+	bool Reference;
+};
+
+/**
+ * Thrown for expressions which can't be compiled.
+ */
+struct UnsupportedExpression { };
+
+static Value BinaryOperation(BytecodeOp op, const Value& a, const Value& b)
+{
+	switch (op) {
+		case OpAdd:
+			return a + b;
+		case OpSubtract:
+			return a - b;
+		case OpMultiply:
+			return a * b;
+		case OpDivide:
+			return a / b;
+		case OpModulo:
+			return a % b;
+		case OpXor:
+			return a ^ b;
+		case OpBinaryAnd:
+			return a & b;
+		case OpBinaryOr:
+			return a | b;
+		case OpShiftLeft:
+			return a << b;
+		case OpShiftRight:
+			return a >> b;
+		case OpEqual:
+			return a == b;
+		case OpNotEqual:
+			return a != b;
+		case OpLessThan:
+			return a < b;
+		case OpGreaterThan:
+			return a > b;
+		case OpLessThanOrEqual:
+			return a <= b;
+		case OpGreaterThanOrEqual:
+			return a >= b;
+		default:
+			VERIFY(!"Invalid binary operation.");
+	}
+}
+
+class BytecodeExpression::Compiler
+{
+public:
+	Compiler(BytecodeExpression& program)
+		: m_Program(program)
+	{ }
+
+	/**
+	 * Compiles an expression as a value.
+	 *
+	 * @return A constant or a register at or above the first free one before the call
+	 */
+	uint32_t Compile(const Expression *expression)
+	{
+		auto& type (typeid(*expression));
+
+		if (type == typeid(LiteralExpression)) {
+			return AddConstant(static_cast<const LiteralExpression *>(expression)->GetValue());
+		}
+
+		if (type == typeid(VariableExpression)) {
+			auto dst (AllocRegister());
+
+			Emit(OpLoadVar, dst, l_NoRegister, l_NoRegister, GetSlot(static_cast<const VariableExpression *>(expression), false), 0, expression);
+			return dst;
+		}
+
+		if (type == typeid(GetScopeExpression)) {
+			auto dst (AllocRegister());
+
+			Emit(OpLoadScope, dst, l_NoRegister, l_NoRegister, static_cast<const GetScopeExpression *>(expression)->m_ScopeSpec, 0, expression);
+			return dst;
+		}
+
+		if (type == typeid(IndexerExpression)) {
+			auto indexer (static_cast<const IndexerExpression *>(expression));
+
+			return CompileBinary(OpGetField, indexer->GetOperand1().get(), indexer->GetOperand2().get(), expression, false);
+		}
+
+		if (type == typeid(NegateExpression) || type == typeid(LogicalNegateExpression)) {
+			auto op (type == typeid(NegateExpression) ? OpNegate : OpLogicalNegate);
+			auto top (m_Top);
+			auto operand (Compile(static_cast<const UnaryExpression *>(expression)->m_Operand.get()));
+
+			if (IsConstant(operand)) {
+				try {
+					auto& value (GetConstant(operand));
+					return AddConstant(op == OpNegate ? Value(~(long)value) : Value(!value.ToBool()));
+				} catch (const std::exception&) {
+					/* Let it fail at runtime, with the correct debug info. */
+				}
+			}
+
+			m_Top = top;
+
+			auto dst (AllocRegister());
+
+			Emit(op, dst, operand, l_NoRegister, 0, 0, expression);
+			return dst;
+		}
+
+		static const std::unordered_map<std::type_index, BytecodeOp> binaryOps ({
+			{ typeid(AddExpression), OpAdd },
+			{ typeid(SubtractExpression), OpSubtract },
+			{ typeid(MultiplyExpression), OpMultiply },
+			{ typeid(DivideExpression), OpDivide },
+			{ typeid(ModuloExpression), OpModulo },
+			{ typeid(XorExpression), OpXor },
+			{ typeid(BinaryAndExpression), OpBinaryAnd },
+			{ typeid(BinaryOrExpression), OpBinaryOr },
+			{ typeid(ShiftLeftExpression), OpShiftLeft },
+			{ typeid(ShiftRightExpression), OpShiftRight },
+			{ typeid(EqualExpression), OpEqual },
+			{ typeid(NotEqualExpression), OpNotEqual },
+			{ typeid(LessThanExpression), OpLessThan },
+			{ typeid(GreaterThanExpression), OpGreaterThan },
+			{ typeid(LessThanOrEqualExpression), OpLessThanOrEqual },
+			{ typeid(GreaterThanOrEqualExpression), OpGreaterThanOrEqual }
+		});
+
+		auto binaryOp (binaryOps.find(type));
+
+		if (binaryOp != binaryOps.end()) {
+			auto binary (static_cast<const BinaryExpression *>(expression));
+
+			return CompileBinary(binaryOp->second, binary->GetOperand1().get(), binary->GetOperand2().get(), expression, true);
+		}
+
+		if (type == typeid(InExpression) || type == typeid(NotInExpression)) {
+			auto binary (static_cast<const BinaryExpression *>(expression));
+
+			return CompileIn(type == typeid(InExpression), binary->GetOperand1().get(), binary->GetOperand2().get(), expression);
+		}
+
+		if (type == typeid(LogicalAndExpression) || type == typeid(LogicalOrExpression)) {
+			auto binary (static_cast<const BinaryExpression *>(expression));
+
+			return CompileLogical(type == typeid(LogicalAndExpression), binary->GetOperand1().get(), binary->GetOperand2().get());
+		}
+
+		if (type == typeid(ArrayExpression)) {
+			auto& elements (static_cast<const ArrayExpression *>(expression)->m_Expressions);
+			auto first (CompileSequence(elements));
+			auto dst (AllocRegister());
+
+			Emit(OpMakeArray, dst, first, l_NoRegister, 0, elements.size(), expression);
+			return dst;
+		}
+
+		if (type == typeid(DictExpression)) {
+			auto dict (static_cast<const DictExpression *>(expression));
+
+			/* Only blocks (e.g. the top-level expression of a filter), not dictionary literals. */
+			if (!dict->m_Inline) {
+				throw UnsupportedExpression();
+			}
+
+			auto& statements (dict->GetExpressions());
+			uint32_t result = AddConstant(Empty);
+			auto top (m_Top);
+
+			for (auto& statement : statements) {
+				m_Top = top;
+				result = Compile(statement.get());
+			}
+
+			return result;
+		}
+
+		if (type == typeid(FunctionCallExpression)) {
+			return CompileCall(static_cast<const FunctionCallExpression *>(expression));
+		}
+
+		throw UnsupportedExpression();
+	}
+
+private:
+	BytecodeExpression& m_Program;
+	uint32_t m_Top{0};
+
+	static bool IsConstant(uint32_t operand)
+	{
+		return operand & l_ConstantOperand;
+	}
+
+	const Value& GetConstant(uint32_t operand) const
+	{
+		return m_Program.m_Constants[operand & ~l_ConstantOperand];
+	}
+
+	uint32_t AddConstant(Value value)
+	{
+		m_Program.m_Constants.emplace_back(std::move(value));
+
+		return (m_Program.m_Constants.size() - 1u) | l_ConstantOperand;
+	}
+
+	uint32_t AllocRegister()
+	{
+		auto reg (m_Top++);
+
+		if (m_Top > m_Program.m_Registers) {
+			m_Program.m_Registers = m_Top;
+		}
+
+		return reg;
+	}
+
+	size_t Emit(BytecodeOp op, uint32_t dst, uint32_t a, uint32_t b, uint32_t c, uint32_t n, const Expression *source)
+	{
+		m_Program.m_Code.push_back({ op, dst, a, b, c, n, &source->GetDebugInfo() });
+
+		return m_Program.m_Code.size() - 1u;
+	}
+
+	/**
+	 * Variables with the same name and imports share a slot.
+	 */
+	uint32_t GetSlot(const VariableExpression *variable, bool reference)
+	{
+		auto& slots (m_Program.m_Slots);
+
+		for (uint32_t i = 0; i < slots.size(); i++) {
+			if (slots[i].Reference == reference && slots[i].Variable->GetVariable() == variable->GetVariable()
+				&& slots[i].Variable->m_Imports == variable->m_Imports) {
+				return i;
+			}
+		}
+
+		slots.push_back({ variable, reference });
+		return slots.size() - 1u;
+	}
+
+	/**
+	 * Compiles the expressions into consecutive registers.
+	 *
+	 * @return The first register
+	 */
+	uint32_t CompileSequence(const std::vector<std::unique_ptr<Expression>>& expressions)
+	{
+		auto first (m_Top);
+
+		for (auto& expression : expressions) {
+			auto reg (AllocRegister());
+			auto value (Compile(expression.get()));
+
+			if (value != reg) {
+				Emit(OpMove, reg, value, l_NoRegister, 0, 0, expression.get());
+			}
+
+			m_Top = reg + 1u;
+		}
+
+		m_Top = first;
+		return first;
+	}
+
+	uint32_t CompileBinary(BytecodeOp op, const Expression *operand1, const Expression *operand2, const Expression *source, bool fold)
+	{
+		auto top (m_Top);
+		auto a (Compile(operand1));
+		auto b (Compile(operand2));
+
+		if (fold && IsConstant(a) && IsConstant(b)) {
+			try {
+				return AddConstant(BinaryOperation(op, GetConstant(a), GetConstant(b)));
+			} catch (const std::exception&) {
+				/* Let it fail at runtime, with the correct debug info. */
+			}
+		}
+
+		m_Top = top;
+
+		auto dst (AllocRegister());
+
+		Emit(op, dst, a, b, 0, 0, source);
+		return dst;
+	}
+
+	/**
+	 * Like InExpression/NotInExpression, evaluates the array first and the needle only if it's needed.
+	 */
+	uint32_t CompileIn(bool in, const Expression *needle, const Expression *haystack, const Expression *source)
+	{
+		auto top (m_Top);
+		uint32_t array;
+		bool checked = false;
+
+		/* Arrays of literals are built only once, they don't escape the 'in' operator. */
+		if (typeid(*haystack) == typeid(ArrayExpression)) {
+			ArrayData elements;
+
+			for (auto& element : static_cast<const ArrayExpression *>(haystack)->m_Expressions) {
+				if (typeid(*element) != typeid(LiteralExpression)) {
+					break;
+				}
+
+				elements.push_back(static_cast<const LiteralExpression *>(element.get())->GetValue());
+			}
+
+			if (elements.size() == static_cast<const ArrayExpression *>(haystack)->m_Expressions.size()) {
+				array = AddConstant(new Array(std::move(elements)));
+				checked = true;
+			} else {
+				array = Compile(haystack);
+			}
+		} else {
+			array = Compile(haystack);
+
+			if (IsConstant(array) && GetConstant(array).IsEmpty()) {
+				m_Top = top;
+				return AddConstant(!in);
+			}
+		}
+
+		auto dst (AllocRegister());
+		size_t check = 0;
+
+		if (!checked) {
+			check = Emit(in ? OpCheckIn : OpCheckNotIn, dst, l_NoRegister, array, 0, 0, source);
+		}
+
+		auto value (Compile(needle));
+
+		Emit(in ? OpIn : OpNotIn, dst, value, array, 0, 0, source);
+
+		if (!checked) {
+			m_Program.m_Code[check].C = m_Program.m_Code.size();
+		}
+
+		m_Top = dst + 1u;
+		return dst;
+	}
+
+	/**
+	 * Like LogicalAndExpression/LogicalOrExpression, yields the first operand deciding the result.
+	 */
+	uint32_t CompileLogical(bool isAnd, const Expression *operand1, const Expression *operand2)
+	{
+		auto top (m_Top);
+		auto a (Compile(operand1));
+
+		if (IsConstant(a)) {
+			if (GetConstant(a).ToBool() != isAnd) {
+				m_Top = top;
+				return a;
+			}
+
+			m_Top = top;
+			return Compile(operand2);
+		}
+
+		m_Top = top;
+
+		auto dst (AllocRegister());
+
+		if (a != dst) {
+			Emit(OpMove, dst, a, l_NoRegister, 0, 0, operand1);
+		}
+
+		auto jump (Emit(isAnd ? OpJumpIfFalse : OpJumpIfTrue, l_NoRegister, dst, l_NoRegister, 0, 0, operand1));
+		auto b (Compile(operand2));
+
+		if (b != dst) {
+			Emit(OpMove, dst, b, l_NoRegister, 0, 0, operand2);
+		}
+
+		m_Program.m_Code[jump].C = m_Program.m_Code.size();
+
+		m_Top = dst + 1u;
+		return dst;
+	}
+
+	/**
+	 * Compiles an expression like Expression#GetReference() followed by VMOps::GetField(),
+	 * i.e. the way a method call's object is determined.
+	 */
+	uint32_t CompileReferenced(const Expression *expression, const Expression *source)
+	{
+		auto& type (typeid(*expression));
+
+		if (type == typeid(VariableExpression)) {
+			auto dst (AllocRegister());
+
+			Emit(OpLoadVarRef, dst, l_NoRegister, l_NoRegister, GetSlot(static_cast<const VariableExpression *>(expression), true), 0, source);
+			return dst;
+		}
+
+		if (type == typeid(IndexerExpression)) {
+			auto indexer (static_cast<const IndexerExpression *>(expression));
+			auto top (m_Top);
+			auto parent (CompileReferenced(indexer->GetOperand1().get(), expression));
+			auto index (Compile(indexer->GetOperand2().get()));
+
+			m_Top = top;
+
+			auto dst (AllocRegister());
+
+			Emit(OpGetField, dst, parent, index, 0, 0, source);
+			return dst;
+		}
+
+		return Compile(expression);
+	}
+
+	uint32_t CompileCall(const FunctionCallExpression *call)
+	{
+		auto top (m_Top);
+		auto fname (call->m_FName.get());
+		auto& type (typeid(*fname));
+		uint32_t self, function;
+
+		if (type == typeid(VariableExpression)) {
+			function = AllocRegister();
+			self = AllocRegister();
+
+			Emit(OpLoadVarRef, function, self, l_NoRegister, GetSlot(static_cast<const VariableExpression *>(fname), true), 0, call);
+		} else if (type == typeid(IndexerExpression)) {
+			auto indexer (static_cast<const IndexerExpression *>(fname));
+
+			self = CompileReferenced(indexer->GetOperand1().get(), fname);
+
+			auto index (Compile(indexer->GetOperand2().get()));
+
+			function = AllocRegister();
+
+			Emit(OpGetField, function, self, index, 0, 0, call);
+		} else {
+			self = AddConstant(Empty);
+			function = Compile(fname);
+		}
+
+		Emit(OpCheckCallable, l_NoRegister, function, l_NoRegister, 0, 0, call);
+
+		auto first (CompileSequence(call->m_Args));
+
+		m_Top = top;
+
+		auto dst (AllocRegister());
+
+		Emit(OpCall, dst, function, self, first, call->m_Args.size(), call);
+		return dst;
+	}
+};
+
+BytecodeExpression::BytecodeExpression(const Expression *source)
+	: m_Source(source)
+{ }
+
+BytecodeExpression::~BytecodeExpression() = default;
+
+/**
+ * Compiles the given expression if enabled via Configuration.ScriptBytecode.
+ *
+ * @param expression The expression to compile
+ *
+ * @return The compiled expression or the given one if it can't be compiled
+ */
+Expression::Ptr BytecodeExpression::Compile(const Expression::Ptr& expression)
+{
+	if (!Configuration::ScriptBytecode || !expression) {
+		return expression;
+	}
+
+	auto program (TryCompile(expression.get()));
+
+	if (!program) {
+		return expression;
+	}
+
+	program->m_Expression = expression;
+	return program.release();
+}
+
+/**
+ * Compiles the given expression if enabled via Configuration.ScriptBytecode.
+ *
+ * @param expression The expression to compile
+ *
+ * @return The compiled expression or the given one if it can't be compiled
+ */
+std::unique_ptr<Expression> BytecodeExpression::Compile(std::unique_ptr<Expression> expression)
+{
+	if (!Configuration::ScriptBytecode || !expression) {
+		return expression;
+	}
+
+	auto program (TryCompile(expression.get()));
+
+	if (!program) {
+		return expression;
+	}
+
+	program->m_Expression = expression.release();
+	return std::move(program);
+}
+
+/**
+ * Compiles the given expression regardless of Configuration.ScriptBytecode.
+ * The expression must outlive the result.
+ *
+ * @param expression The expression to compile
+ *
+ * @return The compiled expression or nullptr if it contains unsupported expressions
+ */
+std::unique_ptr<BytecodeExpression> BytecodeExpression::TryCompile(const Expression *expression)
+{
+	std::unique_ptr<BytecodeExpression> program (new BytecodeExpression(expression));
+	Compiler compiler (*program);
+
+	try {
+		program->m_Result = compiler.Compile(expression);
+	} catch (const UnsupportedExpression&) {
+		return nullptr;
+	}
+
+	return program;
+}
+
+const DebugInfo& BytecodeExpression::GetDebugInfo() const
+{
+	return m_Source->GetDebugInfo();
+}
+
+size_t BytecodeExpression::GetInstructionCount() const
+{
+	return m_Code.size();
+}
+
+/**
+ * Runs the program. Besides Dst = Op(A, B):
+ *
+ * - LoadVar/LoadVarRef: Dst = the variable in slot C, A = its parent (LoadVarRef only, optional)
+ * - LoadScope: Dst = the scope C
+ * - CheckIn/CheckNotIn: if B is null, Dst = (not in) and jump to C, otherwise B must be an array
+ * - JumpIfFalse/JumpIfTrue: jump to C depending on A
+ * - MakeArray: Dst = the N registers starting at A
+ * - CheckCallable: A must be a function or a type
+ * - Call: Dst = A(N registers starting at C) with B as this
+ */
+ExpressionResult BytecodeExpression::DoEvaluate(ScriptFrame& frame, DebugHint *) const
+{
+	std::vector<Value> registers (m_Registers);
+	std::vector<Value> slotValues (m_Slots.size());
+	std::vector<Value> slotParents (m_Slots.size());
+	std::vector<bool> slotsLoaded (m_Slots.size());
+
+	auto operand ([this, &registers](uint32_t op) -> const Value& {
+		return op & l_ConstantOperand ? m_Constants[op & ~l_ConstantOperand] : registers[op];
+	});
+
+	auto loadSlot ([&frame, &slotValues, &slotParents, &slotsLoaded, this](uint32_t slot, const DebugInfo& di) {
+		if (slotsLoaded[slot]) {
+			return;
+		}
+
+		auto& s (m_Slots[slot]);
+		const Expression *variable = s.Variable;
+
+		if (s.Reference) {
+			String index;
+
+			variable->GetReference(frame, false, &slotParents[slot], &index);
+			slotValues[slot] = VMOps::GetField(slotParents[slot], index, frame.Sandboxed, di);
+		} else {
+			slotValues[slot] = variable->DoEvaluate(frame, nullptr).GetValue();
+		}
+
+		slotsLoaded[slot] = true;
+	});
+
+	size_t pc = 0;
+
+	try {
+		for (; pc < m_Code.size(); pc++) {
+			auto& in (m_Code[pc]);
+
+			switch (in.Op) {
+				case OpMove:
+					registers[in.Dst] = operand(in.A);
+					break;
+
+				case OpLoadVar:
+				case OpLoadVarRef:
+					loadSlot(in.C, *in.DI);
+					registers[in.Dst] = slotValues[in.C];
+
+					if (in.A != l_NoRegister) {
+						registers[in.A] = slotParents[in.C];
+					}
+
+					break;
+
+				case OpLoadScope:
+					switch (in.C) {
+						case ScopeLocal:
+							registers[in.Dst] = frame.Locals;
+							break;
+						case ScopeThis:
+							registers[in.Dst] = frame.Self;
+							break;
+						default:
+							registers[in.Dst] = ScriptGlobal::GetGlobals();
+					}
+
+					break;
+
+				case OpGetField:
+					registers[in.Dst] = VMOps::GetField(operand(in.A), operand(in.B), frame.Sandboxed, *in.DI);
+					break;
+
+				case OpNegate:
+					registers[in.Dst] = ~(long)operand(in.A);
+					break;
+
+				case OpLogicalNegate:
+					registers[in.Dst] = !operand(in.A).ToBool();
+					break;
+
+				case OpCheckIn:
+				case OpCheckNotIn: {
+					auto& array (operand(in.B));
+
+					if (array.IsEmpty()) {
+						registers[in.Dst] = in.Op == OpCheckNotIn;
+						pc = in.C - 1u;
+					} else if (!array.IsObjectType<Array>()) {
+						BOOST_THROW_EXCEPTION(ScriptError("Invalid right side argument for 'in' operator: " + JsonEncode(array), *in.DI));
+					}
+
+					break;
+				}
+
+				case OpIn:
+				case OpNotIn: {
+					Array::Ptr array = operand(in.B);
+					bool contains = array->Contains(operand(in.A));
+
+					registers[in.Dst] = in.Op == OpIn ? contains : !contains;
+					break;
+				}
+
+				case OpJumpIfFalse:
+					if (!operand(in.A).ToBool()) {
+						pc = in.C - 1u;
+					}
+
+					break;
+
+				case OpJumpIfTrue:
+					if (operand(in.A).ToBool()) {
+						pc = in.C - 1u;
+					}
+
+					break;
+
+				case OpMakeArray:
+					registers[in.Dst] = new Array(ArrayData(registers.begin() + in.A, registers.begin() + in.A + in.N));
+					break;
+
+				case OpCheckCallable: {
+					auto& function (operand(in.A));
+
+					if (function.IsObjectType<Type>()) {
+						break;
+					}
+
+					if (!function.IsObjectType<Function>()) {
+						BOOST_THROW_EXCEPTION(ScriptError("Argument is not a callable object.", *in.DI));
+					}
+
+					if (frame.Sandboxed) {
+						Function::Ptr func = function;
+
+						if (!func->IsSideEffectFree()) {
+							BOOST_THROW_EXCEPTION(ScriptError("Function is not marked as safe for sandbox mode.", *in.DI));
+						}
+					}
+
+					break;
+				}
+
+				case OpCall: {
+					auto& function (operand(in.A));
+					std::vector<Value> arguments (registers.begin() + in.C, registers.begin() + in.C + in.N);
+
+					if (function.IsObjectType<Type>()) {
+						registers[in.Dst] = VMOps::ConstructorCall(function, arguments, *in.DI);
+					} else {
+						registers[in.Dst] = VMOps::FunctionCall(frame, operand(in.B), function, arguments);
+
+						/* The function may have changed any variable. */
+						std::fill(slotsLoaded.begin(), slotsLoaded.end(), false);
+					}
+
+					break;
+				}
+
+				default:
+					registers[in.Dst] = BinaryOperation(in.Op, operand(in.A), operand(in.B));
+			}
+		}
+	} catch (const ScriptError&) {
+		throw;
+	} catch (const std::exception& ex) {
+		BOOST_THROW_EXCEPTION(ScriptError("Error while evaluating expression: " + String(ex.what()), *m_Code[pc].DI)
+			<< boost::errinfo_nested_exception(boost::current_exception()));
+	}
+
+	return operand(m_Result);
+}
@@ -0,0 +1,65 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "config/i2-config.hpp"
+#include "config/expression.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * An expression compiled into a compact register-based bytecode.
+ *
+ * Only the side effect free subset of the language typically used by apply rule
+ * and API filters (literals, variables, indexers, operators, arrays and function
+ * calls) can be compiled. Variables are resolved into slots which are looked up
+ * at most once per evaluation (or function call) and constant subexpressions are
+ * folded at compile time. The results and errors are the same as those of the
+ * original expression tree.
+ *
+ * @ingroup config
+ */
+class BytecodeExpression final : public Expression
+{
+public:
+	~BytecodeExpression() override;
+
+	static Expression::Ptr Compile(const Expression::Ptr& expression);
+	static std::unique_ptr<Expression> Compile(std::unique_ptr<Expression> expression);
+
+	static std::unique_ptr<BytecodeExpression> TryCompile(const Expression *expression);
+
+	const DebugInfo& GetDebugInfo() const override;
+
+	size_t GetInstructionCount() const;
+
+protected:
+	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override;
+
+private:
+	struct Instruction;
+	struct Slot;
+	class Compiler;
+
+	/* The compiled expression, referenced by the instructions (debug info, variables).
+	 * Owned by this object unless created by TryCompile(). */
+	const Expression *m_Source;
+	Expression::Ptr m_Expression;
+
+	std::vector<Instruction> m_Code;
+	std::vector<Value> m_Constants;
+	std::vector<Slot> m_Slots;
+	uint32_t m_Registers{0};
+	uint32_t m_Result{0};
+
+	BytecodeExpression(const Expression *source);
+};
+
+}
+
+#endif /* BYTECODE_H */
@@ -0,0 +1,1173 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "config/compiledconfigcache.hpp"
+#include "base/application.hpp"
+#include "base/atomic-file.hpp"
+#include "base/configuration.hpp"
+#include "base/exception.hpp"
+#include "base/logger.hpp"
+#include "base/tlsutility.hpp"
+#include "base/utility.hpp"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+using namespace icinga;
+
+/* Bump this whenever an expression class or this format changes. */
+static const char l_EntryMagic[] = "I2CCFG02";
+static const size_t l_EntryMagicLength = 8;
+
+/* Length of the hex-encoded SHA256 hash of the config file's content. */
+static const size_t l_EntryHashLength = 64;
+
+/* Prune() reads at most this much of each entry, enough for the header. */
+static const size_t l_EntryMaxHeaderLength = l_EntryMagicLength + l_EntryHashLength + 64 * 1024;
+
+enum ExpressionTag : unsigned char
+{
+	TagNull,
+	TagLiteral,
+	TagVariable,
+	TagDeref,
+	TagRef,
+	TagNegate,
+	TagLogicalNegate,
+	TagAdd,
+	TagSubtract,
+	TagMultiply,
+	TagDivide,
+	TagModulo,
+	TagXor,
+	TagBinaryAnd,
+	TagBinaryOr,
+	TagShiftLeft,
+	TagShiftRight,
+	TagEqual,
+	TagNotEqual,
+	TagLessThan,
+	TagGreaterThan,
+	TagLessThanOrEqual,
+	TagGreaterThanOrEqual,
+	TagIn,
+	TagNotIn,
+	TagLogicalAnd,
+	TagLogicalOr,
+	TagFunctionCall,
+	TagArray,
+	TagDict,
+	TagSetConst,
+	TagSet,
+	TagConditional,
+	TagWhile,
+	TagReturn,
+	TagBreak,
+	TagContinue,
+	TagGetScope,
+	TagIndexer,
+	TagThrow,
+	TagImport,
+	TagImportDefaultTemplates,
+	TagFunction,
+	TagApply,
+	TagNamespace,
+	TagObject,
+	TagFor,
+	TagLibrary,
+	TagInclude,
+	TagBreakpoint,
+	TagTryExcept
+};
+
+enum LiteralTag : unsigned char
+{
+	LiteralEmpty,
+	LiteralFalse,
+	LiteralTrue,
+	LiteralNumber,
+	LiteralString
+};
+
+static const std::unordered_map<std::type_index, ExpressionTag> l_ExpressionTags ({
+	{ typeid(LiteralExpression), TagLiteral },
+	{ typeid(VariableExpression), TagVariable },
+	{ typeid(DerefExpression), TagDeref },
+	{ typeid(RefExpression), TagRef },
+	{ typeid(NegateExpression), TagNegate },
+	{ typeid(LogicalNegateExpression), TagLogicalNegate },
+	{ typeid(AddExpression), TagAdd },
+	{ typeid(SubtractExpression), TagSubtract },
+	{ typeid(MultiplyExpression), TagMultiply },
+	{ typeid(DivideExpression), TagDivide },
+	{ typeid(ModuloExpression), TagModulo },
+	{ typeid(XorExpression), TagXor },
+	{ typeid(BinaryAndExpression), TagBinaryAnd },
+	{ typeid(BinaryOrExpression), TagBinaryOr },
+	{ typeid(ShiftLeftExpression), TagShiftLeft },
+	{ typeid(ShiftRightExpression), TagShiftRight },
+	{ typeid(EqualExpression), TagEqual },
+	{ typeid(NotEqualExpression), TagNotEqual },
+	{ typeid(LessThanExpression), TagLessThan },
+	{ typeid(GreaterThanExpression), TagGreaterThan },
+	{ typeid(LessThanOrEqualExpression), TagLessThanOrEqual },
+	{ typeid(GreaterThanOrEqualExpression), TagGreaterThanOrEqual },
+	{ typeid(InExpression), TagIn },
+	{ typeid(NotInExpression), TagNotIn },
+	{ typeid(LogicalAndExpression), TagLogicalAnd },
+	{ typeid(LogicalOrExpression), TagLogicalOr },
+	{ typeid(FunctionCallExpression), TagFunctionCall },
+	{ typeid(ArrayExpression), TagArray },
+	{ typeid(DictExpression), TagDict },
+	{ typeid(SetConstExpression), TagSetConst },
+	{ typeid(SetExpression), TagSet },
+	{ typeid(ConditionalExpression), TagConditional },
+	{ typeid(WhileExpression), TagWhile },
+	{ typeid(ReturnExpression), TagReturn },
+	{ typeid(BreakExpression), TagBreak },
+	{ typeid(ContinueExpression), TagContinue },
+	{ typeid(GetScopeExpression), TagGetScope },
+	{ typeid(IndexerExpression), TagIndexer },
+	{ typeid(ThrowExpression), TagThrow },
+	{ typeid(ImportExpression), TagImport },
+	{ typeid(ImportDefaultTemplatesExpression), TagImportDefaultTemplates },
+	{ typeid(FunctionExpression), TagFunction },
+	{ typeid(ApplyExpression), TagApply },
+	{ typeid(NamespaceExpression), TagNamespace },
+	{ typeid(ObjectExpression), TagObject },
+	{ typeid(ForExpression), TagFor },
+	{ typeid(LibraryExpression), TagLibrary },
+	{ typeid(IncludeExpression), TagInclude },
+	{ typeid(BreakpointExpression), TagBreakpoint },
+	{ typeid(TryExceptExpression), TagTryExcept }
+});
+
+/* VariableExpression appends these to the imports of the parser. */
+static const size_t l_DefaultImports = 4;
+
+/**
+ * Encodes a syntax tree. Strings (most notably the file path in the debug info
+ * of every expression) and shared imports are written only once and referenced afterwards.
+ */
+struct CompiledConfigCache::Writer
+{
+	std::string Buffer;
+	std::unordered_map<String, uint64_t> Strings;
+	std::unordered_map<const Expression *, uint64_t> Imports;
+
+	void WriteByte(unsigned char value)
+	{
+		Buffer += (char)value;
+	}
+
+	void WriteBool(bool value)
+	{
+		WriteByte(value ? 1 : 0);
+	}
+
+	void WriteNumber(uint64_t value)
+	{
+		while (value >= 0x80u) {
+			Buffer += (char)(value | 0x80u);
+			value >>= 7u;
+		}
+
+		Buffer += (char)value;
+	}
+
+	void WriteInt(int value)
+	{
+		WriteNumber((uint32_t)value);
+	}
+
+	void WriteDouble(double value)
+	{
+		uint64_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+
+		for (int shift = 0; shift < 64; shift += 8) {
+			Buffer += (char)(bits >> shift);
+		}
+	}
+
+	/* 0 and the string itself if not written yet, otherwise its number + 1 */
+	void WriteString(const String& value)
+	{
+		auto it (Strings.find(value));
+
+		if (it != Strings.end()) {
+			WriteNumber(it->second + 1u);
+			return;
+		}
+
+		WriteNumber(0);
+		WriteNumber(value.GetLength());
+		Buffer.append(value.CStr(), value.GetLength());
+
+		auto id (Strings.size());
+		Strings.emplace(value, id);
+	}
+
+	void WriteDebugInfo(const DebugInfo& di)
+	{
+		WriteString(di.Path);
+		WriteInt(di.FirstLine);
+		WriteInt(di.FirstColumn);
+		WriteInt(di.LastLine);
+		WriteInt(di.LastColumn);
+	}
+};
+
+struct CompiledConfigCache::Reader
+{
+	const char *Position;
+	const char *End;
+	std::vector<String> Strings;
+	std::vector<Expression::Ptr> Imports;
+
+	void Need(size_t bytes)
+	{
+		if ((size_t)(End - Position) < bytes) {
+			BOOST_THROW_EXCEPTION(std::runtime_error("Compiled config cache entry is truncated."));
+		}
+	}
+
+	unsigned char ReadByte()
+	{
+		Need(1);
+		return (unsigned char)*Position++;
+	}
+
+	bool ReadBool()
+	{
+		return ReadByte();
+	}
+
+	uint64_t ReadNumber()
+	{
+		uint64_t value = 0;
+
+		for (int shift = 0; shift < 64; shift += 7) {
+			unsigned char byte = ReadByte();
+
+			value |= (uint64_t)(byte & 0x7Fu) << shift;
+
+			if (!(byte & 0x80u)) {
+				return value;
+			}
+		}
+
+		BOOST_THROW_EXCEPTION(std::runtime_error("Compiled config cache entry contains an invalid number."));
+	}
+
+	int ReadInt()
+	{
+		return (int)(uint32_t)ReadNumber();
+	}
+
+	double ReadDouble()
+	{
+		Need(8);
+
+		uint64_t bits = 0;
+
+		for (int i = 7; i >= 0; i--) {
+			bits = (bits << 8u) | (unsigned char)Position[i];
+		}
+
+		Position += 8;
+
+		double value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	String ReadString()
+	{
+		uint64_t id = ReadNumber();
+
+		if (id) {
+			if (id > Strings.size()) {
+				BOOST_THROW_EXCEPTION(std::runtime_error("Compiled config cache entry references an unknown string."));
+			}
+
+			return Strings[id - 1u];
+		}
+
+		uint64_t length = ReadNumber();
+		Need(length);
+
+		Strings.emplace_back(Position, Position + length);
+		Position += length;
+
+		return Strings.back();
+	}
+
+	DebugInfo ReadDebugInfo()
+	{
+		DebugInfo di;
+
+		di.Path = ReadString();
+		di.FirstLine = ReadInt();
+		di.FirstColumn = ReadInt();
+		di.LastLine = ReadInt();
+		di.LastColumn = ReadInt();
+
+		return di;
+	}
+};
+
+/**
+ * Encodes a syntax tree.
+ *
+ * @param expression The tree as returned by ConfigCompiler
+ *
+ * @return Binary data for Deserialize()
+ * @exception std::invalid_argument The tree contains expressions not created by the parser
+ */
+String CompiledConfigCache::Serialize(const Expression *expression)
+{
+	Writer writer;
+
+	WriteExpression(writer, expression);
+
+	return String(std::move(writer.Buffer));
+}
+
+/**
+ * Decodes a syntax tree encoded by Serialize().
+ *
+ * @param data Binary data
+ *
+ * @return The tree
+ * @exception std::runtime_error The data is invalid
+ */
+std::unique_ptr<Expression> CompiledConfigCache::Deserialize(const String& data)
+{
+	Reader reader;
+
+	reader.Position = data.CStr();
+	reader.End = data.CStr() + data.GetLength();
+
+	auto expression (ReadExpression(reader));
+
+	if (reader.Position != reader.End) {
+		BOOST_THROW_EXCEPTION(std::runtime_error("Compiled config cache entry has trailing data."));
+	}
+
+	return expression;
+}
+
+template<class T>
+static const T *As(const Expression *expression)
+{
+	return static_cast<const T *>(expression);
+}
+
+void CompiledConfigCache::WriteExpression(Writer& writer, const Expression *expression)
+{
+	if (!expression) {
+		writer.WriteByte(TagNull);
+		return;
+	}
+
+	auto tag (l_ExpressionTags.find(typeid(*expression)));
+
+	if (tag == l_ExpressionTags.end()) {
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Can't serialize expression of type " + String(typeid(*expression).name())));
+	}
+
+	writer.WriteByte(tag->second);
+
+	/* All but literals and scope lookups carry debug info. */
+	if (tag->second != TagLiteral && tag->second != TagGetScope) {
+		writer.WriteDebugInfo(expression->GetDebugInfo());
+	}
+
+	auto writeClosedVars ([&writer](const std::map<String, std::unique_ptr<Expression>>& closedVars) {
+		writer.WriteNumber(closedVars.size());
+
+		for (auto& kv : closedVars) {
+			writer.WriteString(kv.first);
+			WriteExpression(writer, kv.second.get());
+		}
+	});
+
+	auto writeExpressions ([&writer](const std::vector<std::unique_ptr<Expression>>& expressions) {
+		writer.WriteNumber(expressions.size());
+
+		for (auto& expression : expressions) {
+			WriteExpression(writer, expression.get());
+		}
+	});
+
+	switch (tag->second) {
+		case TagLiteral: {
+			const Value& value (As<LiteralExpression>(expression)->GetValue());
+
+			switch (value.GetType()) {
+				case ValueEmpty:
+					writer.WriteByte(LiteralEmpty);
+					break;
+				case ValueBoolean:
+					writer.WriteByte(value.ToBool() ? LiteralTrue : LiteralFalse);
+					break;
+				case ValueNumber:
+					writer.WriteByte(LiteralNumber);
+					writer.WriteDouble(value.Get<double>());
+					break;
+				case ValueString:
+					writer.WriteByte(LiteralString);
+					writer.WriteString(value.Get<String>());
+					break;
+				default:
+					BOOST_THROW_EXCEPTION(std::invalid_argument("Can't serialize literal of type " + value.GetTypeName()));
+			}
+
+			break;
+		}
+
+		case TagVariable: {
+			auto expr (As<VariableExpression>(expression));
+			auto imports (expr->m_Imports.size() - l_DefaultImports);
+
+			writer.WriteString(expr->m_Variable);
+			writer.WriteNumber(imports);
+
+			for (size_t i = 0; i < imports; i++) {
+				auto import (expr->m_Imports[i].get());
+				auto id (writer.Imports.find(import));
+
+				if (id == writer.Imports.end()) {
+					writer.WriteNumber(0);
+					WriteExpression(writer, import);
+
+					auto newId (writer.Imports.size());
+					writer.Imports.emplace(import, newId);
+				} else {
+					writer.WriteNumber(id->second + 1u);
+				}
+			}
+
+			break;
+		}
+
+		case TagDeref:
+		case TagRef:
+		case TagNegate:
+		case TagLogicalNegate:
+		case TagReturn:
+		case TagLibrary:
+			WriteExpression(writer, As<UnaryExpression>(expression)->m_Operand.get());
+			break;
+
+		case TagAdd:
+		case TagSubtract:
+		case TagMultiply:
+		case TagDivide:
+		case TagModulo:
+		case TagXor:
+		case TagBinaryAnd:
+		case TagBinaryOr:
+		case TagShiftLeft:
+		case TagShiftRight:
+		case TagEqual:
+		case TagNotEqual:
+		case TagLessThan:
+		case TagGreaterThan:
+		case TagLessThanOrEqual:
+		case TagGreaterThanOrEqual:
+		case TagIn:
+		case TagNotIn:
+		case TagLogicalAnd:
+		case TagLogicalOr:
+			WriteExpression(writer, As<BinaryExpression>(expression)->GetOperand1().get());
+			WriteExpression(writer, As<BinaryExpression>(expression)->GetOperand2().get());
+			break;
+
+		case TagFunctionCall: {
+			auto expr (As<FunctionCallExpression>(expression));
+
+			WriteExpression(writer, expr->m_FName.get());
+			writeExpressions(expr->m_Args);
+			break;
+		}
+
+		case TagArray:
+			writeExpressions(As<ArrayExpression>(expression)->m_Expressions);
+			break;
+
+		case TagDict: {
+			auto expr (As<DictExpression>(expression));
+
+			writeExpressions(expr->m_Expressions);
+			writer.WriteBool(expr->m_Inline);
+			break;
+		}
+
+		case TagSetConst: {
+			auto expr (As<SetConstExpression>(expression));
+
+			writer.WriteString(expr->m_Name);
+			WriteExpression(writer, expr->m_Operand.get());
+			break;
+		}
+
+		case TagSet: {
+			auto expr (As<SetExpression>(expression));
+
+			WriteExpression(writer, expr->GetOperand1().get());
+			writer.WriteByte(expr->m_Op);
+			WriteExpression(writer, expr->GetOperand2().get());
+			writer.WriteBool(expr->m_OverrideFrozen);
+			break;
+		}
+
+		case TagConditional: {
+			auto expr (As<ConditionalExpression>(expression));
+
+			WriteExpression(writer, expr->m_Condition.get());
+			WriteExpression(writer, expr->m_TrueBranch.get());
+			WriteExpression(writer, expr->m_FalseBranch.get());
+			break;
+		}
+
+		case TagWhile: {
+			auto expr (As<WhileExpression>(expression));
+
+			WriteExpression(writer, expr->m_Condition.get());
+			WriteExpression(writer, expr->m_LoopBody.get());
+			break;
+		}
+
+		case TagBreak:
+		case TagContinue:
+		case TagImportDefaultTemplates:
+		case TagBreakpoint:
+			break;
+
+		case TagGetScope:
+			writer.WriteByte(As<GetScopeExpression>(expression)->m_ScopeSpec);
+			break;
+
+		case TagIndexer: {
+			auto expr (As<IndexerExpression>(expression));
+
+			WriteExpression(writer, expr->GetOperand1().get());
+			WriteExpression(writer, expr->GetOperand2().get());
+			writer.WriteBool(expr->m_OverrideFrozen);
+			break;
+		}
+
+		case TagThrow: {
+			auto expr (As<ThrowExpression>(expression));
+
+			WriteExpression(writer, expr->m_Message.get());
+			writer.WriteBool(expr->m_IncompleteExpr);
+			break;
+		}
+
+		case TagImport:
+			WriteExpression(writer, As<ImportExpression>(expression)->m_Name.get());
+			break;
+
+		case TagFunction: {
+			auto expr (As<FunctionExpression>(expression));
+
+			writer.WriteString(expr->m_Name);
+			writer.WriteNumber(expr->m_Args.size());
+
+			for (auto& arg : expr->m_Args) {
+				writer.WriteString(arg);
+			}
+
+			writeClosedVars(expr->m_ClosedVars);
+			WriteExpression(writer, expr->m_Expression.get());
+			break;
+		}
+
+		case TagApply: {
+			auto expr (As<ApplyExpression>(expression));
+
+			writer.WriteString(expr->m_Type);
+			writer.WriteString(expr->m_Target);
+			WriteExpression(writer, expr->m_Name.get());
+			WriteExpression(writer, expr->m_Filter.get());
+			writer.WriteString(expr->m_Package);
+			writer.WriteString(expr->m_FKVar);
+			writer.WriteString(expr->m_FVVar);
+			WriteExpression(writer, expr->m_FTerm.get());
+			writeClosedVars(expr->m_ClosedVars);
+			writer.WriteBool(expr->m_IgnoreOnError);
+			WriteExpression(writer, expr->m_Expression.get());
+			break;
+		}
+
+		case TagNamespace:
+			WriteExpression(writer, As<NamespaceExpression>(expression)->m_Expression.get());
+			break;
+
+		case TagObject: {
+			auto expr (As<ObjectExpression>(expression));
+
+			writer.WriteBool(expr->m_Abstract);
+			WriteExpression(writer, expr->m_Type.get());
+			WriteExpression(writer, expr->m_Name.get());
+			WriteExpression(writer, expr->m_Filter.get());
+			writer.WriteString(expr->m_Zone);
+			writer.WriteString(expr->m_Package);
+			writeClosedVars(expr->m_ClosedVars);
+			writer.WriteBool(expr->m_DefaultTmpl);
+			writer.WriteBool(expr->m_IgnoreOnError);
+			WriteExpression(writer, expr->m_Expression.get());
+			break;
+		}
+
+		case TagFor: {
+			auto expr (As<ForExpression>(expression));
+
+			writer.WriteString(expr->m_FKVar);
+			writer.WriteString(expr->m_FVVar);
+			WriteExpression(writer, expr->m_Value.get());
+			WriteExpression(writer, expr->m_Expression.get());
+			break;
+		}
+
+		case TagInclude: {
+			auto expr (As<IncludeExpression>(expression));
+
+			writer.WriteString(expr->m_RelativeBase);
+			WriteExpression(writer, expr->m_Path.get());
+			WriteExpression(writer, expr->m_Pattern.get());
+			WriteExpression(writer, expr->m_Name.get());
+			writer.WriteByte(expr->m_Type);
+			writer.WriteBool(expr->m_SearchIncludes);
+			writer.WriteString(expr->m_Zone);
+			writer.WriteString(expr->m_Package);
+			break;
+		}
+
+		case TagTryExcept: {
+			auto expr (As<TryExceptExpression>(expression));
+
+			WriteExpression(writer, expr->m_TryBody.get());
+			WriteExpression(writer, expr->m_ExceptBody.get());
+			break;
+		}
+
+		default:
+			VERIFY(!"Unhandled expression tag");
+	}
+}
+
+std::unique_ptr<Expression> CompiledConfigCache::ReadExpression(Reader& reader)
+{
+	unsigned char tag = reader.ReadByte();
+
+	if (tag == TagNull) {
+		return nullptr;
+	}
+
+	if (tag > TagTryExcept) {
+		BOOST_THROW_EXCEPTION(std::runtime_error("Compiled config cache entry contains an unknown expression."));
+	}
+
+	DebugInfo di;
+
+	if (tag != TagLiteral && tag != TagGetScope) {
+		di = reader.ReadDebugInfo();
+	}
+
+	auto readClosedVars ([&reader]() {
+		std::map<String, std::unique_ptr<Expression>> closedVars;
+
+		for (auto count (reader.ReadNumber()); count; count--) {
+			String name = reader.ReadString();
+			closedVars.emplace(std::move(name), ReadExpression(reader));
+		}
+
+		return closedVars;
+	});
+
+	auto readExpressions ([&reader]() {
+		std::vector<std::unique_ptr<Expression>> expressions;
+
+		for (auto count (reader.ReadNumber()); count; count--) {
+			expressions.emplace_back(ReadExpression(reader));
+		}
+
+		return expressions;
+	});
+
+	/* Function arguments are evaluated in unspecified order, so everything is read into locals first. */
+	switch (tag) {
+		case TagLiteral:
+			switch (reader.ReadByte()) {
+				case LiteralEmpty:
+					return MakeLiteral();
+				case LiteralFalse:
+					return MakeLiteral(false);
+				case LiteralTrue:
+					return MakeLiteral(true);
+				case LiteralNumber:
+					return MakeLiteral(reader.ReadDouble());
+				case LiteralString:
+					return MakeLiteral(reader.ReadString());
+				default:
+					BOOST_THROW_EXCEPTION(std::runtime_error("Compiled config cache entry contains an unknown literal."));
+			}
+
+		case TagVariable: {
+			String variable = reader.ReadString();
+			std::vector<Expression::Ptr> imports;
+
+			for (auto count (reader.ReadNumber()); count; count--) {
+				auto id (reader.ReadNumber());
+
+				if (id) {
+					if (id > reader.Imports.size()) {
+						BOOST_THROW_EXCEPTION(std::runtime_error("Compiled config cache entry references an unknown import."));
+					}
+
+					imports.emplace_back(reader.Imports[id - 1u]);
+				} else {
+					Expression::Ptr import (ReadExpression(reader).release());
+
+					reader.Imports.emplace_back(import);
+					imports.emplace_back(std::move(import));
+				}
+			}
+
+			return std::unique_ptr<Expression>(new VariableExpression(std::move(variable), std::move(imports), di));
+		}
+
+		case TagDeref:
+			return std::unique_ptr<Expression>(new DerefExpression(ReadExpression(reader), di));
+		case TagRef:
+			return std::unique_ptr<Expression>(new RefExpression(ReadExpression(reader), di));
+		case TagNegate:
+			return std::unique_ptr<Expression>(new NegateExpression(ReadExpression(reader), di));
+		case TagLogicalNegate:
+			return std::unique_ptr<Expression>(new LogicalNegateExpression(ReadExpression(reader), di));
+		case TagReturn:
+			return std::unique_ptr<Expression>(new ReturnExpression(ReadExpression(reader), di));
+		case TagLibrary:
+			return std::unique_ptr<Expression>(new LibraryExpression(ReadExpression(reader), di));
+
+		case TagAdd:
+		case TagSubtract:
+		case TagMultiply:
+		case TagDivide:
+		case TagModulo:
+		case TagXor:
+		case TagBinaryAnd:
+		case TagBinaryOr:
+		case TagShiftLeft:
+		case TagShiftRight:
+		case TagEqual:
+		case TagNotEqual:
+		case TagLessThan:
+		case TagGreaterThan:
+		case TagLessThanOrEqual:
+		case TagGreaterThanOrEqual:
+		case TagIn:
+		case TagNotIn:
+		case TagLogicalAnd:
+		case TagLogicalOr: {
+			auto op1 (ReadExpression(reader));
+			auto op2 (ReadExpression(reader));
+
+			switch (tag) {
+				case TagAdd:
+					return std::unique_ptr<Expression>(new AddExpression(std::move(op1), std::move(op2), di));
+				case TagSubtract:
+					return std::unique_ptr<Expression>(new SubtractExpression(std::move(op1), std::move(op2), di));
+				case TagMultiply:
+					return std::unique_ptr<Expression>(new MultiplyExpression(std::move(op1), std::move(op2), di));
+				case TagDivide:
+					return std::unique_ptr<Expression>(new DivideExpression(std::move(op1), std::move(op2), di));
+				case TagModulo:
+					return std::unique_ptr<Expression>(new ModuloExpression(std::move(op1), std::move(op2), di));
+				case TagXor:
+					return std::unique_ptr<Expression>(new XorExpression(std::move(op1), std::move(op2), di));
+				case TagBinaryAnd:
+					return std::unique_ptr<Expression>(new BinaryAndExpression(std::move(op1), std::move(op2), di));
+				case TagBinaryOr:
+					return std::unique_ptr<Expression>(new BinaryOrExpression(std::move(op1), std::move(op2), di));
+				case TagShiftLeft:
+					return std::unique_ptr<Expression>(new ShiftLeftExpression(std::move(op1), std::move(op2), di));
+				case TagShiftRight:
+					return std::unique_ptr<Expression>(new ShiftRightExpression(std::move(op1), std::move(op2), di));
+				case TagEqual:
+					return std::unique_ptr<Expression>(new EqualExpression(std::move(op1), std::move(op2), di));
+				case TagNotEqual:
+					return std::unique_ptr<Expression>(new NotEqualExpression(std::move(op1), std::move(op2), di));
+				case TagLessThan:
+					return std::unique_ptr<Expression>(new LessThanExpression(std::move(op1), std::move(op2), di));
+				case TagGreaterThan:
+					return std::unique_ptr<Expression>(new GreaterThanExpression(std::move(op1), std::move(op2), di));
+				case TagLessThanOrEqual:
+					return std::unique_ptr<Expression>(new LessThanOrEqualExpression(std::move(op1), std::move(op2), di));
+				case TagGreaterThanOrEqual:
+					return std::unique_ptr<Expression>(new GreaterThanOrEqualExpression(std::move(op1), std::move(op2), di));
+				case TagIn:
+					return std::unique_ptr<Expression>(new InExpression(std::move(op1), std::move(op2), di));
+				case TagNotIn:
+					return std::unique_ptr<Expression>(new NotInExpression(std::move(op1), std::move(op2), di));
+				case TagLogicalAnd:
+					return std::unique_ptr<Expression>(new LogicalAndExpression(std::move(op1), std::move(op2), di));
+				default:
+					return std::unique_ptr<Expression>(new LogicalOrExpression(std::move(op1), std::move(op2), di));
+			}
+		}
+
+		case TagFunctionCall: {
+			auto fname (ReadExpression(reader));
+			auto args (readExpressions());
+
+			return std::unique_ptr<Expression>(new FunctionCallExpression(std::move(fname), std::move(args), di));
+		}
+
+		case TagArray:
+			return std::unique_ptr<Expression>(new ArrayExpression(readExpressions(), di));
+
+		case TagDict: {
+			std::unique_ptr<DictExpression> expr (new DictExpression(readExpressions(), di));
+
+			if (reader.ReadBool()) {
+				expr->MakeInline();
+			}
+
+			return std::move(expr);
+		}
+
+		case TagSetConst: {
+			String name = reader.ReadString();
+
+			return std::unique_ptr<Expression>(new SetConstExpression(name, ReadExpression(reader), di));
+		}
+
+		case TagSet: {
+			auto op1 (ReadExpression(reader));
+			auto op (static_cast<CombinedSetOp>(reader.ReadByte()));
+			auto op2 (ReadExpression(reader));
+			std::unique_ptr<SetExpression> expr (new SetExpression(std::move(op1), op, std::move(op2), di));
+
+			if (reader.ReadBool()) {
+				expr->SetOverrideFrozen();
+			}
+
+			return std::move(expr);
+		}
+
+		case TagConditional: {
+			auto condition (ReadExpression(reader));
+			auto trueBranch (ReadExpression(reader));
+			auto falseBranch (ReadExpression(reader));
+
+			return std::unique_ptr<Expression>(new ConditionalExpression(std::move(condition), std::move(trueBranch), std::move(falseBranch), di));
+		}
+
+		case TagWhile: {
+			auto condition (ReadExpression(reader));
+			auto loopBody (ReadExpression(reader));
+
+			return std::unique_ptr<Expression>(new WhileExpression(std::move(condition), std::move(loopBody), di));
+		}
+
+		case TagBreak:
+			return std::unique_ptr<Expression>(new BreakExpression(di));
+		case TagContinue:
+			return std::unique_ptr<Expression>(new ContinueExpression(di));
+		case TagImportDefaultTemplates:
+			return std::unique_ptr<Expression>(new ImportDefaultTemplatesExpression(di));
+		case TagBreakpoint:
+			return std::unique_ptr<Expression>(new BreakpointExpression(di));
+
+		case TagGetScope:
+			return std::unique_ptr<Expression>(new GetScopeExpression(static_cast<ScopeSpecifier>(reader.ReadByte())));
+
+		case TagIndexer: {
+			auto op1 (ReadExpression(reader));
+			auto op2 (ReadExpression(reader));
+			std::unique_ptr<IndexerExpression> expr (new IndexerExpression(std::move(op1), std::move(op2), di));
+
+			if (reader.ReadBool()) {
+				expr->SetOverrideFrozen();
+			}
+
+			return std::move(expr);
+		}
+
+		case TagThrow: {
+			auto message (ReadExpression(reader));
+			bool incompleteExpr = reader.ReadBool();
+
+			return std::unique_ptr<Expression>(new ThrowExpression(std::move(message), incompleteExpr, di));
+		}
+
+		case TagImport:
+			return std::unique_ptr<Expression>(new ImportExpression(ReadExpression(reader), di));
+
+		case TagFunction: {
+			String name = reader.ReadString();
+			std::vector<String> args;
+
+			for (auto count (reader.ReadNumber()); count; count--) {
+				args.emplace_back(reader.ReadString());
+			}
+
+			auto closedVars (readClosedVars());
+			auto body (ReadExpression(reader));
+
+			return std::unique_ptr<Expression>(new FunctionExpression(std::move(name), std::move(args), std::move(closedVars), std::move(body), di));
+		}
+
+		case TagApply: {
+			String type = reader.ReadString();
+			String target = reader.ReadString();
+			auto name (ReadExpression(reader));
+			auto filter (ReadExpression(reader));
+			String package = reader.ReadString();
+			String fkvar = reader.ReadString();
+			String fvvar = reader.ReadString();
+			auto fterm (ReadExpression(reader));
+			auto closedVars (readClosedVars());
+			bool ignoreOnError = reader.ReadBool();
+			auto body (ReadExpression(reader));
+
+			return std::unique_ptr<Expression>(new ApplyExpression(std::move(type), std::move(target), std::move(name), std::move(filter),
+				std::move(package), std::move(fkvar), std::move(fvvar), std::move(fterm), std::move(closedVars), ignoreOnError, std::move(body), di));
+		}
+
+		case TagNamespace:
+			return std::unique_ptr<Expression>(new NamespaceExpression(ReadExpression(reader), di));
+
+		case TagObject: {
+			bool abstract = reader.ReadBool();
+			auto type (ReadExpression(reader));
+			auto name (ReadExpression(reader));
+			auto filter (ReadExpression(reader));
+			String zone = reader.ReadString();
+			String package = reader.ReadString();
+			auto closedVars (readClosedVars());
+			bool defaultTmpl = reader.ReadBool();
+			bool ignoreOnError = reader.ReadBool();
+			auto body (ReadExpression(reader));
+
+			return std::unique_ptr<Expression>(new ObjectExpression(abstract, std::move(type), std::move(name), std::move(filter),
+				std::move(zone), std::move(package), std::move(closedVars), defaultTmpl, ignoreOnError, std::move(body), di));
+		}
+
+		case TagFor: {
+			String fkvar = reader.ReadString();
+			String fvvar = reader.ReadString();
+			auto value (ReadExpression(reader));
+			auto body (ReadExpression(reader));
+
+			return std::unique_ptr<Expression>(new ForExpression(std::move(fkvar), std::move(fvvar), std::move(value), std::move(body), di));
+		}
+
+		case TagInclude: {
+			String relativeBase = reader.ReadString();
+			auto path (ReadExpression(reader));
+			auto pattern (ReadExpression(reader));
+			auto name (ReadExpression(reader));
+			auto type (static_cast<IncludeType>(reader.ReadByte()));
+			bool searchIncludes = reader.ReadBool();
+			String zone = reader.ReadString();
+			String package = reader.ReadString();
+
+			return std::unique_ptr<Expression>(new IncludeExpression(std::move(relativeBase), std::move(path), std::move(pattern),
+				std::move(name), type, searchIncludes, std::move(zone), std::move(package), di));
+		}
+
+		default: {
+			auto tryBody (ReadExpression(reader));
+			auto exceptBody (ReadExpression(reader));
+
+			return std::unique_ptr<Expression>(new TryExceptExpression(std::move(tryBody), std::move(exceptBody), di));
+		}
+	}
+}
+
+String CompiledConfigCache::GetCacheDir()
+{
+	return Configuration::CacheDir + "/compiled-config";
+}
+
+/**
+ * Each compiled file has one cache entry, replaced whenever the file changes.
+ */
+String CompiledConfigCache::GetEntryPath(const String& path, const String& zone, const String& package)
+{
+	String key = Application::GetAppVersion() + "\n" + path + "\n" + zone + "\n" + package;
+
+	return GetCacheDir() + "/" + SHA256(key);
+}
+
+/**
+ * Loads the syntax tree of a config file from the cache.
+ *
+ * @param path The config file
+ * @param content The config file's current content
+ * @param zone The zone passed to the compiler
+ * @param package The package passed to the compiler
+ *
+ * @return The cached tree or nullptr if there's no entry for the current content
+ */
+std::unique_ptr<Expression> CompiledConfigCache::Load(const String& path, const String& content, const String& zone, const String& package)
+{
+	String entryPath = GetEntryPath(path, zone, package);
+	std::ifstream fp (entryPath.CStr(), std::ios_base::in | std::ios_base::binary);
+
+	if (!fp) {
+		return nullptr;
+	}
+
+	String entry((std::istreambuf_iterator<char>(fp)), std::istreambuf_iterator<char>());
+	String hash = SHA256(content);
+
+	if (entry.GetLength() < l_EntryMagicLength + hash.GetLength()
+		|| memcmp(entry.CStr(), l_EntryMagic, l_EntryMagicLength)
+		|| memcmp(entry.CStr() + l_EntryMagicLength, hash.CStr(), hash.GetLength())) {
+		return nullptr;
+	}
+
+	try {
+		Reader reader;
+
+		reader.Position = entry.CStr() + l_EntryMagicLength + hash.GetLength();
+		reader.End = entry.CStr() + entry.GetLength();
+
+		/* The header has strings of its own, the tree's string references start over. */
+		ReadHeader(reader);
+		reader.Strings.clear();
+
+		auto expression (ReadExpression(reader));
+
+		if (reader.Position != reader.End) {
+			BOOST_THROW_EXCEPTION(std::runtime_error("Compiled config cache entry has trailing data."));
+		}
+
+		return expression;
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "CompiledConfigCache")
+			<< "Ignoring invalid cache entry '" << entryPath << "' for config file '" << path << "': " << DiagnosticInformation(ex, false);
+
+		return nullptr;
+	}
+}
+
+/**
+ * Stores the syntax tree of a config file in the cache. Errors are just logged,
+ * the cache is an optimization.
+ *
+ * @param path The config file
+ * @param content The config file's content the tree was compiled from
+ * @param zone The zone passed to the compiler
+ * @param package The package passed to the compiler
+ * @param expression The tree
+ */
+void CompiledConfigCache::Store(const String& path, const String& content, const String& zone, const String& package, const Expression *expression)
+{
+	String entryPath = GetEntryPath(path, zone, package);
+
+	try {
+		String data = Serialize(expression);
+
+		Writer header;
+		header.WriteString(Application::GetAppVersion());
+		header.WriteString(path);
+
+		Utility::MkDirP(GetCacheDir(), 0750);
+
+		AtomicFile fp (entryPath, 0600);
+		fp << l_EntryMagic << SHA256(content) << header.Buffer << data;
+		fp.Commit();
+	} catch (const std::exception& ex) {
+		Log(LogNotice, "CompiledConfigCache")
+			<< "Cannot cache compiled config file '" << path << "': " << DiagnosticInformation(ex, false);
+	}
+}
+
+/**
+ * Reads the header of a cache entry which follows the magic and the content hash.
+ *
+ * @return The version and the path of the config file the entry was created by
+ */
+std::pair<String, String> CompiledConfigCache::ReadHeader(Reader& reader)
+{
+	String version = reader.ReadString();
+	String path = reader.ReadString();
+
+	return std::make_pair(std::move(version), std::move(path));
+}
+
+/**
+ * Removes the entries of config files which don't exist anymore, of other versions
+ * and invalid ones. Entries of config files not compiled by this process are kept,
+ * so validating another config doesn't wipe the daemon's entries.
+ */
+void CompiledConfigCache::Prune()
+{
+	String dir = GetCacheDir();
+
+	if (!Utility::PathExists(dir)) {
+		return;
+	}
+
+	std::vector<String> unused;
+
+	Utility::Glob(dir + "/*", [&unused](const String& entry) {
+		std::ifstream fp (entry.CStr(), std::ios_base::in | std::ios_base::binary);
+
+		if (!fp) {
+			return;
+		}
+
+		std::vector<char> buffer (l_EntryMaxHeaderLength);
+		fp.read(buffer.data(), buffer.size());
+		buffer.resize(fp.gcount());
+
+		if (buffer.size() < l_EntryMagicLength + l_EntryHashLength || memcmp(buffer.data(), l_EntryMagic, l_EntryMagicLength)) {
+			unused.emplace_back(entry);
+			return;
+		}
+
+		try {
+			Reader reader;
+
+			reader.Position = buffer.data() + l_EntryMagicLength + l_EntryHashLength;
+			reader.End = buffer.data() + buffer.size();
+
+			auto header (ReadHeader(reader));
+
+			if (header.first != Application::GetAppVersion() || !Utility::PathExists(header.second)) {
+				unused.emplace_back(entry);
+			}
+		} catch (const std::exception&) {
+			unused.emplace_back(entry);
+		}
+	}, GlobFile);
+
+	for (auto& entry : unused) {
+		try {
+			Utility::Remove(entry);
+		} catch (const std::exception& ex) {
+			Log(LogNotice, "CompiledConfigCache")
+				<< "Cannot remove unused cache entry: " << DiagnosticInformation(ex, false);
+		}
+	}
+
+	if (!unused.empty()) {
+		Log(LogNotice, "CompiledConfigCache")
+			<< "Removed " << unused.size() << " unused cache entries.";
+	}
+}
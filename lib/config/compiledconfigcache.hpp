@@ -0,0 +1,46 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef COMPILEDCONFIGCACHE_H
+#define COMPILEDCONFIGCACHE_H
+
+#include "config/i2-config.hpp"
+#include "config/expression.hpp"
+#include <memory>
+#include <utility>
+
+namespace icinga
+{
+
+/**
+ * An on-disk cache of compiled config files. Each file's syntax tree is stored
+ * in a compact binary form together with a hash of the file's content, so that
+ * unchanged files don't have to be parsed again on restart and reload.
+ *
+ * @ingroup config
+ */
+class CompiledConfigCache
+{
+public:
+	static std::unique_ptr<Expression> Load(const String& path, const String& content, const String& zone, const String& package);
+	static void Store(const String& path, const String& content, const String& zone, const String& package, const Expression *expression);
+
+	static void Prune();
+
+	static String Serialize(const Expression *expression);
+	static std::unique_ptr<Expression> Deserialize(const String& data);
+
+private:
+	struct Writer;
+	struct Reader;
+
+	static String GetCacheDir();
+	static String GetEntryPath(const String& path, const String& zone, const String& package);
+	static std::pair<String, String> ReadHeader(Reader& reader);
+
+	static void WriteExpression(Writer& writer, const Expression *expression);
+	static std::unique_ptr<Expression> ReadExpression(Reader& reader);
+};
+
+}
+
+#endif /* COMPILEDCONFIGCACHE_H */
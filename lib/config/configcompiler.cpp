@@ -1,13 +1,24 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
 #include "config/configcompiler.hpp"
+#include "config/compiledconfigcache.hpp"
+#include "config/configcompilercontext.hpp"
 #include "config/configitem.hpp"
+#include "config/configprofiler.hpp"
 #include "base/logger.hpp"
 #include "base/utility.hpp"
 #include "base/loader.hpp"
 #include "base/context.hpp"
 #include "base/exception.hpp"
+#include "base/configuration.hpp"
+#include "base/workqueue.hpp"
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/stream.hpp>
+#include <algorithm>
 #include <fstream>
+#include <iterator>
+#include <numeric>
+#include <sstream>
 
 using namespace icinga;
 
@@ -104,6 +115,56 @@ void ConfigCompiler::CollectIncludes(std::vector<std::unique_ptr<Expression> >&
 	}
 }
 
+/**
+ * Compiles the files matched by an include directive. They're parsed in parallel,
+ * but added to the expressions in their original order.
+ *
+ * @param expressions Receives the compiled files.
+ * @param files The files to compile.
+ */
+void ConfigCompiler::CompileIncludes(std::vector<std::unique_ptr<Expression> >& expressions,
+	const std::vector<IncludedFile>& files)
+{
+	if (files.size() < 2 || Configuration::Concurrency < 2) {
+		for (auto& file : files) {
+			CollectIncludes(expressions, file.Path, file.Zone, file.Package);
+		}
+
+		return;
+	}
+
+	std::vector<std::unique_ptr<Expression> > compiled (files.size());
+	std::vector<String> errors (files.size());
+	std::vector<size_t> ids (files.size());
+
+	std::iota(ids.begin(), ids.end(), 0);
+
+	WorkQueue upq (0, std::min<size_t>(Configuration::Concurrency, files.size()), LogNotice);
+	upq.SetName("ConfigCompiler::CompileIncludes");
+
+	upq.ParallelFor(ids, false, [&files, &compiled, &errors](size_t id) {
+		auto& file (files[id]);
+
+		try {
+			compiled[id] = CompileFile(file.Path, file.Zone, file.Package);
+		} catch (const std::exception& ex) {
+			errors[id] = DiagnosticInformation(ex);
+		}
+	});
+
+	upq.Join();
+
+	for (size_t id = 0; id < files.size(); id++) {
+		if (errors[id].IsEmpty()) {
+			expressions.emplace_back(std::move(compiled[id]));
+		} else {
+			Log(LogWarning, "ConfigCompiler")
+				<< "Cannot compile file '"
+				<< files[id].Path << "': " << errors[id];
+		}
+	}
+}
+
 /**
  * Handles an include directive.
  *
@@ -135,8 +196,8 @@ std::unique_ptr<Expression> ConfigCompiler::HandleInclude(const String& relative
 		}
 	}
 
-	std::vector<std::unique_ptr<Expression> > expressions;
-	auto funcCallback = [&expressions, zone, package](const String& file) { CollectIncludes(expressions, file, zone, package); };
+	std::vector<IncludedFile> files;
+	auto funcCallback = [&files, zone, package](const String& file) { files.push_back({ file, zone, package }); };
 
 	if (!Utility::Glob(includePath, funcCallback, GlobFile) && includePath.FindFirstOf("*?") == String::NPos) {
 		std::ostringstream msgbuf;
@@ -144,6 +205,9 @@ std::unique_ptr<Expression> ConfigCompiler::HandleInclude(const String& relative
 		BOOST_THROW_EXCEPTION(ScriptError(msgbuf.str(), debuginfo));
 	}
 
+	std::vector<std::unique_ptr<Expression> > expressions;
+	CompileIncludes(expressions, files);
+
 	std::unique_ptr<DictExpression> expr{new DictExpression(std::move(expressions))};
 	expr->MakeInline();
 	return std::move(expr);
@@ -167,17 +231,20 @@ std::unique_ptr<Expression> ConfigCompiler::HandleIncludeRecursive(const String&
 	else
 		ppath = relativeBase + "/" + path;
 
-	std::vector<std::unique_ptr<Expression> > expressions;
-	Utility::GlobRecursive(ppath, pattern, [&expressions, zone, package](const String& file) {
-		CollectIncludes(expressions, file, zone, package);
+	std::vector<IncludedFile> files;
+	Utility::GlobRecursive(ppath, pattern, [&files, zone, package](const String& file) {
+		files.push_back({ file, zone, package });
 	}, GlobFile);
 
+	std::vector<std::unique_ptr<Expression> > expressions;
+	CompileIncludes(expressions, files);
+
 	std::unique_ptr<DictExpression> dict{new DictExpression(std::move(expressions))};
 	dict->MakeInline();
 	return std::move(dict);
 }
 
-void ConfigCompiler::HandleIncludeZone(const String& relativeBase, const String& tag, const String& path, const String& pattern, const String& package, std::vector<std::unique_ptr<Expression> >& expressions)
+void ConfigCompiler::HandleIncludeZone(const String& relativeBase, const String& tag, const String& path, const String& pattern, const String& package, std::vector<IncludedFile>& files)
 {
 	String zoneName = Utility::BaseName(path);
 
@@ -190,8 +257,8 @@ void ConfigCompiler::HandleIncludeZone(const String& relativeBase, const String&
 
 	RegisterZoneDir(tag, ppath, zoneName);
 
-	Utility::GlobRecursive(ppath, pattern, [&expressions, zoneName, package](const String& file) {
-		CollectIncludes(expressions, file, zoneName, package);
+	Utility::GlobRecursive(ppath, pattern, [&files, zoneName, package](const String& file) {
+		files.push_back({ file, zoneName, package });
 	}, GlobFile);
 }
 
@@ -217,11 +284,14 @@ std::unique_ptr<Expression> ConfigCompiler::HandleIncludeZones(const String& rel
 		newRelativeBase = ".";
 	}
 
-	std::vector<std::unique_ptr<Expression> > expressions;
-	Utility::Glob(ppath + "/*", [newRelativeBase, tag, pattern, package, &expressions](const String& path) {
-		HandleIncludeZone(newRelativeBase, tag, path, pattern, package, expressions);
+	std::vector<IncludedFile> files;
+	Utility::Glob(ppath + "/*", [newRelativeBase, tag, pattern, package, &files](const String& path) {
+		HandleIncludeZone(newRelativeBase, tag, path, pattern, package, files);
 	}, GlobDirectory);
 
+	std::vector<std::unique_ptr<Expression> > expressions;
+	CompileIncludes(expressions, files);
+
 	return std::unique_ptr<Expression>(new DictExpression(std::move(expressions)));
 }
 
@@ -260,19 +330,52 @@ std::unique_ptr<Expression> ConfigCompiler::CompileFile(const String& path, cons
 	const String& package)
 {
 	CONTEXT("Compiling configuration file '" << path << "'");
+	ConfigProfiler::Scope profile (path);
 
-	std::ifstream stream(path.CStr(), std::ifstream::in);
+	std::ifstream fp(path.CStr(), std::ifstream::in);
 
-	if (!stream)
+	if (!fp)
 		BOOST_THROW_EXCEPTION(posix_error()
 			<< boost::errinfo_api_function("std::ifstream::open")
 			<< boost::errinfo_errno(errno)
 			<< boost::errinfo_file_name(path));
 
+	fp.exceptions(std::istream::badbit);
+
+	String content((std::istreambuf_iterator<char>(fp)), std::istreambuf_iterator<char>());
+
+	auto cached (CompiledConfigCache::Load(path, content, zone, package));
+
+	if (cached) {
+		Log(LogNotice, "ConfigCompiler")
+			<< "Using cached compiled config file: " << path;
+
+		ConfigCompilerContext::GetInstance()->WriteFile(path, content, cached.get());
+
+		return cached;
+	}
+
 	Log(LogNotice, "ConfigCompiler")
 		<< "Compiling config file: " << path;
 
-	return CompileStream(path, &stream, zone, package);
+	/* Parse the content in place rather than copying it into a std::stringstream. */
+	boost::iostreams::stream<boost::iostreams::array_source> stream(content.CStr(), content.GetLength());
+	ConfigCompiler ctx(path, &stream, zone, package);
+	std::unique_ptr<Expression> expression;
+
+	/* Same as CompileStream(), but only successfully compiled files are cached. */
+	try {
+		expression = ctx.Compile();
+	} catch (const ScriptError& ex) {
+		return std::unique_ptr<Expression>(new ThrowExpression(MakeLiteral(ex.what()), ex.IsIncompleteExpression(), ex.GetDebugInfo()));
+	} catch (const std::exception& ex) {
+		return std::unique_ptr<Expression>(new ThrowExpression(MakeLiteral(DiagnosticInformation(ex)), false));
+	}
+
+	CompiledConfigCache::Store(path, content, zone, package, expression.get());
+	ConfigCompilerContext::GetInstance()->WriteFile(path, content, expression.get());
+
+	return expression;
 }
 
 /**
@@ -61,6 +61,16 @@ struct ZoneFragment
 	String Path;
 };
 
+/**
+ * A config file matched by an include directive.
+ */
+struct IncludedFile
+{
+	String Path;
+	String Zone;
+	String Package;
+};
+
 /**
  * The configuration compiler can be used to compile a configuration file
  * into a number of configuration items.
@@ -98,6 +108,8 @@ public:
 
 	static void CollectIncludes(std::vector<std::unique_ptr<Expression> >& expressions,
 		const String& file, const String& zone, const String& package);
+	static void CompileIncludes(std::vector<std::unique_ptr<Expression> >& expressions,
+		const std::vector<IncludedFile>& files);
 
 	static std::unique_ptr<Expression> HandleInclude(const String& relativeBase, const String& path, bool search,
 		const String& zone, const String& package, const DebugInfo& debuginfo = DebugInfo());
@@ -132,7 +144,7 @@ private:
 	void InitializeScanner();
 	void DestroyScanner();
 
-	static void HandleIncludeZone(const String& relativeBase, const String& tag, const String& path, const String& pattern, const String& package, std::vector<std::unique_ptr<Expression> >& expressions);
+	static void HandleIncludeZone(const String& relativeBase, const String& tag, const String& path, const String& pattern, const String& package, std::vector<IncludedFile>& files);
 
 	static bool IsAbsolutePath(const String& path);
 
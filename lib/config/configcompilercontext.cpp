@@ -1,11 +1,13 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
 #include "config/configcompilercontext.hpp"
+#include "config/expression.hpp"
 #include "base/singleton.hpp"
 #include "base/json.hpp"
 #include "base/netstring.hpp"
 #include "base/exception.hpp"
 #include "base/application.hpp"
+#include "base/tlsutility.hpp"
 #include "base/utility.hpp"
 
 using namespace icinga;
@@ -19,6 +21,8 @@ void ConfigCompilerContext::OpenObjectsFile(const String& filename)
 {
 	try {
 		m_ObjectsFP = std::make_unique<AtomicFile>(filename, 0600);
+		m_ObjectsPath = filename;
+		m_Files = new Dictionary();
 	} catch (const std::exception& ex) {
 		Log(LogCritical, "cli", "Could not create temporary objects file: " + DiagnosticInformation(ex, false));
 		Application::Exit(1);
@@ -38,12 +42,58 @@ void ConfigCompilerContext::WriteObject(const Dictionary::Ptr& object)
 	}
 }
 
+/**
+ * @returns Whether the given compiled file consists only of object definitions
+ * (without "assign where") and includes, i.e. changes to it can't affect other objects.
+ */
+bool ConfigCompilerContext::ContainsObjectsOnly(const Expression *expression)
+{
+	auto dict (dynamic_cast<const DictExpression*>(expression));
+
+	if (!dict)
+		return false;
+
+	for (auto& expr : dict->GetExpressions()) {
+		if (dynamic_cast<const IncludeExpression*>(expr.get()))
+			continue;
+
+		auto object (dynamic_cast<const ObjectExpression*>(expr.get()));
+
+		if (!object || object->m_Filter)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Records a config file which has been compiled while writing the objects file.
+ * The records are written into the objects file's path with the suffix ".files",
+ * so that the objects of two dumps can be related to the files which changed.
+ */
+void ConfigCompilerContext::WriteFile(const String& path, const String& content, const Expression *expression)
+{
+	if (!m_ObjectsFP)
+		return;
+
+	Dictionary::Ptr file = new Dictionary({
+		{ "hash", SHA256(content) },
+		{ "objects_only", ContainsObjectsOnly(expression) }
+	});
+
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Files->Set(path, file);
+	}
+}
+
 void ConfigCompilerContext::CancelObjectsFile()
 {
 	if (!m_ObjectsFP)
 		return;
 
 	m_ObjectsFP.reset(nullptr);
+	m_Files.reset();
 }
 
 void ConfigCompilerContext::FinishObjectsFile()
@@ -53,4 +103,12 @@ void ConfigCompilerContext::FinishObjectsFile()
 
 	m_ObjectsFP->Commit();
 	m_ObjectsFP.reset(nullptr);
+
+	try {
+		AtomicFile::Write(m_ObjectsPath + ".files", 0600, JsonEncode(m_Files));
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "cli", "Could not write config files list: " + DiagnosticInformation(ex, false));
+	}
+
+	m_Files.reset();
 }
@@ -13,6 +13,8 @@
 namespace icinga
 {
 
+class Expression;
+
 /*
  * @ingroup config
  */
@@ -21,6 +23,7 @@ class ConfigCompilerContext
 public:
 	void OpenObjectsFile(const String& filename);
 	void WriteObject(const Dictionary::Ptr& object);
+	void WriteFile(const String& path, const String& content, const Expression *expression);
 	void CancelObjectsFile();
 	void FinishObjectsFile();
 
@@ -33,8 +36,12 @@ public:
 
 private:
 	std::unique_ptr<AtomicFile> m_ObjectsFP;
+	String m_ObjectsPath;
+	Dictionary::Ptr m_Files;
 
 	mutable std::mutex m_Mutex;
+
+	static bool ContainsObjectsOnly(const Expression *expression);
 };
 
 }
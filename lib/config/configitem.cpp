@@ -5,8 +5,10 @@
 #include "config/applyrule.hpp"
 #include "config/objectrule.hpp"
 #include "config/configcompiler.hpp"
+#include "config/configprofiler.hpp"
 #include "base/application.hpp"
 #include "base/configtype.hpp"
+#include "base/configuration.hpp"
 #include "base/objectlock.hpp"
 #include "base/convert.hpp"
 #include "base/logger.hpp"
@@ -36,6 +38,9 @@ ConfigItem::TypeMap ConfigItem::m_DefaultTemplates;
 ConfigItem::ItemList ConfigItem::m_UnnamedItems;
 ConfigItem::IgnoredItemList ConfigItem::m_IgnoredItems;
 
+/* Child objects are created in this many chunks of items per thread. */
+static const size_t l_ChildObjectChunksPerThread = 16;
+
 REGISTER_FUNCTION(Internal, run_with_activation_context, &ConfigItem::RunWithActivationContext, "func");
 
 /**
@@ -177,6 +182,8 @@ ConfigObject::Ptr ConfigItem::Commit(bool discard)
 	if (IsAbstract())
 		return nullptr;
 
+	ConfigProfiler::Scope profile (type);
+
 	ConfigObject::Ptr dobj = static_pointer_cast<ConfigObject>(type->Instantiate(std::vector<Value>()));
 
 	dobj->SetDebugInfo(m_DebugInfo);
@@ -590,7 +597,13 @@ bool ConfigItem::CommitNewItems(const ActivationContext::Ptr& context, WorkQueue
 				auto items (itemsByType.find(loadDep));
 
 				if (items != itemsByType.end()) {
-					upq.ParallelFor(items->second, [&type, &notified_items](const ItemPair& ip) {
+					/* The number of apply rules matching the items varies a lot, so let idle threads
+					 * pick up the next chunk rather than pre-assigning equal shares to each thread.
+					 * A task per item would cost more than it balances for hundreds of thousands of items.
+					 */
+					size_t chunks = std::min<size_t>(items->second.size(), static_cast<size_t>(Configuration::Concurrency) * l_ChildObjectChunksPerThread);
+
+					upq.ParallelForChunks(items->second, chunks, [&type, &notified_items](const ItemPair& ip) {
 						const ConfigItem::Ptr& item = ip.first;
 
 						if (!item->m_Object)
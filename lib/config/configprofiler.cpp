@@ -0,0 +1,361 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "config/configprofiler.hpp"
+#include "config/applyrule.hpp"
+#include "config/expression.hpp"
+#include "base/array.hpp"
+#include "base/atomic-file.hpp"
+#include "base/convert.hpp"
+#include "base/dictionary.hpp"
+#include "base/exception.hpp"
+#include "base/json.hpp"
+#include "base/logger.hpp"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+using namespace icinga;
+
+std::atomic<bool> ConfigProfiler::m_Enabled (false);
+
+namespace
+{
+
+enum class ProfileCategory
+{
+	Expression,
+	ApplyRule,
+	Object,
+	File
+};
+
+struct ProfileStats
+{
+	uint64_t Count{0};
+	double Total{0};
+	double Self{0};
+};
+
+struct ProfileFrame
+{
+	ProfileCategory Category;
+	String Name;
+	DebugInfo Location;
+};
+
+/**
+ * A node of the call tree, i.e. a frame called from a specific stack of other frames.
+ */
+struct ProfileNode
+{
+	size_t Frame;
+	size_t Parent;
+	std::unordered_map<size_t /* frame */, size_t /* node */> Children;
+	ProfileStats Stats;
+};
+
+struct ProfileActiveNode
+{
+	size_t Node;
+	std::chrono::steady_clock::time_point Start;
+	double Children;
+};
+
+/**
+ * Each thread records into its own call tree which is merged into the global
+ * results when the thread exits (or the report is written).
+ */
+struct ProfileThreadData
+{
+	std::vector<ProfileFrame> Frames;
+	std::unordered_map<const void *, size_t> FramesByKey;
+	std::unordered_map<String, size_t> FramesByName;
+	std::vector<ProfileNode> Nodes;
+	std::vector<ProfileActiveNode> Stack;
+
+	ProfileThreadData()
+	{
+		Nodes.push_back({0, 0, {}, {}});
+	}
+
+	~ProfileThreadData()
+	{
+		Merge();
+	}
+
+	void Merge();
+};
+
+struct ProfileFrameStats
+{
+	ProfileStats Stats;
+	String Path;
+};
+
+}
+
+static std::mutex l_ProfileMutex;
+static std::map<String /* folded stack */, double> l_ProfileStacks;
+static std::map<std::pair<ProfileCategory, String>, ProfileFrameStats> l_ProfileFrames;
+static thread_local ProfileThreadData l_ProfileThreadData;
+
+/**
+ * Names end up in folded stacks ("a;b;c 42") which don't allow these characters.
+ */
+static String SanitizeFrameName(String name)
+{
+	std::replace(name.Begin(), name.End(), ';', ',');
+	std::replace(name.Begin(), name.End(), '\n', ' ');
+
+	return name;
+}
+
+void ProfileThreadData::Merge()
+{
+	std::vector<String> stacks (Nodes.size());
+
+	std::unique_lock<std::mutex> lock (l_ProfileMutex);
+
+	for (size_t i = 1; i < Nodes.size(); i++) {
+		auto& node (Nodes[i]);
+		auto& frame (Frames[node.Frame]);
+
+		stacks[i] = node.Parent ? stacks[node.Parent] + ";" + frame.Name : frame.Name;
+
+		if (!node.Stats.Count)
+			continue;
+
+		l_ProfileStacks[stacks[i]] += node.Stats.Self;
+
+		auto& stats (l_ProfileFrames[{frame.Category, frame.Name}]);
+
+		stats.Path = frame.Location.Path;
+		stats.Stats.Count += node.Stats.Count;
+		stats.Stats.Self += node.Stats.Self;
+
+		/* Don't count the time of recursive calls twice. */
+		bool recursive = false;
+
+		for (auto parent (node.Parent); parent; parent = Nodes[parent].Parent) {
+			if (Frames[Nodes[parent].Frame].Name == frame.Name) {
+				recursive = true;
+				break;
+			}
+		}
+
+		if (!recursive)
+			stats.Stats.Total += node.Stats.Total;
+
+		node.Stats = ProfileStats();
+	}
+}
+
+static void EnterFrame(ProfileThreadData& data, size_t frame)
+{
+	size_t parent = data.Stack.empty() ? 0 : data.Stack.back().Node;
+	size_t node;
+	auto& children (data.Nodes[parent].Children);
+	auto child (children.find(frame));
+
+	if (child == children.end()) {
+		node = data.Nodes.size();
+		children.emplace(frame, node);
+		data.Nodes.push_back({frame, parent, {}, {}});
+	} else {
+		node = child->second;
+	}
+
+	data.Stack.push_back({node, std::chrono::steady_clock::now(), 0});
+}
+
+static size_t GetNamedFrame(ProfileThreadData& data, ProfileCategory category, const String& name, const DebugInfo& di = DebugInfo())
+{
+	auto frame (data.FramesByName.find(name));
+
+	if (frame != data.FramesByName.end())
+		return frame->second;
+
+	data.Frames.push_back({category, SanitizeFrameName(name), di});
+	data.FramesByName.emplace(name, data.Frames.size() - 1u);
+
+	return data.Frames.size() - 1u;
+}
+
+void ConfigProfiler::Enable()
+{
+	m_Enabled.store(true);
+}
+
+bool ConfigProfiler::IsEnabled()
+{
+	return m_Enabled.load();
+}
+
+bool ConfigProfiler::EnterExpression(const Expression *expression)
+{
+	auto& di (expression->GetDebugInfo());
+
+	/* E.g. literals. Their time is attributed to the expression using them. */
+	if (di.Path.IsEmpty())
+		return false;
+
+	auto& data (l_ProfileThreadData);
+	auto frame (data.FramesByKey.find(&di));
+
+	/* An expression may have been freed and another one allocated at the same address. */
+	if (frame == data.FramesByKey.end() || data.Frames[frame->second].Location.Path != di.Path
+		|| data.Frames[frame->second].Location.FirstLine != di.FirstLine
+		|| data.Frames[frame->second].Location.FirstColumn != di.FirstColumn) {
+		String name = di.Path + ":" + Convert::ToString(di.FirstLine) + ":" + Convert::ToString(di.FirstColumn);
+
+		data.Frames.push_back({ProfileCategory::Expression, SanitizeFrameName(name), di});
+		frame = data.FramesByKey.emplace(&di, data.Frames.size() - 1u).first;
+		frame->second = data.Frames.size() - 1u;
+	}
+
+	EnterFrame(data, frame->second);
+
+	return true;
+}
+
+void ConfigProfiler::EnterApplyRule(const ApplyRule& rule, const Type::Ptr& sourceType)
+{
+	auto& data (l_ProfileThreadData);
+	auto frame (data.FramesByKey.find(&rule));
+
+	if (frame == data.FramesByKey.end()) {
+		std::ostringstream msgbuf;
+		msgbuf << "apply " << sourceType->GetName() << " \"" << rule.GetName() << "\" (" << rule.GetDebugInfo() << ")";
+
+		data.Frames.push_back({ProfileCategory::ApplyRule, SanitizeFrameName(msgbuf.str()), rule.GetDebugInfo()});
+		frame = data.FramesByKey.emplace(&rule, data.Frames.size() - 1u).first;
+	}
+
+	EnterFrame(data, frame->second);
+}
+
+void ConfigProfiler::EnterObject(const Type::Ptr& type)
+{
+	auto& data (l_ProfileThreadData);
+
+	EnterFrame(data, GetNamedFrame(data, ProfileCategory::Object, "object " + type->GetName()));
+}
+
+void ConfigProfiler::EnterFile(const String& path)
+{
+	auto& data (l_ProfileThreadData);
+	DebugInfo di;
+
+	di.Path = path;
+
+	EnterFrame(data, GetNamedFrame(data, ProfileCategory::File, "parse " + path, di));
+}
+
+void ConfigProfiler::Leave()
+{
+	auto& data (l_ProfileThreadData);
+	auto active (data.Stack.back());
+
+	data.Stack.pop_back();
+
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - active.Start).count();
+	auto& stats (data.Nodes[active.Node].Stats);
+
+	stats.Count++;
+	stats.Total += elapsed;
+	stats.Self += elapsed - active.Children;
+
+	if (!data.Stack.empty())
+		data.Stack.back().Children += elapsed;
+}
+
+static Array::Ptr ProfileFramesToArray(ProfileCategory category)
+{
+	std::vector<std::pair<String, ProfileStats>> frames;
+
+	for (auto& frame : l_ProfileFrames) {
+		if (frame.first.first == category)
+			frames.emplace_back(frame.first.second, frame.second.Stats);
+	}
+
+	std::sort(frames.begin(), frames.end(), [](const auto& lhs, const auto& rhs) {
+		return lhs.second.Self > rhs.second.Self;
+	});
+
+	ArrayData result;
+
+	for (auto& frame : frames) {
+		result.emplace_back(new Dictionary({
+			{ "name", frame.first },
+			{ "count", frame.second.Count },
+			{ "total", frame.second.Total },
+			{ "self", frame.second.Self }
+		}));
+	}
+
+	return new Array(std::move(result));
+}
+
+/**
+ * Stops profiling and writes the results collected so far into the given JSON file
+ * and the call stacks into the same file with the suffix ".folded", as expected by
+ * e.g. flamegraph.pl (in microseconds).
+ */
+void ConfigProfiler::WriteReport(const String& path)
+{
+	m_Enabled.store(false);
+
+	l_ProfileThreadData.Merge();
+
+	std::unique_lock<std::mutex> lock (l_ProfileMutex);
+	std::map<String, std::pair<double, double>> files;
+
+	for (auto& frame : l_ProfileFrames) {
+		if (frame.first.first == ProfileCategory::File)
+			files[frame.second.Path].first += frame.second.Stats.Self;
+		else if (frame.first.first == ProfileCategory::Expression)
+			files[frame.second.Path].second += frame.second.Stats.Self;
+	}
+
+	ArrayData fileStats;
+
+	for (auto& file : files) {
+		fileStats.emplace_back(new Dictionary({
+			{ "name", file.first },
+			{ "parse", file.second.first },
+			{ "evaluation", file.second.second }
+		}));
+	}
+
+	Dictionary::Ptr report = new Dictionary({
+		{ "files", new Array(std::move(fileStats)) },
+		{ "apply_rules", ProfileFramesToArray(ProfileCategory::ApplyRule) },
+		{ "types", ProfileFramesToArray(ProfileCategory::Object) },
+		{ "locations", ProfileFramesToArray(ProfileCategory::Expression) }
+	});
+
+	std::ostringstream folded;
+
+	for (auto& stack : l_ProfileStacks) {
+		auto usec (static_cast<unsigned long long>(stack.second * 1000000));
+
+		if (usec)
+			folded << stack.first << " " << usec << "\n";
+	}
+
+	try {
+		AtomicFile::Write(path, 0644, JsonEncode(report, true));
+		AtomicFile::Write(path + ".folded", 0644, folded.str());
+	} catch (const std::exception& ex) {
+		Log(LogCritical, "ConfigProfiler")
+			<< "Failed to write config profile to '" << path << "': " << DiagnosticInformation(ex, false);
+		return;
+	}
+
+	Log(LogInformation, "ConfigProfiler")
+		<< "Wrote config profile to '" << path << "' and '" << path << ".folded'.";
+}
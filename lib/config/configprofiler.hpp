@@ -0,0 +1,88 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef CONFIGPROFILER_H
+#define CONFIGPROFILER_H
+
+#include "config/i2-config.hpp"
+#include "base/string.hpp"
+#include "base/type.hpp"
+#include <atomic>
+
+namespace icinga
+{
+
+class ApplyRule;
+class Expression;
+
+/**
+ * Measures where the config evaluation spends its time: per expression
+ * (by its DebugInfo), per apply rule, per object type and per parsed file.
+ *
+ * @ingroup config
+ */
+class ConfigProfiler
+{
+public:
+	/**
+	 * Measures the time between its construction and destruction
+	 * if the profiler has been enabled.
+	 */
+	class Scope
+	{
+	public:
+		inline Scope(const Expression *expression)
+			: m_Active(m_Enabled.load(std::memory_order_relaxed) && EnterExpression(expression))
+		{ }
+
+		inline Scope(const ApplyRule& rule, const Type::Ptr& sourceType)
+			: m_Active(m_Enabled.load(std::memory_order_relaxed))
+		{
+			if (m_Active)
+				EnterApplyRule(rule, sourceType);
+		}
+
+		inline Scope(const Type::Ptr& type)
+			: m_Active(m_Enabled.load(std::memory_order_relaxed))
+		{
+			if (m_Active)
+				EnterObject(type);
+		}
+
+		inline Scope(const String& path)
+			: m_Active(m_Enabled.load(std::memory_order_relaxed))
+		{
+			if (m_Active)
+				EnterFile(path);
+		}
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+		inline ~Scope()
+		{
+			if (m_Active)
+				Leave();
+		}
+
+	private:
+		bool m_Active;
+	};
+
+	static void Enable();
+	static bool IsEnabled();
+
+	static void WriteReport(const String& path);
+
+private:
+	static std::atomic<bool> m_Enabled;
+
+	static bool EnterExpression(const Expression *expression);
+	static void EnterApplyRule(const ApplyRule& rule, const Type::Ptr& sourceType);
+	static void EnterObject(const Type::Ptr& type);
+	static void EnterFile(const String& path);
+	static void Leave();
+};
+
+}
+
+#endif /* CONFIGPROFILER_H */
@@ -3,6 +3,7 @@
 #include "config/expression.hpp"
 #include "config/configitem.hpp"
 #include "config/configcompiler.hpp"
+#include "config/configprofiler.hpp"
 #include "config/vmops.hpp"
 #include "base/array.hpp"
 #include "base/json.hpp"
@@ -52,6 +53,8 @@ ExpressionResult Expression::Evaluate(ScriptFrame& frame, DebugHint *dhint) cons
 			frame.DecreaseStackDepth();
 		});
 
+		ConfigProfiler::Scope profile (this);
+
 		ExpressionResult result = DoEvaluate(frame, dhint);
 		return result;
 	} catch (ScriptError& ex) {
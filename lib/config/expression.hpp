@@ -272,8 +272,16 @@ public:
 		: DebuggableExpression(debugInfo), m_Operand(std::move(operand))
 	{ }
 
+	inline const std::unique_ptr<Expression>& GetOperand() const noexcept
+	{
+		return m_Operand;
+	}
+
 protected:
 	std::unique_ptr<Expression> m_Operand;
+
+	friend class BytecodeExpression;
+	friend class CompiledConfigCache;
 };
 
 class BinaryExpression : public DebuggableExpression
@@ -317,6 +325,8 @@ private:
 	std::vector<Expression::Ptr> m_Imports;
 
 	friend void BindToScope(std::unique_ptr<Expression>& expr, ScopeSpecifier scopeSpec);
+	friend class BytecodeExpression;
+	friend class CompiledConfigCache;
 };
 
 class DerefExpression final : public UnaryExpression
@@ -611,6 +621,9 @@ protected:
 
 private:
 	std::vector<std::unique_ptr<Expression> > m_Expressions;
+
+	friend class BytecodeExpression;
+	friend class CompiledConfigCache;
 };
 
 class DictExpression final : public DebuggableExpression
@@ -635,6 +648,8 @@ private:
 	bool m_Inline{false};
 
 	friend void BindToScope(std::unique_ptr<Expression>& expr, ScopeSpecifier scopeSpec);
+	friend class BytecodeExpression;
+	friend class CompiledConfigCache;
 };
 
 class SetConstExpression final : public UnaryExpression
@@ -648,6 +663,8 @@ protected:
 	String m_Name;
 
 	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override;
+
+	friend class CompiledConfigCache;
 };
 
 class SetExpression final : public BinaryExpression
@@ -667,6 +684,7 @@ private:
 	bool m_OverrideFrozen{false};
 
 	friend void BindToScope(std::unique_ptr<Expression>& expr, ScopeSpecifier scopeSpec);
+	friend class CompiledConfigCache;
 };
 
 class ConditionalExpression final : public DebuggableExpression
@@ -683,6 +701,8 @@ private:
 	std::unique_ptr<Expression> m_Condition;
 	std::unique_ptr<Expression> m_TrueBranch;
 	std::unique_ptr<Expression> m_FalseBranch;
+
+	friend class CompiledConfigCache;
 };
 
 class WhileExpression final : public DebuggableExpression
@@ -698,6 +718,8 @@ protected:
 private:
 	std::unique_ptr<Expression> m_Condition;
 	std::unique_ptr<Expression> m_LoopBody;
+
+	friend class CompiledConfigCache;
 };
 
 
@@ -746,6 +768,9 @@ protected:
 
 private:
 	ScopeSpecifier m_ScopeSpec;
+
+	friend class BytecodeExpression;
+	friend class CompiledConfigCache;
 };
 
 class IndexerExpression final : public BinaryExpression
@@ -764,6 +789,7 @@ protected:
 	bool GetReference(ScriptFrame& frame, bool init_dict, Value *parent, String *index, DebugHint **dhint) const override;
 
 	friend void BindToScope(std::unique_ptr<Expression>& expr, ScopeSpecifier scopeSpec);
+	friend class CompiledConfigCache;
 };
 
 void BindToScope(std::unique_ptr<Expression>& expr, ScopeSpecifier scopeSpec);
@@ -781,6 +807,8 @@ protected:
 private:
 	std::unique_ptr<Expression> m_Message;
 	bool m_IncompleteExpr;
+
+	friend class CompiledConfigCache;
 };
 
 class ImportExpression final : public DebuggableExpression
@@ -795,6 +823,8 @@ protected:
 
 private:
 	std::unique_ptr<Expression> m_Name;
+
+	friend class CompiledConfigCache;
 };
 
 class ImportDefaultTemplatesExpression final : public DebuggableExpression
@@ -824,6 +854,8 @@ private:
 	std::vector<String> m_Args;
 	std::map<String, std::unique_ptr<Expression> > m_ClosedVars;
 	Expression::Ptr m_Expression;
+
+	friend class CompiledConfigCache;
 };
 
 class ApplyExpression final : public DebuggableExpression
@@ -854,6 +886,8 @@ private:
 	bool m_IgnoreOnError;
 	std::map<String, std::unique_ptr<Expression> > m_ClosedVars;
 	Expression::Ptr m_Expression;
+
+	friend class CompiledConfigCache;
 };
 
 class NamespaceExpression final : public DebuggableExpression
@@ -868,6 +902,8 @@ protected:
 
 private:
 	Expression::Ptr m_Expression;
+
+	friend class CompiledConfigCache;
 };
 
 class ObjectExpression final : public DebuggableExpression
@@ -895,6 +931,9 @@ private:
 	bool m_IgnoreOnError;
 	std::map<String, std::unique_ptr<Expression> > m_ClosedVars;
 	Expression::Ptr m_Expression;
+
+	friend class CompiledConfigCache;
+	friend class ConfigCompilerContext;
 };
 
 class ForExpression final : public DebuggableExpression
@@ -912,6 +951,8 @@ private:
 	String m_FVVar;
 	std::unique_ptr<Expression> m_Value;
 	std::unique_ptr<Expression> m_Expression;
+
+	friend class CompiledConfigCache;
 };
 
 class LibraryExpression final : public UnaryExpression
@@ -953,6 +994,8 @@ private:
 	bool m_SearchIncludes;
 	String m_Zone;
 	String m_Package;
+
+	friend class CompiledConfigCache;
 };
 
 class BreakpointExpression final : public DebuggableExpression
@@ -979,6 +1022,8 @@ protected:
 private:
 	std::unique_ptr<Expression> m_TryBody;
 	std::unique_ptr<Expression> m_ExceptBody;
+
+	friend class CompiledConfigCache;
 };
 
 }
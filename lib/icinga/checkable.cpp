@@ -303,6 +303,7 @@ void Checkable::CleanDeadlinedExecutions(const Timer * const&)
 				execution = executions->Get(key);
 				if (execution->Contains("deadline") && now > execution->Get("deadline")) {
 					executions->Remove(key);
+					host->MarkStateChanged();
 				}
 			}
 		}
@@ -315,6 +316,7 @@ void Checkable::CleanDeadlinedExecutions(const Timer * const&)
 				execution = executions->Get(key);
 				if (execution->Contains("deadline") && now > execution->Get("deadline")) {
 					executions->Remove(key);
+					service->MarkStateChanged();
 				}
 			}
 		}
@@ -586,6 +586,7 @@ Value ClusterEvents::LastNotifiedStatePerUserUpdatedAPIHandler(const MessageOrig
 	}
 
 	notification->GetLastNotifiedStatePerUser()->Set(params->Get("user"), state);
+	notification->MarkStateChanged();
 	Notification::OnLastNotifiedStatePerUserUpdated(notification, params->Get("user"), state, origin);
 
 	return Empty;
@@ -637,6 +638,7 @@ Value ClusterEvents::LastNotifiedStatePerUserClearedAPIHandler(const MessageOrig
 	}
 
 	notification->GetLastNotifiedStatePerUser()->Clear();
+	notification->MarkStateChanged();
 	Notification::OnLastNotifiedStatePerUserCleared(notification, origin);
 
 	return Empty;
@@ -1481,6 +1483,7 @@ Value ClusterEvents::ExecutedCommandAPIHandler(const MessageOrigin::Ptr& origin,
 		execution->Set("end", params->Get("end"));
 
 	execution->Remove("pending");
+	checkable->MarkStateChanged();
 
 	/* Broadcast the update */
 	Dictionary::Ptr executionsToBroadcast = new Dictionary();
@@ -4,6 +4,7 @@
 #include "icinga/service.hpp"
 #include "config/configitembuilder.hpp"
 #include "config/applyrule.hpp"
+#include "config/configprofiler.hpp"
 #include "base/initialize.hpp"
 #include "base/configtype.hpp"
 #include "base/logger.hpp"
@@ -67,6 +68,7 @@ bool Dependency::EvaluateApplyRule(const Checkable::Ptr& checkable, const ApplyR
 	auto& di (rule.GetDebugInfo());
 
 	CONTEXT("Evaluating 'apply' rule (" << di << ")");
+	ConfigProfiler::Scope profile (rule, Dependency::TypeInstance);
 
 	Host::Ptr host;
 	Service::Ptr service;
@@ -134,7 +136,7 @@ void Dependency::EvaluateApplyRules(const Host::Ptr& host)
 {
 	CONTEXT("Evaluating 'apply' rules for host '" << host->GetName() << "'");
 
-	for (auto& rule : ApplyRule::GetRules(Dependency::TypeInstance, Host::TypeInstance)) {
+	for (auto& rule : ApplyRule::GetCandidateRules(Dependency::TypeInstance, Host::TypeInstance, host)) {
 		if (EvaluateApplyRule(host, *rule))
 			rule->AddMatch();
 	}
@@ -149,7 +151,7 @@ void Dependency::EvaluateApplyRules(const Service::Ptr& service)
 {
 	CONTEXT("Evaluating 'apply' rules for service '" << service->GetName() << "'");
 
-	for (auto& rule : ApplyRule::GetRules(Dependency::TypeInstance, Service::TypeInstance)) {
+	for (auto& rule : ApplyRule::GetCandidateRules(Dependency::TypeInstance, Service::TypeInstance, service)) {
 		if (EvaluateApplyRule(service, *rule))
 			rule->AddMatch();
 	}
@@ -331,8 +331,10 @@ Downtime::Ptr Downtime::AddDowntime(const Checkable::Ptr& checkable, const Strin
 		Array::Ptr triggers = parentDowntime->GetTriggers();
 
 		ObjectLock olock(triggers);
-		if (!triggers->Contains(fullName))
+		if (!triggers->Contains(fullName)) {
 			triggers->Add(fullName);
+			parentDowntime->MarkStateChanged();
+		}
 	}
 
 	Downtime::Ptr downtime = Downtime::GetByName(fullName);
@@ -123,7 +123,10 @@ void IcingaApplication::OnShutdown()
 		l_RetentionTimer->Stop();
 	}
 
-	DumpProgramState();
+	/* Leave a complete state file behind which doesn't depend on the incremental one,
+	 * e.g. for older versions which don't read the latter.
+	 */
+	DumpProgramState(true);
 }
 
 static void PersistModAttrHelper(AtomicFile& fp, ConfigObject::Ptr& previousObject, const ConfigObject::Ptr& object, const String& attr, const Value& value)
@@ -159,9 +162,13 @@ static void PersistModAttrHelper(AtomicFile& fp, ConfigObject::Ptr& previousObje
 	previousObject = object;
 }
 
-void IcingaApplication::DumpProgramState()
+void IcingaApplication::DumpProgramState(bool full)
 {
-	ConfigObject::DumpObjects(Configuration::StatePath);
+	if (full)
+		ConfigObject::DumpObjects(Configuration::StatePath);
+	else
+		ConfigObject::DumpObjectsIncremental(Configuration::StatePath);
+
 	DumpModifiedAttributes();
 }
 
@@ -4,6 +4,7 @@
 #include "icinga/service.hpp"
 #include "config/configitembuilder.hpp"
 #include "config/applyrule.hpp"
+#include "config/configprofiler.hpp"
 #include "base/initialize.hpp"
 #include "base/configtype.hpp"
 #include "base/logger.hpp"
@@ -66,6 +67,7 @@ bool Notification::EvaluateApplyRule(const Checkable::Ptr& checkable, const Appl
 	auto& di (rule.GetDebugInfo());
 
 	CONTEXT("Evaluating 'apply' rule (" << di << ")");
+	ConfigProfiler::Scope profile (rule, Notification::TypeInstance);
 
 	Host::Ptr host;
 	Service::Ptr service;
@@ -133,7 +135,7 @@ void Notification::EvaluateApplyRules(const Host::Ptr& host)
 {
 	CONTEXT("Evaluating 'apply' rules for host '" << host->GetName() << "'");
 
-	for (auto& rule : ApplyRule::GetRules(Notification::TypeInstance, Host::TypeInstance))
+	for (auto& rule : ApplyRule::GetCandidateRules(Notification::TypeInstance, Host::TypeInstance, host))
 	{
 		if (EvaluateApplyRule(host, *rule))
 			rule->AddMatch();
@@ -149,7 +151,7 @@ void Notification::EvaluateApplyRules(const Service::Ptr& service)
 {
 	CONTEXT("Evaluating 'apply' rules for service '" << service->GetName() << "'");
 
-	for (auto& rule : ApplyRule::GetRules(Notification::TypeInstance, Service::TypeInstance)) {
+	for (auto& rule : ApplyRule::GetCandidateRules(Notification::TypeInstance, Service::TypeInstance, service)) {
 		if (EvaluateApplyRule(service, *rule))
 			rule->AddMatch();
 	}
@@ -237,6 +237,7 @@ void Notification::BeginExecuteNotification(NotificationType type, const CheckRe
 		auto states (GetLastNotifiedStatePerUser());
 
 		states->Clear();
+		MarkStateChanged();
 		OnLastNotifiedStatePerUserCleared(this, nullptr);
 	}
 
@@ -483,18 +484,23 @@ void Notification::BeginExecuteNotification(NotificationType type, const CheckRe
 
 			if (state != (uint_fast8_t)GetLastNotifiedStatePerUser()->Get(userName)) {
 				GetLastNotifiedStatePerUser()->Set(userName, state);
+				MarkStateChanged();
 				OnLastNotifiedStatePerUserUpdated(this, userName, state, nullptr);
 			}
 		}
 
 		/* store all notified users for later recovery checks */
-		if (type == NotificationProblem && !notifiedProblemUsers->Contains(userName))
+		if (type == NotificationProblem && !notifiedProblemUsers->Contains(userName)) {
 			notifiedProblemUsers->Add(userName);
+			MarkStateChanged();
+		}
 	}
 
 	/* if this was a recovery notification, reset all notified users */
-	if (type == NotificationRecovery)
+	if (type == NotificationRecovery) {
 		notifiedProblemUsers->Clear();
+		MarkStateChanged();
+	}
 
 	/* used in db_ido for notification history */
 	Service::OnNotificationSentToAllUsers(this, checkable, allNotifiedUsers, type, cr, author, text, nullptr);
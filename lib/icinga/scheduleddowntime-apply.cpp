@@ -4,6 +4,7 @@
 #include "icinga/service.hpp"
 #include "config/configitembuilder.hpp"
 #include "config/applyrule.hpp"
+#include "config/configprofiler.hpp"
 #include "base/initialize.hpp"
 #include "base/configtype.hpp"
 #include "base/logger.hpp"
@@ -65,6 +66,7 @@ bool ScheduledDowntime::EvaluateApplyRule(const Checkable::Ptr& checkable, const
 	auto& di (rule.GetDebugInfo());
 
 	CONTEXT("Evaluating 'apply' rule (" << di << ")");
+	ConfigProfiler::Scope profile (rule, ScheduledDowntime::TypeInstance);
 
 	Host::Ptr host;
 	Service::Ptr service;
@@ -132,7 +134,7 @@ void ScheduledDowntime::EvaluateApplyRules(const Host::Ptr& host)
 {
 	CONTEXT("Evaluating 'apply' rules for host '" << host->GetName() << "'");
 
-	for (auto& rule : ApplyRule::GetRules(ScheduledDowntime::TypeInstance, Host::TypeInstance)) {
+	for (auto& rule : ApplyRule::GetCandidateRules(ScheduledDowntime::TypeInstance, Host::TypeInstance, host)) {
 		if (EvaluateApplyRule(host, *rule))
 			rule->AddMatch();
 	}
@@ -147,7 +149,7 @@ void ScheduledDowntime::EvaluateApplyRules(const Service::Ptr& service)
 {
 	CONTEXT("Evaluating 'apply' rules for service '" << service->GetName() << "'");
 
-	for (auto& rule : ApplyRule::GetRules(ScheduledDowntime::TypeInstance, Service::TypeInstance)) {
+	for (auto& rule : ApplyRule::GetCandidateRules(ScheduledDowntime::TypeInstance, Service::TypeInstance, service)) {
 		if (EvaluateApplyRule(service, *rule))
 			rule->AddMatch();
 	}
@@ -3,6 +3,7 @@
 #include "icinga/service.hpp"
 #include "config/configitembuilder.hpp"
 #include "config/applyrule.hpp"
+#include "config/configprofiler.hpp"
 #include "base/initialize.hpp"
 #include "base/configtype.hpp"
 #include "base/logger.hpp"
@@ -60,6 +61,7 @@ bool Service::EvaluateApplyRule(const Host::Ptr& host, const ApplyRule& rule, bo
 	auto& di (rule.GetDebugInfo());
 
 	CONTEXT("Evaluating 'apply' rule (" << di << ")");
+	ConfigProfiler::Scope profile (rule, Service::TypeInstance);
 
 	ScriptFrame frame(true);
 	if (rule.GetScope())
@@ -121,7 +123,7 @@ void Service::EvaluateApplyRules(const Host::Ptr& host)
 {
 	CONTEXT("Evaluating 'apply' rules for host '" << host->GetName() << "'");
 
-	for (auto& rule : ApplyRule::GetRules(Service::TypeInstance, Host::TypeInstance)) {
+	for (auto& rule : ApplyRule::GetCandidateRules(Service::TypeInstance, Host::TypeInstance, host)) {
 		if (EvaluateApplyRule(host, *rule))
 			rule->AddMatch();
 	}
@@ -64,16 +64,19 @@ void TimePeriod::AddSegment(double begin, double end)
 			if (segment->Get("begin") >= begin && segment->Get("end") <= end) {
 				segment->Set("begin", begin);
 				segment->Set("end", end); /* Extend an existing segment to both sides */
+				MarkStateChanged();
 				return;
 			}
 
 			if (segment->Get("end") >= begin && segment->Get("end") <= end) {
 				segment->Set("end", end); /* Extend an existing segment to right. */
+				MarkStateChanged();
 				return;
 			}
 
 			if (segment->Get("begin") >= begin && segment->Get("begin") <= end) {
 				segment->Set("begin", begin); /* Extend an existing segment to left. */
+				MarkStateChanged();
 				return;
 			}
 
@@ -92,6 +95,7 @@ void TimePeriod::AddSegment(double begin, double end)
 	}
 
 	segments->Add(segment);
+	MarkStateChanged();
 }
 
 void TimePeriod::AddSegment(const Dictionary::Ptr& segment)
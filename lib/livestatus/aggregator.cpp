@@ -4,6 +4,16 @@
 
 using namespace icinga;
 
+/**
+ * Prepares the aggregator's filter for the specified table. This must be
+ * done before Apply() is called from multiple threads.
+ */
+void Aggregator::Compile(const Table::Ptr& table)
+{
+	if (m_Filter)
+		m_Filter->Compile(table);
+}
+
 void Aggregator::SetFilter(const Filter::Ptr& filter)
 {
 	m_Filter = filter;
@@ -28,6 +28,14 @@ public:
 
 	virtual void Apply(const Table::Ptr& table, const Value& row, AggregatorState **state) = 0;
 	virtual double GetResultAndFreeState(AggregatorState *state) const = 0;
+
+	/**
+	 * Merges a partial state, e.g. one computed by another thread, into the
+	 * target state. The source state is freed.
+	 */
+	virtual void MergeState(AggregatorState **target, AggregatorState *source) const = 0;
+
+	void Compile(const Table::Ptr& table);
 	void SetFilter(const Filter::Ptr& filter);
 
 protected:
@@ -5,8 +5,9 @@
 #include "base/array.hpp"
 #include "base/objectlock.hpp"
 #include "base/logger.hpp"
-#include <boost/regex.hpp>
+#include "base/debug.hpp"
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/lexical_cast.hpp>
 
 using namespace icinga;
 
@@ -14,17 +15,119 @@ AttributeFilter::AttributeFilter(String column, String op, String operand)
 	: m_Column(std::move(column)), m_Operator(std::move(op)), m_Operand(std::move(operand))
 { }
 
+AttributeFilterOperator AttributeFilter::ParseOperator(const String& op)
+{
+	if (op == "=")
+		return AttributeFilterOpEqual;
+	else if (op == "~")
+		return AttributeFilterOpRegex;
+	else if (op == "=~")
+		return AttributeFilterOpEqualICase;
+	else if (op == "~~")
+		return AttributeFilterOpRegexICase;
+	else if (op == "<")
+		return AttributeFilterOpLess;
+	else if (op == ">")
+		return AttributeFilterOpGreater;
+	else if (op == "<=")
+		return AttributeFilterOpLessOrEqual;
+	else if (op == ">=")
+		return AttributeFilterOpGreaterOrEqual;
+	else
+		return AttributeFilterOpUnknown;
+}
+
+/**
+ * Resolves the column and pre-parses the operand for the given table so that
+ * Apply() doesn't have to look up the column, convert the operand or compile
+ * a regular expression for every single row.
+ */
+void AttributeFilter::Compile(const Table::Ptr& table)
+{
+	m_CompiledColumn.reset(new Column(table->GetColumn(m_Column)));
+	m_CompiledOperator = ParseOperator(m_Operator);
+
+	try {
+		m_OperandNumber = boost::lexical_cast<double>(m_Operand);
+		m_OperandIsNumber = true;
+	} catch (const boost::bad_lexical_cast&) {
+		m_OperandIsNumber = false;
+	}
+
+	m_Regex.reset();
+
+	if (m_CompiledOperator == AttributeFilterOpRegex || m_CompiledOperator == AttributeFilterOpRegexICase) {
+		try {
+			if (m_CompiledOperator == AttributeFilterOpRegexICase)
+				m_Regex.reset(new boost::regex(m_Operand.GetData(), boost::regex::icase));
+			else
+				m_Regex.reset(new boost::regex(m_Operand.GetData()));
+		} catch (const std::exception&) {
+			Log(LogWarning, "AttributeFilter")
+				<< "Invalid regex '" << m_Operand << "' for column '" << m_Column << "'.";
+		}
+	}
+
+	m_CompiledTable = table.get();
+}
+
+bool AttributeFilter::CompareNumber(double value) const
+{
+	double operand = m_OperandIsNumber ? m_OperandNumber : Convert::ToDouble(m_Operand);
+
+	switch (m_CompiledOperator) {
+		case AttributeFilterOpEqual:
+			return value == operand;
+		case AttributeFilterOpLess:
+			return value < operand;
+		case AttributeFilterOpGreater:
+			return value > operand;
+		case AttributeFilterOpLessOrEqual:
+			return value <= operand;
+		case AttributeFilterOpGreaterOrEqual:
+			return value >= operand;
+		default:
+			VERIFY(!"Invalid numeric operator.");
+	}
+
+	return false;
+}
+
+bool AttributeFilter::MatchRegex(const Value& value) const
+{
+	if (!m_Regex)
+		return false;
+
+	bool ret;
+	try {
+		String operand = value;
+		boost::smatch what;
+		ret = boost::regex_search(operand.GetData(), what, *m_Regex);
+	} catch (boost::exception&) {
+		Log(LogWarning, "AttributeFilter")
+			<< "Regex '" << m_Operand << " " << m_Operator << " " << value << "' error.";
+		ret = false;
+	}
+
+	//Log(LogDebug, "LivestatusListener/AttributeFilter")
+	//    << "Attribute filter '" << m_Operand + " " << m_Operator << " "
+	//    << value << "' " << (ret ? "matches" : "doesn't match") << ".";
+
+	return ret;
+}
+
 bool AttributeFilter::Apply(const Table::Ptr& table, const Value& row)
 {
-	Column column = table->GetColumn(m_Column);
+	if (!m_CompiledColumn || m_CompiledTable != table.get())
+		Compile(table);
 
-	Value value = column.ExtractValue(row);
+	Value value = m_CompiledColumn->ExtractValue(row);
 
 	if (value.IsObjectType<Array>()) {
 		Array::Ptr array = value;
 
-		if (m_Operator == ">=" || m_Operator == "<") {
-			bool negate = (m_Operator == "<");
+		if (m_CompiledOperator == AttributeFilterOpGreaterOrEqual || m_CompiledOperator == AttributeFilterOpLess) {
+			bool negate = (m_CompiledOperator == AttributeFilterOpLess);
 
 			ObjectLock olock(array);
 			for (const String& item : array) {
@@ -33,87 +136,63 @@ bool AttributeFilter::Apply(const Table::Ptr& table, const Value& row)
 			}
 
 			return negate; /* Item not found in list. */
-		} else if (m_Operator == "=") {
+		} else if (m_CompiledOperator == AttributeFilterOpEqual) {
 			return (array->GetLength() == 0);
 		} else {
 			BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid operator for column '" + m_Column + "': " + m_Operator + " (expected '>=' or '=')."));
 		}
 	} else {
-		if (m_Operator == "=") {
-			if (value.GetType() == ValueNumber || value.GetType() == ValueBoolean)
-				return (static_cast<double>(value) == Convert::ToDouble(m_Operand));
-			else
-				return (static_cast<String>(value) == m_Operand);
-		} else if (m_Operator == "~") {
-			bool ret;
-			try {
-				boost::regex expr(m_Operand.GetData());
-				String operand = value;
-				boost::smatch what;
-				ret = boost::regex_search(operand.GetData(), what, expr);
-			} catch (boost::exception&) {
-				Log(LogWarning, "AttributeFilter")
-					<< "Regex '" << m_Operand << " " << m_Operator << " " << value << "' error.";
-				ret = false;
-			}
+		switch (m_CompiledOperator) {
+			case AttributeFilterOpEqual:
+				if (value.GetType() == ValueNumber || value.GetType() == ValueBoolean)
+					return CompareNumber(static_cast<double>(value));
+				else
+					return (static_cast<String>(value) == m_Operand);
 
-			//Log(LogDebug, "LivestatusListener/AttributeFilter")
-			//    << "Attribute filter '" << m_Operand + " " << m_Operator << " "
-			//    << value << "' " << (ret ? "matches" : "doesn't match") << ".";
-
-			return ret;
-		} else if (m_Operator == "=~") {
-			bool ret;
-			try {
-				String operand = value;
-				ret = boost::iequals(operand, m_Operand.GetData());
-			} catch (boost::exception&) {
-				Log(LogWarning, "AttributeFilter")
-					<< "Case-insensitive equality '" << m_Operand << " " << m_Operator << " " << value << "' error.";
-				ret = false;
-			}
+			case AttributeFilterOpRegex:
+			case AttributeFilterOpRegexICase:
+				return MatchRegex(value);
+
+			case AttributeFilterOpEqualICase: {
+				bool ret;
+				try {
+					String operand = value;
+					ret = boost::iequals(operand, m_Operand.GetData());
+				} catch (boost::exception&) {
+					Log(LogWarning, "AttributeFilter")
+						<< "Case-insensitive equality '" << m_Operand << " " << m_Operator << " " << value << "' error.";
+					ret = false;
+				}
 
-			return ret;
-		} else if (m_Operator == "~~") {
-			bool ret;
-			try {
-				boost::regex expr(m_Operand.GetData(), boost::regex::icase);
-				String operand = value;
-				boost::smatch what;
-				ret = boost::regex_search(operand.GetData(), what, expr);
-			} catch (boost::exception&) {
-				Log(LogWarning, "AttributeFilter")
-					<< "Regex '" << m_Operand << " " << m_Operator << " " << value << "' error.";
-				ret = false;
+				return ret;
 			}
 
-			//Log(LogDebug, "LivestatusListener/AttributeFilter")
-			//    << "Attribute filter '" << m_Operand << " " << m_Operator << " "
-			//    << value << "' " << (ret ? "matches" : "doesn't match") << ".";
+			case AttributeFilterOpLess:
+				if (value.GetType() == ValueNumber)
+					return CompareNumber(static_cast<double>(value));
+				else
+					return (static_cast<String>(value) < m_Operand);
 
-			return ret;
-		} else if (m_Operator == "<") {
-			if (value.GetType() == ValueNumber)
-				return (static_cast<double>(value) < Convert::ToDouble(m_Operand));
-			else
-				return (static_cast<String>(value) < m_Operand);
-		} else if (m_Operator == ">") {
-			if (value.GetType() == ValueNumber)
-				return (static_cast<double>(value) > Convert::ToDouble(m_Operand));
-			else
-				return (static_cast<String>(value) > m_Operand);
-		} else if (m_Operator == "<=") {
-			if (value.GetType() == ValueNumber)
-				return (static_cast<double>(value) <= Convert::ToDouble(m_Operand));
-			else
-				return (static_cast<String>(value) <= m_Operand);
-		} else if (m_Operator == ">=") {
-			if (value.GetType() == ValueNumber)
-				return (static_cast<double>(value) >= Convert::ToDouble(m_Operand));
-			else
-				return (static_cast<String>(value) >= m_Operand);
-		} else {
-			BOOST_THROW_EXCEPTION(std::invalid_argument("Unknown operator for column '" + m_Column + "': " + m_Operator));
+			case AttributeFilterOpGreater:
+				if (value.GetType() == ValueNumber)
+					return CompareNumber(static_cast<double>(value));
+				else
+					return (static_cast<String>(value) > m_Operand);
+
+			case AttributeFilterOpLessOrEqual:
+				if (value.GetType() == ValueNumber)
+					return CompareNumber(static_cast<double>(value));
+				else
+					return (static_cast<String>(value) <= m_Operand);
+
+			case AttributeFilterOpGreaterOrEqual:
+				if (value.GetType() == ValueNumber)
+					return CompareNumber(static_cast<double>(value));
+				else
+					return (static_cast<String>(value) >= m_Operand);
+
+			default:
+				BOOST_THROW_EXCEPTION(std::invalid_argument("Unknown operator for column '" + m_Column + "': " + m_Operator));
 		}
 	}
 
@@ -4,12 +4,30 @@
 #define ATTRIBUTEFILTER_H
 
 #include "livestatus/filter.hpp"
+#include <boost/regex.hpp>
+#include <memory>
 
 using namespace icinga;
 
 namespace icinga
 {
 
+/**
+ * @ingroup livestatus
+ */
+enum AttributeFilterOperator
+{
+	AttributeFilterOpUnknown,
+	AttributeFilterOpEqual,
+	AttributeFilterOpRegex,
+	AttributeFilterOpEqualICase,
+	AttributeFilterOpRegexICase,
+	AttributeFilterOpLess,
+	AttributeFilterOpGreater,
+	AttributeFilterOpLessOrEqual,
+	AttributeFilterOpGreaterOrEqual
+};
+
 /**
  * @ingroup livestatus
  */
@@ -20,12 +38,27 @@ public:
 
 	AttributeFilter(String column, String op, String operand);
 
+	void Compile(const Table::Ptr& table) override;
 	bool Apply(const Table::Ptr& table, const Value& row) override;
 
 protected:
 	String m_Column;
 	String m_Operator;
 	String m_Operand;
+
+private:
+	/* Query plan, resolved once per table by Compile(). */
+	const Table *m_CompiledTable{nullptr};
+	std::unique_ptr<Column> m_CompiledColumn;
+	AttributeFilterOperator m_CompiledOperator{AttributeFilterOpUnknown};
+	bool m_OperandIsNumber{false};
+	double m_OperandNumber{0};
+	std::unique_ptr<boost::regex> m_Regex;
+
+	static AttributeFilterOperator ParseOperator(const String& op);
+
+	bool CompareNumber(double value) const;
+	bool MatchRegex(const Value& value) const;
 };
 
 }
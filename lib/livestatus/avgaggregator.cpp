@@ -36,3 +36,17 @@ double AvgAggregator::GetResultAndFreeState(AggregatorState *state) const
 
 	return result;
 }
+
+void AvgAggregator::MergeState(AggregatorState **target, AggregatorState *source) const
+{
+	if (!source)
+		return;
+
+	AvgAggregatorState *ptarget = EnsureState(target);
+	AvgAggregatorState *psource = static_cast<AvgAggregatorState *>(source);
+
+	ptarget->Avg += psource->Avg;
+	ptarget->AvgCount += psource->AvgCount;
+
+	delete psource;
+}
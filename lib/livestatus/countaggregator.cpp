@@ -28,3 +28,16 @@ double CountAggregator::GetResultAndFreeState(AggregatorState *state) const
 
 	return result;
 }
+
+void CountAggregator::MergeState(AggregatorState **target, AggregatorState *source) const
+{
+	if (!source)
+		return;
+
+	CountAggregatorState *ptarget = EnsureState(target);
+	CountAggregatorState *psource = static_cast<CountAggregatorState *>(source);
+
+	ptarget->Count += psource->Count;
+
+	delete psource;
+}
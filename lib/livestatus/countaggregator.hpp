@@ -27,6 +27,7 @@ public:
 
 	void Apply(const Table::Ptr& table, const Value& row, AggregatorState **) override;
 	double GetResultAndFreeState(AggregatorState *state) const override;
+	void MergeState(AggregatorState **target, AggregatorState *source) const override;
 
 private:
 	static CountAggregatorState *EnsureState(AggregatorState **state);
@@ -0,0 +1,14 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "livestatus/filter.hpp"
+
+using namespace icinga;
+
+/**
+ * Prepares the filter for being applied to rows of the specified table.
+ *
+ * The default implementation does nothing; filters that can resolve columns
+ * or pre-parse operands up front override this.
+ */
+void Filter::Compile(const Table::Ptr&)
+{ }
@@ -36,3 +36,17 @@ double InvAvgAggregator::GetResultAndFreeState(AggregatorState *state) const
 
 	return result;
 }
+
+void InvAvgAggregator::MergeState(AggregatorState **target, AggregatorState *source) const
+{
+	if (!source)
+		return;
+
+	InvAvgAggregatorState *ptarget = EnsureState(target);
+	InvAvgAggregatorState *psource = static_cast<InvAvgAggregatorState *>(source);
+
+	ptarget->InvAvg += psource->InvAvg;
+	ptarget->InvAvgCount += psource->InvAvgCount;
+
+	delete psource;
+}
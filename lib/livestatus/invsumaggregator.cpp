@@ -35,3 +35,16 @@ double InvSumAggregator::GetResultAndFreeState(AggregatorState *state) const
 
 	return result;
 }
+
+void InvSumAggregator::MergeState(AggregatorState **target, AggregatorState *source) const
+{
+	if (!source)
+		return;
+
+	InvSumAggregatorState *ptarget = EnsureState(target);
+	InvSumAggregatorState *psource = static_cast<InvSumAggregatorState *>(source);
+
+	ptarget->InvSum += psource->InvSum;
+
+	delete psource;
+}
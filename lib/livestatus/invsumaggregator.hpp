@@ -29,6 +29,7 @@ public:
 
 	void Apply(const Table::Ptr& table, const Value& row, AggregatorState **state) override;
 	double GetResultAndFreeState(AggregatorState *state) const override;
+	void MergeState(AggregatorState **target, AggregatorState *source) const override;
 
 private:
 	String m_InvSumAttr;
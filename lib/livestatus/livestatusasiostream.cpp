@@ -0,0 +1,64 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "livestatus/livestatusasiostream.hpp"
+#include "base/exception.hpp"
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/system/system_error.hpp>
+
+using namespace icinga;
+
+LivestatusAsioStream::LivestatusAsioStream(Shared<Socket>::Ptr socket, boost::asio::yield_context yc)
+	: m_Socket(std::move(socket)), m_Yc(std::move(yc)), m_Eof(false)
+{ }
+
+size_t LivestatusAsioStream::Read(void *buffer, size_t count)
+{
+	if (m_Eof)
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Tried to read from closed socket."));
+
+	boost::system::error_code ec;
+	size_t rc = m_Socket->async_read_some(boost::asio::buffer(buffer, count), m_Yc[ec]);
+
+	if (ec) {
+		m_Eof = true;
+
+		if (ec == boost::asio::error::eof)
+			return 0;
+
+		BOOST_THROW_EXCEPTION(boost::system::system_error(ec));
+	}
+
+	return rc;
+}
+
+void LivestatusAsioStream::Write(const void *buffer, size_t count)
+{
+	if (m_Eof)
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Tried to write to closed socket."));
+
+	boost::system::error_code ec;
+	boost::asio::async_write(*m_Socket, boost::asio::buffer(buffer, count), m_Yc[ec]);
+
+	if (ec) {
+		m_Eof = true;
+
+		BOOST_THROW_EXCEPTION(boost::system::system_error(ec));
+	}
+}
+
+void LivestatusAsioStream::Close()
+{
+	Stream::Close();
+
+	m_Eof = true;
+
+	boost::system::error_code ec;
+	m_Socket->shutdown(Socket::shutdown_both, ec);
+	m_Socket->close(ec);
+}
+
+bool LivestatusAsioStream::IsEof() const
+{
+	return m_Eof;
+}
@@ -0,0 +1,47 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef LIVESTATUSASIOSTREAM_H
+#define LIVESTATUSASIOSTREAM_H
+
+#include "livestatus/i2-livestatus.hpp"
+#include "base/shared.hpp"
+#include "base/stream.hpp"
+#include <boost/asio/generic/stream_protocol.hpp>
+#include <boost/asio/spawn.hpp>
+
+namespace icinga
+{
+
+/**
+ * Adapts a socket owned by a Livestatus client coroutine to the Stream
+ * interface. All I/O suspends the coroutine instead
+ * of blocking the current thread, so it must only be used from within the
+ * coroutine the yield context belongs to, and never while holding locks.
+ *
+ * @ingroup livestatus
+ */
+class LivestatusAsioStream final : public Stream
+{
+public:
+	DECLARE_PTR_TYPEDEFS(LivestatusAsioStream);
+
+	typedef boost::asio::generic::stream_protocol::socket Socket;
+
+	LivestatusAsioStream(Shared<Socket>::Ptr socket, boost::asio::yield_context yc);
+
+	size_t Read(void *buffer, size_t count) override;
+	void Write(const void *buffer, size_t count) override;
+
+	void Close() override;
+
+	bool IsEof() const override;
+
+private:
+	Shared<Socket>::Ptr m_Socket;
+	boost::asio::yield_context m_Yc;
+	bool m_Eof;
+};
+
+}
+
+#endif /* LIVESTATUSASIOSTREAM_H */
@@ -2,19 +2,32 @@
 
 #include "livestatus/livestatuslistener.hpp"
 #include "livestatus/livestatuslistener-ti.cpp"
+#include "livestatus/livestatusquerycache.hpp"
 #include "base/utility.hpp"
 #include "base/perfdatavalue.hpp"
 #include "base/objectlock.hpp"
 #include "base/configtype.hpp"
 #include "base/logger.hpp"
 #include "base/exception.hpp"
-#include "base/tcpsocket.hpp"
-#include "base/unixsocket.hpp"
-#include "base/networkstream.hpp"
 #include "base/application.hpp"
 #include "base/function.hpp"
 #include "base/statsfunction.hpp"
 #include "base/convert.hpp"
+#include "base/defer.hpp"
+#include "base/fifo.hpp"
+#include "base/io-engine.hpp"
+#include "base/workqueue.hpp"
+#include "base/configuration.hpp"
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/asio/buffers_iterator.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <memory>
+#ifndef _WIN32
+#	include <boost/asio/local/stream_protocol.hpp>
+#endif /* _WIN32 */
 
 using namespace icinga;
 
@@ -24,11 +37,29 @@ static int l_ClientsConnected = 0;
 static int l_Connections = 0;
 static std::mutex l_ComponentMutex;
 
+/* Maximum size of a single request a client may have pending. */
+static const size_t l_MaxRequestSize = 1024 * 1024;
+
 REGISTER_STATSFUNCTION(LivestatusListener, &LivestatusListener::StatsFunc);
 
+/**
+ * Returns the queue which executes the queries of all clients, so that they
+ * neither occupy I/O threads nor start threads of their own.
+ */
+static WorkQueue& GetQueryQueue()
+{
+	static WorkQueue queue (0, Configuration::Concurrency, LogNotice);
+	static std::once_flag nameOnce;
+
+	std::call_once(nameOnce, []() { queue.SetName("LivestatusListener, Queries"); });
+
+	return queue;
+}
+
 void LivestatusListener::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	DictionaryData nodes;
+	bool queryCache = false;
 
 	for (const LivestatusListener::Ptr& livestatuslistener : ConfigType::GetObjectsByType<LivestatusListener>()) {
 		nodes.emplace_back(livestatuslistener->GetName(), new Dictionary({
@@ -36,9 +67,29 @@ void LivestatusListener::StatsFunc(const Dictionary::Ptr& status, const Array::P
 		}));
 
 		perfdata->Add(new PerfdataValue("livestatuslistener_" + livestatuslistener->GetName() + "_connections", l_Connections));
+
+		if (livestatuslistener->GetEnableQueryCache())
+			queryCache = true;
 	}
 
 	status->Set("livestatuslistener", new Dictionary(std::move(nodes)));
+
+	/* The query cache is shared by all listeners. */
+	if (queryCache) {
+		double cacheHits = LivestatusQueryCache::GetHits();
+		double cacheMisses = LivestatusQueryCache::GetMisses();
+		double cacheSize = LivestatusQueryCache::GetSize();
+
+		status->Set("livestatusquerycache", new Dictionary({
+			{ "hits", cacheHits },
+			{ "misses", cacheMisses },
+			{ "size", cacheSize }
+		}));
+
+		perfdata->Add(new PerfdataValue("livestatus_query_cache_hits", cacheHits, true));
+		perfdata->Add(new PerfdataValue("livestatus_query_cache_misses", cacheMisses, true));
+		perfdata->Add(new PerfdataValue("livestatus_query_cache_size", cacheSize));
+	}
 }
 
 /**
@@ -46,36 +97,64 @@ void LivestatusListener::StatsFunc(const Dictionary::Ptr& status, const Array::P
  */
 void LivestatusListener::Start(bool runtimeCreated)
 {
+	namespace asio = boost::asio;
+	using asio::generic::stream_protocol;
+
 	ObjectImpl<LivestatusListener>::Start(runtimeCreated);
 
 	Log(LogInformation, "LivestatusListener")
 		<< "'" << GetName() << "' started.";
 
-	if (GetSocketType() == "tcp") {
-		TcpSocket::Ptr socket = new TcpSocket();
+	auto& io (IoEngine::Get().GetIoContext());
+	auto acceptor (Shared<Acceptor>::Make(io));
 
+	if (GetSocketType() == "tcp") {
 		try {
-			socket->Bind(GetBindHost(), GetBindPort(), AF_UNSPEC);
-		} catch (std::exception&) {
+			asio::ip::tcp::resolver resolver (io);
+			auto result (resolver.resolve(GetBindHost().GetData(), GetBindPort().GetData(), asio::ip::tcp::resolver::passive));
+			auto current (result.begin());
+
+			for (;;) {
+				try {
+					stream_protocol::endpoint endpoint (current->endpoint());
+
+					acceptor->open(endpoint.protocol());
+					acceptor->set_option(asio::socket_base::reuse_address(true));
+					acceptor->bind(endpoint);
+
+					break;
+				} catch (const std::exception&) {
+					if (++current == result.end()) {
+						throw;
+					}
+
+					if (acceptor->is_open()) {
+						acceptor->close();
+					}
+				}
+			}
+
+			acceptor->listen(asio::socket_base::max_listen_connections);
+		} catch (const std::exception&) {
 			Log(LogCritical, "LivestatusListener")
 				<< "Cannot bind TCP socket on host '" << GetBindHost() << "' port '" << GetBindPort() << "'.";
 			return;
 		}
 
-		m_Listener = socket;
-
-		m_Thread = std::thread([this]() { ServerThreadProc(); });
-
 		Log(LogInformation, "LivestatusListener")
 			<< "Created TCP socket listening on host '" << GetBindHost() << "' port '" << GetBindPort() << "'.";
 	}
 	else if (GetSocketType() == "unix") {
 #ifndef _WIN32
-		UnixSocket::Ptr socket = new UnixSocket();
-
 		try {
-			socket->Bind(GetSocketPath());
-		} catch (std::exception&) {
+			unlink(GetSocketPath().CStr());
+
+			stream_protocol::endpoint endpoint (asio::local::stream_protocol::endpoint(GetSocketPath().GetData()));
+
+			acceptor->open(endpoint.protocol());
+			acceptor->bind(endpoint);
+			acceptor->listen(asio::socket_base::max_listen_connections);
+		} catch (const std::exception&) {
 			Log(LogCritical, "LivestatusListener")
 				<< "Cannot bind UNIX socket to '" << GetSocketPath() << "'.";
 			return;
@@ -90,10 +169,6 @@ void LivestatusListener::Start(bool runtimeCreated)
 			return;
 		}
 
-		m_Listener = socket;
-
-		m_Thread = std::thread([this]() { ServerThreadProc(); });
-
 		Log(LogInformation, "LivestatusListener")
 			<< "Created UNIX socket in '" << GetSocketPath() << "'.";
 #else
@@ -101,7 +176,18 @@ void LivestatusListener::Start(bool runtimeCreated)
 		Log(LogCritical, "LivestatusListener", "Unix sockets are not supported on Windows.");
 		return;
 #endif
+	} else {
+		return;
 	}
+
+	m_Acceptor = acceptor;
+	m_AcceptorStrand = Shared<asio::io_context::strand>::Make(io);
+
+	LivestatusListener::Ptr keepAlive (this);
+
+	IoEngine::SpawnCoroutine(*m_AcceptorStrand, [keepAlive, acceptor](asio::yield_context yc) {
+		keepAlive->ServerCoroutineProc(yc, acceptor);
+	});
 }
 
 void LivestatusListener::Stop(bool runtimeRemoved)
@@ -111,10 +197,15 @@ void LivestatusListener::Stop(bool runtimeRemoved)
 	Log(LogInformation, "LivestatusListener")
 		<< "'" << GetName() << "' stopped.";
 
-	m_Listener->Close();
+	if (m_Acceptor) {
+		auto acceptor (m_Acceptor);
 
-	if (m_Thread.joinable())
-		m_Thread.join();
+		/* The acceptor isn't thread-safe, close it on the strand the accept loop runs on. */
+		boost::asio::post(*m_AcceptorStrand, [acceptor]() {
+			boost::system::error_code ec;
+			acceptor->close(ec);
+		});
+	}
 }
 
 int LivestatusListener::GetClientsConnected()
@@ -131,55 +222,96 @@ int LivestatusListener::GetConnections()
 	return l_Connections;
 }
 
-void LivestatusListener::ServerThreadProc()
+void LivestatusListener::ServerCoroutineProc(boost::asio::yield_context yc, const Shared<Acceptor>::Ptr& acceptor)
 {
-	m_Listener->Listen();
+	namespace asio = boost::asio;
 
-	try {
-		for (;;) {
-			timeval tv = { 0, 500000 };
+	auto& io (IoEngine::Get().GetIoContext());
 
-			if (m_Listener->Poll(true, false, &tv)) {
-				Socket::Ptr client = m_Listener->Accept();
-				Log(LogNotice, "LivestatusListener", "Client connected");
-				Utility::QueueAsyncCallback([this, client]() { ClientHandler(client); }, LowLatencyScheduler);
-			}
+	for (;;) {
+		auto client (Shared<LivestatusAsioStream::Socket>::Make(io));
 
-			if (!IsActive())
-				break;
+		boost::system::error_code ec;
+		acceptor->async_accept(*client, yc[ec]);
+
+		if (!acceptor->is_open() || !IsActive())
+			break;
+
+		if (ec) {
+			Log(LogCritical, "LivestatusListener")
+				<< "Cannot accept new connection: " << ec.message();
+			continue;
 		}
-	} catch (std::exception&) {
-		Log(LogCritical, "LivestatusListener", "Cannot accept new connection.");
-	}
 
-	m_Listener->Close();
+		Log(LogNotice, "LivestatusListener", "Client connected");
+
+		auto strand (Shared<asio::io_context::strand>::Make(io));
+		LivestatusListener::Ptr keepAlive (this);
+
+		IoEngine::SpawnCoroutine(*strand, [keepAlive, strand, client](asio::yield_context yc) {
+			keepAlive->ClientHandler(yc, strand, client);
+		});
+	}
 }
 
-void LivestatusListener::ClientHandler(const Socket::Ptr& client)
+void LivestatusListener::ClientHandler(boost::asio::yield_context yc, const Shared<boost::asio::io_context::strand>::Ptr& strand,
+	const Shared<LivestatusAsioStream::Socket>::Ptr& client)
 {
+	namespace asio = boost::asio;
+
 	{
 		std::unique_lock<std::mutex> lock(l_ComponentMutex);
 		l_ClientsConnected++;
 		l_Connections++;
 	}
 
-	Stream::Ptr stream = new NetworkStream(client);
+	Defer disconnected ([]() {
+		std::unique_lock<std::mutex> lock(l_ComponentMutex);
+		l_ClientsConnected--;
+	});
 
-	StreamReadContext context;
+	auto& io (IoEngine::Get().GetIoContext());
 
-	for (;;) {
-		String line;
+	LivestatusAsioStream::Ptr stream = new LivestatusAsioStream(client, yc);
+	Defer closeStream ([&stream]() { stream->Close(); });
+
+	std::vector<char> writeBuffer (64 * 1024);
+
+	/* Idle clients just wait for data without occupying a thread. The buffer
+	 * limits how much a single client may queue up for one request.
+	 */
+	asio::streambuf buf (l_MaxRequestSize);
 
+	for (;;) {
 		std::vector<String> lines;
 
 		for (;;) {
-			StreamReadStatus srs = stream->ReadLine(&line, context);
+			boost::system::error_code ec;
+			size_t length = asio::async_read_until(*client, buf, '\n', yc[ec]);
+
+			if (ec == asio::error::not_found) {
+				Log(LogWarning, "LivestatusListener")
+					<< "Livestatus request exceeds the maximum size of " << l_MaxRequestSize << " bytes, closing connection.";
+				return;
+			}
+
+			if (ec) {
+				/* A final request may not be terminated by an empty line. */
+				String line (asio::buffers_begin(buf.data()), asio::buffers_end(buf.data()));
+				buf.consume(buf.size());
+
+				boost::algorithm::trim_right(line);
+
+				if (line.GetLength() > 0)
+					lines.push_back(line);
 
-			if (srs == StatusEof)
 				break;
+			}
+
+			String line (asio::buffers_begin(buf.data()), asio::buffers_begin(buf.data()) + length);
+			buf.consume(length);
 
-			if (srs != StatusNewItem)
-				continue;
+			boost::algorithm::trim_right(line);
 
 			if (line.GetLength() > 0)
 				lines.push_back(line);
@@ -190,18 +322,58 @@ void LivestatusListener::ClientHandler(const Socket::Ptr& client)
 		if (lines.empty())
 			break;
 
-		LivestatusQuery::Ptr query = new LivestatusQuery(lines, GetCompatLogPath());
-		if (!query->Execute(stream))
+		LivestatusQuery::Ptr query;
+
+		try {
+			query = new LivestatusQuery(lines, GetCompatLogPath());
+
+			if (GetEnableQueryCache())
+				query->EnableCache(GetQueryCacheMaxAge());
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "LivestatusListener")
+				<< "Invalid livestatus query: " << DiagnosticInformation(ex, false);
 			break;
-	}
+		}
 
-	{
-		std::unique_lock<std::mutex> lock(l_ComponentMutex);
-		l_ClientsConnected--;
+		/* Queries are executed by the query queue's threads, not by this I/O thread. The tables
+		 * lock objects while fetching rows and the historical ones read files. The response
+		 * is buffered and only written to the client afterwards, so no object stays locked
+		 * while waiting for a slow client.
+		 */
+		FIFO::Ptr response = new FIFO();
+		auto executed (Shared<AsioConditionVariable>::Make(io));
+		auto keepAliveQuery (std::make_shared<bool>(false));
+
+		GetQueryQueue().Enqueue([query, response, executed, keepAliveQuery, strand]() {
+			Defer notify ([&executed, &strand]() {
+				boost::asio::post(*strand, [executed]() { executed->Set(); });
+			});
+
+			*keepAliveQuery = query->Execute(response);
+		});
+
+		executed->Wait(yc);
+
+		try {
+			for (;;) {
+				size_t count = response->Read(writeBuffer.data(), writeBuffer.size());
+
+				if (count == 0)
+					break;
+
+				stream->Write(writeBuffer.data(), count);
+			}
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "LivestatusListener")
+				<< "Cannot write query response to client: " << ex.what();
+			break;
+		}
+
+		if (!*keepAliveQuery)
+			break;
 	}
 }
 
-
 void LivestatusListener::ValidateSocketType(const Lazy<String>& lvalue, const ValidationUtils& utils)
 {
 	ObjectImpl<LivestatusListener>::ValidateSocketType(lvalue, utils);
@@ -6,8 +6,12 @@
 #include "livestatus/i2-livestatus.hpp"
 #include "livestatus/livestatuslistener-ti.hpp"
 #include "livestatus/livestatusquery.hpp"
-#include "base/socket.hpp"
-#include <thread>
+#include "livestatus/livestatusasiostream.hpp"
+#include "base/shared.hpp"
+#include <boost/asio/basic_socket_acceptor.hpp>
+#include <boost/asio/generic/stream_protocol.hpp>
+#include <boost/asio/io_context_strand.hpp>
+#include <boost/asio/spawn.hpp>
 
 using namespace icinga;
 
@@ -35,11 +39,14 @@ protected:
 	void Stop(bool runtimeRemoved) override;
 
 private:
-	void ServerThreadProc();
-	void ClientHandler(const Socket::Ptr& client);
+	typedef boost::asio::basic_socket_acceptor<boost::asio::generic::stream_protocol> Acceptor;
 
-	Socket::Ptr m_Listener;
-	std::thread m_Thread;
+	void ServerCoroutineProc(boost::asio::yield_context yc, const Shared<Acceptor>::Ptr& acceptor);
+	void ClientHandler(boost::asio::yield_context yc, const Shared<boost::asio::io_context::strand>::Ptr& strand,
+		const Shared<LivestatusAsioStream::Socket>::Ptr& client);
+
+	Shared<Acceptor>::Ptr m_Acceptor;
+	Shared<boost::asio::io_context::strand>::Ptr m_AcceptorStrand;
 };
 
 }
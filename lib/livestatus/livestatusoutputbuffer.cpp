@@ -0,0 +1,102 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "livestatus/livestatusoutputbuffer.hpp"
+#include <algorithm>
+#include <cstring>
+
+using namespace icinga;
+
+/**
+ * @param captureLimit If not 0, a copy of the data written to the stream is kept
+ *                     as long as it doesn't exceed this many bytes, see GetCapturedData().
+ */
+LivestatusOutputBuffer::LivestatusOutputBuffer(Stream::Ptr stream, size_t size, size_t captureLimit)
+	: m_Stream(std::move(stream)), m_Buffer(size), m_CaptureLimit(captureLimit), m_Capturing(captureLimit > 0)
+{
+	setp(m_Buffer.data(), m_Buffer.data() + m_Buffer.size());
+}
+
+/**
+ * Returns the number of bytes which have been handed to the underlying stream so far.
+ */
+size_t LivestatusOutputBuffer::GetBytesWritten() const
+{
+	return m_BytesWritten;
+}
+
+/**
+ * Retrieves the copy of all data written to the stream so far.
+ *
+ * @returns false if no copy was requested or the data exceeded the capture limit.
+ */
+bool LivestatusOutputBuffer::GetCapturedData(String *data) const
+{
+	if (!m_Capturing)
+		return false;
+
+	*data = m_Captured;
+	return true;
+}
+
+/**
+ * Writes the buffered data to the underlying stream. Any exception thrown by
+ * the stream (e.g. because the client went away) is propagated to the caller.
+ */
+void LivestatusOutputBuffer::FlushBuffer()
+{
+	size_t count = pptr() - pbase();
+
+	if (count > 0) {
+		if (m_Capturing) {
+			if (m_Captured.size() + count <= m_CaptureLimit) {
+				m_Captured.append(pbase(), count);
+			} else {
+				/* Too large to be kept, the rest is only streamed. */
+				m_Capturing = false;
+				std::string().swap(m_Captured);
+			}
+		}
+
+		m_Stream->Write(pbase(), count);
+		m_BytesWritten += count;
+	}
+
+	setp(m_Buffer.data(), m_Buffer.data() + m_Buffer.size());
+}
+
+LivestatusOutputBuffer::int_type LivestatusOutputBuffer::overflow(int_type ch)
+{
+	FlushBuffer();
+
+	if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+		*pptr() = traits_type::to_char_type(ch);
+		pbump(1);
+	}
+
+	return traits_type::not_eof(ch);
+}
+
+std::streamsize LivestatusOutputBuffer::xsputn(const char_type *s, std::streamsize count)
+{
+	std::streamsize written = 0;
+
+	while (written < count) {
+		if (pptr() == epptr())
+			FlushBuffer();
+
+		std::streamsize chunk = std::min<std::streamsize>(count - written, epptr() - pptr());
+
+		std::memcpy(pptr(), s + written, chunk);
+		pbump(static_cast<int>(chunk));
+		written += chunk;
+	}
+
+	return written;
+}
+
+int LivestatusOutputBuffer::sync()
+{
+	FlushBuffer();
+
+	return 0;
+}
@@ -0,0 +1,52 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef LIVESTATUSOUTPUTBUFFER_H
+#define LIVESTATUSOUTPUTBUFFER_H
+
+#include "livestatus/i2-livestatus.hpp"
+#include "base/stream.hpp"
+#include "base/string.hpp"
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * A bounded std::streambuf which forwards everything written to it to a
+ * Stream in chunks of at most the buffer size. This allows Livestatus to
+ * write large result sets to the client while they're being produced.
+ *
+ * @ingroup livestatus
+ */
+class LivestatusOutputBuffer final : public std::streambuf
+{
+public:
+	LivestatusOutputBuffer(Stream::Ptr stream, size_t size = 64 * 1024, size_t captureLimit = 0);
+
+	LivestatusOutputBuffer(const LivestatusOutputBuffer&) = delete;
+	LivestatusOutputBuffer& operator=(const LivestatusOutputBuffer&) = delete;
+
+	size_t GetBytesWritten() const;
+	bool GetCapturedData(String *data) const;
+
+protected:
+	int_type overflow(int_type ch) override;
+	std::streamsize xsputn(const char_type *s, std::streamsize count) override;
+	int sync() override;
+
+private:
+	Stream::Ptr m_Stream;
+	std::vector<char> m_Buffer;
+	size_t m_BytesWritten{0};
+	size_t m_CaptureLimit;
+	bool m_Capturing;
+	std::string m_Captured;
+
+	void FlushBuffer();
+};
+
+}
+
+#endif /* LIVESTATUSOUTPUTBUFFER_H */
@@ -13,6 +13,8 @@
 #include "livestatus/negatefilter.hpp"
 #include "livestatus/orfilter.hpp"
 #include "livestatus/andfilter.hpp"
+#include "livestatus/livestatusoutputbuffer.hpp"
+#include "livestatus/livestatusquerycache.hpp"
 #include "icinga/externalcommandprocessor.hpp"
 #include "base/debug.hpp"
 #include "base/convert.hpp"
@@ -24,16 +26,39 @@
 #include "base/serializer.hpp"
 #include "base/timer.hpp"
 #include "base/initialize.hpp"
+#include "base/configuration.hpp"
+#include "base/workqueue.hpp"
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/join.hpp>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 
 using namespace icinga;
 
 static int l_ExternalCommands = 0;
 static std::mutex l_QueryMutex;
 
+/* Number of rows per batch of Stats queries which may be aggregated by the shared stats queue. */
+static const size_t l_StatsBatchSize = 5000;
+
+/**
+ * Returns the queue which aggregates batches of all Stats queries, so that
+ * concurrent queries don't start threads of their own.
+ */
+static WorkQueue& GetStatsQueue()
+{
+	static WorkQueue queue (0, Configuration::Concurrency > 1 ? Configuration::Concurrency - 1 : 1, LogNotice);
+	static std::once_flag nameOnce;
+
+	std::call_once(nameOnce, []() { queue.SetName("LivestatusQuery, Stats"); });
+
+	return queue;
+}
+
 LivestatusQuery::LivestatusQuery(const std::vector<String>& lines, const String& compat_log_path)
-	: m_KeepAlive(false), m_OutputFormat("csv"), m_ColumnHeaders(true), m_Limit(-1), m_ErrorCode(0),
+	: m_KeepAlive(false), m_OutputFormat("csv"), m_ColumnHeaders(true), m_Limit(-1), m_CacheMaxAge(-1), m_ErrorCode(0),
 	m_LogTimeFrom(0), m_LogTimeUntil(static_cast<long>(Utility::GetTime()))
 {
 	if (lines.size() == 0) {
@@ -68,6 +93,7 @@ LivestatusQuery::LivestatusQuery(const std::vector<String>& lines, const String&
 	String target = line.SubStr(sp_index + 1);
 
 	m_Verb = verb;
+	m_CacheKey = verb + " " + target.Trim() + "\n";
 
 	if (m_Verb == "COMMAND") {
 		m_KeepAlive = true;
@@ -95,6 +121,10 @@ LivestatusQuery::LivestatusQuery(const std::vector<String>& lines, const String&
 		if (line.GetLength() > col_index + 1)
 			params = line.SubStr(col_index + 1).Trim();
 
+		/* Neither affects the result set itself. */
+		if (header != "KeepAlive" && header != "ResponseHeader")
+			m_CacheKey += header.Trim() + ": " + params + "\n";
+
 		if (header == "ResponseHeader")
 			m_ResponseHeader = params;
 		else if (header == "OutputFormat")
@@ -258,6 +288,16 @@ LivestatusQuery::LivestatusQuery(const std::vector<String>& lines, const String&
 	m_Aggregators.swap(aggregators);
 }
 
+/**
+ * Allows results of this query to be answered from and stored in the result cache.
+ *
+ * @param maxAge The maximum age in seconds of cached results.
+ */
+void LivestatusQuery::EnableCache(double maxAge)
+{
+	m_CacheMaxAge = maxAge;
+}
+
 int LivestatusQuery::GetExternalCommands()
 {
 	std::unique_lock<std::mutex> lock(l_QueryMutex);
@@ -440,6 +480,20 @@ void LivestatusQuery::ExecuteGetHelper(const Stream::Ptr& stream)
 	Log(LogNotice, "LivestatusQuery")
 		<< "Table: " << m_Table;
 
+	int cacheScopes = 0;
+
+	if (m_CacheMaxAge >= 0)
+		cacheScopes = LivestatusQueryCache::GetTableScopes(m_Table);
+
+	if (cacheScopes) {
+		String cachedResult;
+
+		if (LivestatusQueryCache::Get(m_CacheKey, cacheScopes, m_CacheMaxAge, &cachedResult)) {
+			SendResponse(stream, LivestatusErrorOK, cachedResult);
+			return;
+		}
+	}
+
 	Table::Ptr table = Table::GetByName(m_Table, m_CompatLogPath, m_LogTimeFrom, m_LogTimeUntil);
 
 	if (!table) {
@@ -448,74 +502,201 @@ void LivestatusQuery::ExecuteGetHelper(const Stream::Ptr& stream)
 		return;
 	}
 
-	std::vector<LivestatusRowValue> objects = table->FilterRows(m_Filter, m_Limit);
+	LivestatusCacheGeneration generation;
+
+	if (cacheScopes)
+		generation = LivestatusQueryCache::GetGeneration();
+
+	if (m_ResponseHeader == "fixed16") {
+		/* The fixed16 header contains the length of the response, so we have to
+		 * buffer the whole result set before we can send anything.
+		 */
+		std::ostringstream result;
+		WriteResultSet(table, result);
+
+		String data = result.str();
+
+		if (cacheScopes)
+			LivestatusQueryCache::Set(m_CacheKey, cacheScopes, generation, data);
+
+		SendResponse(stream, LivestatusErrorOK, data);
+	} else {
+		/* Without a length header the result set is written to the stream
+		 * through a bounded buffer while it is being produced. A copy for the
+		 * cache is only kept as long as it doesn't exceed the maximum entry size.
+		 */
+		LivestatusOutputBuffer buffer(stream, 64 * 1024, cacheScopes ? LivestatusQueryCache::GetMaxEntrySize() : 0);
+		std::ostream result(&buffer);
+		result.exceptions(std::ostream::badbit);
+
+		try {
+			WriteResultSet(table, result);
+			result.flush();
+		} catch (const std::exception&) {
+			/* Parts of the result set may have been sent already, the client
+			 * can't tell a truncated response from a complete one.
+			 */
+			if (buffer.GetBytesWritten() > 0)
+				m_KeepAlive = false;
+
+			throw;
+		}
+
+		String data;
+
+		if (cacheScopes && buffer.GetCapturedData(&data))
+			LivestatusQueryCache::Set(m_CacheKey, cacheScopes, generation, data);
+	}
+}
+
+void LivestatusQuery::WriteResultSet(const Table::Ptr& table, std::ostream& result)
+{
 	std::vector<String> columns;
 
-	if (m_Columns.size() > 0)
+	/* Stats queries are only grouped by explicitly requested columns. */
+	if (m_Columns.size() > 0 || !m_Aggregators.empty())
 		columns = m_Columns;
 	else
 		columns = table->GetColumnNames();
 
-	std::ostringstream result;
+	/* Resolve the requested columns once per query rather than once per row. */
+	std::vector<Column> column_objs;
+	column_objs.reserve(columns.size());
+
+	for (const String& columnName : columns)
+		column_objs.emplace_back(table->GetColumn(columnName));
+
 	bool first_row = true;
 	BeginResultSet(result);
 
 	if (m_Aggregators.empty()) {
-		typedef std::pair<String, Column> ColumnPair;
+		/* Rows are streamed into the result set as they are fetched, without collecting them first. */
+		table->FilterRows(m_Filter, m_Limit, [this, &columns, &column_objs, &result, &first_row](const Value& object, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject) {
+			if (m_ColumnHeaders) {
+				AppendResultRow(result, Array::FromVector(columns), first_row);
+				m_ColumnHeaders = false;
+			}
 
-		std::vector<ColumnPair> column_objs;
-		column_objs.reserve(columns.size());
+			ArrayData row;
+			row.reserve(column_objs.size());
 
-		for (const String& columnName : columns)
-			column_objs.emplace_back(columnName, table->GetColumn(columnName));
+			for (const Column& column : column_objs)
+				row.push_back(column.ExtractValue(object, groupByType, groupByObject));
 
-		ArrayData header;
+			AppendResultRow(result, new Array(std::move(row)), first_row);
 
-		for (const LivestatusRowValue& object : objects) {
-			ArrayData row;
+			return true;
+		});
+	} else {
+		for (const Aggregator::Ptr& aggregator : m_Aggregators)
+			aggregator->Compile(table);
+
+		/* Rows are aggregated while they're fetched. Large result sets are split into
+		 * batches, up to Concurrency - 1 of which are aggregated by the shared stats
+		 * queue at a time, each into its own set of states. Any other batch is
+		 * aggregated right here. The partial states are merged afterwards.
+		 */
+		StatsMap allStats;
+		std::deque<StatsMap> partialStats;
+		std::vector<LivestatusRowValue> batch;
+		size_t maxPendingBatches = Configuration::Concurrency > 1 ? Configuration::Concurrency - 1 : 0;
+
+		std::mutex pendingMutex;
+		std::condition_variable pendingCV;
+		size_t pendingBatches = 0;
+		boost::exception_ptr batchException;
+
+		auto dispatchBatch ([this, &table, &column_objs, &allStats, &partialStats, &batch, maxPendingBatches,
+			&pendingMutex, &pendingCV, &pendingBatches, &batchException]() {
+			{
+				std::unique_lock<std::mutex> lock (pendingMutex);
+
+				if (pendingBatches < maxPendingBatches) {
+					pendingBatches++;
+					lock.unlock();
+
+					/* References to deque elements stay valid while other elements are added. */
+					partialStats.emplace_back();
+					StatsMap& stats = partialStats.back();
+
+					GetStatsQueue().Enqueue([this, &table, &column_objs, &stats, &pendingMutex, &pendingCV,
+						&pendingBatches, &batchException, rows = std::move(batch)]() {
+						boost::exception_ptr exception;
+
+						try {
+							for (const LivestatusRowValue& row : rows)
+								AggregateRow(table, column_objs, row, stats);
+						} catch (...) {
+							exception = boost::current_exception();
+						}
+
+						std::unique_lock<std::mutex> lock (pendingMutex);
+
+						if (exception && !batchException)
+							batchException = exception;
+
+						pendingBatches--;
+						pendingCV.notify_all();
+					});
+
+					batch = std::vector<LivestatusRowValue>();
+					return;
+				}
+			}
 
-			row.reserve(column_objs.size());
+			for (const LivestatusRowValue& row : batch)
+				AggregateRow(table, column_objs, row, allStats);
 
-			for (const ColumnPair& cv : column_objs) {
-				if (m_ColumnHeaders)
-					header.push_back(cv.first);
+			batch.clear();
+		});
 
-				row.push_back(cv.second.ExtractValue(object.Row, object.GroupByType, object.GroupByObject));
-			}
+		/* Batches reference local state, so wait for them even if fetching rows fails.
+		 * Queries aren't executed by I/O threads (see LivestatusListener::ClientHandler()),
+		 * so this blocks a thread of the query queue at most.
+		 */
+		auto waitForBatches ([&pendingMutex, &pendingCV, &pendingBatches]() {
+			std::unique_lock<std::mutex> lock (pendingMutex);
+			pendingCV.wait(lock, [&pendingBatches]() { return pendingBatches == 0; });
+		});
 
-			if (m_ColumnHeaders) {
-				AppendResultRow(result, new Array(std::move(header)), first_row);
-				m_ColumnHeaders = false;
-			}
+		try {
+			table->FilterRows(m_Filter, m_Limit, [this, &table, &column_objs, &allStats, &batch, maxPendingBatches, &dispatchBatch](const Value& object, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject) {
+				if (maxPendingBatches == 0) {
+					AggregateRow(table, column_objs, { object, groupByType, groupByObject }, allStats);
+					return true;
+				}
 
-			AppendResultRow(result, new Array(std::move(row)), first_row);
-		}
-	} else {
-		std::map<std::vector<Value>, std::vector<AggregatorState *> > allStats;
+				batch.push_back({ object, groupByType, groupByObject });
 
-		/* add aggregated stats */
-		for (const LivestatusRowValue& object : objects) {
-			std::vector<Value> statsKey;
+				if (batch.size() >= l_StatsBatchSize)
+					dispatchBatch();
 
-			for (const String& columnName : m_Columns) {
-				Column column = table->GetColumn(columnName);
-				statsKey.emplace_back(column.ExtractValue(object.Row, object.GroupByType, object.GroupByObject));
-			}
+				return true;
+			});
 
-			auto it = allStats.find(statsKey);
+			for (const LivestatusRowValue& row : batch)
+				AggregateRow(table, column_objs, row, allStats);
+		} catch (...) {
+			waitForBatches();
+			throw;
+		}
 
-			if (it == allStats.end()) {
-				std::vector<AggregatorState *> newStats(m_Aggregators.size(), nullptr);
-				it = allStats.insert(std::make_pair(statsKey, newStats)).first;
-			}
+		waitForBatches();
 
-			auto& stats = it->second;
+		if (batchException)
+			boost::rethrow_exception(batchException);
 
-			int index = 0;
+		for (StatsMap& partial : partialStats) {
+			for (auto& kv : partial) {
+				auto it = allStats.find(kv.first);
 
-			for (const Aggregator::Ptr& aggregator : m_Aggregators) {
-				aggregator->Apply(table, object.Row, &stats[index]);
-				index++;
+				if (it == allStats.end()) {
+					allStats.insert(std::move(kv));
+					continue;
+				}
+
+				for (size_t i = 0; i < m_Aggregators.size(); i++)
+					m_Aggregators[i]->MergeState(&it->second[i], kv.second[i]);
 			}
 		}
 
@@ -566,8 +747,31 @@ void LivestatusQuery::ExecuteGetHelper(const Stream::Ptr& stream)
 	}
 
 	EndResultSet(result);
+}
+
+void LivestatusQuery::AggregateRow(const Table::Ptr& table, const std::vector<Column>& columns, const LivestatusRowValue& object, StatsMap& stats) const
+{
+	std::vector<Value> statsKey;
+	statsKey.reserve(columns.size());
+
+	for (const Column& column : columns)
+		statsKey.emplace_back(column.ExtractValue(object.Row, object.GroupByType, object.GroupByObject));
+
+	auto it = stats.find(statsKey);
+
+	if (it == stats.end()) {
+		std::vector<AggregatorState *> newStats(m_Aggregators.size(), nullptr);
+		it = stats.insert(std::make_pair(std::move(statsKey), std::move(newStats))).first;
+	}
 
-	SendResponse(stream, LivestatusErrorOK, result.str());
+	auto& states = it->second;
+
+	int index = 0;
+
+	for (const Aggregator::Ptr& aggregator : m_Aggregators) {
+		aggregator->Apply(table, object.Row, &states[index]);
+		index++;
+	}
 }
 
 void LivestatusQuery::ExecuteCommandHelper(const Stream::Ptr& stream)
@@ -581,6 +785,9 @@ void LivestatusQuery::ExecuteCommandHelper(const Stream::Ptr& stream)
 	Log(LogNotice, "LivestatusQuery")
 		<< "Executing command: " << m_Command;
 	ExternalCommandProcessor::Execute(m_Command);
+
+	/* Commands may change anything, not all of it is covered by events. */
+	LivestatusQueryCache::BumpGeneration(LivestatusCacheScopeCheckables | LivestatusCacheScopeDowntimes | LivestatusCacheScopeComments);
 	SendResponse(stream, LivestatusErrorOK, "");
 }
 
@@ -10,6 +10,8 @@
 #include "base/stream.hpp"
 #include "base/scriptframe.hpp"
 #include <deque>
+#include <map>
+#include <vector>
 
 using namespace icinga;
 
@@ -35,6 +37,8 @@ public:
 
 	bool Execute(const Stream::Ptr& stream);
 
+	void EnableCache(double maxAge);
+
 	static int GetExternalCommands();
 
 private:
@@ -56,6 +60,10 @@ private:
 
 	String m_ResponseHeader;
 
+	/* Normalised query text used as key for the result cache. */
+	String m_CacheKey;
+	double m_CacheMaxAge;
+
 	/* Parameters for COMMAND/SCRIPT queries. */
 	String m_Command;
 	String m_Session;
@@ -75,7 +83,12 @@ private:
 	void PrintPythonArray(std::ostream& fp, const Array::Ptr& array) const;
 	static String QuoteStringPython(const String& str);
 
+	typedef std::map<std::vector<Value>, std::vector<AggregatorState *> > StatsMap;
+
+	void AggregateRow(const Table::Ptr& table, const std::vector<Column>& columns, const LivestatusRowValue& object, StatsMap& stats) const;
+
 	void ExecuteGetHelper(const Stream::Ptr& stream);
+	void WriteResultSet(const Table::Ptr& table, std::ostream& fp);
 	void ExecuteCommandHelper(const Stream::Ptr& stream);
 	void ExecuteErrorHelper(const Stream::Ptr& stream);
 
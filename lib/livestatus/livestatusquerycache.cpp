@@ -0,0 +1,290 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "livestatus/livestatusquerycache.hpp"
+#include "icinga/checkable.hpp"
+#include "icinga/comment.hpp"
+#include "icinga/downtime.hpp"
+#include "icinga/notification.hpp"
+#include "base/configobject.hpp"
+#include "base/initialize.hpp"
+#include "base/utility.hpp"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+using namespace icinga;
+
+struct LivestatusCacheEntry
+{
+	String Result;
+	int Scopes;
+	LivestatusCacheGeneration Generation;
+	double Timestamp;
+};
+
+/* Upper bounds for the memory used by the results, all entries together and a single one. */
+static const size_t l_MaxCacheSize = 64 * 1024 * 1024;
+static const size_t l_MaxCacheEntrySize = 16 * 1024 * 1024;
+
+static const int l_AllCacheScopes = LivestatusCacheScopeCheckables | LivestatusCacheScopeDowntimes | LivestatusCacheScopeComments;
+
+static std::mutex l_CacheMutex;
+static std::unordered_map<String, LivestatusCacheEntry> l_Cache;
+static size_t l_CacheSize = 0;
+static std::atomic<uint_fast64_t> l_Generations[3];
+static std::atomic<uint_fast64_t> l_CacheHits (0);
+static std::atomic<uint_fast64_t> l_CacheMisses (0);
+
+INITIALIZE_ONCE(&LivestatusQueryCache::StaticInitialize);
+
+void LivestatusQueryCache::StaticInitialize()
+{
+	for (auto& generation : l_Generations)
+		generation.store(0);
+
+	Checkable::OnNewCheckResult.connect([](const Checkable::Ptr&, const CheckResult::Ptr&, const MessageOrigin::Ptr&) {
+		BumpGeneration(LivestatusCacheScopeCheckables);
+	});
+	Checkable::OnStateChange.connect([](const Checkable::Ptr&, const CheckResult::Ptr&, StateType, const MessageOrigin::Ptr&) {
+		BumpGeneration(LivestatusCacheScopeCheckables);
+	});
+	Checkable::OnAcknowledgementSet.connect([](const Checkable::Ptr&, const String&, const String&,
+		AcknowledgementType, bool, bool, double, double, const MessageOrigin::Ptr&) {
+		BumpGeneration(LivestatusCacheScopeCheckables);
+	});
+	Checkable::OnAcknowledgementCleared.connect([](const Checkable::Ptr&, const String&, double, const MessageOrigin::Ptr&) {
+		BumpGeneration(LivestatusCacheScopeCheckables);
+	});
+	Checkable::OnFlappingChange.connect([](const Checkable::Ptr&, double) {
+		BumpGeneration(LivestatusCacheScopeCheckables);
+	});
+
+	/* Downtimes and comments also show up in host and service columns. */
+	Downtime::OnDowntimeAdded.connect([](const Downtime::Ptr&) { BumpGeneration(LivestatusCacheScopeDowntimes | LivestatusCacheScopeCheckables); });
+	Downtime::OnDowntimeRemoved.connect([](const Downtime::Ptr&) { BumpGeneration(LivestatusCacheScopeDowntimes | LivestatusCacheScopeCheckables); });
+	Downtime::OnDowntimeStarted.connect([](const Downtime::Ptr&) { BumpGeneration(LivestatusCacheScopeDowntimes | LivestatusCacheScopeCheckables); });
+	Downtime::OnDowntimeTriggered.connect([](const Downtime::Ptr&) { BumpGeneration(LivestatusCacheScopeDowntimes | LivestatusCacheScopeCheckables); });
+
+	Comment::OnCommentAdded.connect([](const Comment::Ptr&) { BumpGeneration(LivestatusCacheScopeComments | LivestatusCacheScopeCheckables); });
+	Comment::OnCommentRemoved.connect([](const Comment::Ptr&) { BumpGeneration(LivestatusCacheScopeComments | LivestatusCacheScopeCheckables); });
+
+	/* Notification numbers and times are host and service columns as well. */
+	Checkable::OnNotificationSentToAllUsers.connect([](const Notification::Ptr&, const Checkable::Ptr&, const std::set<User::Ptr>&,
+		const NotificationType&, const CheckResult::Ptr&, const String&, const String&, const MessageOrigin::Ptr&) {
+		BumpGeneration(LivestatusCacheScopeCheckables);
+	});
+	Notification::OnNextNotificationChanged.connect([](const Notification::Ptr&, const MessageOrigin::Ptr&) {
+		BumpGeneration(LivestatusCacheScopeCheckables);
+	});
+
+	/* Objects which are created, activated or deleted at runtime may affect any table,
+	 * so may modified attributes (e.g. from external commands or the API).
+	 */
+	ConfigObject::OnStateChanged.connect([](const ConfigObject::Ptr&) {
+		BumpGeneration(l_AllCacheScopes);
+	});
+	ConfigObject::OnVersionChanged.connect([](const ConfigObject::Ptr&, const Value&) {
+		BumpGeneration(l_AllCacheScopes);
+	});
+	ConfigObject::OnOriginalAttributesChanged.connect([](const ConfigObject::Ptr&, const Value&) {
+		BumpGeneration(l_AllCacheScopes);
+	});
+}
+
+/**
+ * Returns the scopes the results of a table depend on.
+ *
+ * @param table The table name.
+ * @returns The scopes, or 0 if results for this table must not be cached
+ *          (e.g. because they are read from log files or depend on the current time).
+ */
+int LivestatusQueryCache::GetTableScopes(const String& table)
+{
+	if (table == "hosts" || table == "hostsbygroup" || table == "services" || table == "servicesbygroup" ||
+		table == "servicesbyhostgroup" || table == "hostgroups" || table == "servicegroups")
+		return l_AllCacheScopes;
+	else if (table == "downtimes")
+		return LivestatusCacheScopeCheckables | LivestatusCacheScopeDowntimes;
+	else if (table == "comments")
+		return LivestatusCacheScopeCheckables | LivestatusCacheScopeComments;
+	else if (table == "commands" || table == "contacts" || table == "contactgroups")
+		return LivestatusCacheScopeCheckables;
+
+	return 0;
+}
+
+LivestatusCacheGeneration LivestatusQueryCache::GetGeneration()
+{
+	LivestatusCacheGeneration generation;
+
+	for (size_t i = 0; i < generation.size(); i++)
+		generation[i] = l_Generations[i].load();
+
+	return generation;
+}
+
+static bool IsCacheEntryValid(const LivestatusCacheEntry& entry, const LivestatusCacheGeneration& generation, double maxAge, double now)
+{
+	if (entry.Timestamp + maxAge < now)
+		return false;
+
+	for (size_t i = 0; i < generation.size(); i++) {
+		if ((entry.Scopes & (1 << i)) && entry.Generation[i] != generation[i])
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Looks up a cached result.
+ *
+ * @param key The normalised query text.
+ * @param scopes The scopes the result depends on.
+ * @param maxAge The maximum age in seconds for the result to be considered.
+ * @param result Receives the cached result.
+ * @returns true if a valid result was found.
+ */
+bool LivestatusQueryCache::Get(const String& key, int scopes, double maxAge, String *result)
+{
+	LivestatusCacheGeneration generation = GetGeneration();
+	double now = Utility::GetTime();
+
+	{
+		std::unique_lock<std::mutex> lock (l_CacheMutex);
+
+		auto it = l_Cache.find(key);
+
+		if (it != l_Cache.end() && it->second.Scopes == scopes && IsCacheEntryValid(it->second, generation, maxAge, now)) {
+			*result = it->second.Result;
+			l_CacheHits.fetch_add(1);
+
+			return true;
+		}
+	}
+
+	l_CacheMisses.fetch_add(1);
+
+	return false;
+}
+
+static size_t GetCacheEntrySize(const String& key, const LivestatusCacheEntry& entry)
+{
+	return key.GetLength() + entry.Result.GetLength();
+}
+
+/**
+ * Removes entries until another size bytes fit into the cache. Invalid
+ * entries go first, then the oldest ones.
+ */
+static void MakeCacheRoom(size_t size)
+{
+	if (l_CacheSize + size <= l_MaxCacheSize)
+		return;
+
+	LivestatusCacheGeneration current = LivestatusQueryCache::GetGeneration();
+
+	for (auto it = l_Cache.begin(); it != l_Cache.end();) {
+		if (!IsCacheEntryValid(it->second, current, 0, it->second.Timestamp)) {
+			l_CacheSize -= GetCacheEntrySize(it->first, it->second);
+			it = l_Cache.erase(it);
+		} else
+			++it;
+	}
+
+	if (l_CacheSize + size <= l_MaxCacheSize)
+		return;
+
+	std::vector<decltype(l_Cache)::iterator> entries;
+	entries.reserve(l_Cache.size());
+
+	for (auto it = l_Cache.begin(); it != l_Cache.end(); ++it)
+		entries.push_back(it);
+
+	std::sort(entries.begin(), entries.end(), [](const decltype(l_Cache)::iterator& a, const decltype(l_Cache)::iterator& b) {
+		return a->second.Timestamp < b->second.Timestamp;
+	});
+
+	for (auto& it : entries) {
+		if (l_CacheSize + size <= l_MaxCacheSize)
+			break;
+
+		l_CacheSize -= GetCacheEntrySize(it->first, it->second);
+		l_Cache.erase(it);
+	}
+}
+
+/**
+ * Stores a result.
+ *
+ * @param generation The generation which was current before the result was
+ *                   computed. Changes that happened in the meantime
+ *                   therefore invalidate the entry right away.
+ */
+void LivestatusQueryCache::Set(const String& key, int scopes, const LivestatusCacheGeneration& generation, const String& result)
+{
+	if (result.GetLength() > l_MaxCacheEntrySize)
+		return;
+
+	double now = Utility::GetTime();
+
+	std::unique_lock<std::mutex> lock (l_CacheMutex);
+
+	auto it = l_Cache.find(key);
+
+	if (it != l_Cache.end()) {
+		l_CacheSize -= GetCacheEntrySize(it->first, it->second);
+		l_Cache.erase(it);
+	}
+
+	LivestatusCacheEntry entry;
+	entry.Result = result;
+	entry.Scopes = scopes;
+	entry.Generation = generation;
+	entry.Timestamp = now;
+
+	size_t size = GetCacheEntrySize(key, entry);
+
+	MakeCacheRoom(size);
+
+	l_Cache.emplace(key, std::move(entry));
+	l_CacheSize += size;
+}
+
+void LivestatusQueryCache::BumpGeneration(int scopes)
+{
+	for (size_t i = 0; i < 3; i++) {
+		if (scopes & (1 << i))
+			l_Generations[i].fetch_add(1);
+	}
+}
+
+/**
+ * Returns the size of the largest result which is cached.
+ */
+size_t LivestatusQueryCache::GetMaxEntrySize()
+{
+	return l_MaxCacheEntrySize;
+}
+
+uint_fast64_t LivestatusQueryCache::GetHits()
+{
+	return l_CacheHits.load();
+}
+
+uint_fast64_t LivestatusQueryCache::GetMisses()
+{
+	return l_CacheMisses.load();
+}
+
+/**
+ * Returns the number of bytes used by the cached results and their keys.
+ */
+size_t LivestatusQueryCache::GetSize()
+{
+	std::unique_lock<std::mutex> lock (l_CacheMutex);
+
+	return l_CacheSize;
+}
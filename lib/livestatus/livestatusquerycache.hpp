@@ -0,0 +1,69 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef LIVESTATUSQUERYCACHE_H
+#define LIVESTATUSQUERYCACHE_H
+
+#include "livestatus/i2-livestatus.hpp"
+#include "base/string.hpp"
+#include <array>
+#include <cstdint>
+
+namespace icinga
+{
+
+/**
+ * Classes of runtime changes a cached Livestatus result may depend on.
+ *
+ * @ingroup livestatus
+ */
+enum LivestatusCacheScope
+{
+	LivestatusCacheScopeCheckables = 1,
+	LivestatusCacheScopeDowntimes = 2,
+	LivestatusCacheScopeComments = 4
+};
+
+/**
+ * A snapshot of the generation counters, one per cache scope.
+ *
+ * @ingroup livestatus
+ */
+typedef std::array<uint_fast64_t, 3> LivestatusCacheGeneration;
+
+/**
+ * Cache for the results of Livestatus GET queries.
+ *
+ * Results are keyed by the normalised query text. Every scope has a
+ * generation counter which is bumped whenever an event affecting the scope
+ * occurs; a cached result is only used as long as the generations of all
+ * scopes its table depends on haven't changed. The memory used by the
+ * results is bounded in bytes, the oldest entries are evicted first.
+ *
+ * @ingroup livestatus
+ */
+class LivestatusQueryCache
+{
+public:
+	static void StaticInitialize();
+
+	static int GetTableScopes(const String& table);
+	static LivestatusCacheGeneration GetGeneration();
+
+	static bool Get(const String& key, int scopes, double maxAge, String *result);
+	static void Set(const String& key, int scopes, const LivestatusCacheGeneration& generation, const String& result);
+
+	static void BumpGeneration(int scopes);
+
+	static size_t GetMaxEntrySize();
+
+	static uint_fast64_t GetHits();
+	static uint_fast64_t GetMisses();
+	static size_t GetSize();
+
+private:
+	LivestatusQueryCache();
+};
+
+}
+
+#endif /* LIVESTATUSQUERYCACHE_H */
@@ -36,3 +36,17 @@ double MaxAggregator::GetResultAndFreeState(AggregatorState *state) const
 
 	return result;
 }
+
+void MaxAggregator::MergeState(AggregatorState **target, AggregatorState *source) const
+{
+	if (!source)
+		return;
+
+	MaxAggregatorState *ptarget = EnsureState(target);
+	MaxAggregatorState *psource = static_cast<MaxAggregatorState *>(source);
+
+	if (psource->Max > ptarget->Max)
+		ptarget->Max = psource->Max;
+
+	delete psource;
+}
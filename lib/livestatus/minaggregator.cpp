@@ -43,3 +43,17 @@ double MinAggregator::GetResultAndFreeState(AggregatorState *state) const
 
 	return result;
 }
+
+void MinAggregator::MergeState(AggregatorState **target, AggregatorState *source) const
+{
+	if (!source)
+		return;
+
+	MinAggregatorState *ptarget = EnsureState(target);
+	MinAggregatorState *psource = static_cast<MinAggregatorState *>(source);
+
+	if (psource->Min < ptarget->Min)
+		ptarget->Min = psource->Min;
+
+	delete psource;
+}
@@ -8,6 +8,11 @@ NegateFilter::NegateFilter(Filter::Ptr inner)
 	: m_Inner(std::move(inner))
 { }
 
+void NegateFilter::Compile(const Table::Ptr& table)
+{
+	m_Inner->Compile(table);
+}
+
 bool NegateFilter::Apply(const Table::Ptr& table, const Value& row)
 {
 	return !m_Inner->Apply(table, row);
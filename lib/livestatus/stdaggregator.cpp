@@ -38,3 +38,18 @@ double StdAggregator::GetResultAndFreeState(AggregatorState *state) const
 
 	return result;
 }
+
+void StdAggregator::MergeState(AggregatorState **target, AggregatorState *source) const
+{
+	if (!source)
+		return;
+
+	StdAggregatorState *ptarget = EnsureState(target);
+	StdAggregatorState *psource = static_cast<StdAggregatorState *>(source);
+
+	ptarget->StdSum += psource->StdSum;
+	ptarget->StdQSum += psource->StdQSum;
+	ptarget->StdCount += psource->StdCount;
+
+	delete psource;
+}
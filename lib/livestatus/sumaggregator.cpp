@@ -35,3 +35,16 @@ double SumAggregator::GetResultAndFreeState(AggregatorState *state) const
 
 	return result;
 }
+
+void SumAggregator::MergeState(AggregatorState **target, AggregatorState *source) const
+{
+	if (!source)
+		return;
+
+	SumAggregatorState *ptarget = EnsureState(target);
+	SumAggregatorState *psource = static_cast<SumAggregatorState *>(source);
+
+	ptarget->Sum += psource->Sum;
+
+	delete psource;
+}
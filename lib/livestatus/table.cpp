@@ -110,28 +110,51 @@ std::vector<LivestatusRowValue> Table::FilterRows(const Filter::Ptr& filter, int
 {
 	std::vector<LivestatusRowValue> rs;
 
-	FetchRows([this, filter, limit, &rs](const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject) {
-		return FilteredAddRow(rs, filter, limit, row, groupByType, groupByObject);
+	FilterRows(filter, limit, [&rs](const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject) {
+		LivestatusRowValue rval;
+		rval.Row = row;
+		rval.GroupByType = groupByType;
+		rval.GroupByObject = groupByObject;
+
+		rs.emplace_back(std::move(rval));
+
+		return true;
 	});
 
 	return rs;
 }
 
-bool Table::FilteredAddRow(std::vector<LivestatusRowValue>& rs, const Filter::Ptr& filter, int limit, const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject)
+/**
+ * Streams all rows matching the filter to the specified callback instead of
+ * collecting them. Fetching stops once the limit is reached or the callback
+ * returns false.
+ *
+ * @param filter The filter, may be null.
+ * @param limit The maximum number of matching rows, negative for no limit.
+ * @param resultFn The callback which is invoked for every matching row.
+ */
+void Table::FilterRows(const Filter::Ptr& filter, int limit, const AddRowFunction& resultFn)
 {
-	if (limit != -1 && static_cast<int>(rs.size()) == limit)
-		return false;
+	if (limit == 0)
+		return;
 
-	if (!filter || filter->Apply(this, row)) {
-		LivestatusRowValue rval;
-		rval.Row = row;
-		rval.GroupByType = groupByType;
-		rval.GroupByObject = groupByObject;
+	if (filter)
+		filter->Compile(this);
 
-		rs.emplace_back(std::move(rval));
-	}
+	int matched = 0;
 
-	return true;
+	FetchRows([this, &filter, limit, &resultFn, &matched](const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject) {
+		if (filter && !filter->Apply(this, row))
+			return true;
+
+		matched++;
+
+		if (!resultFn(row, groupByType, groupByObject))
+			return false;
+
+		/* Stop fetching as soon as the limit is reached. */
+		return limit < 0 || matched < limit;
+	});
 }
 
 Value Table::ZeroAccessor(const Value&)
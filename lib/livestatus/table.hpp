@@ -39,6 +39,7 @@ public:
 	virtual String GetPrefix() const = 0;
 
 	std::vector<LivestatusRowValue> FilterRows(const intrusive_ptr<Filter>& filter, int limit = -1);
+	void FilterRows(const intrusive_ptr<Filter>& filter, int limit, const AddRowFunction& resultFn);
 
 	void AddColumn(const String& name, const Column& column);
 	Column GetColumn(const String& name) const;
@@ -62,8 +63,6 @@ protected:
 
 private:
 	std::map<String, Column> m_Columns;
-
-	bool FilteredAddRow(std::vector<LivestatusRowValue>& rs, const intrusive_ptr<Filter>& filter, int limit, const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject);
 };
 
 }
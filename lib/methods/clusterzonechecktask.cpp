@@ -137,6 +137,8 @@ void ClusterZoneCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const Che
 	double messagesReceivedPerSecond = 0;
 	double bytesSentPerSecond = 0;
 	double bytesReceivedPerSecond = 0;
+	double uncompressedBytesSentPerSecond = 0;
+	double uncompressedBytesReceivedPerSecond = 0;
 
 	{
 		auto endpoints (zone->GetEndpoints());
@@ -160,6 +162,8 @@ void ClusterZoneCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const Che
 			messagesReceivedPerSecond += endpoint->GetMessagesReceivedPerSecond();
 			bytesSentPerSecond += endpoint->GetBytesSentPerSecond();
 			bytesReceivedPerSecond += endpoint->GetBytesReceivedPerSecond();
+			uncompressedBytesSentPerSecond += endpoint->GetUncompressedBytesSentPerSecond();
+			uncompressedBytesReceivedPerSecond += endpoint->GetUncompressedBytesReceivedPerSecond();
 		}
 
 		if (!connected && endpoints.size() == 1u && *endpoints.begin() == Endpoint::GetLocalEndpoint()) {
@@ -210,7 +214,9 @@ void ClusterZoneCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const Che
 			new PerfdataValue("sum_messages_sent_per_second", messagesSentPerSecond),
 			new PerfdataValue("sum_messages_received_per_second", messagesReceivedPerSecond),
 			new PerfdataValue("sum_bytes_sent_per_second", bytesSentPerSecond),
-			new PerfdataValue("sum_bytes_received_per_second", bytesReceivedPerSecond)
+			new PerfdataValue("sum_bytes_received_per_second", bytesReceivedPerSecond),
+			new PerfdataValue("sum_uncompressed_bytes_sent_per_second", uncompressedBytesSentPerSecond),
+			new PerfdataValue("sum_uncompressed_bytes_received_per_second", uncompressedBytesReceivedPerSecond)
 		}));
 
 		checkable->ProcessCheckResult(cr);
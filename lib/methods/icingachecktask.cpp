@@ -80,6 +80,8 @@ void IcingaCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const CheckRes
 	perfdata->Add(new PerfdataValue("current_pending_callbacks", Application::GetTP().GetPending()));
 	perfdata->Add(new PerfdataValue("current_concurrent_checks", Checkable::CurrentConcurrentChecks.load()));
 	perfdata->Add(new PerfdataValue("remote_check_queue", ClusterEvents::GetCheckRequestQueueSize()));
+	perfdata->Add(new PerfdataValue("last_state_dump_duration", ConfigObject::GetLastDumpDuration(), false, "seconds"));
+	perfdata->Add(new PerfdataValue("last_state_dump_objects", ConfigObject::GetLastDumpObjects()));
 
 	CheckableCheckStatistics scs = CIB::CalculateServiceCheckStats();
 
@@ -127,6 +129,8 @@ void IcingaCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const CheckRes
 	double messagesReceivedPerSecond = 0;
 	double bytesSentPerSecond = 0;
 	double bytesReceivedPerSecond = 0;
+	double uncompressedBytesSentPerSecond = 0;
+	double uncompressedBytesReceivedPerSecond = 0;
 
 	for (const Endpoint::Ptr& endpoint : endpoints)
 	{
@@ -140,6 +144,8 @@ void IcingaCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const CheckRes
 		messagesReceivedPerSecond += endpoint->GetMessagesReceivedPerSecond();
 		bytesSentPerSecond += endpoint->GetBytesSentPerSecond();
 		bytesReceivedPerSecond += endpoint->GetBytesReceivedPerSecond();
+		uncompressedBytesSentPerSecond += endpoint->GetUncompressedBytesSentPerSecond();
+		uncompressedBytesReceivedPerSecond += endpoint->GetUncompressedBytesReceivedPerSecond();
 	}
 
 	perfdata->Add(new PerfdataValue("last_messages_sent", lastMessageSent));
@@ -148,6 +154,8 @@ void IcingaCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const CheckRes
 	perfdata->Add(new PerfdataValue("sum_messages_received_per_second", messagesReceivedPerSecond));
 	perfdata->Add(new PerfdataValue("sum_bytes_sent_per_second", bytesSentPerSecond));
 	perfdata->Add(new PerfdataValue("sum_bytes_received_per_second", bytesReceivedPerSecond));
+	perfdata->Add(new PerfdataValue("sum_uncompressed_bytes_sent_per_second", uncompressedBytesSentPerSecond));
+	perfdata->Add(new PerfdataValue("sum_uncompressed_bytes_received_per_second", uncompressedBytesReceivedPerSecond));
 
 	cr->SetPerformanceData(perfdata);
 	ServiceState state = ServiceOK;
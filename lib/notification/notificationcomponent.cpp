@@ -153,6 +153,7 @@ void NotificationComponent::NotificationTimerHandler()
 						<< "Notification '" << notificationName << "': HA cluster active, this endpoint does not have the authority. Dropping all stashed notifications.";
 
 					stashedNotifications->Clear();
+					notification->MarkStateChanged();
 				}
 			}
 
@@ -182,6 +183,9 @@ void NotificationComponent::NotificationTimerHandler()
 					stashedNotifications->Clear();
 				}
 
+				if (unstashedNotifications->GetLength())
+					notification->MarkStateChanged();
+
 				ObjectLock olock(unstashedNotifications);
 
 				for (Dictionary::Ptr unstashedNotification : unstashedNotifications) {
@@ -8,6 +8,7 @@
 #include "remote/apifunction.hpp"
 #include "remote/configpackageutility.hpp"
 #include "remote/configobjectutility.hpp"
+#include "remote/replaylog.hpp"
 #include "base/atomic-file.hpp"
 #include "base/convert.hpp"
 #include "base/defer.hpp"
@@ -37,6 +38,7 @@
 #include <climits>
 #include <cstdint>
 #include <fstream>
+#include <map>
 #include <memory>
 #include <openssl/ssl.h>
 #include <openssl/tls1.h>
@@ -266,7 +268,7 @@ void ApiListener::Start(bool runtimeCreated)
 	ObjectImpl<ApiListener>::Start(runtimeCreated);
 
 	{
-		std::unique_lock<std::mutex> lock(m_LogLock);
+		std::unique_lock<std::shared_timed_mutex> lock(m_LogLock);
 		OpenLogFile();
 	}
 
@@ -374,8 +376,8 @@ void ApiListener::Stop(bool runtimeDeleted)
 		<< "'" << GetName() << "' stopped.";
 
 	{
-		std::unique_lock<std::mutex> lock(m_LogLock);
-		CloseLogFile();
+		std::unique_lock<std::shared_timed_mutex> lock(m_LogLock);
+		CloseLogFile(true);
 		RotateLogFile();
 	}
 
@@ -645,6 +647,10 @@ static const auto l_AppVersionInt (([]() -> unsigned long {
 
 static const auto l_MyCapabilities (
 	(uint_fast64_t)ApiCapabilities::ExecuteArbitraryCommand | (uint_fast64_t)ApiCapabilities::IfwApiCheckCommand
+		| (uint_fast64_t)ApiCapabilities::CborMessages
+#ifdef HAVE_ZLIB
+		| (uint_fast64_t)ApiCapabilities::CompressedMessages
+#endif /* HAVE_ZLIB */
 );
 
 /**
@@ -1144,32 +1150,50 @@ void ApiListener::RelayMessage(const MessageOrigin::Ptr& origin,
 	m_RelayQueue.Enqueue([this, origin, secobj, message, log]() { SyncRelayMessage(origin, secobj, message, log); }, PriorityNormal, true);
 }
 
-void ApiListener::PersistMessage(const Dictionary::Ptr& message, const ConfigObject::Ptr& secobj)
+/**
+ * Writes a message to the replay log.
+ *
+ * @param message The message.
+ * @param encodedMessage The JSON-encoded message as it was already sent to other endpoints.
+ * @param secobj The object the message is about, used for filtering on replay.
+ */
+void ApiListener::PersistMessage(const Dictionary::Ptr& message, const String& encodedMessage, const ConfigObject::Ptr& secobj)
 {
 	double ts = message->Get("ts");
 
 	ASSERT(ts != 0);
 
-	Dictionary::Ptr pmessage = new Dictionary();
-	pmessage->Set("timestamp", ts);
-
-	pmessage->Set("message", JsonEncode(message));
+	ReplayLogRecord record;
+	record.Timestamp = ts;
+	record.Message = encodedMessage;
 
 	if (secobj) {
-		Dictionary::Ptr secname = new Dictionary();
-		secname->Set("type", secobj->GetReflectionType()->GetName());
-		secname->Set("name", secobj->GetName());
-		pmessage->Set("secobj", secname);
+		record.SecobjType = secobj->GetReflectionType()->GetName();
+		record.SecobjName = secobj->GetName();
+
+		/* Same as Zone#CanAccessObject(), so that the replay can decide by the zone alone. */
+		Zone::Ptr zone;
+
+		if (secobj->GetReflectionType() == Zone::TypeInstance)
+			zone = static_pointer_cast<Zone>(secobj);
+		else
+			zone = static_pointer_cast<Zone>(secobj->GetZone());
+
+		if (!zone)
+			zone = Zone::GetLocalZone();
+
+		if (zone)
+			record.Zone = zone->GetName();
 	}
 
-	std::unique_lock<std::mutex> lock(m_LogLock);
+	std::unique_lock<std::shared_timed_mutex> lock(m_LogLock);
 	if (m_LogFile) {
-		NetString::WriteStringToStream(m_LogFile, JsonEncode(pmessage));
+		m_LogFile->Write(record);
 		m_LogMessageCount++;
 		SetLogMessageTimestamp(ts);
 
 		if (m_LogMessageCount > 50000) {
-			CloseLogFile();
+			CloseLogFile(true);
 			RotateLogFile();
 			OpenLogFile();
 		}
@@ -1177,12 +1201,26 @@ void ApiListener::PersistMessage(const Dictionary::Ptr& message, const ConfigObj
 }
 
 void ApiListener::SyncSendMessage(const Endpoint::Ptr& endpoint, const Dictionary::Ptr& message)
+{
+	JsonRpcMessageEncodings encodings (message);
+
+	SyncSendMessage(endpoint, encodings);
+}
+
+/**
+ * Sends a message to the newest connection of an endpoint.
+ *
+ * @param endpoint The endpoint.
+ * @param message The message, encoded at most once per wire encoding
+ *                and shared between all recipients.
+ */
+void ApiListener::SyncSendMessage(const Endpoint::Ptr& endpoint, JsonRpcMessageEncodings& message)
 {
 	ObjectLock olock(endpoint);
 
 	if (!endpoint->GetSyncing()) {
 		Log(LogNotice, "ApiListener")
-			<< "Sending message '" << message->Get("method") << "' to '" << endpoint->GetName() << "'";
+			<< "Sending message '" << message.GetMessage()->Get("method") << "' to '" << endpoint->GetName() << "'";
 
 		double maxTs = 0;
 
@@ -1195,7 +1233,7 @@ void ApiListener::SyncSendMessage(const Endpoint::Ptr& endpoint, const Dictionar
 			if (client->GetTimestamp() != maxTs)
 				continue;
 
-			client->SendMessage(message);
+			client->SendRawMessage(message.Get(client->GetEncoding()));
 		}
 	}
 }
@@ -1206,12 +1244,12 @@ void ApiListener::SyncSendMessage(const Endpoint::Ptr& endpoint, const Dictionar
  *
  * @param targetZone The zone to relay to
  * @param origin Information about where this message is relayed from (if it was not generated locally)
- * @param message The message to relay
+ * @param message The message to relay, its encodings are shared by all endpoints it's relayed to
  * @param currentZoneMaster The current master node of the local zone
  * @return true if the message has been relayed to all relevant endpoints,
  *         false if it hasn't and must be persisted in the replay log
  */
-bool ApiListener::RelayMessageOne(const Zone::Ptr& targetZone, const MessageOrigin::Ptr& origin, const Dictionary::Ptr& message, const Endpoint::Ptr& currentZoneMaster)
+bool ApiListener::RelayMessageOne(const Zone::Ptr& targetZone, const MessageOrigin::Ptr& origin, JsonRpcMessageEncodings& message, const Endpoint::Ptr& currentZoneMaster)
 {
 	ASSERT(targetZone);
 
@@ -1314,7 +1352,7 @@ bool ApiListener::RelayMessageOne(const Zone::Ptr& targetZone, const MessageOrig
 	}
 
 	if (!skippedEndpoints.empty()) {
-		double ts = message->Get("ts");
+		double ts = message.GetMessage()->Get("ts");
 
 		for (const Endpoint::Ptr& skippedEndpoint : skippedEndpoints)
 			skippedEndpoint->SetLocalLogPosition(ts);
@@ -1349,47 +1387,62 @@ void ApiListener::SyncRelayMessage(const MessageOrigin::Ptr& origin,
 
 	Endpoint::Ptr master = GetMaster();
 
-	bool need_log = !RelayMessageOne(target_zone, origin, message, master);
+	/* The message isn't modified anymore from here on, so it's encoded only once
+	 * per wire encoding and the same buffer is queued for all connections.
+	 * The replay log shares the JSON one.
+	 */
+	JsonRpcMessageEncodings encodings (message);
+
+	bool need_log = !RelayMessageOne(target_zone, origin, encodings, master);
 
 	for (const Zone::Ptr& zone : target_zone->GetAllParentsRaw()) {
-		if (!RelayMessageOne(zone, origin, message, master))
+		if (!RelayMessageOne(zone, origin, encodings, master))
 			need_log = true;
 	}
 
 	if (log && need_log)
-		PersistMessage(message, secobj);
+		PersistMessage(message, *encodings.Get(JsonRpcEncoding::Json), secobj);
 }
 
-/* must hold m_LogLock */
+/* must hold m_LogLock exclusively */
 void ApiListener::OpenLogFile()
 {
 	String path = GetApiDir() + "log/current";
 
 	Utility::MkDirP(Utility::DirName(path), 0750);
 
-	std::unique_ptr<std::fstream> fp = std::make_unique<std::fstream>(path.CStr(), std::fstream::out | std::ofstream::app);
+	/* Log files written by older versions are rotated as they are, new records go into a new segment. */
+	if (Utility::PathExists(path) && ReplayLogReader(path).IsLegacy())
+		RotateLogFile();
 
-	if (!fp->good()) {
+	try {
+		m_LogFile = std::make_unique<ReplayLogWriter>(path);
+	} catch (const std::exception& ex) {
 		Log(LogWarning, "ApiListener")
-			<< "Could not open spool file: " << path;
+			<< "Could not open spool file: " << path << ": " << DiagnosticInformation(ex, false);
 		return;
 	}
 
-	m_LogFile = new StdioStream(fp.release(), true);
 	SetLogMessageTimestamp(Utility::GetTime());
 }
 
-/* must hold m_LogLock */
-void ApiListener::CloseLogFile()
+/**
+ * Closes the current log file.
+ *
+ * Must hold m_LogLock exclusively.
+ *
+ * @param finish Whether the log file is going to be rotated, i.e. won't be written to anymore
+ */
+void ApiListener::CloseLogFile(bool finish)
 {
 	if (!m_LogFile)
 		return;
 
-	m_LogFile->Close();
+	m_LogFile->Close(finish);
 	m_LogFile.reset();
 }
 
-/* must hold m_LogLock */
+/* must hold m_LogLock exclusively */
 void ApiListener::RotateLogFile()
 {
 	double ts = GetLogMessageTimestamp();
@@ -1462,110 +1515,141 @@ void ApiListener::ReplayLog(const JsonRpcConnection::Ptr& client)
 		return;
 	}
 
-	for (;;) {
-		std::unique_lock<std::mutex> lock(m_LogLock);
-
-		CloseLogFile();
-
-		if (count == -1 || count > 50000) {
-			OpenLogFile();
-			lock.unlock();
-		} else {
-			last_sync = true;
-		}
-
-		count = 0;
+	/* Whether target_zone may see messages about objects in a zone, by zone name */
+	std::map<String, bool> zoneAccess;
 
+	auto getRotatedFiles ([this, &peer_ts]() {
 		std::vector<int> files;
 		Utility::Glob(GetApiDir() + "log/*", [&files](const String& file) { LogGlobHandler(files, file); }, GlobFile);
 		std::sort(files.begin(), files.end());
 
-		std::vector<std::pair<int, String>> allFiles;
+		std::vector<std::pair<int, String>> rotatedFiles;
 
 		for (int ts : files) {
 			if (ts >= peer_ts) {
-				allFiles.emplace_back(ts, GetApiDir() + "log/" + Convert::ToString(ts));
+				rotatedFiles.emplace_back(ts, GetApiDir() + "log/" + Convert::ToString(ts));
 			}
 		}
 
-		allFiles.emplace_back(Utility::GetTime() + 1, GetApiDir() + "log/current");
+		return rotatedFiles;
+	});
 
-		for (auto& file : allFiles) {
-			Log(LogNotice, "ApiListener")
-				<< "Replaying log: " << file.second;
+	auto replayFile ([&](int fileTs, const String& path, ReplayLogReader& reader) {
+		Log(LogNotice, "ApiListener")
+			<< "Replaying log: " << path;
+
+		ReplayLogRecord record;
 
-			auto *fp = new std::fstream(file.second.CStr(), std::fstream::in | std::fstream::binary);
-			StdioStream::Ptr logStream = new StdioStream(fp, true);
+		for (;;) {
+			try {
+				/* Records the peer already has are skipped without being read entirely. */
+				if (!reader.Next(record, peer_ts))
+					break;
+			} catch (const std::exception&) {
+				Log(LogWarning, "ApiListener")
+					<< "Unexpected end-of-file for cluster log: " << path;
 
-			String message;
-			StreamReadContext src;
-			while (true) {
-				Dictionary::Ptr pmessage;
+				/* Log files may be incomplete or corrupted. This is perfectly OK. */
+				break;
+			}
 
-				try {
-					StreamReadStatus srs = NetString::ReadStringFromStream(logStream, &message, src);
+			if (!record.SecobjType.IsEmpty()) {
+				ConfigObject::Ptr secobj = ConfigObject::GetObject(record.SecobjType, record.SecobjName);
 
-					if (srs == StatusEof)
-						break;
+				if (!secobj)
+					continue;
 
-					if (srs != StatusNewItem)
+				if (record.Zone.IsEmpty()) {
+					if (!target_zone->CanAccessObject(secobj))
 						continue;
+				} else {
+					auto access (zoneAccess.find(record.Zone));
 
-					pmessage = JsonDecode(message);
-				} catch (const std::exception&) {
-					Log(LogWarning, "ApiListener")
-						<< "Unexpected end-of-file for cluster log: " << file.second;
+					if (access == zoneAccess.end()) {
+						Zone::Ptr zone = Zone::GetByName(record.Zone);
+						access = zoneAccess.emplace(record.Zone, zone && (zone->GetGlobal() || zone->IsChildOf(target_zone))).first;
+					}
 
-					/* Log files may be incomplete or corrupted. This is perfectly OK. */
-					break;
+					if (!access->second)
+						continue;
 				}
+			}
 
-				if (pmessage->Get("timestamp") <= peer_ts)
-					continue;
+			try  {
+				client->SendRawMessage(record.Message);
+				count++;
+			} catch (const std::exception& ex) {
+				Log(LogWarning, "ApiListener")
+					<< "Error while replaying log for endpoint '" << endpoint->GetName() << "': " << DiagnosticInformation(ex, false);
 
-				Dictionary::Ptr secname = pmessage->Get("secobj");
+				Log(LogDebug, "ApiListener")
+					<< "Error while replaying log for endpoint '" << endpoint->GetName() << "': " << DiagnosticInformation(ex);
 
-				if (secname) {
-					ConfigObject::Ptr secobj = ConfigObject::GetObject(secname->Get("type"), secname->Get("name"));
+				break;
+			}
 
-					if (!secobj)
-						continue;
+			peer_ts = record.Timestamp;
 
-					if (!target_zone->CanAccessObject(secobj))
-						continue;
-				}
+			if (fileTs > logpos_ts + 10) {
+				logpos_ts = fileTs;
 
-				try  {
-					client->SendRawMessage(pmessage->Get("message"));
-					count++;
-				} catch (const std::exception& ex) {
-					Log(LogWarning, "ApiListener")
-						<< "Error while replaying log for endpoint '" << endpoint->GetName() << "': " << DiagnosticInformation(ex, false);
+				Dictionary::Ptr lmessage = new Dictionary({
+					{ "jsonrpc", "2.0" },
+					{ "method", "log::SetLogPosition" },
+					{ "params", new Dictionary({
+						{ "log_position", logpos_ts }
+					}) }
+				});
 
-					Log(LogDebug, "ApiListener")
-						<< "Error while replaying log for endpoint '" << endpoint->GetName() << "': " << DiagnosticInformation(ex);
+				client->SendMessage(lmessage);
+			}
+		}
+	});
 
-					break;
-				}
+	for (;;) {
+		if (count != -1 && count <= 50000)
+			last_sync = true;
 
-				peer_ts = pmessage->Get("timestamp");
+		count = 0;
 
-				if (file.first > logpos_ts + 10) {
-					logpos_ts = file.first;
+		/* Rotated log files aren't written to anymore. They're replayed without holding m_LogLock,
+		 * so that messages can be persisted and other endpoints can be replayed meanwhile.
+		 */
+		for (auto& file : getRotatedFiles()) {
+			ReplayLogReader reader (file.second);
+			replayFile(file.first, file.second, reader);
+		}
 
-					Dictionary::Ptr lmessage = new Dictionary({
-						{ "jsonrpc", "2.0" },
-						{ "method", "log::SetLogPosition" },
-						{ "params", new Dictionary({
-							{ "log_position", logpos_ts }
-						}) }
-					});
+		/* Only the current log file is guarded. PersistMessage() writes to it while holding m_LogLock
+		 * exclusively, so any number of endpoints may replay it concurrently while holding m_LogLock shared.
+		 * The last pass holds the lock until the endpoint doesn't sync anymore, so that no message is missed.
+		 */
+		std::shared_lock<std::shared_timed_mutex> lock (m_LogLock);
 
-					client->SendMessage(lmessage);
-				}
-			}
+		/* Log files rotated since the above glob, already replayed ones are skipped by their index */
+		std::vector<std::pair<int, String>> tailFiles (getRotatedFiles());
+		std::vector<std::unique_ptr<ReplayLogReader>> tailReaders;
 
-			logStream->Close();
+		for (auto& file : tailFiles) {
+			tailReaders.emplace_back(std::make_unique<ReplayLogReader>(file.second));
+		}
+
+		tailFiles.emplace_back(Utility::GetTime() + 1, GetApiDir() + "log/current");
+
+		if (m_LogFile) {
+			/* PersistMessage() can't write meanwhile, so all records up to this offset are complete. */
+			m_LogFile->Flush();
+			tailReaders.emplace_back(std::make_unique<ReplayLogReader>(tailFiles.back().second, m_LogFile->GetIndex(), m_LogFile->GetOffset()));
+		} else {
+			tailReaders.emplace_back(std::make_unique<ReplayLogReader>(tailFiles.back().second));
+		}
+
+		/* All of the files have been opened, so they're read consistently even if the log is rotated now. */
+		if (!last_sync)
+			lock.unlock();
+
+		for (decltype(tailFiles.size()) i = 0; i < tailFiles.size(); i++) {
+			replayFile(tailFiles[i].first, tailFiles[i].second, *tailReaders[i]);
 		}
 
 		if (count > 0) {
@@ -1583,8 +1667,6 @@ void ApiListener::ReplayLog(const JsonRpcConnection::Ptr& client)
 				endpoint->SetSyncing(false);
 			}
 
-			OpenLogFile();
-
 			break;
 		}
 	}
@@ -1798,6 +1880,25 @@ Value ApiListener::HelloAPIHandler(const MessageOrigin::Ptr& origin, const Dicti
 				endpoint->SetIcingaVersion(nodeVersion);
 				endpoint->SetCapabilities((double)params->Get("capabilities"));
 
+				ApiListener::Ptr listener = ApiListener::GetInstance();
+
+				/* We always announce CBOR support, so the peer may switch to it as soon as it
+				 * gets our hello. Its own hello precedes any CBOR message it sends.
+				 */
+				if (endpoint->GetCapabilities() & (uint_fast64_t)ApiCapabilities::CborMessages) {
+					client->AcceptCbor();
+
+					if (listener && listener->GetEnableBinaryMessages()) {
+						client->SetEncoding(JsonRpcEncoding::Cbor);
+					}
+				}
+
+				/* Same for compression, each direction is compressed independently. */
+				if (listener && listener->GetCompressionLevel() > 0
+					&& (endpoint->GetCapabilities() & (uint_fast64_t)ApiCapabilities::CompressedMessages)) {
+					client->EnableCompression(listener->GetCompressionLevel());
+				}
+
 				if (nodeVersion == 0u) {
 					nodeVersion = 21200;
 				}
@@ -1928,6 +2029,19 @@ void ApiListener::ValidateTlsHandshakeTimeout(const Lazy<double>& lvalue, const
 		BOOST_THROW_EXCEPTION(ValidationError(this, { "tls_handshake_timeout" }, "Value must be greater than 0."));
 }
 
+void ApiListener::ValidateCompressionLevel(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<ApiListener>::ValidateCompressionLevel(lvalue, utils);
+
+	if (lvalue() < 0 || lvalue() > 9)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "compression_level" }, "Value must be between 0 and 9."));
+
+#ifndef HAVE_ZLIB
+	if (lvalue() > 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "compression_level" }, "Icinga 2 was built without zlib, compression isn't available."));
+#endif /* HAVE_ZLIB */
+}
+
 bool ApiListener::IsHACluster()
 {
 	Zone::Ptr zone = Zone::GetLocalZone();
@@ -4,10 +4,12 @@
 #define APILISTENER_H
 
 #include "remote/apilistener-ti.hpp"
+#include "remote/jsonrpc.hpp"
 #include "remote/jsonrpcconnection.hpp"
 #include "remote/httpserverconnection.hpp"
 #include "remote/endpoint.hpp"
 #include "remote/messageorigin.hpp"
+#include "remote/replaylog.hpp"
 #include "base/configobject.hpp"
 #include "base/process.hpp"
 #include "base/shared.hpp"
@@ -23,8 +25,10 @@
 #include <boost/asio/ssl/context.hpp>
 #include <boost/thread/shared_mutex.hpp>
 #include <cstdint>
+#include <memory>
 #include <mutex>
 #include <set>
+#include <shared_mutex>
 
 namespace icinga
 {
@@ -69,6 +73,8 @@ enum class ApiCapabilities : uint_fast64_t
 {
 	ExecuteArbitraryCommand = 1u << 0u,
 	IfwApiCheckCommand = 1u << 1u,
+	CborMessages = 1u << 2u,
+	CompressedMessages = 1u << 3u,
 };
 
 /**
@@ -159,6 +165,7 @@ protected:
 
 	void ValidateTlsProtocolmin(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
 	void ValidateTlsHandshakeTimeout(const Lazy<double>& lvalue, const ValidationUtils& utils) override;
+	void ValidateCompressionLevel(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
 
 private:
 	Shared<boost::asio::ssl::context>::Ptr m_SSLContext;
@@ -202,17 +209,18 @@ private:
 	WorkQueue m_RelayQueue;
 	WorkQueue m_SyncQueue{0, 4};
 
-	std::mutex m_LogLock;
-	Stream::Ptr m_LogFile;
+	std::shared_timed_mutex m_LogLock;
+	std::unique_ptr<ReplayLogWriter> m_LogFile;
 	size_t m_LogMessageCount{0};
 
-	bool RelayMessageOne(const Zone::Ptr& zone, const MessageOrigin::Ptr& origin, const Dictionary::Ptr& message, const Endpoint::Ptr& currentZoneMaster);
+	void SyncSendMessage(const Endpoint::Ptr& endpoint, JsonRpcMessageEncodings& message);
+	bool RelayMessageOne(const Zone::Ptr& zone, const MessageOrigin::Ptr& origin, JsonRpcMessageEncodings& message, const Endpoint::Ptr& currentZoneMaster);
 	void SyncRelayMessage(const MessageOrigin::Ptr& origin, const ConfigObject::Ptr& secobj, const Dictionary::Ptr& message, bool log);
-	void PersistMessage(const Dictionary::Ptr& message, const ConfigObject::Ptr& secobj);
+	void PersistMessage(const Dictionary::Ptr& message, const String& encodedMessage, const ConfigObject::Ptr& secobj);
 
 	void OpenLogFile();
 	void RotateLogFile();
-	void CloseLogFile();
+	void CloseLogFile(bool finish = false);
 	static void LogGlobHandler(std::vector<int>& files, const String& file);
 	void ReplayLog(const JsonRpcConnection::Ptr& client);
 
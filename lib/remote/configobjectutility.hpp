@@ -36,10 +36,12 @@ public:
 	static bool DeleteObject(const ConfigObject::Ptr& object, bool cascade, const Array::Ptr& errors,
 		const Array::Ptr& diagnosticInformation, const Value& cookie = Empty);
 
-private:
-	static String EscapeName(const String& name);
+	/* Same as DeleteObject(), but for objects of any package. */
 	static bool DeleteObjectHelper(const ConfigObject::Ptr& object, bool cascade, const Array::Ptr& errors,
 		const Array::Ptr& diagnosticInformation, const Value& cookie = Empty);
+
+private:
+	static String EscapeName(const String& name);
 };
 
 }
@@ -101,19 +101,33 @@ Endpoint::Ptr Endpoint::GetLocalEndpoint()
 	return listener->GetLocalEndpoint();
 }
 
-void Endpoint::AddMessageSent(int bytes)
+/**
+ * Accounts a message sent to this endpoint.
+ *
+ * @param bytes Bytes on the wire
+ * @param uncompressedBytes Size of the message before compression
+ */
+void Endpoint::AddMessageSent(int bytes, int uncompressedBytes)
 {
 	double time = Utility::GetTime();
 	m_MessagesSent.InsertValue(time, 1);
 	m_BytesSent.InsertValue(time, bytes);
+	m_UncompressedBytesSent.InsertValue(time, uncompressedBytes);
 	SetLastMessageSent(time);
 }
 
-void Endpoint::AddMessageReceived(int bytes)
+/**
+ * Accounts a message received from this endpoint.
+ *
+ * @param bytes Bytes on the wire
+ * @param uncompressedBytes Size of the message after decompression
+ */
+void Endpoint::AddMessageReceived(int bytes, int uncompressedBytes)
 {
 	double time = Utility::GetTime();
 	m_MessagesReceived.InsertValue(time, 1);
 	m_BytesReceived.InsertValue(time, bytes);
+	m_UncompressedBytesReceived.InsertValue(time, uncompressedBytes);
 	SetLastMessageReceived(time);
 }
 
@@ -136,3 +150,13 @@ double Endpoint::GetBytesReceivedPerSecond() const
 {
 	return m_BytesReceived.CalculateRate(Utility::GetTime(), 60);
 }
+
+double Endpoint::GetUncompressedBytesSentPerSecond() const
+{
+	return m_UncompressedBytesSent.CalculateRate(Utility::GetTime(), 60);
+}
+
+double Endpoint::GetUncompressedBytesReceivedPerSecond() const
+{
+	return m_UncompressedBytesReceived.CalculateRate(Utility::GetTime(), 60);
+}
@@ -40,8 +40,8 @@ public:
 
 	void SetCachedZone(const intrusive_ptr<Zone>& zone);
 
-	void AddMessageSent(int bytes);
-	void AddMessageReceived(int bytes);
+	void AddMessageSent(int bytes, int uncompressedBytes);
+	void AddMessageReceived(int bytes, int uncompressedBytes);
 
 	double GetMessagesSentPerSecond() const override;
 	double GetMessagesReceivedPerSecond() const override;
@@ -49,6 +49,9 @@ public:
 	double GetBytesSentPerSecond() const override;
 	double GetBytesReceivedPerSecond() const override;
 
+	double GetUncompressedBytesSentPerSecond() const override;
+	double GetUncompressedBytesReceivedPerSecond() const override;
+
 protected:
 	void OnAllConfigLoaded() override;
 
@@ -61,6 +64,8 @@ private:
 	mutable RingBuffer m_MessagesReceived{60};
 	mutable RingBuffer m_BytesSent{60};
 	mutable RingBuffer m_BytesReceived{60};
+	mutable RingBuffer m_UncompressedBytesSent{60};
+	mutable RingBuffer m_UncompressedBytesReceived{60};
 };
 
 }
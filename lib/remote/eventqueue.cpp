@@ -1,12 +1,15 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
+#include "config/bytecode.hpp"
 #include "config/configcompiler.hpp"
 #include "remote/eventqueue.hpp"
 #include "remote/filterutility.hpp"
 #include "base/io-engine.hpp"
+#include "base/json.hpp"
 #include "base/singleton.hpp"
 #include "base/logger.hpp"
 #include "base/utility.hpp"
+#include <boost/algorithm/string/replace.hpp>
 #include <boost/asio/spawn.hpp>
 #include <boost/date_time/posix_time/posix_time_duration.hpp>
 #include <boost/date_time/posix_time/ptime.hpp>
@@ -166,7 +169,7 @@ EventsInbox::EventsInbox(String filter, const String& filterSource)
 		m_Filter = m_Filters.find(filter);
 
 		if (m_Filter == m_Filters.end()) {
-			m_Filter = m_Filters.emplace(std::move(filter), Filter{1, Expression::Ptr(expr.release())}).first;
+			m_Filter = m_Filters.emplace(std::move(filter), Filter{1, BytecodeExpression::Compile(Expression::Ptr(expr.release()))}).first;
 		} else {
 			++m_Filter->second.Refs;
 		}
@@ -189,15 +192,20 @@ const Expression::Ptr& EventsInbox::GetFilter()
 	return m_Filter->second.Expr;
 }
 
-void EventsInbox::Push(Dictionary::Ptr event)
+void EventsInbox::Push(EncodedEvent event)
 {
 	std::unique_lock<std::mutex> lock (m_Mutex);
 
-	m_Queue.emplace(std::move(event));
+	m_Queue.emplace_back(std::move(event));
 	m_Timer.expires_at(boost::posix_time::neg_infin);
 }
 
-Dictionary::Ptr EventsInbox::Shift(boost::asio::yield_context yc, double timeout)
+/**
+ * Waits for events and takes all of them at once, so that the caller can write them in one go.
+ *
+ * @return The queued events, oldest first, or nothing after timeout seconds
+ */
+std::vector<EncodedEvent> EventsInbox::Shift(boost::asio::yield_context yc, double timeout)
 {
 	std::unique_lock<std::mutex> lock (m_Mutex, std::defer_lock);
 
@@ -223,15 +231,11 @@ Dictionary::Ptr EventsInbox::Shift(boost::asio::yield_context yc, double timeout
 				m_Timer.async_wait(yc[ec]);
 			}
 		}
-
-		if (m_Queue.empty()) {
-			return nullptr;
-		}
 	}
 
-	auto event (std::move(m_Queue.front()));
-	m_Queue.pop();
-	return event;
+	std::vector<EncodedEvent> events;
+	events.swap(m_Queue);
+	return events;
 }
 
 EventsSubscriber::EventsSubscriber(std::set<EventType> types, String filter, const String& filterSource)
@@ -250,19 +254,28 @@ const EventsInbox::Ptr& EventsSubscriber::GetInbox()
 	return m_Inbox;
 }
 
-EventsFilter::EventsFilter(std::map<Expression::Ptr, std::set<EventsInbox::Ptr>> inboxes)
+EventsFilter::EventsFilter(std::shared_ptr<const EventsSubscribers> inboxes)
 	: m_Inboxes(std::move(inboxes))
 {
 }
 
 EventsFilter::operator bool()
 {
-	return !m_Inboxes.empty();
+	return m_Inboxes && !m_Inboxes->empty();
 }
 
 void EventsFilter::Push(Dictionary::Ptr event)
 {
-	for (auto& perFilter : m_Inboxes) {
+	if (!m_Inboxes) {
+		return;
+	}
+
+	EncodedEvent encoded;
+
+	/* Each distinct filter is evaluated once, no matter how many inboxes share it,
+	 * and the event is encoded once for all of them.
+	 */
+	for (auto& perFilter : *m_Inboxes) {
 		if (perFilter.first) {
 			ScriptFrame frame(true, new Namespace());
 			frame.Sandboxed = true;
@@ -278,8 +291,16 @@ void EventsFilter::Push(Dictionary::Ptr event)
 			}
 		}
 
+		if (!encoded) {
+			String body = JsonEncode(event);
+
+			boost::algorithm::replace_all(body, "\n", "");
+
+			encoded = std::make_shared<const String>(std::move(body));
+		}
+
 		for (auto& inbox : perFilter.second) {
-			inbox->Push(event);
+			inbox->Push(encoded);
 		}
 	}
 }
@@ -291,61 +312,50 @@ EventsRouter& EventsRouter::GetInstance()
 
 void EventsRouter::Subscribe(const std::set<EventType>& types, const EventsInbox::Ptr& inbox)
 {
-	const auto& filter (inbox->GetFilter());
-	std::unique_lock<std::mutex> lock (m_Mutex);
-
-	for (auto type : types) {
-		auto perType (m_Subscribers.find(type));
-
-		if (perType == m_Subscribers.end()) {
-			perType = m_Subscribers.emplace(type, decltype(perType->second)()).first;
-		}
-
-		auto perFilter (perType->second.find(filter));
-
-		if (perFilter == perType->second.end()) {
-			perFilter = perType->second.emplace(filter, decltype(perFilter->second)()).first;
-		}
-
-		perFilter->second.emplace(inbox);
-	}
+	Update(types, inbox, true);
 }
 
 void EventsRouter::Unsubscribe(const std::set<EventType>& types, const EventsInbox::Ptr& inbox)
+{
+	Update(types, inbox, false);
+}
+
+void EventsRouter::Update(const std::set<EventType>& types, const EventsInbox::Ptr& inbox, bool subscribe)
 {
 	const auto& filter (inbox->GetFilter());
-	std::unique_lock<std::mutex> lock (m_Mutex);
 
 	for (auto type : types) {
-		auto perType (m_Subscribers.find(type));
+		auto& shard (m_Shards.at((size_t)type));
+		std::unique_lock<std::mutex> lock (shard.Mutex);
 
-		if (perType != m_Subscribers.end()) {
-			auto perFilter (perType->second.find(filter));
+		auto subscribers (shard.Subscribers ? std::make_shared<EventsSubscribers>(*shard.Subscribers) : std::make_shared<EventsSubscribers>());
 
-			if (perFilter != perType->second.end()) {
+		if (subscribe) {
+			(*subscribers)[filter].emplace(inbox);
+		} else {
+			auto perFilter (subscribers->find(filter));
+
+			if (perFilter != subscribers->end()) {
 				perFilter->second.erase(inbox);
 
 				if (perFilter->second.empty()) {
-					perType->second.erase(perFilter);
+					subscribers->erase(perFilter);
 				}
 			}
+		}
 
-			if (perType->second.empty()) {
-				m_Subscribers.erase(perType);
-			}
+		if (subscribers->empty()) {
+			shard.Subscribers = nullptr;
+		} else {
+			shard.Subscribers = std::move(subscribers);
 		}
 	}
 }
 
 EventsFilter EventsRouter::GetInboxes(EventType type)
 {
-	std::unique_lock<std::mutex> lock (m_Mutex);
-
-	auto perType (m_Subscribers.find(type));
-
-	if (perType == m_Subscribers.end()) {
-		return EventsFilter({});
-	}
+	auto& shard (m_Shards.at((size_t)type));
+	std::unique_lock<std::mutex> lock (shard.Mutex);
 
-	return EventsFilter(perType->second);
+	return EventsFilter(shard.Subscribers);
 }
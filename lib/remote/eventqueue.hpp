@@ -8,14 +8,17 @@
 #include "config/expression.hpp"
 #include <boost/asio/deadline_timer.hpp>
 #include <boost/asio/spawn.hpp>
+#include <array>
 #include <condition_variable>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <mutex>
 #include <set>
 #include <map>
 #include <deque>
 #include <queue>
+#include <vector>
 
 namespace icinga
 {
@@ -86,6 +89,14 @@ enum class EventType : uint_fast8_t
 	ObjectModified
 };
 
+/**
+ * An event as written to /v1/events streams: JSON-encoded, without newlines.
+ * Encoded once and shared by all inboxes it's pushed to.
+ *
+ * @ingroup remote
+ */
+typedef std::shared_ptr<const String> EncodedEvent;
+
 class EventsInbox : public Object
 {
 public:
@@ -100,8 +111,8 @@ public:
 
 	const Expression::Ptr& GetFilter();
 
-	void Push(Dictionary::Ptr event);
-	Dictionary::Ptr Shift(boost::asio::yield_context yc, double timeout = 5);
+	void Push(EncodedEvent event);
+	std::vector<EncodedEvent> Shift(boost::asio::yield_context yc, double timeout = 5);
 
 private:
 	struct Filter
@@ -115,7 +126,7 @@ private:
 
 	std::mutex m_Mutex;
 	decltype(m_Filters.begin()) m_Filter;
-	std::queue<Dictionary::Ptr> m_Queue;
+	std::vector<EncodedEvent> m_Queue;
 	boost::asio::deadline_timer m_Timer;
 };
 
@@ -136,17 +147,19 @@ private:
 	EventsInbox::Ptr m_Inbox;
 };
 
+typedef std::map<Expression::Ptr, std::set<EventsInbox::Ptr>> EventsSubscribers;
+
 class EventsFilter
 {
 public:
-	EventsFilter(std::map<Expression::Ptr, std::set<EventsInbox::Ptr>> inboxes);
+	EventsFilter(std::shared_ptr<const EventsSubscribers> inboxes);
 
 	operator bool();
 
 	void Push(Dictionary::Ptr event);
 
 private:
-	std::map<Expression::Ptr, std::set<EventsInbox::Ptr>> m_Inboxes;
+	std::shared_ptr<const EventsSubscribers> m_Inboxes;
 };
 
 class EventsRouter
@@ -168,8 +181,18 @@ private:
 	EventsRouter& operator=(EventsRouter&&) = delete;
 	~EventsRouter() = default;
 
-	std::mutex m_Mutex;
-	std::map<EventType, std::map<Expression::Ptr, std::set<EventsInbox::Ptr>>> m_Subscribers;
+	/* One shard per event type. Its subscribers are never modified in place, but replaced
+	 * by (un)subscribers, so the event producers just have to grab the current pointer.
+	 */
+	struct Shard
+	{
+		std::mutex Mutex;
+		std::shared_ptr<const EventsSubscribers> Subscribers;
+	};
+
+	std::array<Shard, (size_t)EventType::ObjectModified + 1u> m_Shards;
+
+	void Update(const std::set<EventType>& types, const EventsInbox::Ptr& inbox, bool subscribe);
 };
 
 }
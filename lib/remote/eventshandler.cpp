@@ -1,6 +1,7 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
 #include "remote/eventshandler.hpp"
+#include "remote/apilistener.hpp"
 #include "remote/httputility.hpp"
 #include "remote/filterutility.hpp"
 #include "config/configcompiler.hpp"
@@ -8,12 +9,15 @@
 #include "base/defer.hpp"
 #include "base/io-engine.hpp"
 #include "base/objectlock.hpp"
-#include "base/json.hpp"
 #include <boost/asio/buffer.hpp>
+#include <boost/asio/deadline_timer.hpp>
 #include <boost/asio/write.hpp>
-#include <boost/algorithm/string/replace.hpp>
+#include <boost/date_time/posix_time/posix_time_duration.hpp>
+#include <boost/system/error_code.hpp>
+#include <cstdint>
 #include <map>
 #include <set>
+#include <vector>
 
 using namespace icinga;
 
@@ -111,22 +115,52 @@ bool EventsHandler::HandleRequest(
 	stream.async_flush(yc);
 
 	asio::const_buffer newLine ("\n", 1);
+	auto& inbox (subscriber.GetInbox());
+	double flushInterval = 0;
+
+	{
+		auto listener (ApiListener::GetInstance());
+
+		if (listener) {
+			flushInterval = listener->GetEventsFlushInterval();
+		}
+	}
+
+	asio::deadline_timer flushTimer (IoEngine::Get().GetIoContext());
+	std::vector<asio::const_buffer> buffers;
 
 	for (;;) {
-		auto event (subscriber.GetInbox()->Shift(yc));
+		auto events (inbox->Shift(yc));
+
+		if (events.empty()) {
+			if (server.Disconnected()) {
+				return true;
+			}
 
-		if (event) {
-			String body = JsonEncode(event);
+			continue;
+		}
 
-			boost::algorithm::replace_all(body, "\n", "");
+		/* Give the following events some time to arrive and send them all together. */
+		if (flushInterval > 0) {
+			boost::system::error_code ec;
 
-			asio::const_buffer payload (body.CStr(), body.GetLength());
+			flushTimer.expires_from_now(boost::posix_time::microseconds((int64_t)(flushInterval * 1e6)));
+			flushTimer.async_wait(yc[ec]);
 
-			asio::async_write(stream, payload, yc);
-			asio::async_write(stream, newLine, yc);
-			stream.async_flush(yc);
-		} else if (server.Disconnected()) {
-			return true;
+			for (auto& event : inbox->Shift(yc, 0)) {
+				events.emplace_back(std::move(event));
+			}
 		}
+
+		buffers.clear();
+		buffers.reserve(events.size() * 2u);
+
+		for (auto& event : events) {
+			buffers.emplace_back(event->CStr(), event->GetLength());
+			buffers.emplace_back(newLine);
+		}
+
+		asio::async_write(stream, buffers, yc);
+		stream.async_flush(yc);
 	}
 }
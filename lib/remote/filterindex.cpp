@@ -0,0 +1,356 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "remote/filterindex.hpp"
+#include "base/configtype.hpp"
+#include "base/dependencygraph.hpp"
+#include <algorithm>
+#include <iterator>
+#include <set>
+
+using namespace icinga;
+
+typedef std::set<ConfigObject::Ptr> FilterCandidates;
+
+struct FilterIndexContext
+{
+	Type::Ptr TargetType;
+	String VariableName;
+	Dictionary::Ptr FilterVars;
+};
+
+/**
+ * @returns If the given expression is a constant string, its address. nullptr on failure.
+ */
+static const String *GetConstString(Expression *exp, const Dictionary::Ptr& filterVars)
+{
+	const Value *cnst = nullptr;
+	auto lit (dynamic_cast<LiteralExpression*>(exp));
+
+	if (lit) {
+		cnst = &lit->GetValue();
+	} else if (filterVars) {
+		auto var (dynamic_cast<VariableExpression*>(exp));
+
+		if (var) {
+			cnst = filterVars->GetRef(var->GetVariable());
+		}
+	}
+
+	return cnst && cnst->IsString() ? &cnst->Get<String>() : nullptr;
+}
+
+/**
+ * If the given expression is like $variable$.$attr$, find out which object the variable
+ * refers to while evaluating the filter (see FilterUtility#EvaluateFilter()).
+ *
+ * @param navigationField Receives the field of the target type navigating to that object, -1 for the target itself
+ * @param varType Receives the type of that object
+ * @param attr Receives the attribute
+ *
+ * @returns Whether the given expression is like above.
+ */
+static bool GetIndexer(Expression *exp, const FilterIndexContext& ctx, int& navigationField, Type::Ptr& varType, String& attr)
+{
+	auto ixr (dynamic_cast<IndexerExpression*>(exp));
+
+	if (!ixr) {
+		return false;
+	}
+
+	auto var (dynamic_cast<VariableExpression*>(ixr->GetOperand1().get()));
+
+	if (!var) {
+		return false;
+	}
+
+	auto attrName (GetConstString(ixr->GetOperand2().get(), ctx.FilterVars));
+
+	if (!attrName) {
+		return false;
+	}
+
+	const String& name (var->GetVariable());
+
+	for (int fid = 0; fid < ctx.TargetType->GetFieldCount(); fid++) {
+		Field field = ctx.TargetType->GetFieldInfo(fid);
+
+		if ((field.Attributes & FANavigation) && name == field.NavigationName) {
+			/* Navigation fields like Service#host hold the object itself, not its name. */
+			varType = Type::GetByName(field.RefTypeName ? field.RefTypeName : field.TypeName);
+
+			if (!varType || !dynamic_cast<ConfigType*>(varType.get())) {
+				return false;
+			}
+
+			navigationField = fid;
+			attr = *attrName;
+			return true;
+		}
+	}
+
+	if (name == ctx.VariableName || name == "obj") {
+		navigationField = -1;
+		varType = ctx.TargetType;
+		attr = *attrName;
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * @returns Whether $attr$ is the name ConfigType indexes the objects of the given type by.
+ */
+static bool IsNameAttribute(const Type::Ptr& type, const String& attr)
+{
+	/* Services etc. are indexed by their full name, "name" is the short one. */
+	return attr == "__name" || (attr == "name" && !dynamic_cast<NameComposer*>(type.get()));
+}
+
+/**
+ * Finds the objects referring to the object of the given attribute's type and name.
+ *
+ * @returns Whether the attribute is a reference to another object and that object exists.
+ */
+static bool GetReferringObjects(const Type::Ptr& type, const String& attr, const String& name, bool array, FilterCandidates& candidates)
+{
+	int fid = type->GetFieldId(attr);
+
+	if (fid < 0) {
+		return false;
+	}
+
+	Field field = type->GetFieldInfo(fid);
+
+	/* Only references by name are tracked by DependencyGraph. */
+	if (!field.RefTypeName || (field.ArrayRank > 0) != array) {
+		return false;
+	}
+
+	ConfigObject::Ptr ref = ConfigObject::GetObject(field.RefTypeName, name);
+
+	if (!ref) {
+		return false;
+	}
+
+	for (const Object::Ptr& parent : DependencyGraph::GetParents(ref)) {
+		if (type->IsAssignableFrom(parent->GetReflectionType())) {
+			candidates.emplace(static_pointer_cast<ConfigObject>(parent));
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Replaces objects joined by the given navigation field with the objects of the target type joining them.
+ */
+static void ResolveNavigation(const FilterIndexContext& ctx, int navigationField, FilterCandidates& candidates)
+{
+	if (navigationField < 0) {
+		return;
+	}
+
+	FilterCandidates targets;
+
+	for (const ConfigObject::Ptr& joined : candidates) {
+		for (const Object::Ptr& parent : DependencyGraph::GetParents(joined)) {
+			if (ctx.TargetType->IsAssignableFrom(parent->GetReflectionType())) {
+				targets.emplace(static_pointer_cast<ConfigObject>(parent));
+			}
+		}
+	}
+
+	candidates = std::move(targets);
+}
+
+static bool GetEqualCandidates(Expression *indexer, Expression *value, const FilterIndexContext& ctx, FilterCandidates& candidates)
+{
+	int navigationField;
+	Type::Ptr varType;
+	String attr;
+
+	if (!GetIndexer(indexer, ctx, navigationField, varType, attr)) {
+		return false;
+	}
+
+	auto name (GetConstString(value, ctx.FilterVars));
+
+	if (!name) {
+		return false;
+	}
+
+	if (IsNameAttribute(varType, attr)) {
+		ConfigObject::Ptr object = dynamic_cast<ConfigType*>(varType.get())->GetObject(*name);
+
+		if (object) {
+			candidates.emplace(std::move(object));
+		}
+	} else if (!GetReferringObjects(varType, attr, *name, false, candidates)) {
+		return false;
+	}
+
+	ResolveNavigation(ctx, navigationField, candidates);
+	return true;
+}
+
+static bool GetInCandidates(InExpression *in, const FilterIndexContext& ctx, FilterCandidates& candidates)
+{
+	int navigationField;
+	Type::Ptr varType;
+	String attr;
+
+	if (!GetIndexer(in->GetOperand2().get(), ctx, navigationField, varType, attr)) {
+		return false;
+	}
+
+	auto name (GetConstString(in->GetOperand1().get(), ctx.FilterVars));
+
+	if (!name || !GetReferringObjects(varType, attr, *name, true, candidates)) {
+		return false;
+	}
+
+	ResolveNavigation(ctx, navigationField, candidates);
+	return true;
+}
+
+static bool GetMatchCandidates(FunctionCallExpression *call, const FilterIndexContext& ctx, FilterCandidates& candidates)
+{
+	auto fname (dynamic_cast<VariableExpression*>(call->m_FName.get()));
+
+	/* match() may have been shadowed by a filter variable. */
+	if (!fname || fname->GetVariable() != "match" || call->m_Args.size() != 2u
+		|| (ctx.FilterVars && ctx.FilterVars->Contains("match"))) {
+		return false;
+	}
+
+	auto pattern (GetConstString(call->m_Args[0].get(), ctx.FilterVars));
+
+	if (!pattern) {
+		return false;
+	}
+
+	int navigationField;
+	Type::Ptr varType;
+	String attr;
+
+	if (!GetIndexer(call->m_Args[1].get(), ctx, navigationField, varType, attr) || !IsNameAttribute(varType, attr)) {
+		return false;
+	}
+
+	String prefix = pattern->SubStr(0, pattern->FindFirstOf("*?[\\"));
+
+	if (prefix.IsEmpty()) {
+		return false;
+	}
+
+	for (ConfigObject::Ptr& object : dynamic_cast<ConfigType*>(varType.get())->GetObjectsByNamePrefix(prefix)) {
+		candidates.emplace(std::move(object));
+	}
+
+	ResolveNavigation(ctx, navigationField, candidates);
+	return true;
+}
+
+static bool GetCandidatesInternal(Expression *exp, const FilterIndexContext& ctx, FilterCandidates& candidates)
+{
+	auto dict (dynamic_cast<DictExpression*>(exp));
+
+	if (dict) {
+		auto& subex (dict->GetExpressions());
+
+		return subex.size() == 1u && GetCandidatesInternal(subex[0].get(), ctx, candidates);
+	}
+
+	auto land (dynamic_cast<LogicalAndExpression*>(exp));
+
+	if (land) {
+		FilterCandidates candidates1, candidates2;
+		bool indexed1 = GetCandidatesInternal(land->GetOperand1().get(), ctx, candidates1);
+		bool indexed2 = GetCandidatesInternal(land->GetOperand2().get(), ctx, candidates2);
+
+		if (indexed1 && indexed2) {
+			std::set_intersection(candidates1.begin(), candidates1.end(), candidates2.begin(), candidates2.end(),
+				std::inserter(candidates, candidates.end()));
+		} else if (indexed1) {
+			candidates = std::move(candidates1);
+		} else if (indexed2) {
+			candidates = std::move(candidates2);
+		} else {
+			return false;
+		}
+
+		return true;
+	}
+
+	auto lor (dynamic_cast<LogicalOrExpression*>(exp));
+
+	if (lor) {
+		FilterCandidates candidates2;
+
+		if (!GetCandidatesInternal(lor->GetOperand1().get(), ctx, candidates)
+			|| !GetCandidatesInternal(lor->GetOperand2().get(), ctx, candidates2)) {
+			return false;
+		}
+
+		candidates.insert(candidates2.begin(), candidates2.end());
+		return true;
+	}
+
+	auto eq (dynamic_cast<EqualExpression*>(exp));
+
+	if (eq) {
+		return GetEqualCandidates(eq->GetOperand1().get(), eq->GetOperand2().get(), ctx, candidates)
+			|| GetEqualCandidates(eq->GetOperand2().get(), eq->GetOperand1().get(), ctx, candidates);
+	}
+
+	auto in (dynamic_cast<InExpression*>(exp));
+
+	if (in) {
+		return GetInCandidates(in, ctx, candidates);
+	}
+
+	auto call (dynamic_cast<FunctionCallExpression*>(exp));
+
+	if (call) {
+		return GetMatchCandidates(call, ctx, candidates);
+	}
+
+	return false;
+}
+
+/**
+ * Finds the objects the given filter may match without evaluating it.
+ *
+ * The filter still has to be evaluated for the candidates. Objects which haven't been
+ * activated yet may be missing as DependencyGraph doesn't know their references.
+ *
+ * @param filter The filter
+ * @param type The queried type
+ * @param variableName The name of the variable the filter refers to the object by
+ * @param filterVars The variables the filter is evaluated with
+ * @param candidates Receives the candidates, in the order of ConfigType#GetObjects()
+ *
+ * @returns Whether the filter could be answered from the indexes.
+ */
+bool FilterIndex::GetCandidates(Expression *filter, const Type::Ptr& type, const String& variableName,
+	const Dictionary::Ptr& filterVars, std::vector<ConfigObject::Ptr>& candidates)
+{
+	if (!type || !dynamic_cast<ConfigType*>(type.get())) {
+		return false;
+	}
+
+	FilterIndexContext ctx { type, variableName, filterVars };
+	FilterCandidates result;
+
+	if (!GetCandidatesInternal(filter, ctx, result)) {
+		return false;
+	}
+
+	candidates.assign(result.begin(), result.end());
+
+	/* Return the objects in the same order as evaluating the filter for all of them. */
+	dynamic_cast<ConfigType*>(type.get())->SortByRegistration(candidates);
+
+	return true;
+}
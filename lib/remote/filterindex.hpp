@@ -0,0 +1,40 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef FILTERINDEX_H
+#define FILTERINDEX_H
+
+#include "remote/i2-remote.hpp"
+#include "config/expression.hpp"
+#include "base/configobject.hpp"
+#include "base/dictionary.hpp"
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * Narrows down the objects an API filter has to be evaluated for.
+ *
+ * Recognizes the following patterns (and any combination of them with && and ||)
+ * for the queried type and the types joined by its navigation fields, e.g. host for services:
+ *
+ * - host.name == "H", host.__name == "H"
+ * - match("web*", host.name) (by the literal prefix of the pattern)
+ * - host.zone == "Z", service.host_name == "H" (any attribute referring to another object by name)
+ * - "G" in host.groups (any array of such references)
+ *
+ * These are answered from the objects' names and from the references tracked by DependencyGraph.
+ * The candidates are in the order they have been registered, just like with the full scan.
+ *
+ * @ingroup remote
+ */
+class FilterIndex
+{
+public:
+	static bool GetCandidates(Expression *filter, const Type::Ptr& type, const String& variableName,
+		const Dictionary::Ptr& filterVars, std::vector<ConfigObject::Ptr>& candidates);
+};
+
+}
+
+#endif /* FILTERINDEX_H */
@@ -1,20 +1,50 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
 #include "remote/filterutility.hpp"
+#include "remote/filterindex.hpp"
 #include "remote/httputility.hpp"
 #include "config/applyrule.hpp"
+#include "config/bytecode.hpp"
 #include "config/configcompiler.hpp"
 #include "config/expression.hpp"
 #include "base/namespace.hpp"
 #include "base/json.hpp"
 #include "base/configtype.hpp"
+#include "base/configuration.hpp"
+#include "base/defer.hpp"
 #include "base/logger.hpp"
 #include "base/utility.hpp"
+#include "base/workqueue.hpp"
 #include <boost/algorithm/string/case_conv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 
 using namespace icinga;
 
+/* Filters are evaluated in parallel for at least this many objects. */
+static const size_t l_ParallelFilterThreshold = 4096;
+
+/* Whether a request is evaluating its filter in parallel right now. */
+static std::atomic<bool> l_ParallelFilterActive (false);
+
+/**
+ * Returns the queue which evaluates filters for all requests, so that
+ * concurrent requests don't start threads of their own.
+ */
+static WorkQueue& GetFilterQueue()
+{
+	static WorkQueue queue (0, Configuration::Concurrency > 1 ? Configuration::Concurrency - 1 : 1, LogNotice);
+	static std::once_flag nameOnce;
+
+	std::call_once(nameOnce, []() { queue.SetName("FilterUtility, Filter"); });
+
+	return queue;
+}
+
 Type::Ptr FilterUtility::TypeFromPluralName(const String& pluralName)
 {
 	String uname = pluralName;
@@ -126,6 +156,119 @@ static void FilteredAddTarget(ScriptFrame& permissionFrame, Expression *permissi
 	}
 }
 
+/**
+ * Evaluates the filters for all of the given targets, in parallel if there are enough of them
+ * and no other request is evaluating its filters in parallel.
+ *
+ * The frames are used for sequential evaluation only. Each partition evaluated in parallel
+ * gets its own frames, with the filter variables set like in the given frame.
+ *
+ * @param targets The objects to evaluate the filters for
+ * @param result Receives the matching objects, in the same order
+ */
+static void FilteredAddTargets(ScriptFrame& permissionFrame, Expression *permissionFilter,
+	ScriptFrame& frame, Expression *ufilter, const Dictionary::Ptr& filterVars, std::vector<Value>& result,
+	const String& variableName, const std::vector<Object::Ptr>& targets)
+{
+	size_t partitionCount = 1;
+
+	/* Only one request at a time is evaluated in parallel, all others evaluate their filters
+	 * sequentially meanwhile. So the partitions of one request never wait behind the ones of
+	 * another request and at most one I/O thread waits for the shared queue.
+	 */
+	if (targets.size() >= l_ParallelFilterThreshold && Configuration::Concurrency > 1 && !l_ParallelFilterActive.exchange(true))
+		partitionCount = std::min<size_t>(Configuration::Concurrency, targets.size() / (l_ParallelFilterThreshold / 2));
+
+	if (partitionCount == 1) {
+		for (auto& target : targets) {
+			FilteredAddTarget(permissionFrame, permissionFilter, frame, ufilter, result, variableName, target);
+		}
+
+		return;
+	}
+
+	Defer parallelFilterDone ([]() { l_ParallelFilterActive.store(false); });
+
+	std::vector<std::vector<Value>> partitions (partitionCount);
+
+	auto filterPartition ([permissionFilter, ufilter, &filterVars, &variableName, &targets, &partitions, partitionCount](size_t partition) {
+		size_t count = targets.size() / partitionCount;
+		size_t begin = partition * count;
+		size_t end = (partition == partitionCount - 1) ? targets.size() : begin + count;
+
+		/* Script frames are per thread. */
+		Namespace::Ptr permissionFrameNS = new Namespace();
+		ScriptFrame permissionFrame(false, permissionFrameNS);
+
+		Namespace::Ptr frameNS = new Namespace();
+		ScriptFrame frame(false, frameNS);
+		frame.Sandboxed = true;
+
+		if (filterVars) {
+			ObjectLock olock (filterVars);
+
+			for (auto& kv : filterVars) {
+				frameNS->Set(kv.first, kv.second);
+			}
+		}
+
+		for (size_t i = begin; i < end; i++) {
+			FilteredAddTarget(permissionFrame, permissionFilter, frame, ufilter, partitions[partition], variableName, targets[i]);
+		}
+	});
+
+	/* The caller holds a CpuBoundWork slot and evaluates the first partition itself,
+	 * the others are evaluated by the shared queue meanwhile. Waiting for them takes
+	 * about as long as evaluating one partition, which the caller would do anyway.
+	 */
+	std::mutex pendingMutex;
+	std::condition_variable pendingCV;
+	size_t pendingPartitions = partitionCount - 1;
+	boost::exception_ptr partitionException;
+
+	for (size_t partition = 1; partition < partitionCount; partition++) {
+		GetFilterQueue().Enqueue([&filterPartition, &pendingMutex, &pendingCV, &pendingPartitions, &partitionException, partition]() {
+			boost::exception_ptr exception;
+
+			try {
+				filterPartition(partition);
+			} catch (...) {
+				exception = boost::current_exception();
+			}
+
+			std::unique_lock<std::mutex> lock (pendingMutex);
+
+			if (exception && !partitionException)
+				partitionException = exception;
+
+			pendingPartitions--;
+			pendingCV.notify_all();
+		});
+	}
+
+	try {
+		filterPartition(0);
+	} catch (...) {
+		boost::exception_ptr exception = boost::current_exception();
+		std::unique_lock<std::mutex> lock (pendingMutex);
+
+		if (!partitionException)
+			partitionException = exception;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock (pendingMutex);
+		pendingCV.wait(lock, [&pendingPartitions]() { return pendingPartitions == 0; });
+	}
+
+	if (partitionException)
+		boost::rethrow_exception(partitionException);
+
+	for (auto& partition : partitions) {
+		std::move(partition.begin(), partition.end(), std::back_inserter(result));
+	}
+}
+
 /**
  * Checks whether the given API user is granted the given permission
  *
@@ -335,17 +478,39 @@ std::vector<Value> FilterUtility::GetFilterTargets(const QueryDescription& qd, c
 					}
 				}
 
-				provider->FindTargets(type, [&permissionFrame, &permissionFilter, &frame, &ufilter, &result, variableName](const Object::Ptr& target) {
-					FilteredAddTarget(permissionFrame, permissionFilter.get(), frame, &*ufilter, result, variableName, target);
-				});
+				std::vector<ConfigObject::Ptr> candidates;
+				std::vector<Object::Ptr> targets;
+
+				if (dynamic_cast<ConfigObjectTargetProvider*>(provider.get())
+					&& FilterIndex::GetCandidates(ufilter.get(), Type::GetByName(type), variableName.IsEmpty() ? type.ToLower() : variableName, filter_vars, candidates)) {
+					Log(LogDebug, "FilterUtility")
+						<< "Filter for type '" << type << "' answered from index: " << candidates.size() << " candidates.";
+
+					targets.assign(candidates.begin(), candidates.end());
+				} else {
+					Log(LogDebug, "FilterUtility")
+						<< "Filter for type '" << type << "' not answered from index, evaluating it for all objects.";
+
+					provider->FindTargets(type, [&targets](const Object::Ptr& target) {
+						targets.emplace_back(target);
+					});
+				}
+
+				ufilter = BytecodeExpression::Compile(std::move(ufilter));
+
+				FilteredAddTargets(permissionFrame, permissionFilter.get(), frame, &*ufilter, filter_vars, result, variableName, targets);
 			}
 		} else {
+			std::vector<Object::Ptr> targets;
+
+			provider->FindTargets(type, [&targets](const Object::Ptr& target) {
+				targets.emplace_back(target);
+			});
+
 			/* Ensure to pass a nullptr as filter expression.
 			 * GCC 8.1.1 on F28 causes problems, see GH #6533.
 			 */
-			provider->FindTargets(type, [&permissionFrame, &permissionFilter, &frame, &result, variableName](const Object::Ptr& target) {
-				FilteredAddTarget(permissionFrame, permissionFilter.get(), frame, nullptr, result, variableName, target);
-			});
+			FilteredAddTargets(permissionFrame, permissionFilter.get(), frame, nullptr, nullptr, result, variableName, targets);
 		}
 	}
 
@@ -41,7 +41,7 @@ HttpServerConnection::HttpServerConnection(const String& identity, bool authenti
 }
 
 HttpServerConnection::HttpServerConnection(const String& identity, bool authenticated, const Shared<AsioTlsStream>::Ptr& stream, boost::asio::io_context& io)
-	: m_Stream(stream), m_Seen(Utility::GetTime()), m_IoStrand(io), m_ShuttingDown(false), m_HasStartedStreaming(false),
+	: m_Stream(stream), m_Seen(Utility::GetTime()), m_IoStrand(io), m_ShuttingDown(false), m_HasStartedStreaming(false), m_HasStartedChunkedResponse(false),
 	m_CheckLivenessTimer(io)
 {
 	if (authenticated) {
@@ -131,6 +131,15 @@ void HttpServerConnection::StartStreaming()
 	});
 }
 
+/**
+ * Tells that the handler sends the response on its own, using chunked transfer encoding.
+ * Unlike with StartStreaming() the connection may be used for further requests afterwards.
+ */
+void HttpServerConnection::StartChunkedResponse()
+{
+	m_HasStartedChunkedResponse = true;
+}
+
 bool HttpServerConnection::Disconnected()
 {
 	return m_ShuttingDown;
@@ -430,6 +439,8 @@ bool ProcessRequest(
 	boost::beast::http::response<boost::beast::http::string_body>& response,
 	HttpServerConnection& server,
 	bool& hasStartedStreaming,
+	bool& hasStartedChunkedResponse,
+	const String& peerAddress,
 	boost::asio::yield_context& yc
 )
 {
@@ -444,6 +455,14 @@ bool ProcessRequest(
 			return false;
 		}
 
+		if (hasStartedChunkedResponse) {
+			/* The response is incomplete, the client can only tell by the connection being closed. */
+			Log(LogWarning, "HttpServerConnection")
+				<< "Error while sending chunked response to " << peerAddress << ", closing connection: " << DiagnosticInformation(ex, false);
+
+			return false;
+		}
+
 		auto sysErr (dynamic_cast<const boost::system::system_error*>(&ex));
 
 		if (sysErr && sysErr->code() == boost::asio::error::operation_aborted) {
@@ -464,6 +483,10 @@ bool ProcessRequest(
 		return false;
 	}
 
+	if (hasStartedChunkedResponse) {
+		return true;
+	}
+
 	http::async_write(stream, response, yc);
 	stream.async_flush(yc);
 
@@ -549,8 +572,9 @@ void HttpServerConnection::ProcessMessages(boost::asio::yield_context yc)
 			}
 
 			m_Seen = std::numeric_limits<decltype(m_Seen)>::max();
+			m_HasStartedChunkedResponse = false;
 
-			if (!ProcessRequest(*m_Stream, request, authenticatedUser, response, *this, m_HasStartedStreaming, yc)) {
+			if (!ProcessRequest(*m_Stream, request, authenticatedUser, response, *this, m_HasStartedStreaming, m_HasStartedChunkedResponse, m_PeerAddress, yc)) {
 				break;
 			}
 
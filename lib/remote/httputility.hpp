@@ -5,7 +5,15 @@
 
 #include "remote/url.hpp"
 #include "base/dictionary.hpp"
+#include "base/io-engine.hpp"
+#include "base/json.hpp"
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/socket_base.hpp>
+#include <boost/asio/spawn.hpp>
+#include <boost/asio/write.hpp>
 #include <boost/beast/http.hpp>
+#include <cstddef>
+#include <functional>
 #include <string>
 
 namespace icinga
@@ -26,8 +34,77 @@ public:
 	static void SendJsonBody(boost::beast::http::response<boost::beast::http::string_body>& response, const Dictionary::Ptr& params, const Value& val);
 	static void SendJsonError(boost::beast::http::response<boost::beast::http::string_body>& response, const Dictionary::Ptr& params, const int code,
 		const String& verbose = String(), const String& diagnosticInformation = String());
+
+	template<class AsyncWriteStream>
+	static void SendJsonArrayChunked(AsyncWriteStream& stream, boost::beast::http::response<boost::beast::http::string_body>& response,
+		const String& key, size_t count, const std::function<Value(size_t)>& getItem, bool pretty, boost::asio::yield_context& yc);
 };
 
+/**
+ * Sends {"<key>":[...]} with chunked transfer encoding. The items are produced one
+ * at a time and sent in chunks of about 64 KiB, so the whole body is never kept in memory.
+ * The coroutine waits for every write, so a slow client holds back the producer.
+ *
+ * If producing an item fails after the header has been sent, the terminating chunk isn't
+ * sent and the connection is shut down. This way the client can tell that the body is
+ * incomplete. The exception is rethrown, the connection must not be used anymore.
+ *
+ * @param getItem Produces the item with the given index, must not be called from an I/O bound work slot.
+ */
+template<class AsyncWriteStream>
+void HttpUtility::SendJsonArrayChunked(AsyncWriteStream& stream, boost::beast::http::response<boost::beast::http::string_body>& response,
+	const String& key, size_t count, const std::function<Value(size_t)>& getItem, bool pretty, boost::asio::yield_context& yc)
+{
+	namespace asio = boost::asio;
+	namespace http = boost::beast::http;
+
+	static const size_t chunkSize = 64 * 1024;
+
+	response.set(http::field::content_type, "application/json");
+	response.chunked(true);
+
+	{
+		IoBoundWorkSlot dontLockTheIoThread (yc);
+
+		http::response_serializer<http::string_body> serializer (response);
+		http::async_write_header(stream, serializer, yc);
+	}
+
+	std::string chunk = "{" + JsonEncode(key).GetData() + ":[";
+
+	auto flushChunk ([&stream, &chunk, &yc]() {
+		IoBoundWorkSlot dontLockTheIoThread (yc);
+
+		asio::async_write(stream, http::make_chunk(asio::buffer(chunk)), yc);
+		chunk.clear();
+	});
+
+	try {
+		for (size_t i = 0; i < count; i++) {
+			if (i > 0)
+				chunk += ',';
+
+			String json = JsonEncode(getItem(i), pretty);
+			chunk.append(json.Begin(), json.End());
+
+			if (chunk.size() >= chunkSize)
+				flushChunk();
+		}
+	} catch (const std::exception&) {
+		boost::system::error_code ec;
+		stream.lowest_layer().shutdown(asio::socket_base::shutdown_both, ec);
+
+		throw;
+	}
+
+	chunk += "]}";
+	flushChunk();
+
+	IoBoundWorkSlot dontLockTheIoThread (yc);
+
+	asio::async_write(stream, http::make_chunk_last(), yc);
+}
+
 }
 
 #endif /* HTTPUTILITY_H */
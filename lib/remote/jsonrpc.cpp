@@ -1,6 +1,7 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
 #include "remote/jsonrpc.hpp"
+#include "remote/jsonrpccompression.hpp"
 #include "base/netstring.hpp"
 #include "base/json.hpp"
 #include "base/console.hpp"
@@ -45,6 +46,53 @@ static bool GetDebugJsonRpcCached()
 }
 #endif /* I2_DEBUG */
 
+/* How deeply containers in received CBOR messages may be nested. The decoder recurses into
+ * each level on the stack of the reading coroutine, which is much smaller than a thread's.
+ * Real messages, including deeply nested custom variables, stay far below this.
+ */
+static const size_t l_MaxCborMessageDepth = 128;
+
+/**
+ * Tell whether a received message is CBOR rather than JSON.
+ *
+ * Every message is a dictionary, so a JSON message starts with '{'
+ * while a CBOR one starts with the initial byte of a map.
+ *
+ * @param message Message as read from the stream
+ *
+ * @return Whether the message is CBOR-encoded
+ */
+static inline bool IsCborMessage(const String& message)
+{
+	return !message.IsEmpty() && ((unsigned char)message[0] & 0xE0u) == 0xA0u;
+}
+
+#ifdef I2_DEBUG
+/**
+ * Make a raw message human-readable for debug output.
+ *
+ * @param message JSON or CBOR message
+ *
+ * @return JSON message
+ */
+static String GetDebugRepresentation(const String& message)
+{
+#ifdef HAVE_ZLIB
+	if (JsonRpcInflater::IsCompressed(message))
+		return "(compressed, " + Convert::ToString(message.GetLength()) + " bytes)";
+#endif /* HAVE_ZLIB */
+
+	if (!IsCborMessage(message))
+		return message;
+
+	try {
+		return "(CBOR) " + JsonEncode(CborDecode(message));
+	} catch (const std::exception&) {
+		return "(invalid CBOR)";
+	}
+}
+#endif /* I2_DEBUG */
+
 /**
  * Sends a message to the connected peer and returns the bytes sent.
  *
@@ -89,7 +137,7 @@ size_t JsonRpc::SendRawMessage(const Shared<AsioTlsStream>::Ptr& stream, const S
 {
 #ifdef I2_DEBUG
 	if (GetDebugJsonRpcCached())
-		std::cerr << ConsoleColorTag(Console_ForegroundBlue) << ">> " << json << ConsoleColorTag(Console_Normal) << "\n";
+		std::cerr << ConsoleColorTag(Console_ForegroundBlue) << ">> " << GetDebugRepresentation(json) << ConsoleColorTag(Console_Normal) << "\n";
 #endif /* I2_DEBUG */
 
 	return NetString::WriteStringToStream(stream, json, yc);
@@ -110,7 +158,7 @@ String JsonRpc::ReadMessage(const Shared<AsioTlsStream>::Ptr& stream, ssize_t ma
 
 #ifdef I2_DEBUG
 	if (GetDebugJsonRpcCached())
-		std::cerr << ConsoleColorTag(Console_ForegroundBlue) << "<< " << jsonString << ConsoleColorTag(Console_Normal) << "\n";
+		std::cerr << ConsoleColorTag(Console_ForegroundBlue) << "<< " << GetDebugRepresentation(jsonString) << ConsoleColorTag(Console_Normal) << "\n";
 #endif /* I2_DEBUG */
 
 	return jsonString;
@@ -131,22 +179,50 @@ String JsonRpc::ReadMessage(const Shared<AsioTlsStream>::Ptr& stream, boost::asi
 
 #ifdef I2_DEBUG
 	if (GetDebugJsonRpcCached())
-		std::cerr << ConsoleColorTag(Console_ForegroundBlue) << "<< " << jsonString << ConsoleColorTag(Console_Normal) << "\n";
+		std::cerr << ConsoleColorTag(Console_ForegroundBlue) << "<< " << GetDebugRepresentation(jsonString) << ConsoleColorTag(Console_Normal) << "\n";
 #endif /* I2_DEBUG */
 
 	return jsonString;
 }
 
+/**
+ * Encode a message for the wire
+ *
+ * @param message Dictionary ptr
+ * @param encoding Encoding the peer has agreed on
+ *
+ * @return JSON or CBOR string
+ */
+String JsonRpc::EncodeMessage(const Dictionary::Ptr& message, JsonRpcEncoding encoding)
+{
+	switch (encoding) {
+		case JsonRpcEncoding::Cbor:
+			return CborEncode(message);
+		default:
+			return JsonEncode(message);
+	}
+}
+
 /**
  * Decode message, enforce a Dictionary
  *
- * @param message JSON string
+ * CBOR is only accepted from peers which have negotiated it,
+ * i.e. authenticated endpoints which announced the capability.
+ *
+ * @param message JSON or CBOR string
+ * @param allowCbor Whether the message may be CBOR-encoded
  *
  * @return Dictionary ptr
  */
-Dictionary::Ptr JsonRpc::DecodeMessage(const String& message)
+Dictionary::Ptr JsonRpc::DecodeMessage(const String& message, bool allowCbor)
 {
-	Value value = JsonDecode(message);
+	Value value;
+
+	if (allowCbor && IsCborMessage(message)) {
+		value = CborDecode(message, l_MaxCborMessageDepth);
+	} else {
+		value = JsonDecode(message);
+	}
 
 	if (!value.IsObjectType<Dictionary>()) {
 		BOOST_THROW_EXCEPTION(std::invalid_argument("JSON-RPC"
@@ -155,3 +231,31 @@ Dictionary::Ptr JsonRpc::DecodeMessage(const String& message)
 
 	return value;
 }
+
+JsonRpcMessageEncodings::JsonRpcMessageEncodings(Dictionary::Ptr message)
+	: m_Message(std::move(message))
+{
+}
+
+const Dictionary::Ptr& JsonRpcMessageEncodings::GetMessage() const
+{
+	return m_Message;
+}
+
+/**
+ * Get the message in the given encoding, encoding it on first use
+ *
+ * @param encoding Wire encoding
+ *
+ * @return Shared, immutable encoded message
+ */
+const std::shared_ptr<const String>& JsonRpcMessageEncodings::Get(JsonRpcEncoding encoding)
+{
+	auto& encoded (encoding == JsonRpcEncoding::Cbor ? m_Cbor : m_Json);
+
+	if (!encoded) {
+		encoded = std::make_shared<const String>(JsonRpc::EncodeMessage(m_Message, encoding));
+	}
+
+	return encoded;
+}
@@ -13,6 +13,18 @@
 namespace icinga
 {
 
+/**
+ * Wire encodings of JSON-RPC messages. Both share the same netstring framing
+ * and message model, the binary one is CBOR (RFC 8949).
+ *
+ * @ingroup remote
+ */
+enum class JsonRpcEncoding
+{
+	Json,
+	Cbor
+};
+
 /**
  * A JSON-RPC connection.
  *
@@ -28,12 +40,33 @@ public:
 	static String ReadMessage(const Shared<AsioTlsStream>::Ptr& stream, ssize_t maxMessageLength = -1);
 	static String ReadMessage(const Shared<AsioTlsStream>::Ptr& stream, boost::asio::yield_context yc, ssize_t maxMessageLength = -1);
 
-	static Dictionary::Ptr DecodeMessage(const String& message);
+	static String EncodeMessage(const Dictionary::Ptr& message, JsonRpcEncoding encoding);
+	static Dictionary::Ptr DecodeMessage(const String& message, bool allowCbor = false);
 
 private:
 	JsonRpc();
 };
 
+/**
+ * A message which is encoded on demand, at most once per encoding, so that
+ * the result can be shared between all connections it's sent to.
+ *
+ * @ingroup remote
+ */
+class JsonRpcMessageEncodings
+{
+public:
+	explicit JsonRpcMessageEncodings(Dictionary::Ptr message);
+
+	const Dictionary::Ptr& GetMessage() const;
+	const std::shared_ptr<const String>& Get(JsonRpcEncoding encoding);
+
+private:
+	Dictionary::Ptr m_Message;
+	std::shared_ptr<const String> m_Json;
+	std::shared_ptr<const String> m_Cbor;
+};
+
 }
 
 #endif /* JSONRPC_H */
@@ -0,0 +1,178 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "remote/jsonrpccompression.hpp"
+
+#ifdef HAVE_ZLIB
+
+#include "base/exception.hpp"
+#include <boost/throw_exception.hpp>
+#include <stdexcept>
+#include <vector>
+
+using namespace icinga;
+
+/* Marks a compressed message. JSON messages start with '{' and CBOR ones with a map header. */
+static const char l_CompressedMarker = '\x01';
+
+/* Z_SYNC_FLUSH terminates every message with an empty stored block. It's always the same,
+ * so it's stripped by the sender and re-added by the receiver (like RFC 7692 does).
+ */
+static const unsigned char l_SyncFlushTrailer[] = { 0x00, 0x00, 0xFF, 0xFF };
+
+/* Snippets of the most common cluster messages, the most frequent ones last.
+ * Changing this breaks the protocol unless it's negotiated by a new ApiCapabilities bit.
+ */
+static const char l_Dictionary[] =
+	"\"acknowledgement\":\"author\":\"comment\":\"expiry\":\"notify\":\"event::SetAcknowledgement\""
+	"\"event::SetNextCheck\",\"next_check\":\"event::SetForceNextCheck\"\"event::UpdateExecutions\""
+	"\"config::UpdateObject\",\"config::DeleteObject\"\"log::SetLogPosition\",\"log_position\":"
+	"\"event::Heartbeat\",\"timeout\":120"
+	"\"vars_after\":{\"attempt\":1,\"reachable\":true,\"state\":0,\"state_type\":1},"
+	"\"vars_before\":{\"attempt\":1,\"reachable\":true,\"state\":0,\"state_type\":1}},"
+	"\"check_source\":\"\",\"command\":[\"/usr/lib/nagios/plugins/check_\",\"-H\",\"-w\",\"-c\"],"
+	"\"execution_end\":\"execution_start\":\"exit_status\":0,\"output\":\"OK - \",\"performance_data\":[\""
+	"\"previous_hard_state\":99,\"schedule_end\":\"schedule_start\":\"scheduling_source\":\""
+	"\"state\":0.0,\"ttl\":0,\"type\":\"CheckResult\",\"vars_after\":"
+	"{\"jsonrpc\":\"2.0\",\"method\":\"event::CheckResult\",\"originZone\":\"\","
+	"\"params\":{\"cr\":{\"active\":true,\"host\":\"\",\"service\":\"\"},\"ts\":1";
+
+JsonRpcDeflater::JsonRpcDeflater(int level)
+{
+	m_Stream.zalloc = Z_NULL;
+	m_Stream.zfree = Z_NULL;
+	m_Stream.opaque = Z_NULL;
+
+	/* Raw deflate, no zlib header and checksum: TLS already takes care of integrity. */
+	if (deflateInit2(&m_Stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		BOOST_THROW_EXCEPTION(std::runtime_error("Failed to initialize deflate stream: " + String(m_Stream.msg ? m_Stream.msg : "")));
+	}
+
+	deflateSetDictionary(&m_Stream, reinterpret_cast<const Bytef*>(l_Dictionary), sizeof(l_Dictionary) - 1u);
+}
+
+JsonRpcDeflater::~JsonRpcDeflater()
+{
+	deflateEnd(&m_Stream);
+}
+
+/**
+ * Compresses a message.
+ *
+ * @param message JSON or CBOR message
+ *
+ * @return Compressed message, to be passed to JsonRpcInflater#Decompress() by the peer
+ */
+String JsonRpcDeflater::Compress(const String& message)
+{
+	std::vector<char> result;
+	result.reserve(1u + deflateBound(&m_Stream, message.GetLength()));
+	result.emplace_back(l_CompressedMarker);
+
+	m_Stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(message.CStr()));
+	m_Stream.avail_in = message.GetLength();
+
+	do {
+		auto offset (result.size());
+		result.resize(offset + 16u * 1024u);
+
+		m_Stream.next_out = reinterpret_cast<Bytef*>(result.data() + offset);
+		m_Stream.avail_out = result.size() - offset;
+
+		int rc = deflate(&m_Stream, Z_SYNC_FLUSH);
+
+		if (rc != Z_OK && rc != Z_BUF_ERROR) {
+			BOOST_THROW_EXCEPTION(std::runtime_error("Failed to compress JSON-RPC message: " + String(m_Stream.msg ? m_Stream.msg : "")));
+		}
+
+		result.resize(result.size() - m_Stream.avail_out);
+	} while (m_Stream.avail_out == 0u);
+
+	if (result.size() >= 1u + sizeof(l_SyncFlushTrailer)) {
+		result.resize(result.size() - sizeof(l_SyncFlushTrailer));
+	}
+
+	return String(result.begin(), result.end());
+}
+
+JsonRpcInflater::JsonRpcInflater()
+{
+	m_Stream.zalloc = Z_NULL;
+	m_Stream.zfree = Z_NULL;
+	m_Stream.opaque = Z_NULL;
+	m_Stream.next_in = Z_NULL;
+	m_Stream.avail_in = 0;
+
+	if (inflateInit2(&m_Stream, -15) != Z_OK) {
+		BOOST_THROW_EXCEPTION(std::runtime_error("Failed to initialize inflate stream: " + String(m_Stream.msg ? m_Stream.msg : "")));
+	}
+
+	inflateSetDictionary(&m_Stream, reinterpret_cast<const Bytef*>(l_Dictionary), sizeof(l_Dictionary) - 1u);
+}
+
+JsonRpcInflater::~JsonRpcInflater()
+{
+	inflateEnd(&m_Stream);
+}
+
+/**
+ * Tells whether a received message has been compressed by JsonRpcDeflater.
+ *
+ * @param message Message as read from the stream
+ *
+ * @return Whether the message has to be decompressed
+ */
+bool JsonRpcInflater::IsCompressed(const String& message)
+{
+	return !message.IsEmpty() && message[0] == l_CompressedMarker;
+}
+
+/**
+ * Decompresses a message. Messages have to be passed in the order they were compressed.
+ *
+ * @param message Compressed message
+ * @param maxMessageLength Limit for the decompressed message, -1 for no limit
+ *
+ * @return JSON or CBOR message
+ */
+String JsonRpcInflater::Decompress(const String& message, ssize_t maxMessageLength)
+{
+	std::vector<char> result;
+	bool trailerPending = true;
+
+	m_Stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(message.CStr() + 1));
+	m_Stream.avail_in = message.GetLength() - 1u;
+
+	for (;;) {
+		if (m_Stream.avail_in == 0u && trailerPending) {
+			m_Stream.next_in = const_cast<Bytef*>(l_SyncFlushTrailer);
+			m_Stream.avail_in = sizeof(l_SyncFlushTrailer);
+			trailerPending = false;
+		}
+
+		auto offset (result.size());
+		result.resize(offset + 16u * 1024u);
+
+		m_Stream.next_out = reinterpret_cast<Bytef*>(result.data() + offset);
+		m_Stream.avail_out = result.size() - offset;
+
+		int rc = inflate(&m_Stream, Z_SYNC_FLUSH);
+
+		result.resize(result.size() - m_Stream.avail_out);
+
+		if (rc != Z_OK && rc != Z_BUF_ERROR) {
+			BOOST_THROW_EXCEPTION(std::runtime_error("Failed to decompress JSON-RPC message: " + String(m_Stream.msg ? m_Stream.msg : "")));
+		}
+
+		if (maxMessageLength >= 0 && result.size() > (size_t)maxMessageLength) {
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Decompressed JSON-RPC message exceeds the maximum message length."));
+		}
+
+		if (m_Stream.avail_in == 0u && !trailerPending && m_Stream.avail_out != 0u) {
+			break;
+		}
+	}
+
+	return String(result.begin(), result.end());
+}
+
+#endif /* HAVE_ZLIB */
@@ -0,0 +1,63 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef JSONRPCCOMPRESSION_H
+#define JSONRPCCOMPRESSION_H
+
+#include "remote/i2-remote.hpp"
+#include "base/string.hpp"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+
+namespace icinga
+{
+
+/**
+ * Compresses the messages sent over one JSON-RPC connection.
+ *
+ * All messages share one deflate stream (and thereby its 32 KiB window) which
+ * is primed with a dictionary of common cluster message snippets.
+ * Each message is flushed separately and sent as its own netstring.
+ *
+ * @ingroup remote
+ */
+class JsonRpcDeflater
+{
+public:
+	explicit JsonRpcDeflater(int level);
+	JsonRpcDeflater(const JsonRpcDeflater&) = delete;
+	JsonRpcDeflater& operator=(const JsonRpcDeflater&) = delete;
+	~JsonRpcDeflater();
+
+	String Compress(const String& message);
+
+private:
+	z_stream m_Stream;
+};
+
+/**
+ * Decompresses the messages received over one JSON-RPC connection.
+ *
+ * @ingroup remote
+ */
+class JsonRpcInflater
+{
+public:
+	JsonRpcInflater();
+	JsonRpcInflater(const JsonRpcInflater&) = delete;
+	JsonRpcInflater& operator=(const JsonRpcInflater&) = delete;
+	~JsonRpcInflater();
+
+	static bool IsCompressed(const String& message);
+
+	String Decompress(const String& message, ssize_t maxMessageLength = -1);
+
+private:
+	z_stream m_Stream;
+};
+
+}
+
+#endif /* HAVE_ZLIB */
+
+#endif /* JSONRPCCOMPRESSION_H */
@@ -4,6 +4,7 @@
 #include "remote/apilistener.hpp"
 #include "remote/apifunction.hpp"
 #include "remote/jsonrpc.hpp"
+#include "base/configuration.hpp"
 #include "base/defer.hpp"
 #include "base/configtype.hpp"
 #include "base/io-engine.hpp"
@@ -29,6 +30,13 @@ REGISTER_APIFUNCTION(SetLogPosition, log, &SetLogPositionHandler);
 
 static RingBuffer l_TaskStats (15 * 60);
 
+/* Maximum number of pipelined messages per connection which have been read, but not handled yet. */
+static const size_t l_MaxPendingMessages = 1024;
+
+/* Maximum length of a decompressed message, for anonymous and authenticated peers. */
+static const ssize_t l_MaxAnonymousMessageLength = 1024 * 1024;
+static const ssize_t l_MaxDecompressedMessageLength = 512 * 1024 * 1024;
+
 JsonRpcConnection::JsonRpcConnection(const String& identity, bool authenticated,
 	const Shared<AsioTlsStream>::Ptr& stream, ConnectionRole role)
 	: JsonRpcConnection(identity, authenticated, stream, role, IoEngine::Get().GetIoContext())
@@ -38,20 +46,40 @@ JsonRpcConnection::JsonRpcConnection(const String& identity, bool authenticated,
 JsonRpcConnection::JsonRpcConnection(const String& identity, bool authenticated,
 	const Shared<AsioTlsStream>::Ptr& stream, ConnectionRole role, boost::asio::io_context& io)
 	: m_Identity(identity), m_Authenticated(authenticated), m_Stream(stream), m_Role(role),
-	m_Timestamp(Utility::GetTime()), m_Seen(Utility::GetTime()), m_NextHeartbeat(0), m_IoStrand(io),
-	m_OutgoingMessagesQueued(io), m_WriterDone(io), m_ShuttingDown(false),
-	m_CheckLivenessTimer(io), m_HeartbeatTimer(io)
+	m_Timestamp(Utility::GetTime()), m_Seen(Utility::GetTime()), m_NextHeartbeat(0), m_Encoding(JsonRpcEncoding::Json), m_CborAccepted(false), m_IoStrand(io),
+	m_PendingMessages(0), m_PendingMessagesProcessed(io), m_OutgoingMessagesQueued(io), m_WriterDone(io),
+	m_ShuttingDown(false), m_CheckLivenessTimer(io), m_HeartbeatTimer(io)
 {
 	if (authenticated)
 		m_Endpoint = Endpoint::GetByName(identity);
 }
 
+JsonRpcConnection::MessageLane::MessageLane(boost::asio::io_context& io)
+	: Strand(io), Queued(io), ShuttingDown(false)
+{
+}
+
 void JsonRpcConnection::Start()
 {
 	namespace asio = boost::asio;
 
 	JsonRpcConnection::Ptr keepAlive (this);
 
+	auto listener (ApiListener::GetInstance());
+
+	/* Messages from anonymous clients are few, don't bother pipelining them. */
+	if (m_Endpoint && listener && listener->GetEnableMessagePipelining() && Configuration::Concurrency > 1) {
+		for (auto i (Configuration::Concurrency); i; --i) {
+			m_MessageLanes.emplace_back(new MessageLane(m_IoStrand.context()));
+		}
+	}
+
+	for (auto& lane : m_MessageLanes) {
+		auto l (lane.get());
+
+		IoEngine::SpawnCoroutine(l->Strand, [this, keepAlive, l](asio::yield_context yc) { HandlePipelinedMessages(*l, yc); });
+	}
+
 	IoEngine::SpawnCoroutine(m_IoStrand, [this, keepAlive](asio::yield_context yc) { HandleIncomingMessages(yc); });
 	IoEngine::SpawnCoroutine(m_IoStrand, [this, keepAlive](asio::yield_context yc) { WriteOutgoingMessages(yc); });
 	IoEngine::SpawnCoroutine(m_IoStrand, [this, keepAlive](asio::yield_context yc) { HandleAndWriteHeartbeats(yc); });
@@ -66,7 +94,7 @@ void JsonRpcConnection::HandleIncomingMessages(boost::asio::yield_context yc)
 		String message;
 
 		try {
-			message = JsonRpc::ReadMessage(m_Stream, yc, m_Endpoint ? -1 : 1024 * 1024);
+			message = JsonRpc::ReadMessage(m_Stream, yc, m_Endpoint ? -1 : l_MaxAnonymousMessageLength);
 		} catch (const std::exception& ex) {
 			Log(m_ShuttingDown ? LogDebug : LogNotice, "JsonRpcConnection")
 				<< "Error while reading JSON-RPC message for identity '" << m_Identity
@@ -78,11 +106,18 @@ void JsonRpcConnection::HandleIncomingMessages(boost::asio::yield_context yc)
 		m_Seen = Utility::GetTime();
 
 		try {
-			CpuBoundWork handleMessage (yc);
+			if (m_MessageLanes.empty()) {
+				CpuBoundWork handleMessage (yc);
 
-			MessageHandler(message);
+				size_t wireLength = message.GetLength();
 
-			l_TaskStats.InsertValue(Utility::GetTime(), 1);
+				DecompressMessage(message);
+				MessageHandler(message, wireLength);
+
+				l_TaskStats.InsertValue(Utility::GetTime(), 1);
+			} else {
+				PipelineMessage(std::move(message), yc);
+			}
 		} catch (const std::exception& ex) {
 			Log(m_ShuttingDown ? LogDebug : LogWarning, "JsonRpcConnection")
 				<< "Error while processing JSON-RPC message for identity '" << m_Identity
@@ -95,6 +130,53 @@ void JsonRpcConnection::HandleIncomingMessages(boost::asio::yield_context yc)
 	Disconnect();
 }
 
+/**
+ * Reads the decoded messages dispatched to a lane by PipelineMessage() and handles them.
+ *
+ * @param lane The lane, all of its members are only accessed on its strand
+ * @param yc Yield context of a coroutine on the lane's strand
+ */
+void JsonRpcConnection::HandlePipelinedMessages(MessageLane& lane, boost::asio::yield_context yc)
+{
+	JsonRpcConnection::Ptr keepAlive (this);
+
+	do {
+		lane.Queued.Wait(yc);
+
+		auto queue (std::move(lane.Queue));
+
+		lane.Queue.clear();
+		lane.Queued.Clear();
+
+		for (auto& message : queue) {
+			/* Even if we're shutting down, account the message not to stall the reader. */
+			if (!lane.ShuttingDown) {
+				try {
+					CpuBoundWork handleMessage (yc);
+
+					Dictionary::Ptr resultMessage = HandleMessage(message);
+
+					if (resultMessage)
+						SendMessage(resultMessage);
+
+					l_TaskStats.InsertValue(Utility::GetTime(), 1);
+				} catch (const std::exception& ex) {
+					Log(LogWarning, "JsonRpcConnection")
+						<< "Error while processing JSON-RPC message for identity '" << m_Identity
+						<< "': " << DiagnosticInformation(ex);
+
+					lane.ShuttingDown = true;
+					Disconnect();
+				}
+			}
+
+			--m_PendingMessages;
+
+			m_IoStrand.post([this, keepAlive]() { m_PendingMessagesProcessed.Set(); });
+		}
+	} while (!lane.ShuttingDown);
+}
+
 void JsonRpcConnection::WriteOutgoingMessages(boost::asio::yield_context yc)
 {
 	Defer signalWriterDone ([this]() { m_WriterDone.Set(); });
@@ -109,11 +191,29 @@ void JsonRpcConnection::WriteOutgoingMessages(boost::asio::yield_context yc)
 
 		if (!queue.empty()) {
 			try {
-				for (auto& message : queue) {
-					size_t bytesSent = JsonRpc::SendRawMessage(m_Stream, message, yc);
+				std::vector<String> compressed;
+
+#ifdef HAVE_ZLIB
+				if (m_Deflater) {
+					/* Compress the whole batch before sending, so the slot isn't held while sending. */
+					CpuBoundWork compressMessages (yc);
+
+					compressed.reserve(queue.size());
+
+					for (auto& message : queue) {
+						compressed.emplace_back(m_Deflater->Compress(*message));
+					}
+				}
+#endif /* HAVE_ZLIB */
+
+				for (size_t i = 0; i < queue.size(); i++) {
+					auto& message (queue[i]);
+					const String* payload = compressed.empty() ? message.get() : &compressed[i];
+
+					size_t bytesSent = JsonRpc::SendRawMessage(m_Stream, *payload, yc);
 
 					if (m_Endpoint) {
-						m_Endpoint->AddMessageSent(bytesSent);
+						m_Endpoint->AddMessageSent(bytesSent, bytesSent - payload->GetLength() + message->GetLength());
 					}
 				}
 
@@ -161,6 +261,52 @@ ConnectionRole JsonRpcConnection::GetRole() const
 	return m_Role;
 }
 
+/**
+ * Get the encoding used for messages sent by us. Received ones are detected automatically,
+ * see AcceptCbor().
+ *
+ * @return The outgoing message encoding
+ */
+JsonRpcEncoding JsonRpcConnection::GetEncoding() const
+{
+	return m_Encoding.load();
+}
+
+void JsonRpcConnection::SetEncoding(JsonRpcEncoding encoding)
+{
+	m_Encoding.store(encoding);
+}
+
+/**
+ * Accept CBOR-encoded messages from now on. Until then all received messages are decoded as JSON.
+ * Only for authenticated peers which announced ApiCapabilities::CborMessages in icinga::Hello.
+ */
+void JsonRpcConnection::AcceptCbor()
+{
+	if (m_Endpoint) {
+		m_CborAccepted.store(true);
+	}
+}
+
+/**
+ * Compress all messages sent from now on. The peer must have announced
+ * ApiCapabilities::CompressedMessages.
+ *
+ * @param level zlib compression level (1-9)
+ */
+void JsonRpcConnection::EnableCompression(int level)
+{
+#ifdef HAVE_ZLIB
+	Ptr keepAlive (this);
+
+	m_IoStrand.post([this, keepAlive, level]() {
+		if (!m_Deflater) {
+			m_Deflater.reset(new JsonRpcDeflater(level));
+		}
+	});
+#endif /* HAVE_ZLIB */
+}
+
 void JsonRpcConnection::SendMessage(const Dictionary::Ptr& message)
 {
 	Ptr keepAlive (this);
@@ -169,6 +315,17 @@ void JsonRpcConnection::SendMessage(const Dictionary::Ptr& message)
 }
 
 void JsonRpcConnection::SendRawMessage(const String& message)
+{
+	SendRawMessage(std::make_shared<const String>(message));
+}
+
+/**
+ * Queues an already encoded message. The buffer is shared rather than copied,
+ * so the same message can be queued for any number of connections.
+ *
+ * @param message The encoded message, must not be modified afterwards.
+ */
+void JsonRpcConnection::SendRawMessage(const std::shared_ptr<const String>& message)
 {
 	Ptr keepAlive (this);
 
@@ -180,7 +337,7 @@ void JsonRpcConnection::SendRawMessage(const String& message)
 
 void JsonRpcConnection::SendMessageInternal(const Dictionary::Ptr& message)
 {
-	m_OutgoingMessagesQueue.emplace_back(JsonEncode(message));
+	m_OutgoingMessagesQueue.emplace_back(std::make_shared<const String>(JsonRpc::EncodeMessage(message, m_Encoding.load())));
 	m_OutgoingMessagesQueued.Set();
 }
 
@@ -208,6 +365,16 @@ void JsonRpcConnection::Disconnect()
 			}
 
 			m_OutgoingMessagesQueued.Set();
+			m_PendingMessagesProcessed.Set();
+
+			for (auto& lane : m_MessageLanes) {
+				auto l (lane.get());
+
+				l->Strand.post([l, keepAlive]() {
+					l->ShuttingDown = true;
+					l->Queued.Set();
+				});
+			}
 
 			m_WriterDone.Wait(yc);
 
@@ -245,20 +412,156 @@ void JsonRpcConnection::Disconnect()
 	});
 }
 
-void JsonRpcConnection::MessageHandler(const String& jsonString)
+/**
+ * Decompresses a message in place if the peer has compressed it.
+ *
+ * @param message Message as read from the stream
+ */
+void JsonRpcConnection::DecompressMessage(String& message)
+{
+#ifdef HAVE_ZLIB
+	if (JsonRpcInflater::IsCompressed(message)) {
+		if (!m_Inflater) {
+			m_Inflater.reset(new JsonRpcInflater());
+		}
+
+		/* A few bytes may decompress to a huge message, so limit it for authenticated peers, too. */
+		message = m_Inflater->Decompress(message, m_Endpoint ? l_MaxDecompressedMessageLength : l_MaxAnonymousMessageLength);
+	}
+#endif /* HAVE_ZLIB */
+}
+
+/**
+ * Decodes a message and dispatches it to one of the lanes by its host name, so that
+ * messages about different hosts are handled in parallel, but the ones about the
+ * same host or its services in the order they arrived.
+ *
+ * Messages not concerning a particular host (e.g. config updates) wait for all
+ * pending ones and are handled directly, in order with all others.
+ *
+ * @param message Message as read from the stream
+ * @param yc Yield context of the reader coroutine
+ */
+void JsonRpcConnection::PipelineMessage(String message, boost::asio::yield_context yc)
 {
-	Dictionary::Ptr message = JsonRpc::DecodeMessage(jsonString);
+	Dictionary::Ptr request;
+	Value host;
+
+	{
+		CpuBoundWork decodeMessage (yc);
+
+		size_t wireLength = message.GetLength();
+
+		DecompressMessage(message);
+
+		request = JsonRpc::DecodeMessage(message, m_CborAccepted.load());
+
+		if (!AcceptMessage(request, wireLength, message.GetLength()))
+			return;
+
+		Value params = request->Get("params");
+
+		if (params.IsObjectType<Dictionary>())
+			host = ((Dictionary::Ptr)params)->Get("host");
+	}
+
+	if (!host.IsString()) {
+		WaitForPendingMessages(0, yc);
+
+		CpuBoundWork handleMessage (yc);
+
+		Dictionary::Ptr resultMessage = HandleMessage(request);
+
+		if (resultMessage)
+			SendMessageInternal(resultMessage);
+
+		l_TaskStats.InsertValue(Utility::GetTime(), 1);
+		return;
+	}
+
+	WaitForPendingMessages(l_MaxPendingMessages - 1u, yc);
+
+	if (m_ShuttingDown)
+		return;
+
+	auto lane (m_MessageLanes[std::hash<String>()(host.Get<String>()) % m_MessageLanes.size()].get());
+	Ptr keepAlive (this);
+
+	++m_PendingMessages;
 
+	lane->Strand.post([lane, keepAlive, request]() {
+		lane->Queue.emplace_back(request);
+		lane->Queued.Set();
+	});
+}
+
+/**
+ * Waits until at most the given number of pipelined messages are pending or we're shutting down.
+ *
+ * @param limit Number of messages which may still be pending
+ * @param yc Yield context of the reader coroutine
+ */
+void JsonRpcConnection::WaitForPendingMessages(size_t limit, boost::asio::yield_context yc)
+{
+	while (m_PendingMessages.load() > limit && !m_ShuttingDown) {
+		m_PendingMessagesProcessed.Clear();
+
+		if (m_PendingMessages.load() > limit) {
+			m_PendingMessagesProcessed.Wait(yc);
+		}
+	}
+}
+
+void JsonRpcConnection::MessageHandler(const String& jsonString, size_t wireLength)
+{
+	Dictionary::Ptr message = JsonRpc::DecodeMessage(jsonString, m_CborAccepted.load());
+
+	if (!AcceptMessage(message, wireLength, jsonString.GetLength()))
+		return;
+
+	Dictionary::Ptr resultMessage = HandleMessage(message);
+
+	if (resultMessage)
+		SendMessageInternal(resultMessage);
+}
+
+/**
+ * Does the bookkeeping for a received message which has to happen in the order the messages arrived.
+ *
+ * @param message The decoded message
+ * @param wireLength Size of the message as received
+ * @param length Size of the message after decompression
+ *
+ * @return Whether the message should be handled, i.e. isn't older than the last one we got
+ */
+bool JsonRpcConnection::AcceptMessage(const Dictionary::Ptr& message, size_t wireLength, size_t length)
+{
 	if (m_Endpoint && message->Contains("ts")) {
 		double ts = message->Get("ts");
 
 		/* ignore old messages */
 		if (ts < m_Endpoint->GetRemoteLogPosition())
-			return;
+			return false;
 
 		m_Endpoint->SetRemoteLogPosition(ts);
 	}
 
+	if (m_Endpoint) {
+		m_Endpoint->AddMessageReceived(wireLength, length);
+	}
+
+	return true;
+}
+
+/**
+ * Calls the API function a message refers to.
+ *
+ * @param message The decoded message
+ *
+ * @return The response to send back, if the peer expects one
+ */
+Dictionary::Ptr JsonRpcConnection::HandleMessage(const Dictionary::Ptr& message)
+{
 	MessageOrigin::Ptr origin = new MessageOrigin();
 	origin->FromClient = this;
 
@@ -267,8 +570,6 @@ void JsonRpcConnection::MessageHandler(const String& jsonString)
 			origin->FromZone = m_Endpoint->GetZone();
 		else
 			origin->FromZone = Zone::GetByName(message->Get("originZone"));
-
-		m_Endpoint->AddMessageReceived(jsonString.GetLength());
 	}
 
 	Value vmethod;
@@ -277,12 +578,12 @@ void JsonRpcConnection::MessageHandler(const String& jsonString)
 		Value vid;
 
 		if (!message->Get("id", &vid))
-			return;
+			return nullptr;
 
 		Log(LogWarning, "JsonRpcConnection",
 			"We received a JSON-RPC response message. This should never happen because we're only ever sending notifications.");
 
-		return;
+		return nullptr;
 	}
 
 	String method = vmethod;
@@ -317,8 +618,10 @@ void JsonRpcConnection::MessageHandler(const String& jsonString)
 		resultMessage->Set("jsonrpc", "2.0");
 		resultMessage->Set("id", message->Get("id"));
 
-		SendMessageInternal(resultMessage);
+		return resultMessage;
 	}
+
+	return nullptr;
 }
 
 Value SetLogPositionHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
@@ -5,10 +5,14 @@
 
 #include "remote/i2-remote.hpp"
 #include "remote/endpoint.hpp"
+#include "remote/jsonrpc.hpp"
+#include "remote/jsonrpccompression.hpp"
 #include "base/io-engine.hpp"
 #include "base/tlsstream.hpp"
 #include "base/timer.hpp"
 #include "base/workqueue.hpp"
+#include <atomic>
+#include <deque>
 #include <memory>
 #include <vector>
 #include <boost/asio/io_context.hpp>
@@ -52,11 +56,16 @@ public:
 	Endpoint::Ptr GetEndpoint() const;
 	Shared<AsioTlsStream>::Ptr GetStream() const;
 	ConnectionRole GetRole() const;
+	JsonRpcEncoding GetEncoding() const;
+	void SetEncoding(JsonRpcEncoding encoding);
+	void AcceptCbor();
+	void EnableCompression(int level);
 
 	void Disconnect();
 
 	void SendMessage(const Dictionary::Ptr& request);
 	void SendRawMessage(const String& request);
+	void SendRawMessage(const std::shared_ptr<const String>& request);
 
 	static Value HeartbeatAPIHandler(const intrusive_ptr<MessageOrigin>& origin, const Dictionary::Ptr& params);
 
@@ -65,6 +74,19 @@ public:
 	static void SendCertificateRequest(const JsonRpcConnection::Ptr& aclient, const intrusive_ptr<MessageOrigin>& origin, const String& path);
 
 private:
+	/**
+	 * Handles the pipelined messages concerning some of the hosts (and their services) in order.
+	 */
+	struct MessageLane
+	{
+		MessageLane(boost::asio::io_context& io);
+
+		boost::asio::io_context::strand Strand;
+		std::deque<Dictionary::Ptr> Queue;
+		AsioConditionVariable Queued;
+		bool ShuttingDown;
+	};
+
 	String m_Identity;
 	bool m_Authenticated;
 	Endpoint::Ptr m_Endpoint;
@@ -73,8 +95,17 @@ private:
 	double m_Timestamp;
 	double m_Seen;
 	double m_NextHeartbeat;
+	std::atomic<JsonRpcEncoding> m_Encoding;
+	std::atomic<bool> m_CborAccepted;
 	boost::asio::io_context::strand m_IoStrand;
-	std::vector<String> m_OutgoingMessagesQueue;
+	std::vector<std::shared_ptr<const String>> m_OutgoingMessagesQueue;
+#ifdef HAVE_ZLIB
+	std::unique_ptr<JsonRpcDeflater> m_Deflater;
+	std::unique_ptr<JsonRpcInflater> m_Inflater;
+#endif /* HAVE_ZLIB */
+	std::vector<std::unique_ptr<MessageLane>> m_MessageLanes;
+	std::atomic<size_t> m_PendingMessages;
+	AsioConditionVariable m_PendingMessagesProcessed;
 	AsioConditionVariable m_OutgoingMessagesQueued;
 	AsioConditionVariable m_WriterDone;
 	bool m_ShuttingDown;
@@ -86,9 +117,15 @@ private:
 	void WriteOutgoingMessages(boost::asio::yield_context yc);
 	void HandleAndWriteHeartbeats(boost::asio::yield_context yc);
 	void CheckLiveness(boost::asio::yield_context yc);
+	void HandlePipelinedMessages(MessageLane& lane, boost::asio::yield_context yc);
 
 	bool ProcessMessage();
-	void MessageHandler(const String& jsonString);
+	void DecompressMessage(String& message);
+	void MessageHandler(const String& jsonString, size_t wireLength);
+	void PipelineMessage(String message, boost::asio::yield_context yc);
+	void WaitForPendingMessages(size_t limit, boost::asio::yield_context yc);
+	bool AcceptMessage(const Dictionary::Ptr& message, size_t wireLength, size_t length);
+	Dictionary::Ptr HandleMessage(const Dictionary::Ptr& message);
 
 	void CertificateRequestResponseHandler(const Dictionary::Ptr& message);
 
@@ -6,7 +6,10 @@
 #include "base/serializer.hpp"
 #include "base/dependencygraph.hpp"
 #include "base/configtype.hpp"
+#include "base/io-engine.hpp"
 #include <boost/algorithm/string/case_conv.hpp>
+#include <boost/beast/http.hpp>
+#include <stdexcept>
 #include <set>
 #include <unordered_map>
 
@@ -165,9 +168,6 @@ bool ObjectQueryHandler::HandleRequest(
 		return true;
 	}
 
-	ArrayData results;
-	results.reserve(objs.size());
-
 	std::set<String> joinAttrs;
 	std::set<String> userJoinAttrs;
 
@@ -193,7 +193,7 @@ bool ObjectQueryHandler::HandleRequest(
 	std::unordered_map<Type*, std::pair<bool, std::unique_ptr<Expression>>> typePermissions;
 	std::unordered_map<Object*, bool> objectAccessAllowed;
 
-	for (const ConfigObject::Ptr& obj : objs) {
+	auto serializeObject ([&](const ConfigObject::Ptr& obj, String& error) -> Dictionary::Ptr {
 		DictionaryData result1{
 			{ "name", obj->GetName() },
 			{ "type", obj->GetReflectionType()->GetName() }
@@ -223,8 +223,8 @@ bool ObjectQueryHandler::HandleRequest(
 				} else if (meta == "location") {
 					metaAttrs.emplace_back("location", obj->GetSourceLocation());
 				} else {
-					HttpUtility::SendJsonError(response, params, 400, "Invalid field specified for meta: " + meta);
-					return true;
+					error = "Invalid field specified for meta: " + meta;
+					return nullptr;
 				}
 			}
 		}
@@ -234,8 +234,8 @@ bool ObjectQueryHandler::HandleRequest(
 		try {
 			result1.emplace_back("attrs", SerializeObjectAttrs(obj, String(), uattrs, false, false));
 		} catch (const ScriptError& ex) {
-			HttpUtility::SendJsonError(response, params, 400, ex.what());
-			return true;
+			error = ex.what();
+			return nullptr;
 		}
 
 		DictionaryData joins;
@@ -245,15 +245,15 @@ bool ObjectQueryHandler::HandleRequest(
 			int fid = type->GetFieldId(joinAttr);
 
 			if (fid < 0) {
-				HttpUtility::SendJsonError(response, params, 400, "Invalid field specified for join: " + joinAttr);
-				return true;
+				error = "Invalid field specified for join: " + joinAttr;
+				return nullptr;
 			}
 
 			Field field = type->GetFieldInfo(fid);
 
 			if (!(field.Attributes & FANavigation)) {
-				HttpUtility::SendJsonError(response, params, 400, "Not a joinable field: " + joinAttr);
-				return true;
+				error = "Not a joinable field: " + joinAttr;
+				return nullptr;
 			}
 
 			joinedObj = obj->NavigateField(fid);
@@ -309,22 +309,82 @@ bool ObjectQueryHandler::HandleRequest(
 			try {
 				joins.emplace_back(prefix, SerializeObjectAttrs(joinedObj, prefix, ujoins, true, allJoins));
 			} catch (const ScriptError& ex) {
-				HttpUtility::SendJsonError(response, params, 400, ex.what());
-				return true;
+				error = ex.what();
+				return nullptr;
 			}
 		}
 
 		result1.emplace_back("joins", new Dictionary(std::move(joins)));
 
-		results.push_back(new Dictionary(std::move(result1)));
+		return new Dictionary(std::move(result1));
+	});
+
+	/* Errors which apply to all objects are detected by the first one, before the response is sent. */
+	Dictionary::Ptr firstResult;
+
+	if (!objs.empty()) {
+		String error;
+		firstResult = serializeObject(objs[0], error);
+
+		if (!firstResult) {
+			HttpUtility::SendJsonError(response, params, 400, error);
+			return true;
+		}
 	}
 
-	Dictionary::Ptr result = new Dictionary({
-		{ "results", new Array(std::move(results)) }
-	});
+	/* HTTP/1.0 doesn't support chunked transfer encoding. */
+	if (request.version() == 10) {
+		ArrayData results;
+		results.reserve(objs.size());
+
+		if (firstResult)
+			results.emplace_back(firstResult);
+
+		for (decltype(objs.size()) i = 1; i < objs.size(); i++) {
+			String error;
+			Dictionary::Ptr result = serializeObject(objs[i], error);
+
+			if (!result) {
+				HttpUtility::SendJsonError(response, params, 400, error);
+				return true;
+			}
+
+			results.emplace_back(std::move(result));
+		}
+
+		Dictionary::Ptr result = new Dictionary({
+			{ "results", new Array(std::move(results)) }
+		});
+
+		response.result(http::status::ok);
+		HttpUtility::SendJsonBody(response, params, result);
+
+		return true;
+	}
+
+	/* Otherwise the objects are serialized and sent one chunk at a time, so the whole
+	 * response never has to be kept in memory.
+	 */
+	server.StartChunkedResponse();
 
 	response.result(http::status::ok);
-	HttpUtility::SendJsonBody(response, params, result);
+
+	HttpUtility::SendJsonArrayChunked(stream, response, "results", objs.size(), [&objs, &firstResult, &serializeObject](size_t i) -> Value {
+		if (i == 0)
+			return std::move(firstResult);
+
+		String error;
+		Dictionary::Ptr result = serializeObject(objs[i], error);
+
+		if (!result)
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Error while streaming objects: " + error));
+
+		return result;
+	}, HttpUtility::GetLastParameter(params, "pretty"), yc);
+
+	IoBoundWorkSlot dontLockTheIoThread (yc);
+
+	stream.async_flush(yc);
 
 	return true;
 }
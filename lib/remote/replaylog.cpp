@@ -0,0 +1,526 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "remote/replaylog.hpp"
+#include "base/dictionary.hpp"
+#include "base/json.hpp"
+#include "base/netstring.hpp"
+#include "base/utility.hpp"
+#include <algorithm>
+#include <boost/filesystem/operations.hpp>
+#include <boost/throw_exception.hpp>
+#include <cstring>
+#include <stdexcept>
+
+using namespace icinga;
+
+static const char l_SegmentMagic[] = "I2RLOG01";
+static const char l_IndexMagic[] = "I2RLIDX1";
+static const uint64_t l_MagicLength = 8;
+static const uint64_t l_IndexTrailerLength = 8 + 8 + l_MagicLength;
+static const uint64_t l_IndexEntryLength = 8 + 8;
+static const uint64_t l_IndexInterval = 1024;
+
+/* uint32 length + double timestamp */
+static const uint64_t l_RecordHeadLength = 4 + 8;
+
+static const unsigned char l_FlagSecobj = 1;
+static const unsigned char l_FlagZone = 2;
+
+static void AppendUInt32(std::string& buffer, uint32_t value)
+{
+	for (int shift = 0; shift < 32; shift += 8) {
+		buffer += (char)(value >> shift);
+	}
+}
+
+static void AppendUInt64(std::string& buffer, uint64_t value)
+{
+	for (int shift = 0; shift < 64; shift += 8) {
+		buffer += (char)(value >> shift);
+	}
+}
+
+static void AppendDouble(std::string& buffer, double value)
+{
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	AppendUInt64(buffer, bits);
+}
+
+static void AppendString(std::string& buffer, const String& value)
+{
+	AppendUInt32(buffer, value.GetLength());
+	buffer.append(value.Begin(), value.End());
+}
+
+static uint32_t ParseUInt32(const char *data)
+{
+	uint32_t value = 0;
+
+	for (int i = 3; i >= 0; i--) {
+		value = (value << 8u) | (unsigned char)data[i];
+	}
+
+	return value;
+}
+
+static uint64_t ParseUInt64(const char *data)
+{
+	uint64_t value = 0;
+
+	for (int i = 7; i >= 0; i--) {
+		value = (value << 8u) | (unsigned char)data[i];
+	}
+
+	return value;
+}
+
+static double ParseDouble(const char *data)
+{
+	uint64_t bits = ParseUInt64(data);
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+/**
+ * Reads a length-prefixed string from a record's body.
+ *
+ * @param body The record without its head
+ * @param pos Position of the length, advanced past the string
+ *
+ * @return The string
+ */
+static String ParseString(const std::string& body, size_t& pos)
+{
+	if (body.size() - pos < 4u) {
+		BOOST_THROW_EXCEPTION(std::runtime_error("Corrupt replay log record."));
+	}
+
+	uint32_t length = ParseUInt32(body.data() + pos);
+	pos += 4u;
+
+	if (body.size() - pos < length) {
+		BOOST_THROW_EXCEPTION(std::runtime_error("Corrupt replay log record."));
+	}
+
+	String value (body.begin() + pos, body.begin() + pos + length);
+	pos += length;
+
+	return value;
+}
+
+/**
+ * Reads a segment's index, if it has one.
+ *
+ * @param file The segment
+ * @param size The size of the segment
+ * @param index Receives the index entries
+ *
+ * @return The offset of the index, i.e. the end of the records, or 0 if there's no index
+ */
+static uint64_t ReadIndex(std::istream& file, uint64_t size, std::vector<ReplayLogIndexEntry>& index)
+{
+	if (size < l_MagicLength + l_IndexTrailerLength)
+		return 0;
+
+	char trailer[l_IndexTrailerLength];
+
+	file.seekg(size - l_IndexTrailerLength);
+
+	if (!file.read(trailer, l_IndexTrailerLength) || memcmp(trailer + 16, l_IndexMagic, l_MagicLength) != 0) {
+		file.clear();
+		return 0;
+	}
+
+	uint64_t count = ParseUInt64(trailer);
+	uint64_t offset = ParseUInt64(trailer + 8);
+
+	if (offset < l_MagicLength || offset > size - l_IndexTrailerLength
+		|| (size - l_IndexTrailerLength - offset) != count * l_IndexEntryLength) {
+		return 0;
+	}
+
+	std::string entries (count * l_IndexEntryLength, '\0');
+
+	file.seekg(offset);
+
+	if (!file.read(&entries[0], entries.size())) {
+		file.clear();
+		return 0;
+	}
+
+	index.clear();
+	index.reserve(count);
+
+	for (uint64_t i = 0; i < count; i++) {
+		const char *entry = entries.data() + i * l_IndexEntryLength;
+		index.push_back({ ParseDouble(entry), ParseUInt64(entry + 8) });
+	}
+
+	return offset;
+}
+
+/**
+ * Opens a segment for appending, creating it if necessary.
+ *
+ * An existing segment is checked record by record. Its index (if any)
+ * as well as a partially written record at the end are removed.
+ *
+ * @param path The segment
+ */
+ReplayLogWriter::ReplayLogWriter(const String& path)
+	: m_Offset(0), m_Records(0), m_MaxTimestamp(0)
+{
+	m_Offset = Recover(path);
+
+	m_File.open(path.CStr(), std::fstream::out | std::fstream::binary | std::fstream::app);
+
+	if (!m_File) {
+		BOOST_THROW_EXCEPTION(std::runtime_error("Could not open replay log segment '" + path + "'."));
+	}
+
+	if (m_Offset == 0) {
+		m_File.write(l_SegmentMagic, l_MagicLength);
+		m_Offset = l_MagicLength;
+	}
+}
+
+uint64_t ReplayLogWriter::Recover(const String& path)
+{
+	std::ifstream file (path.CStr(), std::ifstream::binary | std::ifstream::ate);
+
+	if (!file)
+		return 0;
+
+	uint64_t size = file.tellg();
+
+	if (size == 0)
+		return 0;
+
+	char magic[l_MagicLength];
+
+	file.seekg(0);
+
+	if (size < l_MagicLength || !file.read(magic, l_MagicLength) || memcmp(magic, l_SegmentMagic, l_MagicLength) != 0) {
+		BOOST_THROW_EXCEPTION(std::runtime_error("'" + path + "' is not a replay log segment."));
+	}
+
+	std::vector<ReplayLogIndexEntry> index;
+	uint64_t end = ReadIndex(file, size, index);
+
+	if (end == 0)
+		end = size;
+
+	uint64_t offset = l_MagicLength;
+
+	file.seekg(offset);
+
+	while (end - offset >= l_RecordHeadLength) {
+		char head[l_RecordHeadLength];
+
+		if (!file.read(head, l_RecordHeadLength))
+			break;
+
+		uint32_t length = ParseUInt32(head);
+
+		if (length < 8u || end - offset - 4u < length)
+			break;
+
+		if (m_Records % l_IndexInterval == 0) {
+			m_Index.push_back({ m_MaxTimestamp, offset });
+		}
+
+		m_MaxTimestamp = std::max(m_MaxTimestamp, ParseDouble(head + 4));
+		m_Records++;
+
+		offset += 4u + length;
+		file.seekg(offset);
+	}
+
+	file.close();
+
+	if (offset != size) {
+		boost::filesystem::resize_file(path.GetData(), offset);
+	}
+
+	return offset;
+}
+
+/**
+ * Appends a record.
+ *
+ * @param record The record
+ */
+void ReplayLogWriter::Write(const ReplayLogRecord& record)
+{
+	unsigned char flags = 0;
+
+	if (!record.SecobjType.IsEmpty())
+		flags |= l_FlagSecobj;
+
+	if (!record.Zone.IsEmpty())
+		flags |= l_FlagZone;
+
+	std::string buffer;
+	buffer.reserve(64u + record.SecobjType.GetLength() + record.SecobjName.GetLength() + record.Zone.GetLength() + record.Message.GetLength());
+
+	AppendUInt32(buffer, 0);
+	AppendDouble(buffer, record.Timestamp);
+	buffer += (char)flags;
+
+	if (flags & l_FlagSecobj) {
+		AppendString(buffer, record.SecobjType);
+		AppendString(buffer, record.SecobjName);
+	}
+
+	if (flags & l_FlagZone)
+		AppendString(buffer, record.Zone);
+
+	AppendString(buffer, record.Message);
+
+	std::string length;
+	AppendUInt32(length, buffer.size() - 4u);
+	buffer.replace(0, 4, length);
+
+	if (m_Records % l_IndexInterval == 0) {
+		m_Index.push_back({ m_MaxTimestamp, m_Offset });
+	}
+
+	m_File.write(buffer.data(), buffer.size());
+
+	m_Offset += buffer.size();
+	m_Records++;
+	m_MaxTimestamp = std::max(m_MaxTimestamp, record.Timestamp);
+}
+
+/**
+ * Makes the written records visible to readers.
+ *
+ * Unlike the other methods, this may be called concurrently.
+ */
+void ReplayLogWriter::Flush()
+{
+	std::unique_lock<std::mutex> lock (m_FlushMutex);
+	m_File.flush();
+}
+
+/**
+ * Returns the index of the records written so far, for reading the segment
+ * before it's finished.
+ *
+ * @return The index entries
+ */
+std::vector<ReplayLogIndexEntry> ReplayLogWriter::GetIndex() const
+{
+	return m_Index;
+}
+
+/**
+ * Returns the end of the records written so far, for reading the segment
+ * before it's finished. Only the records before it are complete.
+ *
+ * @return The offset of the next record
+ */
+uint64_t ReplayLogWriter::GetOffset() const
+{
+	return m_Offset;
+}
+
+/**
+ * Closes the segment.
+ *
+ * @param finish Whether to append the index, i.e. the segment won't be written to anymore
+ */
+void ReplayLogWriter::Close(bool finish)
+{
+	if (finish) {
+		std::string buffer;
+		buffer.reserve(m_Index.size() * l_IndexEntryLength + l_IndexTrailerLength);
+
+		for (auto& entry : m_Index) {
+			AppendDouble(buffer, entry.MaxTimestampBefore);
+			AppendUInt64(buffer, entry.Offset);
+		}
+
+		AppendUInt64(buffer, m_Index.size());
+		AppendUInt64(buffer, m_Offset);
+		buffer.append(l_IndexMagic, l_MagicLength);
+
+		m_File.write(buffer.data(), buffer.size());
+	}
+
+	m_File.close();
+}
+
+ReplayLogReader::ReplayLogReader(const String& path)
+	: m_Legacy(false), m_File(new std::fstream(path.CStr(), std::fstream::in | std::fstream::binary)), m_DataEnd(UINT64_MAX), m_Seeked(false)
+{
+	char magic[l_MagicLength];
+
+	if (!m_File->read(magic, l_MagicLength) && m_File->gcount() == 0) {
+		/* Empty (or missing) segment, nothing to read. */
+		m_DataEnd = 0;
+		return;
+	}
+
+	if (m_File->gcount() == l_MagicLength && memcmp(magic, l_SegmentMagic, l_MagicLength) == 0) {
+		m_File->seekg(0, std::fstream::end);
+
+		uint64_t size = m_File->tellg();
+		uint64_t end = ReadIndex(*m_File, size, m_Index);
+
+		/* Segments without an index may still be written to, records must not exceed what's there already. */
+		m_DataEnd = end ? end : size;
+
+		m_File->seekg(l_MagicLength);
+		return;
+	}
+
+	m_Legacy = true;
+	m_File->clear();
+	m_File->seekg(0);
+	m_LegacyStream = new StdioStream(m_File.release(), true);
+}
+
+/**
+ * Opens a segment which is still being written to.
+ *
+ * The writer may continue (or finish the segment by appending its index) while this reads,
+ * so the reader is bounded by the end of the records written at the time it has been opened.
+ *
+ * @param path The segment
+ * @param index The index kept by the segment's writer, see ReplayLogWriter#GetIndex()
+ * @param dataEnd The end of the records written so far, see ReplayLogWriter#GetOffset()
+ */
+ReplayLogReader::ReplayLogReader(const String& path, const std::vector<ReplayLogIndexEntry>& index, uint64_t dataEnd)
+	: ReplayLogReader(path)
+{
+	if (m_Legacy)
+		return;
+
+	if (m_Index.empty())
+		m_Index = index;
+
+	m_DataEnd = std::min(m_DataEnd, dataEnd);
+}
+
+/**
+ * Whether this is a log file written before the introduction of segments.
+ * Those don't contain zones and need to be decoded while replaying.
+ *
+ * @return Whether this is a legacy log file
+ */
+bool ReplayLogReader::IsLegacy() const
+{
+	return m_Legacy;
+}
+
+/**
+ * Reads the next record. Older records are skipped without being read entirely.
+ *
+ * @param record Receives the record
+ * @param after Only return records newer than this timestamp
+ *
+ * @return Whether a record has been read, false at the end of the segment
+ *         or of the readable part of a damaged segment
+ */
+bool ReplayLogReader::Next(ReplayLogRecord& record, double after)
+{
+	if (m_Legacy)
+		return NextLegacy(record, after);
+
+	if (!m_Seeked) {
+		m_Seeked = true;
+
+		auto entry (std::upper_bound(m_Index.begin(), m_Index.end(), after, [](double ts, const ReplayLogIndexEntry& entry) {
+			return ts < entry.MaxTimestampBefore;
+		}));
+
+		if (entry != m_Index.begin()) {
+			m_File->seekg((entry - 1)->Offset);
+		}
+	}
+
+	for (;;) {
+		uint64_t offset = m_File->tellg();
+		char head[l_RecordHeadLength];
+
+		if (offset >= m_DataEnd || m_DataEnd - offset < l_RecordHeadLength || !m_File->read(head, l_RecordHeadLength))
+			return false;
+
+		uint32_t length = ParseUInt32(head);
+		double ts = ParseDouble(head + 4);
+
+		if (length < 8u || m_DataEnd - offset - 4u < length)
+			return false;
+
+		if (ts <= after) {
+			m_File->seekg(offset + 4u + length);
+			continue;
+		}
+
+		std::string body (length - 8u, '\0');
+
+		if (!body.empty() && !m_File->read(&body[0], body.size()))
+			return false;
+
+		if (body.empty()) {
+			BOOST_THROW_EXCEPTION(std::runtime_error("Corrupt replay log record."));
+		}
+
+		unsigned char flags = body[0];
+		size_t pos = 1;
+
+		record.Timestamp = ts;
+
+		if (flags & l_FlagSecobj) {
+			record.SecobjType = ParseString(body, pos);
+			record.SecobjName = ParseString(body, pos);
+		} else {
+			record.SecobjType = String();
+			record.SecobjName = String();
+		}
+
+		record.Zone = flags & l_FlagZone ? ParseString(body, pos) : String();
+		record.Message = ParseString(body, pos);
+
+		return true;
+	}
+}
+
+bool ReplayLogReader::NextLegacy(ReplayLogRecord& record, double after)
+{
+	for (;;) {
+		String message;
+		StreamReadStatus srs = NetString::ReadStringFromStream(m_LegacyStream, &message, m_LegacyContext);
+
+		if (srs == StatusEof)
+			return false;
+
+		if (srs != StatusNewItem)
+			continue;
+
+		Dictionary::Ptr pmessage = JsonDecode(message);
+		double ts = pmessage->Get("timestamp");
+
+		if (ts <= after)
+			continue;
+
+		record.Timestamp = ts;
+		record.Message = pmessage->Get("message");
+		record.Zone = String();
+
+		Dictionary::Ptr secname = pmessage->Get("secobj");
+
+		if (secname) {
+			record.SecobjType = secname->Get("type");
+			record.SecobjName = secname->Get("name");
+		} else {
+			record.SecobjType = String();
+			record.SecobjName = String();
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,120 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef REPLAYLOG_H
+#define REPLAYLOG_H
+
+#include "remote/i2-remote.hpp"
+#include "base/stdiostream.hpp"
+#include "base/stream.hpp"
+#include "base/string.hpp"
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * A message persisted in the replay log.
+ *
+ * @ingroup remote
+ */
+struct ReplayLogRecord
+{
+	double Timestamp = 0;
+
+	/* The message as sent to the endpoints, JSON-encoded. */
+	String Message;
+
+	/* The object the message is about, empty if none. */
+	String SecobjType;
+	String SecobjName;
+
+	/* The zone of that object at the time the message was logged, empty if unknown. */
+	String Zone;
+};
+
+/**
+ * Every 1024 records a segment remembers the offset of the next record together
+ * with the newest timestamp of all records before. The latter never decrease,
+ * so the first record newer than a log position can be found by binary search.
+ *
+ * @ingroup remote
+ */
+struct ReplayLogIndexEntry
+{
+	double MaxTimestampBefore;
+	uint64_t Offset;
+};
+
+/**
+ * Appends records to a replay log segment. A finished segment is terminated
+ * by its index, see Close().
+ *
+ * Format (all integers little-endian):
+ *
+ * - header: "I2RLOG01"
+ * - records: uint32 length of the rest, double timestamp, uint8 flags (1 = secobj, 2 = zone),
+ *   [uint32 length, secobj type, uint32 length, secobj name], [uint32 length, zone],
+ *   uint32 length, message
+ * - index: entries (double, uint64), uint64 entry count, uint64 index offset, "I2RLIDX1"
+ *
+ * @ingroup remote
+ */
+class ReplayLogWriter final
+{
+public:
+	explicit ReplayLogWriter(const String& path);
+
+	void Write(const ReplayLogRecord& record);
+	void Flush();
+	void Close(bool finish);
+
+	std::vector<ReplayLogIndexEntry> GetIndex() const;
+	uint64_t GetOffset() const;
+
+private:
+	std::fstream m_File;
+	std::mutex m_FlushMutex;
+	uint64_t m_Offset;
+	uint64_t m_Records;
+	double m_MaxTimestamp;
+	std::vector<ReplayLogIndexEntry> m_Index;
+
+	uint64_t Recover(const String& path);
+};
+
+/**
+ * Reads the records of a replay log segment or of a legacy log file
+ * (JSON in netstrings), oldest first.
+ *
+ * @ingroup remote
+ */
+class ReplayLogReader final
+{
+public:
+	explicit ReplayLogReader(const String& path);
+	ReplayLogReader(const String& path, const std::vector<ReplayLogIndexEntry>& index, uint64_t dataEnd);
+
+	bool IsLegacy() const;
+
+	bool Next(ReplayLogRecord& record, double after = 0);
+
+private:
+	bool m_Legacy;
+	std::unique_ptr<std::fstream> m_File;
+	uint64_t m_DataEnd;
+	std::vector<ReplayLogIndexEntry> m_Index;
+	bool m_Seeked;
+
+	StdioStream::Ptr m_LegacyStream;
+	StreamReadContext m_LegacyContext;
+
+	bool NextLegacy(ReplayLogRecord& record, double after);
+};
+
+}
+
+#endif /* REPLAYLOG_H */
@@ -0,0 +1,57 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/configobject.hpp"
+#include "base/utility.hpp"
+#include <boost/filesystem.hpp>
+#include <BoostTestTargetConfig.h>
+#include <fstream>
+#include <string>
+
+using namespace icinga;
+
+static String GetTempPath()
+{
+	return (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("icinga2-state-%%%%-%%%%")).string();
+}
+
+static void AppendUInt64(std::string& buffer, uint64_t value)
+{
+	for (int shift = 0; shift < 64; shift += 8) {
+		buffer += (char)(value >> shift);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE(base_configobject)
+
+BOOST_AUTO_TEST_CASE(restore_truncated)
+{
+	String path = GetTempPath();
+
+	/* The header of a binary state file, but no index. */
+	std::ofstream(path.CStr(), std::ios_base::out | std::ios_base::binary) << "I2STAT01" << std::string(100, '\xff');
+
+	BOOST_CHECK_NO_THROW(ConfigObject::RestoreObjects(path));
+
+	Utility::Remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(restore_invalid_record)
+{
+	String path = GetTempPath();
+
+	/* A valid index referring to a record which isn't valid CBOR. */
+	std::string data = "I2STAT01";
+	data += "\xff\xff\xff";
+	AppendUInt64(data, 8);
+	AppendUInt64(data, 1);
+	AppendUInt64(data, 11);
+	data += "I2STIDX1";
+
+	std::ofstream(path.CStr(), std::ios_base::out | std::ios_base::binary) << data;
+
+	BOOST_CHECK_NO_THROW(ConfigObject::RestoreObjects(path));
+
+	Utility::Remove(path);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
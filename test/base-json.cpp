@@ -107,4 +107,39 @@ BOOST_AUTO_TEST_CASE(invalid1)
 	BOOST_CHECK_THROW(JsonDecode("{\"test\": \"test\""), std::exception);
 }
 
+BOOST_AUTO_TEST_CASE(cbor)
+{
+	BOOST_CHECK(CborEncode(new Dictionary({ { "a", 1 } })) == String("\xBF\x61" "a" "\x01\xFF"));
+	BOOST_CHECK(CborEncode(new Array({ -1, 500, -1.25, Value(), true })) == String(std::string("\x9F\x20\x19\x01\xF4\xFB\xBF\xF4\0\0\0\0\0\0\xF6\xF5\xFF", 17)));
+
+	Dictionary::Ptr input (new Dictionary({
+		{ "array", new Array({ new Dictionary(), "x" }) },
+		{ "false", false },
+		{ "float", -1.25 },
+		{ "int", -42 },
+		{ "null", Value() },
+		{ "string", "LF\nTAB\tAUml\xC3\xA4Ill\xC3" },
+		{ "true", true },
+		{ "uint", 23u },
+		{ "big", 4294967296.0 }
+	}));
+
+	auto output ((Dictionary::Ptr)CborDecode(CborEncode(input)));
+	BOOST_CHECK(output->GetKeys() == std::vector<String>({"array", "big", "false", "float", "int", "null", "string", "true", "uint"}));
+	BOOST_CHECK(JsonEncode(output) == JsonEncode(input));
+	BOOST_CHECK(output->Get("string") == "LF\nTAB\tAUml\xC3\xA4Ill\xEF\xBF\xBD");
+
+	BOOST_CHECK_THROW(CborDecode("\xBF\x61" "a"), std::exception);
+}
+
+BOOST_AUTO_TEST_CASE(cbor_depth)
+{
+	String nested (std::string(3, '\x9F') + std::string(3, '\xFF'));
+	BOOST_CHECK(JsonEncode(CborDecode(nested, 3)) == "[[[]]]");
+	BOOST_CHECK_THROW(CborDecode(nested, 2), std::invalid_argument);
+
+	/* Rejected before the parser descends further, so the input needn't even be complete. */
+	BOOST_CHECK_THROW(CborDecode(String(std::string(1000000, '\x9F')), 128), std::invalid_argument);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,221 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "cli/hotreloadutility.hpp"
+#include "icinga/user.hpp"
+#include "base/array.hpp"
+#include "base/configuration.hpp"
+#include "base/dictionary.hpp"
+#include "base/json.hpp"
+#include "base/utility.hpp"
+#include <boost/filesystem.hpp>
+#include <BoostTestTargetConfig.h>
+#include <fstream>
+#include <vector>
+
+using namespace icinga;
+
+static const String l_UsersFile = "/etc/icinga2/conf.d/users.conf";
+static const String l_ConstantsFile = "/etc/icinga2/constants.conf";
+
+/**
+ * Points Configuration.CacheDir, where the objects files are, to a temporary directory.
+ */
+class TempCacheDir
+{
+public:
+	TempCacheDir() : m_CacheDir(Configuration::CacheDir)
+	{
+		String path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("icinga2-hotreload-%%%%-%%%%")).string();
+
+		Utility::MkDirP(path, 0700);
+		Configuration::CacheDir = path;
+	}
+
+	~TempCacheDir()
+	{
+		Utility::RemoveDirRecursive(Configuration::CacheDir);
+		Configuration::CacheDir = m_CacheDir;
+	}
+
+private:
+	String m_CacheDir;
+};
+
+/**
+ * Builds an object the way --dump-objects writes it.
+ */
+static Dictionary::Ptr MakeUser(const String& name, const String& email, const String& pager = String())
+{
+	return new Dictionary({
+		{ "type", "User" },
+		{ "name", name },
+		{ "properties", new Dictionary({
+			{ "__name", name },
+			{ "name", name },
+			{ "email", email },
+			{ "pager", pager },
+			{ "package", "_etc" },
+			{ "zone", "" }
+		}) },
+		{ "debug_hints", new Dictionary() },
+		{ "debug_info", new Array({ l_UsersFile, 1, 0, 4, 0 }) }
+	});
+}
+
+static Dictionary::Ptr MakeFiles(const String& usersHash, const String& constantsHash = "c1")
+{
+	return new Dictionary({
+		{ l_UsersFile, new Dictionary({ { "hash", usersHash }, { "objects_only", true } }) },
+		{ l_ConstantsFile, new Dictionary({ { "hash", constantsHash }, { "objects_only", false } }) }
+	});
+}
+
+static void WriteObjectsFile(const String& path, const std::vector<Dictionary::Ptr>& objects, const Dictionary::Ptr& files)
+{
+	std::ofstream fp (path.CStr(), std::ofstream::out | std::ofstream::trunc);
+
+	for (auto& object : objects) {
+		String json = JsonEncode(object);
+		fp << json.GetLength() << ":" << json << ",";
+	}
+
+	std::ofstream ffp ((path + ".files").CStr(), std::ofstream::out | std::ofstream::trunc);
+	ffp << JsonEncode(files);
+}
+
+/**
+ * Applies the differences between the objects files of the "current" and the "new" configuration.
+ */
+static bool Apply(const std::vector<Dictionary::Ptr>& current, const Dictionary::Ptr& currentFiles,
+	const std::vector<Dictionary::Ptr>& next, const Dictionary::Ptr& nextFiles, String& reason)
+{
+	String objectsPath = HotReloadUtility::GetObjectsPath() + ".new";
+
+	WriteObjectsFile(HotReloadUtility::GetObjectsPath(), current, currentFiles);
+	WriteObjectsFile(objectsPath, next, nextFiles);
+
+	return HotReloadUtility::Apply(objectsPath, reason);
+}
+
+BOOST_AUTO_TEST_SUITE(cli_hotreloadutility)
+
+BOOST_AUTO_TEST_CASE(add_remove)
+{
+	TempCacheDir cacheDir;
+	String reason;
+
+	auto user (MakeUser("hotreload-add", "add@example.com"));
+
+	BOOST_CHECK(Apply({}, MakeFiles("u1"), { user }, MakeFiles("u2"), reason));
+
+	User::Ptr object = User::GetByName("hotreload-add");
+	BOOST_REQUIRE(object);
+	BOOST_CHECK(object->IsActive());
+	BOOST_CHECK_EQUAL(object->GetEmail(), "add@example.com");
+
+	BOOST_CHECK(Apply({ user }, MakeFiles("u2"), {}, MakeFiles("u3"), reason));
+	BOOST_CHECK(!User::GetByName("hotreload-add"));
+	BOOST_CHECK(!object->IsActive());
+}
+
+BOOST_AUTO_TEST_CASE(changed_file)
+{
+	TempCacheDir cacheDir;
+	String reason;
+
+	auto user (MakeUser("hotreload-change", "old@example.com"));
+	auto changedUser (MakeUser("hotreload-change", "new@example.com"));
+
+	BOOST_REQUIRE(Apply({}, MakeFiles("u1"), { user }, MakeFiles("u2"), reason));
+
+	User::Ptr object = User::GetByName("hotreload-change");
+	BOOST_REQUIRE(object);
+
+	BOOST_CHECK(Apply({ user }, MakeFiles("u2"), { changedUser }, MakeFiles("u3"), reason));
+	BOOST_CHECK(User::GetByName("hotreload-change") == object);
+	BOOST_CHECK_EQUAL(object->GetEmail(), "new@example.com");
+
+	/* It's the configuration now, not a runtime modification. */
+	BOOST_CHECK(!object->IsAttributeModified("email"));
+
+	BOOST_CHECK(Apply({ changedUser }, MakeFiles("u3"), {}, MakeFiles("u4"), reason));
+}
+
+BOOST_AUTO_TEST_CASE(fallback)
+{
+	TempCacheDir cacheDir;
+	String reason;
+
+	auto user (MakeUser("hotreload-fallback", "old@example.com"));
+	auto changedUser (MakeUser("hotreload-fallback", "new@example.com"));
+
+	BOOST_REQUIRE(Apply({}, MakeFiles("u1"), { user }, MakeFiles("u2"), reason));
+
+	User::Ptr object = User::GetByName("hotreload-fallback");
+	BOOST_REQUIRE(object);
+
+	/* The constants file may affect any object, so its change requires a restart. Nothing is applied. */
+	BOOST_CHECK(!Apply({ user }, MakeFiles("u2", "c1"), { changedUser }, MakeFiles("u3", "c2"), reason));
+	BOOST_CHECK(reason.Find(l_ConstantsFile) != String::NPos);
+	BOOST_CHECK(reason.Find("more than object definitions") != String::NPos);
+	BOOST_CHECK_EQUAL(object->GetEmail(), "old@example.com");
+
+	/* The same, but unchanged, file doesn't matter. */
+	BOOST_CHECK(Apply({ user }, MakeFiles("u2", "c1"), { changedUser }, MakeFiles("u3", "c1"), reason));
+	BOOST_CHECK_EQUAL(object->GetEmail(), "new@example.com");
+
+	BOOST_CHECK(Apply({ changedUser }, MakeFiles("u3"), {}, MakeFiles("u4"), reason));
+}
+
+BOOST_AUTO_TEST_CASE(modified_attribute)
+{
+	TempCacheDir cacheDir;
+	String reason;
+
+	auto user (MakeUser("hotreload-modified", "old@example.com", "old-pager"));
+	auto changedUser (MakeUser("hotreload-modified", "new@example.com", "new-pager"));
+
+	BOOST_REQUIRE(Apply({}, MakeFiles("u1"), { user }, MakeFiles("u2"), reason));
+
+	User::Ptr object = User::GetByName("hotreload-modified");
+	BOOST_REQUIRE(object);
+
+	object->ModifyAttribute("email", "runtime@example.com");
+
+	BOOST_CHECK(Apply({ user }, MakeFiles("u2"), { changedUser }, MakeFiles("u3"), reason));
+
+	/* The runtime modification wins over the changed configuration, other attributes are updated. */
+	BOOST_CHECK_EQUAL(object->GetEmail(), "runtime@example.com");
+	BOOST_CHECK(object->IsAttributeModified("email"));
+	BOOST_CHECK_EQUAL(object->GetPager(), "new-pager");
+
+	BOOST_CHECK(Apply({ changedUser }, MakeFiles("u3"), {}, MakeFiles("u4"), reason));
+}
+
+BOOST_AUTO_TEST_CASE(invalid_update)
+{
+	TempCacheDir cacheDir;
+	String reason;
+
+	auto user (MakeUser("hotreload-invalid", "old@example.com"));
+	auto changedUser (MakeUser("hotreload-invalid", "new@example.com"));
+	auto addedUser (MakeUser("hotreload-invalid-add", "add@example.com"));
+
+	Dictionary::Ptr properties = changedUser->Get("properties");
+	properties->Set("period", "hotreload-missing");
+
+	BOOST_REQUIRE(Apply({}, MakeFiles("u1"), { user }, MakeFiles("u2"), reason));
+
+	User::Ptr object = User::GetByName("hotreload-invalid");
+	BOOST_REQUIRE(object);
+
+	/* The update refers to an object which doesn't exist, so nothing is applied, not even the create. */
+	BOOST_CHECK(!Apply({ user }, MakeFiles("u2"), { changedUser, addedUser }, MakeFiles("u3"), reason));
+	BOOST_CHECK(reason.Find("period") != String::NPos);
+	BOOST_CHECK_EQUAL(object->GetEmail(), "old@example.com");
+	BOOST_CHECK(!User::GetByName("hotreload-invalid-add"));
+
+	BOOST_CHECK(Apply({ user }, MakeFiles("u2"), {}, MakeFiles("u3"), reason));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -77,6 +77,17 @@ static void GetTargetServicesHelper(
 	}
 }
 
+static void AddRuleHelper(const String& name, const String& filter)
+{
+	auto compiled (ConfigCompiler::CompileText("<test>", filter));
+	Expression::Ptr expr = RequireActualExpression(compiled);
+
+	/* The filter is owned by the rule from now on. */
+	(void)compiled.release();
+
+	ApplyRule::AddRule("Service", "Host", name, new LiteralExpression(Empty), expr, "_etc", "", "", nullptr, false, DebugInfo(), nullptr);
+}
+
 BOOST_AUTO_TEST_SUITE(config_apply)
 
 BOOST_AUTO_TEST_CASE(gettargethosts_literal)
@@ -248,4 +259,39 @@ BOOST_AUTO_TEST_CASE(gettargetservices_noindexer_service)
 	GetTargetServicesHelper("host.name == \"foo\" && name == \"bar\"", nullptr, false);
 }
 
+BOOST_AUTO_TEST_CASE(getcandidaterules)
+{
+	AddRuleHelper("prefilter-in", "\"linux\" in host.groups");
+	AddRuleHelper("prefilter-in-no", "\"windows\" in host.groups");
+	AddRuleHelper("prefilter-eq", "host.vars.os == \"Linux\" && host.vars.role != \"db\"");
+	AddRuleHelper("prefilter-eq-no", "host.vars.role != \"db\" && host.vars.os == \"Windows\"");
+	AddRuleHelper("prefilter-impure", "len(host.name) > 1 && host.vars.os == \"Windows\"");
+	AddRuleHelper("prefilter-match", "match(\"web*\", host.name)");
+	AddRuleHelper("prefilter-match-no", "match(\"db*\", host.name)");
+	AddRuleHelper("prefilter-or", "host.vars.os == \"Windows\" || \"linux\" in host.groups");
+	AddRuleHelper("prefilter-or-no", "host.vars.os == \"Windows\" || !(\"linux\" in host.groups) && host.vars.os == \"BSD\"");
+	AddRuleHelper("prefilter-error", "\"linux\" in host.vars.os");
+	AddRuleHelper("prefilter-null", "host.vars.missing == \"\"");
+
+	Dictionary::Ptr host = new Dictionary({
+		{ "name", "web01" },
+		{ "groups", new Array({ "linux", "web" }) },
+		{ "vars", new Dictionary({ { "os", "Linux" } }) }
+	});
+
+	std::vector<String> names;
+
+	for (auto& rule : ApplyRule::GetCandidateRules(Type::GetByName("Service"), Type::GetByName("Host"), host)) {
+		if (rule->GetName().Contains("prefilter-")) {
+			names.emplace_back(rule->GetName());
+		}
+	}
+
+	std::vector<String> expected ({
+		"prefilter-in", "prefilter-eq", "prefilter-impure", "prefilter-match", "prefilter-or", "prefilter-error", "prefilter-null"
+	});
+
+	BOOST_CHECK_EQUAL_COLLECTIONS(names.begin(), names.end(), expected.begin(), expected.end());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,101 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "config/bytecode.hpp"
+#include "config/configcompiler.hpp"
+#include "base/exception.hpp"
+#include "base/json.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+static Dictionary::Ptr MakeLocals()
+{
+	Dictionary::Ptr vars = new Dictionary({
+		{ "os", "Linux" },
+		{ "port", 22 },
+		{ "disks", new Array({ "/", "/var" }) }
+	});
+
+	Dictionary::Ptr host = new Dictionary({
+		{ "name", "web01" },
+		{ "groups", new Array({ "linux", "web" }) },
+		{ "vars", vars }
+	});
+
+	return new Dictionary({ { "host", host } });
+}
+
+static String Run(const Expression *expr)
+{
+	ScriptFrame frame(true);
+	frame.Locals = MakeLocals();
+
+	try {
+		return JsonEncode(expr->Evaluate(frame).GetValue());
+	} catch (const ScriptError& ex) {
+		return "error: " + String(ex.what());
+	}
+}
+
+/* Both engines must yield the same results and errors. */
+static void CheckSame(const String& text)
+{
+	std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<test>", text);
+	std::unique_ptr<BytecodeExpression> program = BytecodeExpression::TryCompile(expr.get());
+
+	BOOST_REQUIRE_MESSAGE(program, "Cannot compile: " << text);
+	BOOST_CHECK_MESSAGE(Run(program.get()) == Run(expr.get()), "Different result: " << text);
+}
+
+BOOST_AUTO_TEST_SUITE(config_bytecode)
+
+BOOST_AUTO_TEST_CASE(compare)
+{
+	CheckSame("");
+	CheckSame("1 + 2 * 3 - 4 / 2");
+	CheckSame("\"web\" + 1");
+	CheckSame("7 % 3 + (5 ^ 1) + (6 & 3) + (1 | 2) + (1 << 4) + (64 >> 2)");
+	CheckSame("-host.vars.port");
+	CheckSame("host.name == \"web01\" && host.vars.port > 20");
+	CheckSame("host.name != \"web01\" || host.vars.port <= 22");
+	CheckSame("host.vars.missing || \"default\"");
+	CheckSame("host.vars.port && host.vars.os");
+	CheckSame("!host.vars.missing");
+	CheckSame("host.vars.os in [ \"Linux\", \"FreeBSD\" ]");
+	CheckSame("host.vars.os !in [ \"Windows\", host.name ]");
+	CheckSame("\"web\" in host.groups");
+	CheckSame("\"web\" in host.vars.missing");
+	CheckSame("\"web\" !in host.vars.missing");
+	CheckSame("1 in 2");
+	CheckSame("match(\"web*\", host.name) && regex(\"^web\", host.name)");
+	CheckSame("host.name.contains(\"01\")");
+	CheckSame("host.groups.contains(\"web\") && len(host.vars.disks) == 2");
+	CheckSame("locals.host[\"name\"]");
+	CheckSame("String(host.vars.port)");
+	CheckSame("[ host.name, host.vars.port, [ 1, 2 ] ]");
+	CheckSame("undefined_variable == 1");
+	CheckSame("host.name / 2");
+	CheckSame("host.name()");
+	CheckSame("1 / 0");
+}
+
+BOOST_AUTO_TEST_CASE(folding)
+{
+	std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<test>", "2 * 3 + 1 == 7 && !false");
+	std::unique_ptr<BytecodeExpression> program = BytecodeExpression::TryCompile(expr.get());
+
+	BOOST_REQUIRE(program);
+	BOOST_CHECK(program->GetInstructionCount() == 0);
+	BOOST_CHECK(Run(program.get()) == "true");
+}
+
+BOOST_AUTO_TEST_CASE(unsupported)
+{
+	std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<test>", "var x = 1; x");
+	BOOST_CHECK(!BytecodeExpression::TryCompile(expr.get()));
+
+	expr = ConfigCompiler::CompileText("<test>", "{ a = 1 }");
+	BOOST_CHECK(!BytecodeExpression::TryCompile(expr.get()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,107 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "config/compiledconfigcache.hpp"
+#include "config/configcompiler.hpp"
+#include "base/configuration.hpp"
+#include "base/exception.hpp"
+#include "base/utility.hpp"
+#include <boost/filesystem.hpp>
+#include <BoostTestTargetConfig.h>
+#include <fstream>
+
+using namespace icinga;
+
+static Value RoundTrip(const String& text)
+{
+	std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<test>", text);
+	String data = CompiledConfigCache::Serialize(expr.get());
+
+	/* Serializing the decoded tree must yield the very same data. */
+	std::unique_ptr<Expression> copy = CompiledConfigCache::Deserialize(data);
+	BOOST_CHECK(CompiledConfigCache::Serialize(copy.get()) == data);
+
+	ScriptFrame frame(true);
+	return copy->Evaluate(frame).GetValue();
+}
+
+static String GetTempPath()
+{
+	return (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("icinga2-compiledconfig-%%%%-%%%%")).string();
+}
+
+BOOST_AUTO_TEST_SUITE(config_compiledconfigcache)
+
+BOOST_AUTO_TEST_CASE(roundtrip)
+{
+	BOOST_CHECK(RoundTrip("") == Empty);
+	BOOST_CHECK(RoundTrip("1 + 3 * 2") == 7);
+	BOOST_CHECK(RoundTrip("\"a\" + \"b\" + \"a\"") == "aba");
+	BOOST_CHECK(RoundTrip("0.5 + 0.25") == 0.75);
+	BOOST_CHECK(RoundTrip("true && !false") == true);
+	BOOST_CHECK(RoundTrip("null") == Empty);
+	BOOST_CHECK(RoundTrip("3 in [ 1, 2, 3 ]") == true);
+	BOOST_CHECK(RoundTrip("var a = 2; a += 3; a") == 5);
+	BOOST_CHECK(RoundTrip("var d = { a = 1; b = { c = 2 } }; d.b.c") == 2);
+	BOOST_CHECK(RoundTrip("var s = 0; for (i in [ 1, 2, 3 ]) { if (i == 2) { continue }; s += i }; s") == 4);
+	BOOST_CHECK(RoundTrip("var i = 0; while (true) { i += 1; if (i >= 5) { break } }; i") == 5);
+	BOOST_CHECK(RoundTrip("function f(x) { return x * 2 }; f(21)") == 42);
+	BOOST_CHECK(RoundTrip("var y = 2; var f = function(x) use (y) { x * y }; f(4)") == 8);
+	BOOST_CHECK(RoundTrip("var r = 0; try { throw \"x\" } except { r = 7 }; r") == 7);
+	BOOST_CHECK(RoundTrip("namespace ns { x = 3 }; ns.x") == 3);
+	BOOST_CHECK(RoundTrip("Math.max(3, 4)") == 4);
+}
+
+BOOST_AUTO_TEST_CASE(debuginfo)
+{
+	std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<test>", "1 +\n  2");
+	std::unique_ptr<Expression> copy = CompiledConfigCache::Deserialize(CompiledConfigCache::Serialize(expr.get()));
+
+	const DebugInfo& di = expr->GetDebugInfo();
+	const DebugInfo& copyDi = copy->GetDebugInfo();
+
+	BOOST_CHECK(copyDi.Path == di.Path);
+	BOOST_CHECK(copyDi.FirstLine == di.FirstLine);
+	BOOST_CHECK(copyDi.FirstColumn == di.FirstColumn);
+	BOOST_CHECK(copyDi.LastLine == di.LastLine);
+	BOOST_CHECK(copyDi.LastColumn == di.LastColumn);
+}
+
+BOOST_AUTO_TEST_CASE(invalid)
+{
+	std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<test>", "var x = [ 1, 2, 3 ]");
+	String data = CompiledConfigCache::Serialize(expr.get());
+
+	BOOST_CHECK_THROW(CompiledConfigCache::Deserialize(data.SubStr(0, data.GetLength() - 1)), std::runtime_error);
+	BOOST_CHECK_THROW(CompiledConfigCache::Deserialize(data + "x"), std::runtime_error);
+	BOOST_CHECK_THROW(CompiledConfigCache::Deserialize("\xff"), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(prune)
+{
+	String cacheDir = Configuration::CacheDir;
+	String dir = GetTempPath();
+
+	Utility::MkDirP(dir, 0700);
+	Configuration::CacheDir = dir;
+
+	String kept = dir + "/kept.conf";
+	String removed = dir + "/removed.conf";
+	String content = "var x = 1";
+
+	std::ofstream(kept.CStr()) << content;
+
+	std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<test>", content);
+	CompiledConfigCache::Store(kept, content, "", "", expr.get());
+	CompiledConfigCache::Store(removed, content, "", "", expr.get());
+
+	/* Entries of existing files are kept even if this process didn't compile them. */
+	CompiledConfigCache::Prune();
+
+	BOOST_CHECK(CompiledConfigCache::Load(kept, content, "", ""));
+	BOOST_CHECK(!CompiledConfigCache::Load(removed, content, "", ""));
+
+	Utility::RemoveDirRecursive(dir);
+	Configuration::CacheDir = cacheDir;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
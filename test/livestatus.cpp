@@ -102,6 +102,37 @@ BOOST_AUTO_TEST_CASE(services)
 
 	BOOST_TEST_MESSAGE("Done with testing livestatus services...");
 }
+
+BOOST_AUTO_TEST_CASE(hosts_filter)
+{
+	BOOST_TEST_MESSAGE( "Querying Livestatus...");
+
+	std::vector<String> lines;
+	lines.emplace_back("GET hosts");
+	lines.emplace_back("Columns: host_name");
+	lines.emplace_back("Filter: address = 127.0.0.2");
+	lines.emplace_back("Filter: name ~ ^test-");
+	lines.emplace_back("OutputFormat: json");
+	lines.emplace_back("\n");
+
+	Array::Ptr query_result = JsonDecode(LivestatusQueryHelper(lines));
+
+	BOOST_CHECK(query_result->GetLength() == 1);
+	BOOST_CHECK(Array::Ptr(query_result->Get(0))->Get(0) == "test-02");
+
+	lines.clear();
+	lines.emplace_back("GET hosts");
+	lines.emplace_back("Columns: host_name");
+	lines.emplace_back("Limit: 1");
+	lines.emplace_back("OutputFormat: json");
+	lines.emplace_back("\n");
+
+	query_result = JsonDecode(LivestatusQueryHelper(lines));
+
+	BOOST_CHECK(query_result->GetLength() == 1);
+
+	BOOST_TEST_MESSAGE("Done with testing livestatus host filters...");
+}
 //____________________________________________________________________________//
 
 BOOST_AUTO_TEST_SUITE_END()
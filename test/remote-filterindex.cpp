@@ -0,0 +1,143 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "remote/filterindex.hpp"
+#include "remote/filterutility.hpp"
+#include "config/configcompiler.hpp"
+#include "config/configitem.hpp"
+#include "base/configtype.hpp"
+#include "base/function.hpp"
+#include "base/namespace.hpp"
+#include <BoostTestTargetConfig.h>
+#include <algorithm>
+#include <set>
+
+using namespace icinga;
+
+static void CreateTestObjects()
+{
+	String config = R"CONFIG(
+object CheckCommand "filterindex-dummy" {
+  command = "/bin/echo"
+}
+
+object HostGroup "filterindex-web" {
+}
+
+object Host "filterindex-web-1" {
+  check_command = "filterindex-dummy"
+  groups = [ "filterindex-web" ]
+  vars.role = "web"
+}
+
+object Host "filterindex-web-2" {
+  check_command = "filterindex-dummy"
+  groups = [ "filterindex-web" ]
+  vars.role = "web"
+}
+
+object Host "filterindex-db-1" {
+  check_command = "filterindex-dummy"
+  vars.role = "db"
+}
+
+apply Service "filterindex-http" {
+  check_command = "filterindex-dummy"
+  assign where "filterindex-web" in host.groups
+}
+
+apply Service "filterindex-disk" {
+  check_command = "filterindex-dummy"
+  assign where match("filterindex-*", host.name)
+}
+)CONFIG";
+
+	std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<filterindex>", config);
+	expr->Evaluate(*ScriptFrame::GetCurrentFrame());
+}
+
+static void EnsureTestObjects()
+{
+	static bool created = false;
+
+	if (!created) {
+		ConfigItem::RunWithActivationContext(new Function("CreateTestObjects", CreateTestObjects));
+		created = true;
+	}
+}
+
+static std::set<String> Evaluate(Expression *filter, const String& variableName, const std::vector<ConfigObject::Ptr>& objects)
+{
+	std::set<String> names;
+
+	for (const ConfigObject::Ptr& object : objects) {
+		ScriptFrame frame (false, new Namespace());
+
+		if (FilterUtility::EvaluateFilter(frame, filter, object, variableName))
+			names.insert(object->GetName());
+	}
+
+	return names;
+}
+
+/**
+ * Checks that evaluating the filter only for the candidates from the index
+ * yields the same objects as evaluating it for all objects of the type.
+ *
+ * @returns The names of the matching objects
+ */
+static std::set<String> CheckIndexed(const String& typeName, const String& filterText)
+{
+	EnsureTestObjects();
+
+	BOOST_TEST_MESSAGE("Filter for type '" << typeName << "': " << filterText);
+
+	Type::Ptr type = Type::GetByName(typeName);
+	String variableName = typeName.ToLower();
+	std::unique_ptr<Expression> filter = ConfigCompiler::CompileText("<filter>", filterText);
+
+	std::vector<ConfigObject::Ptr> candidates;
+	BOOST_REQUIRE(FilterIndex::GetCandidates(filter.get(), type, variableName, nullptr, candidates));
+
+	std::vector<ConfigObject::Ptr> objects = dynamic_cast<ConfigType *>(type.get())->GetObjects();
+
+	/* The candidates have to be in the same order as all objects. */
+	auto position (objects.begin());
+
+	for (const ConfigObject::Ptr& candidate : candidates) {
+		position = std::find(position, objects.end(), candidate);
+		BOOST_CHECK(position != objects.end());
+	}
+
+	std::set<String> indexed = Evaluate(filter.get(), variableName, candidates);
+	std::set<String> scanned = Evaluate(filter.get(), variableName, objects);
+
+	BOOST_CHECK(indexed == scanned);
+
+	return scanned;
+}
+
+BOOST_AUTO_TEST_SUITE(remote_filterindex)
+
+BOOST_AUTO_TEST_CASE(hosts)
+{
+	BOOST_CHECK(CheckIndexed("Host", "host.name == \"filterindex-web-1\"").size() == 1);
+	BOOST_CHECK(CheckIndexed("Host", "\"filterindex-db-1\" == host.__name").size() == 1);
+	BOOST_CHECK(CheckIndexed("Host", "host.name == \"filterindex-missing\"").empty());
+	BOOST_CHECK(CheckIndexed("Host", "match(\"filterindex-web*\", host.name)").size() == 2);
+	BOOST_CHECK(CheckIndexed("Host", "\"filterindex-web\" in host.groups").size() == 2);
+	BOOST_CHECK(CheckIndexed("Host", "host.name == \"filterindex-web-1\" || host.name == \"filterindex-db-1\"").size() == 2);
+	BOOST_CHECK(CheckIndexed("Host", "match(\"filterindex-*\", host.name) && host.vars.role == \"db\"").size() == 1);
+	BOOST_CHECK(CheckIndexed("Host", "\"filterindex-web\" in host.groups && match(\"filterindex-*-2\", host.name)").size() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(services)
+{
+	BOOST_CHECK(CheckIndexed("Service", "host.name == \"filterindex-web-2\"").size() == 2);
+	BOOST_CHECK(CheckIndexed("Service", "service.host_name == \"filterindex-db-1\"").size() == 1);
+	BOOST_CHECK(CheckIndexed("Service", "service.__name == \"filterindex-web-1!filterindex-http\"").size() == 1);
+	BOOST_CHECK(CheckIndexed("Service", "\"filterindex-web\" in host.groups && service.name == \"filterindex-http\"").size() == 2);
+	BOOST_CHECK(CheckIndexed("Service", "match(\"filterindex-web*\", host.name) || host.name == \"filterindex-db-1\"").size() == 5);
+	BOOST_CHECK(CheckIndexed("Service", "service.check_command == \"filterindex-dummy\"").size() == 5);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,118 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "remote/httputility.hpp"
+#include "base/convert.hpp"
+#include "base/io-engine.hpp"
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http.hpp>
+#include <stdexcept>
+#include <thread>
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+namespace asio = boost::asio;
+namespace http = boost::beast::http;
+
+/**
+ * Sends the items over a local TCP connection and reads the response on the other side.
+ *
+ * @returns Whether SendJsonArrayChunked() threw.
+ */
+static bool SendAndReceive(size_t count, const std::function<Value(size_t)>& getItem,
+	http::response_parser<http::string_body>& parser, boost::system::error_code& ec)
+{
+	asio::io_context io;
+	asio::ip::tcp::acceptor acceptor (io, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+	asio::ip::tcp::socket server (io);
+	asio::ip::tcp::socket client (io);
+
+	client.connect(acceptor.local_endpoint());
+	acceptor.accept(server);
+
+	bool threw = false;
+
+	IoEngine::SpawnCoroutine(io, [&server, &threw, count, &getItem](asio::yield_context yc) {
+		http::response<http::string_body> response;
+		response.result(http::status::ok);
+
+		try {
+			HttpUtility::SendJsonArrayChunked(server, response, "results", count, getItem, false, yc);
+		} catch (const std::exception&) {
+			threw = true;
+		}
+	});
+
+	std::thread sender ([&io]() { io.run(); });
+
+	boost::beast::flat_buffer buf;
+	parser.body_limit(-1);
+	http::read(client, buf, parser, ec);
+
+	sender.join();
+
+	return threw;
+}
+
+BOOST_AUTO_TEST_SUITE(remote_httputility)
+
+BOOST_AUTO_TEST_CASE(chunked)
+{
+	/* Large enough for several chunks. */
+	size_t count = 5000;
+
+	http::response_parser<http::string_body> parser;
+	boost::system::error_code ec;
+
+	BOOST_CHECK(!SendAndReceive(count, [](size_t i) -> Value {
+		return new Dictionary({ { "name", "object-" + Convert::ToString(i) }, { "padding", String(64, 'x') } });
+	}, parser, ec));
+
+	BOOST_REQUIRE(!ec);
+	BOOST_CHECK(parser.chunked());
+	BOOST_CHECK(parser.get()[http::field::content_type] == "application/json");
+
+	Dictionary::Ptr body = JsonDecode(parser.get().body());
+	Array::Ptr results = body->Get("results");
+
+	BOOST_REQUIRE(results);
+	BOOST_CHECK(results->GetLength() == count);
+	BOOST_CHECK(static_cast<Dictionary::Ptr>(results->Get(count - 1))->Get("name") == "object-4999");
+}
+
+BOOST_AUTO_TEST_CASE(chunked_empty)
+{
+	http::response_parser<http::string_body> parser;
+	boost::system::error_code ec;
+
+	BOOST_CHECK(!SendAndReceive(0, [](size_t) -> Value { return Empty; }, parser, ec));
+
+	BOOST_REQUIRE(!ec);
+	BOOST_CHECK(parser.get().body() == "{\"results\":[]}");
+}
+
+BOOST_AUTO_TEST_CASE(chunked_error)
+{
+	/* Fail after some chunks have been sent already. */
+	size_t count = 5000;
+
+	http::response_parser<http::string_body> parser;
+	boost::system::error_code ec;
+
+	BOOST_CHECK(SendAndReceive(count, [](size_t i) -> Value {
+		if (i == 4000)
+			BOOST_THROW_EXCEPTION(std::runtime_error("Serialization failed"));
+
+		return new Dictionary({ { "name", "object-" + Convert::ToString(i) }, { "padding", String(64, 'x') } });
+	}, parser, ec));
+
+	/* The header has been received, but the body lacks its terminating chunk. */
+	BOOST_CHECK(parser.is_header_done());
+	BOOST_CHECK(parser.get().result() == http::status::ok);
+	BOOST_CHECK(ec == http::error::partial_message);
+	BOOST_CHECK(!parser.is_done());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,257 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "remote/replaylog.hpp"
+#include "base/convert.hpp"
+#include "base/dictionary.hpp"
+#include "base/json.hpp"
+#include "base/netstring.hpp"
+#include "base/stdiostream.hpp"
+#include <boost/filesystem.hpp>
+#include <BoostTestTargetConfig.h>
+#include <fstream>
+
+using namespace icinga;
+
+static String GetTempPath()
+{
+	return (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("icinga2-replaylog-%%%%-%%%%")).string();
+}
+
+static ReplayLogRecord MakeRecord(int i)
+{
+	ReplayLogRecord record;
+	record.Timestamp = i;
+	record.Message = "{\"jsonrpc\":\"2.0\",\"method\":\"event::Heartbeat\",\"params\":{\"i\":" + Convert::ToString(i) + "}}";
+
+	if (i % 2) {
+		record.SecobjType = "Host";
+		record.SecobjName = "host" + Convert::ToString(i);
+		record.Zone = "master";
+	}
+
+	return record;
+}
+
+BOOST_AUTO_TEST_SUITE(remote_replaylog)
+
+BOOST_AUTO_TEST_CASE(segment)
+{
+	String path = GetTempPath();
+
+	{
+		ReplayLogWriter writer (path);
+
+		for (int i = 1; i <= 3000; i++) {
+			writer.Write(MakeRecord(i));
+		}
+
+		writer.Close(true);
+	}
+
+	ReplayLogRecord record;
+
+	{
+		ReplayLogReader reader (path);
+		BOOST_CHECK(!reader.IsLegacy());
+
+		int expected = 1;
+
+		while (reader.Next(record)) {
+			ReplayLogRecord original = MakeRecord(expected);
+
+			BOOST_CHECK(record.Timestamp == original.Timestamp);
+			BOOST_CHECK(record.Message == original.Message);
+			BOOST_CHECK(record.SecobjType == original.SecobjType);
+			BOOST_CHECK(record.SecobjName == original.SecobjName);
+			BOOST_CHECK(record.Zone == original.Zone);
+
+			expected++;
+		}
+
+		BOOST_CHECK(expected == 3001);
+	}
+
+	{
+		ReplayLogReader reader (path);
+
+		BOOST_CHECK(reader.Next(record, 2500));
+		BOOST_CHECK(record.Timestamp == 2501);
+	}
+
+	/* Reopening a finished segment continues it. */
+	{
+		ReplayLogWriter writer (path);
+		writer.Write(MakeRecord(3001));
+		writer.Close(false);
+	}
+
+	{
+		ReplayLogReader reader (path);
+
+		BOOST_CHECK(reader.Next(record, 2999));
+		BOOST_CHECK(record.Timestamp == 3000);
+		BOOST_CHECK(reader.Next(record, 2999));
+		BOOST_CHECK(record.Timestamp == 3001);
+		BOOST_CHECK(!reader.Next(record, 2999));
+	}
+
+	boost::filesystem::remove(path.GetData());
+}
+
+BOOST_AUTO_TEST_CASE(truncated)
+{
+	String path = GetTempPath();
+
+	{
+		ReplayLogWriter writer (path);
+		writer.Write(MakeRecord(1));
+		writer.Write(MakeRecord(2));
+		writer.Close(false);
+	}
+
+	boost::filesystem::resize_file(path.GetData(), boost::filesystem::file_size(path.GetData()) - 3);
+
+	ReplayLogRecord record;
+
+	{
+		ReplayLogReader reader (path);
+
+		BOOST_CHECK(reader.Next(record));
+		BOOST_CHECK(record.Timestamp == 1);
+		BOOST_CHECK(!reader.Next(record));
+	}
+
+	{
+		ReplayLogWriter writer (path);
+		writer.Write(MakeRecord(3));
+		writer.Close(true);
+	}
+
+	{
+		ReplayLogReader reader (path);
+
+		BOOST_CHECK(reader.Next(record));
+		BOOST_CHECK(record.Timestamp == 1);
+		BOOST_CHECK(reader.Next(record));
+		BOOST_CHECK(record.Timestamp == 3);
+		BOOST_CHECK(!reader.Next(record));
+	}
+
+	boost::filesystem::remove(path.GetData());
+}
+
+BOOST_AUTO_TEST_CASE(concurrent)
+{
+	String path = GetTempPath();
+	ReplayLogWriter writer (path);
+
+	for (int i = 1; i <= 2000; i++) {
+		writer.Write(MakeRecord(i));
+	}
+
+	writer.Flush();
+
+	ReplayLogReader reader (path, writer.GetIndex(), writer.GetOffset());
+
+	/* Neither more records nor the index appended by finishing the segment are read. */
+	writer.Write(MakeRecord(2001));
+	writer.Close(true);
+
+	ReplayLogRecord record;
+
+	BOOST_CHECK(reader.Next(record, 1500));
+	BOOST_CHECK(record.Timestamp == 1501);
+
+	int expected = 1502;
+
+	while (reader.Next(record, 1500)) {
+		BOOST_CHECK(record.Timestamp == expected);
+		expected++;
+	}
+
+	BOOST_CHECK(expected == 2001);
+
+	boost::filesystem::remove(path.GetData());
+}
+
+BOOST_AUTO_TEST_CASE(oversized)
+{
+	String path = GetTempPath();
+
+	{
+		ReplayLogWriter writer (path);
+		writer.Write(MakeRecord(1));
+		writer.Write(MakeRecord(2));
+		writer.Close(false);
+	}
+
+	/* Make the length of the second record exceed the file, its head follows the header and the first record. */
+	{
+		std::fstream fp (path.CStr(), std::fstream::in | std::fstream::out | std::fstream::binary);
+		unsigned char length[4];
+
+		fp.seekg(8);
+		fp.read((char*)length, 4);
+
+		fp.seekp(8 + 4 + (length[0] | length[1] << 8u | length[2] << 16u | (uint32_t)length[3] << 24u));
+		fp.write("\xF0\xFF\xFF\xFF", 4);
+	}
+
+	ReplayLogReader reader (path);
+	ReplayLogRecord record;
+
+	BOOST_CHECK(reader.Next(record));
+	BOOST_CHECK(record.Timestamp == 1);
+	BOOST_CHECK(!reader.Next(record));
+
+	boost::filesystem::remove(path.GetData());
+}
+
+BOOST_AUTO_TEST_CASE(legacy)
+{
+	String path = GetTempPath();
+
+	{
+		StdioStream::Ptr stream = new StdioStream(new std::fstream(path.CStr(), std::fstream::out | std::fstream::binary), true);
+
+		for (int i = 1; i <= 3; i++) {
+			ReplayLogRecord original = MakeRecord(i);
+
+			Dictionary::Ptr pmessage = new Dictionary({
+				{ "timestamp", original.Timestamp },
+				{ "message", original.Message }
+			});
+
+			if (!original.SecobjType.IsEmpty()) {
+				pmessage->Set("secobj", new Dictionary({
+					{ "type", original.SecobjType },
+					{ "name", original.SecobjName }
+				}));
+			}
+
+			NetString::WriteStringToStream(stream, JsonEncode(pmessage));
+		}
+
+		stream->Close();
+	}
+
+	ReplayLogReader reader (path);
+	BOOST_CHECK(reader.IsLegacy());
+
+	ReplayLogRecord record;
+
+	BOOST_CHECK(reader.Next(record, 1));
+	BOOST_CHECK(record.Timestamp == 2);
+	BOOST_CHECK(record.Message == MakeRecord(2).Message);
+	BOOST_CHECK(record.SecobjType.IsEmpty());
+
+	BOOST_CHECK(reader.Next(record, 1));
+	BOOST_CHECK(record.SecobjName == "host3");
+	BOOST_CHECK(record.Zone.IsEmpty());
+
+	BOOST_CHECK(!reader.Next(record, 1));
+
+	boost::filesystem::remove(path.GetData());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -848,6 +848,9 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 				else
 					m_Impl << field.SetAccessor << std::endl << std::endl;
 
+				if (field.Attributes & FAState)
+					m_Impl << "\t" << "OnStateFieldChanged();" << std::endl;
+
 				if (field.Type.IsName || !field.TrackAccessor.empty()) {
 					if (field.Name != "active") {
 						m_Impl << "\t" << "if (!dobj || dobj->IsActive())" << std::endl